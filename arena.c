@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGNMENT 16
+
+static arena_block_t *create_block(size_t size, arena_block_t *next) {
+    arena_block_t *block = malloc(sizeof(arena_block_t) + size);
+    if (!block) return NULL;
+
+    block->next = next;
+    block->used = 0;
+    block->size = size;
+
+    return block;
+}
+
+arena_t *arena_create(size_t block_size) {
+    arena_t *arena = malloc(sizeof(arena_t));
+    if (!arena) return NULL;
+
+    arena->head = NULL;
+    arena->block_size = block_size ? block_size : 64 * 1024;
+
+    return arena;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    if (!arena) return NULL;
+
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+
+    arena_block_t *block = arena->head;
+    if (!block || block->size - block->used < size) {
+        // Oversized requests get a block of their own behind the current
+        // one, so the space left in the current block is not wasted.
+        if (block && size > arena->block_size / 4) {
+            arena_block_t *own = create_block(size, block->next);
+            if (!own) return NULL;
+            block->next = own;
+            own->used = size;
+            return own->data;
+        }
+
+        block = create_block(size > arena->block_size ? size : arena->block_size, arena->head);
+        if (!block) return NULL;
+        arena->head = block;
+    }
+
+    void *memory = block->data + block->used;
+    block->used += size;
+
+    return memory;
+}
+
+char *arena_strndup(arena_t *arena, const char *str, size_t length) {
+    char *copy = arena_alloc(arena, length + 1);
+    if (!copy) return NULL;
+
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+
+    return copy;
+}
+
+char *arena_strdup(arena_t *arena, const char *str) {
+    return arena_strndup(arena, str, strlen(str));
+}
+
+void arena_destroy(arena_t *arena) {
+    if (!arena) return;
+
+    arena_block_t *block = arena->head;
+    while (block) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(arena);
+}
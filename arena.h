@@ -0,0 +1,26 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Region allocator. Allocations are carved out of large blocks and are never
+// freed individually; arena_destroy releases everything at once.
+typedef struct arena_block {
+    struct arena_block *next;
+    size_t used;
+    size_t size;
+    _Alignas(16) char data[];
+} arena_block_t;
+
+typedef struct {
+    arena_block_t *head;
+    size_t block_size;
+} arena_t;
+
+arena_t *arena_create(size_t block_size);
+void *arena_alloc(arena_t *arena, size_t size);
+char *arena_strndup(arena_t *arena, const char *str, size_t length);
+char *arena_strdup(arena_t *arena, const char *str);
+void arena_destroy(arena_t *arena);
+
+#endif
@@ -1,9 +1,36 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ast.h"
+#include "work_stack.h"
+
+// Arena the AST is allocated from. Without one, nodes fall back to malloc
+// and are never freed.
+static arena_t *current_arena = NULL;
+
+void ast_set_arena(arena_t *arena) {
+    current_arena = arena;
+}
+
+arena_t *ast_get_arena(void) {
+    return current_arena;
+}
+
+void *ast_alloc(size_t size) {
+    if (current_arena) {
+        return arena_alloc(current_arena, size);
+    }
+    return malloc(size);
+}
+
+char *ast_strndup(const char *str, size_t length) {
+    if (current_arena) {
+        return arena_strndup(current_arena, str, length);
+    }
+    return strndup(str, length);
+}
 
 struct type *create_type(type_kind_t kind, struct type *subtype, struct param_list *params) {
-    struct type *t = malloc(sizeof(struct type));
+    struct type *t = ast_alloc(sizeof(struct type));
     if (!t) return NULL;
 
     t->kind = kind;
@@ -14,50 +41,47 @@ struct type *create_type(type_kind_t kind, struct type *subtype, struct param_li
     return t;
 }
 
-struct param_list *create_param(char *name, struct type *type, struct param_list *next) {
-    struct param_list *p = malloc(sizeof(struct param_list));
+struct param_list *create_param(const char *name, struct type *type, struct param_list *next) {
+    struct param_list *p = ast_alloc(sizeof(struct param_list));
     if (!p) return NULL;
 
     p->name = name;
     p->type = type;
     p->next = next;
+    p->symbol = NULL;
 
     return p;
 }
 
 struct expr *create_expr(expr_kind_t kind, struct expr *left, struct expr *right) {
-    struct expr *e = malloc(sizeof(struct expr));
+    struct expr *e = ast_alloc(sizeof(struct expr));
     if (!e) return NULL;
 
     e->kind = kind;
+    e->integer_value = 0;
+    e->type = NULL;
     e->left = left;
     e->right = right;
-    e->name = NULL;
-    e->integer_value = 0;
-    e->string_literal = NULL;
 
     return e;
 }
 
 struct stmt *create_stmt(stmt_kind_t kind) {
-    struct stmt *s = malloc(sizeof(struct stmt));
+    struct stmt *s = ast_alloc(sizeof(struct stmt));
     if (!s) return NULL;
 
     s->kind = kind;
+    s->next = NULL;
     s->expr = NULL;
+    s->body = NULL;
     s->init_expr = NULL;
     s->next_expr = NULL;
-    s->body = NULL;
-    s->else_body = NULL;
-    s->next = NULL;
-    s->decl = NULL;
-    s->comment_text = NULL;
 
     return s;
 }
 
-struct decl *create_decl(char *name, struct type *type, struct expr *value, struct stmt *code, struct decl *next) {
-    struct decl *d = malloc(sizeof(struct decl));
+struct decl *create_decl(const char *name, struct type *type, struct expr *value, struct stmt *code, struct decl *next) {
+    struct decl *d = ast_alloc(sizeof(struct decl));
     if (!d) return NULL;
 
     d->name = name;
@@ -67,12 +91,13 @@ struct decl *create_decl(char *name, struct type *type, struct expr *value, stru
     d->next = next;
     d->kind = type && type->kind == TYPE_FUNCTION ? DECL_FUNCTION : DECL_VARIABLE;
     d->comment_text = NULL;
+    d->symbol = NULL;
 
     return d;
 }
 
 struct decl *create_comment_decl(char *comment_text, int is_multi, struct decl *next) {
-    struct decl *d = malloc(sizeof(struct decl));
+    struct decl *d = ast_alloc(sizeof(struct decl));
     if (!d) return NULL;
 
     d->name = NULL;
@@ -82,10 +107,119 @@ struct decl *create_comment_decl(char *comment_text, int is_multi, struct decl *
     d->next = next;
     d->kind = is_multi ? DECL_MULTI_COMMENT : DECL_COMMENT;
     d->comment_text = comment_text;
+    d->symbol = NULL;
 
     return d;
 }
 
+int expr_has_operands(struct expr *e) {
+    switch (e->kind) {
+        case EXPR_NAME:
+        case EXPR_INTEGER_LITERAL:
+        case EXPR_STRING_LITERAL:
+        case EXPR_CHAR_LITERAL:
+        case EXPR_BOOL_LITERAL:
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+typedef struct {
+    struct expr *e;
+    struct stmt *s;
+    struct decl *d;
+} visit_work_t;
+
+static void push_visit(work_stack_t *stack, struct expr *e, struct stmt *s, struct decl *d) {
+    if (!e && !s && !d) return;
+
+    visit_work_t *item = work_stack_push(stack);
+    item->e = e;
+    item->s = s;
+    item->d = d;
+}
+
+// Everything in s except the statements after it.
+static void push_stmt_parts(work_stack_t *stack, struct stmt *s) {
+    switch (s->kind) {
+        case STMT_DECL:
+            push_visit(stack, NULL, NULL, s->decl);
+            break;
+        case STMT_IF_ELSE:
+            push_visit(stack, NULL, s->else_body, NULL);
+            push_visit(stack, NULL, s->body, NULL);
+            push_visit(stack, s->expr, NULL, NULL);
+            break;
+        case STMT_FOR:
+            push_visit(stack, NULL, s->body, NULL);
+            push_visit(stack, s->next_expr, NULL, NULL);
+            push_visit(stack, s->expr, NULL, NULL);
+            push_visit(stack, s->init_expr, NULL, NULL);
+            break;
+        case STMT_COMMENT:
+        case STMT_MULTI_COMMENT:
+            break;
+        default:
+            push_visit(stack, NULL, s->body, NULL);
+            push_visit(stack, s->expr, NULL, NULL);
+            break;
+    }
+}
+
+static void run_visits(work_stack_t *stack, void (*visit)(struct expr *e, void *context), void *context) {
+    visit_work_t item;
+    while (work_stack_pop(stack, &item)) {
+        if (item.e) {
+            visit(item.e, context);
+            if (expr_has_operands(item.e)) {
+                push_visit(stack, item.e->right, NULL, NULL);
+                push_visit(stack, item.e->left, NULL, NULL);
+            }
+        } else if (item.s) {
+            push_visit(stack, NULL, item.s->next, NULL);
+            push_stmt_parts(stack, item.s);
+        } else {
+            if (item.d->type && item.d->type->kind == TYPE_ARRAY) {
+                push_visit(stack, item.d->type->array_size, NULL, NULL);
+            }
+            push_visit(stack, NULL, item.d->code, NULL);
+            push_visit(stack, item.d->value, NULL, NULL);
+        }
+    }
+}
+
+static void visit_decl(work_stack_t *stack, struct decl *d, void (*visit)(struct expr *e, void *context), void *context) {
+    push_visit(stack, NULL, NULL, d);
+    run_visits(stack, visit, context);
+}
+
+void ast_visit_exprs(struct decl *program, void (*visit)(struct expr *e, void *context), void *context) {
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(visit_work_t));
+
+    for (struct decl *d = program; d; d = d->next) {
+        visit_decl(&stack, d, visit, context);
+    }
+
+    work_stack_free(&stack);
+}
+
+void ast_visit_decl_exprs(struct decl *d, void (*visit)(struct expr *e, void *context), void *context) {
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(visit_work_t));
+    visit_decl(&stack, d, visit, context);
+    work_stack_free(&stack);
+}
+
+void ast_visit_stmt_exprs(struct stmt *s, void (*visit)(struct expr *e, void *context), void *context) {
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(visit_work_t));
+    push_stmt_parts(&stack, s);
+    run_visits(&stack, visit, context);
+    work_stack_free(&stack);
+}
+
 void print_type(struct type *t) {
     if (!t) return;
 
@@ -131,68 +265,145 @@ void print_type(struct type *t) {
     }
 }
 
-void print_expr(struct expr *e) {
-    if (!e) return;
+// The dumpers below work from an explicit stack, like the code generator,
+// so they handle any nesting depth and list length. Each node pushes its
+// pieces in reverse so they pop in output order.
+typedef struct {
+    struct expr *e;
+    const char *text;           // printed instead when e is NULL
+} print_expr_work_t;
+
+static void push_print_expr(work_stack_t *stack, struct expr *e, const char *text) {
+    print_expr_work_t *item = work_stack_push(stack);
+    item->e = e;
+    item->text = text;
+}
 
-    switch (e->kind) {
-        case EXPR_NAME:
-            printf("%s", e->name);
-            break;
-        case EXPR_INTEGER_LITERAL:
-            printf("%d", e->integer_value);
-            break;
-        case EXPR_STRING_LITERAL:
-            printf("\"%s\"", e->string_literal);
-            break;
-        case EXPR_CHAR_LITERAL:
-            printf("'%c'", e->integer_value);
-            break;
-        case EXPR_BOOL_LITERAL:
-            printf("%s", e->integer_value ? "true" : "false");
-            break;
-        case EXPR_CALL:
-            print_expr(e->left);
-            printf("(");
-            print_expr(e->right);
-            printf(")");
-            break;
-        default:
-            printf("(");
-            print_expr(e->left);
-
-            switch (e->kind) {
-                case EXPR_ADD: printf(" + "); break;
-                case EXPR_SUB: printf(" - "); break;
-                case EXPR_MUL: printf(" * "); break;
-                case EXPR_DIV: printf(" / "); break;
-                case EXPR_MOD: printf(" %% "); break;
-                case EXPR_EQ: printf(" == "); break;
-                case EXPR_NEQ: printf(" != "); break;
-                case EXPR_LT: printf(" < "); break;
-                case EXPR_GT: printf(" > "); break;
-                case EXPR_LE: printf(" <= "); break;
-                case EXPR_GE: printf(" >= "); break;
-                case EXPR_AND: printf(" && "); break;
-                case EXPR_OR: printf(" || "); break;
-                default: printf(" ? "); break;
-            }
+static const char *binary_operator_text(expr_kind_t kind) {
+    switch (kind) {
+        case EXPR_ADD: return " + ";
+        case EXPR_SUB: return " - ";
+        case EXPR_MUL: return " * ";
+        case EXPR_DIV: return " / ";
+        case EXPR_MOD: return " % ";
+        case EXPR_EQ: return " == ";
+        case EXPR_NEQ: return " != ";
+        case EXPR_LT: return " < ";
+        case EXPR_GT: return " > ";
+        case EXPR_LE: return " <= ";
+        case EXPR_GE: return " >= ";
+        case EXPR_AND: return " && ";
+        case EXPR_OR: return " || ";
+        default: return " ? ";
+    }
+}
 
-            print_expr(e->right);
-            printf(")");
-            break;
+void print_expr(struct expr *root) {
+    if (!root) return;
+
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(print_expr_work_t));
+    push_print_expr(&stack, root, NULL);
+
+    print_expr_work_t item;
+    while (work_stack_pop(&stack, &item)) {
+        struct expr *e = item.e;
+
+        if (!e) {
+            if (item.text) fputs(item.text, stdout);
+            continue;
+        }
+
+        switch (e->kind) {
+            case EXPR_NAME:
+                printf("%s", e->name);
+                break;
+            case EXPR_INTEGER_LITERAL:
+                printf("%d", e->integer_value);
+                break;
+            case EXPR_STRING_LITERAL:
+                printf("\"%s\"", e->string_literal);
+                break;
+            case EXPR_CHAR_LITERAL:
+                printf("'%c'", e->integer_value);
+                break;
+            case EXPR_BOOL_LITERAL:
+                printf("%s", e->integer_value ? "true" : "false");
+                break;
+            case EXPR_CALL:
+                push_print_expr(&stack, NULL, ")");
+                push_print_expr(&stack, e->right, NULL);
+                push_print_expr(&stack, NULL, "(");
+                push_print_expr(&stack, e->left, NULL);
+                break;
+            case EXPR_ARG:
+                if (e->right) {
+                    push_print_expr(&stack, e->right, NULL);
+                    push_print_expr(&stack, NULL, ", ");
+                }
+                push_print_expr(&stack, e->left, NULL);
+                break;
+            case EXPR_ARRAY_LITERAL:
+                push_print_expr(&stack, NULL, "}");
+                push_print_expr(&stack, e->right, NULL);
+                printf("{");
+                break;
+            default:
+                push_print_expr(&stack, NULL, ")");
+                push_print_expr(&stack, e->right, NULL);
+                push_print_expr(&stack, NULL, binary_operator_text(e->kind));
+                push_print_expr(&stack, e->left, NULL);
+                printf("(");
+                break;
+        }
     }
+
+    work_stack_free(&stack);
 }
 
-void print_stmt(struct stmt *s, int indent) {
-    if (!s) return;
+// Statements and declarations nest inside each other, so both go on one
+// stack. An item is the rest of a statement list, the rest of a
+// declaration list, or a line of text.
+typedef struct {
+    struct stmt *s;
+    struct decl *d;
+    const char *text;
+    int indent;
+} print_work_t;
+
+static void push_print(work_stack_t *stack, struct stmt *s, struct decl *d, const char *text, int indent) {
+    print_work_t *item = work_stack_push(stack);
+    item->s = s;
+    item->d = d;
+    item->text = text;
+    item->indent = indent;
+}
+
+// Deeper nesting is printed at this depth, which keeps the output linear.
+#define MAX_INDENT 64
+
+static void print_indent_spaces(int indent) {
+    if (indent > MAX_INDENT) {
+        indent = MAX_INDENT;
+    }
 
     for (int i = 0; i < indent; i++) {
         printf("  ");
     }
+}
+
+static void print_stmt_item(work_stack_t *stack, struct stmt *s, int indent) {
+    if (s->next) {
+        push_print(stack, s->next, NULL, NULL, indent);
+    }
+
+    print_indent_spaces(indent);
 
     switch (s->kind) {
         case STMT_DECL:
-            print_decl(s->decl, 0);
+            if (s->decl) {
+                push_print(stack, NULL, s->decl, NULL, 0);
+            }
             break;
         case STMT_EXPR:
             print_expr(s->expr);
@@ -202,22 +413,16 @@ void print_stmt(struct stmt *s, int indent) {
             printf("if (");
             print_expr(s->expr);
             printf(") {\n");
-            print_stmt(s->body, indent + 1);
-            for (int i = 0; i < indent; i++) {
-                printf("  ");
-            }
-            printf("}\n");
 
             if (s->else_body) {
-                for (int i = 0; i < indent; i++) {
-                    printf("  ");
-                }
-                printf("else {\n");
-                print_stmt(s->else_body, indent + 1);
-                for (int i = 0; i < indent; i++) {
-                    printf("  ");
-                }
-                printf("}\n");
+                push_print(stack, NULL, NULL, "}\n", indent);
+                push_print(stack, s->else_body, NULL, NULL, indent + 1);
+                push_print(stack, NULL, NULL, "else {\n", indent);
+            }
+
+            push_print(stack, NULL, NULL, "}\n", indent);
+            if (s->body) {
+                push_print(stack, s->body, NULL, NULL, indent + 1);
             }
             break;
         case STMT_FOR:
@@ -234,11 +439,11 @@ void print_stmt(struct stmt *s, int indent) {
                 print_expr(s->next_expr);
             }
             printf(") {\n");
-            print_stmt(s->body, indent + 1);
-            for (int i = 0; i < indent; i++) {
-                printf("  ");
+
+            push_print(stack, NULL, NULL, "}\n", indent);
+            if (s->body) {
+                push_print(stack, s->body, NULL, NULL, indent + 1);
             }
-            printf("}\n");
             break;
         case STMT_PRINT:
             printf("print ");
@@ -255,11 +460,11 @@ void print_stmt(struct stmt *s, int indent) {
             break;
         case STMT_BLOCK:
             printf("{\n");
-            print_stmt(s->body, indent + 1);
-            for (int i = 0; i < indent; i++) {
-                printf("  ");
+
+            push_print(stack, NULL, NULL, "}\n", indent);
+            if (s->body) {
+                push_print(stack, s->body, NULL, NULL, indent + 1);
             }
-            printf("}\n");
             break;
         case STMT_COMMENT:
             printf("%s\n", s->comment_text);
@@ -268,19 +473,15 @@ void print_stmt(struct stmt *s, int indent) {
             printf("%s\n", s->comment_text);
             break;
     }
-
-    if (s->next) {
-        print_stmt(s->next, indent);
-    }
 }
 
-void print_decl(struct decl *d, int indent) {
-    if (!d) return;
-
-    for (int i = 0; i < indent; i++) {
-        printf("  ");
+static void print_decl_item(work_stack_t *stack, struct decl *d, int indent) {
+    if (d->next) {
+        push_print(stack, NULL, d->next, NULL, indent);
     }
 
+    print_indent_spaces(indent);
+
     switch (d->kind) {
         case DECL_VARIABLE:
         case DECL_FUNCTION:
@@ -294,11 +495,8 @@ void print_decl(struct decl *d, int indent) {
 
             if (d->code) {
                 printf(" = {\n");
-                print_stmt(d->code, indent + 1);
-                for (int i = 0; i < indent; i++) {
-                    printf("  ");
-                }
-                printf("}\n");
+                push_print(stack, NULL, NULL, "}\n", indent);
+                push_print(stack, d->code, NULL, NULL, indent + 1);
             } else {
                 printf(";\n");
             }
@@ -312,8 +510,34 @@ void print_decl(struct decl *d, int indent) {
             printf("%s\n", d->comment_text);
             break;
     }
+}
 
-    if (d->next) {
-        print_decl(d->next, indent);
+static void print_tree(struct stmt *s, struct decl *d, int indent) {
+    if (!s && !d) return;
+
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(print_work_t));
+    push_print(&stack, s, d, NULL, indent);
+
+    print_work_t item;
+    while (work_stack_pop(&stack, &item)) {
+        if (item.s) {
+            print_stmt_item(&stack, item.s, item.indent);
+        } else if (item.d) {
+            print_decl_item(&stack, item.d, item.indent);
+        } else {
+            print_indent_spaces(item.indent);
+            fputs(item.text, stdout);
+        }
     }
-}
\ No newline at end of file
+
+    work_stack_free(&stack);
+}
+
+void print_stmt(struct stmt *s, int indent) {
+    print_tree(s, NULL, indent);
+}
+
+void print_decl(struct decl *d, int indent) {
+    print_tree(NULL, d, indent);
+}
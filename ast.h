@@ -1,7 +1,9 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stddef.h>
 #include <stdio.h>
+#include "arena.h"
 
 typedef enum {
     TYPE_VOID,
@@ -61,6 +63,8 @@ typedef enum {
     DECL_MULTI_COMMENT
 } decl_kind_t;
 
+struct symbol;
+
 struct type {
     type_kind_t kind;
     struct type *subtype;
@@ -69,50 +73,97 @@ struct type {
 };
 
 struct param_list {
-    char *name;
+    const char *name;
     struct type *type;
     struct param_list *next;
+
+    struct symbol *symbol;          // set by typecheck_program
 };
 
+// Nodes keep only what their kind uses. Names and string literals keep
+// their payload in the space the other kinds use for operands, so code that
+// does not know the kind of a node checks expr_has_operands before it
+// follows left or right.
 struct expr {
     expr_kind_t kind;
-    struct expr *left;
-    struct expr *right;
+    int integer_value;              // integer, character and boolean literals
+    struct type *type;              // of the value, set by typecheck_program
 
-    char *name;
-    int integer_value;
-    char *string_literal;
+    union {
+        struct {
+            struct expr *left;
+            struct expr *right;
+        };
+        struct {
+            const char *name;       // EXPR_NAME
+            struct symbol *symbol;  // the declaration it resolves to, set by typecheck_program
+        };
+        char *string_literal;       // EXPR_STRING_LITERAL
+    };
 };
 
+// expr holds the condition of if and for and the value of the other
+// statements that have one; body is the body of if, for and blocks. The
+// rest depends on the kind: code that does not know it checks it first.
 struct stmt {
     stmt_kind_t kind;
+    struct stmt *next;
     struct expr *expr;
-    struct expr *init_expr;
-    struct expr *next_expr;
     struct stmt *body;
-    struct stmt *else_body;
-    struct stmt *next;
-    struct decl *decl;
-    char *comment_text;
+
+    union {
+        struct {
+            struct expr *init_expr; // STMT_FOR
+            struct expr *next_expr;
+        };
+        struct stmt *else_body;     // STMT_IF_ELSE
+        struct decl *decl;          // STMT_DECL
+        char *comment_text;         // STMT_COMMENT, STMT_MULTI_COMMENT
+    };
 };
 
 struct decl {
-    char *name;
+    const char *name;
     struct type *type;
     struct expr *value;
     struct stmt *code;
     struct decl *next;
     decl_kind_t kind;
     char *comment_text;
+
+    struct symbol *symbol;          // set by typecheck_program
 };
 
+// All AST constructors allocate from the arena set here, so a whole tree is
+// released with a single arena_destroy.
+void ast_set_arena(arena_t *arena);
+arena_t *ast_get_arena(void);
+void *ast_alloc(size_t size);
+char *ast_strndup(const char *str, size_t length);
+
 struct type *create_type(type_kind_t kind, struct type *subtype, struct param_list *params);
-struct param_list *create_param(char *name, struct type *type, struct param_list *next);
+struct param_list *create_param(const char *name, struct type *type, struct param_list *next);
 struct expr *create_expr(expr_kind_t kind, struct expr *left, struct expr *right);
 struct stmt *create_stmt(stmt_kind_t kind);
-struct decl *create_decl(char *name, struct type *type, struct expr *value, struct stmt *code, struct decl *next);
+struct decl *create_decl(const char *name, struct type *type, struct expr *value, struct stmt *code, struct decl *next);
 struct decl *create_comment_decl(char *comment_text, int is_multi, struct decl *next);
 
+// Whether left and right are operands of e: not for names and literals.
+int expr_has_operands(struct expr *e);
+
+// Calls visit on every expression node in the program: initializers,
+// array sizes and every expression in function bodies, nested ones
+// included. Nodes are visited parents first, in no particular order
+// otherwise.
+void ast_visit_exprs(struct decl *program, void (*visit)(struct expr *e, void *context), void *context);
+
+// The same for the one declaration d, without the ones after it.
+void ast_visit_decl_exprs(struct decl *d, void (*visit)(struct expr *e, void *context), void *context);
+
+// The same for the one statement s and the statements nested in it, without
+// the ones after it.
+void ast_visit_stmt_exprs(struct stmt *s, void (*visit)(struct expr *e, void *context), void *context);
+
 void print_type(struct type *t);
 void print_expr(struct expr *e);
 void print_stmt(struct stmt *s, int indent);
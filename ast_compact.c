@@ -0,0 +1,546 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ast_compact.h"
+
+static uint32_t pool_push(void **items, uint32_t *count, uint32_t *capacity, size_t item_size) {
+    if (*count == *capacity) {
+        uint32_t new_capacity = *capacity ? *capacity * 2 : 64;
+        void *grown = realloc(*items, new_capacity * item_size);
+        if (!grown) {
+            return NODE_NONE;
+        }
+        *items = grown;
+        *capacity = new_capacity;
+    }
+
+    memset((char *) *items + *count * item_size, 0, item_size);
+    return (*count)++;
+}
+
+#define POOL_PUSH(pool) \
+    pool_push((void **) &(pool).items, &(pool).count, &(pool).capacity, sizeof(*(pool).items))
+
+/* Pointer AST to compact AST */
+
+// Names are interned and outlive both trees, so only literal and comment
+// text is copied into the compact AST's own storage.
+static string_ref_t add_string(compact_ast_t *ast, const char *str, int copy) {
+    if (!str) return NODE_NONE;
+
+    string_ref_t ref = POOL_PUSH(ast->strings);
+    if (ref != NODE_NONE) {
+        ast->strings.items[ref] = copy ? arena_strdup(ast->string_data, str) : str;
+    }
+    return ref;
+}
+
+static node_ref_t compact_expr(compact_ast_t *ast, struct expr *e);
+
+// Argument and element lists are converted iteratively so long lists do not
+// recurse once per element.
+static node_ref_t compact_arg_list(compact_ast_t *ast, struct expr *e) {
+    node_ref_t first = NODE_NONE;
+    node_ref_t previous = NODE_NONE;
+
+    for (; e; e = e->right) {
+        node_ref_t value = compact_expr(ast, e->left);
+        node_ref_t cell = POOL_PUSH(ast->exprs);
+        if (cell == NODE_NONE) break;
+
+        ast->exprs.items[cell].kind = EXPR_ARG;
+        ast->exprs.items[cell].as.binary.left = value;
+
+        if (previous) {
+            ast->exprs.items[previous].as.binary.right = cell;
+        } else {
+            first = cell;
+        }
+        previous = cell;
+    }
+
+    return first;
+}
+
+static node_ref_t compact_expr(compact_ast_t *ast, struct expr *e) {
+    if (!e) return NODE_NONE;
+
+    struct compact_expr node;
+    memset(&node, 0, sizeof(node));
+    node.kind = e->kind;
+
+    switch (e->kind) {
+        case EXPR_NAME:
+            node.as.name = add_string(ast, e->name, 0);
+            break;
+        case EXPR_INTEGER_LITERAL:
+        case EXPR_CHAR_LITERAL:
+        case EXPR_BOOL_LITERAL:
+            node.as.integer_value = e->integer_value;
+            break;
+        case EXPR_STRING_LITERAL:
+            node.as.string_literal = add_string(ast, e->string_literal, 1);
+            break;
+        case EXPR_UNARY_MINUS:
+        case EXPR_NOT:
+            node.as.operand = compact_expr(ast, e->right);
+            break;
+        case EXPR_ARRAY_LITERAL:
+            node.as.elements = compact_arg_list(ast, e->right);
+            break;
+        case EXPR_ARG:
+            return compact_arg_list(ast, e);
+        case EXPR_CALL:
+            node.as.binary.left = compact_expr(ast, e->left);
+            node.as.binary.right = compact_arg_list(ast, e->right);
+            break;
+        default:
+            node.as.binary.left = compact_expr(ast, e->left);
+            node.as.binary.right = compact_expr(ast, e->right);
+            break;
+    }
+
+    node_ref_t ref = POOL_PUSH(ast->exprs);
+    if (ref != NODE_NONE) {
+        ast->exprs.items[ref] = node;
+    }
+    return ref;
+}
+
+static node_ref_t compact_type(compact_ast_t *ast, struct type *t);
+
+static node_ref_t compact_params(compact_ast_t *ast, struct param_list *p) {
+    node_ref_t first = NODE_NONE;
+    node_ref_t previous = NODE_NONE;
+
+    for (; p; p = p->next) {
+        node_ref_t type = compact_type(ast, p->type);
+        node_ref_t ref = POOL_PUSH(ast->params);
+        if (ref == NODE_NONE) break;
+
+        ast->params.items[ref].name = add_string(ast, p->name, 0);
+        ast->params.items[ref].type = type;
+
+        if (previous) {
+            ast->params.items[previous].next = ref;
+        } else {
+            first = ref;
+        }
+        previous = ref;
+    }
+
+    return first;
+}
+
+static node_ref_t compact_type(compact_ast_t *ast, struct type *t) {
+    if (!t) return NODE_NONE;
+
+    struct compact_type node;
+    node.kind = t->kind;
+    node.subtype = compact_type(ast, t->subtype);
+    node.params = compact_params(ast, t->params);
+    node.array_size = compact_expr(ast, t->array_size);
+
+    node_ref_t ref = POOL_PUSH(ast->types);
+    if (ref != NODE_NONE) {
+        ast->types.items[ref] = node;
+    }
+    return ref;
+}
+
+static node_ref_t compact_decls(compact_ast_t *ast, struct decl *d);
+
+static node_ref_t compact_stmts(compact_ast_t *ast, struct stmt *s) {
+    node_ref_t first = NODE_NONE;
+    node_ref_t previous = NODE_NONE;
+
+    for (; s; s = s->next) {
+        struct compact_stmt node;
+        memset(&node, 0, sizeof(node));
+        node.kind = s->kind;
+
+        switch (s->kind) {
+            case STMT_DECL:
+                node.as.decl = compact_decls(ast, s->decl);
+                break;
+            case STMT_EXPR:
+            case STMT_PRINT:
+            case STMT_RETURN:
+                node.as.expr = compact_expr(ast, s->expr);
+                break;
+            case STMT_IF_ELSE:
+                node.as.if_else.condition = compact_expr(ast, s->expr);
+                node.as.if_else.body = compact_stmts(ast, s->body);
+                node.as.if_else.else_body = compact_stmts(ast, s->else_body);
+                break;
+            case STMT_FOR:
+                node.as.for_loop.init = compact_expr(ast, s->init_expr);
+                node.as.for_loop.condition = compact_expr(ast, s->expr);
+                node.as.for_loop.step = compact_expr(ast, s->next_expr);
+                node.as.for_loop.body = compact_stmts(ast, s->body);
+                break;
+            case STMT_BLOCK:
+                node.as.body = compact_stmts(ast, s->body);
+                break;
+            case STMT_COMMENT:
+            case STMT_MULTI_COMMENT:
+                node.as.comment_text = add_string(ast, s->comment_text, 1);
+                break;
+        }
+
+        node_ref_t ref = POOL_PUSH(ast->stmts);
+        if (ref == NODE_NONE) break;
+        ast->stmts.items[ref] = node;
+
+        if (previous) {
+            ast->stmts.items[previous].next = ref;
+        } else {
+            first = ref;
+        }
+        previous = ref;
+    }
+
+    return first;
+}
+
+static node_ref_t compact_decls(compact_ast_t *ast, struct decl *d) {
+    node_ref_t first = NODE_NONE;
+    node_ref_t previous = NODE_NONE;
+
+    for (; d; d = d->next) {
+        struct compact_decl node;
+        memset(&node, 0, sizeof(node));
+        node.kind = d->kind;
+
+        if (d->kind == DECL_COMMENT || d->kind == DECL_MULTI_COMMENT) {
+            node.name = add_string(ast, d->comment_text, 1);
+        } else {
+            node.name = add_string(ast, d->name, 0);
+            node.type = compact_type(ast, d->type);
+            node.value = compact_expr(ast, d->value);
+            node.code = compact_stmts(ast, d->code);
+        }
+
+        node_ref_t ref = POOL_PUSH(ast->decls);
+        if (ref == NODE_NONE) break;
+        ast->decls.items[ref] = node;
+
+        if (previous) {
+            ast->decls.items[previous].next = ref;
+        } else {
+            first = ref;
+        }
+        previous = ref;
+    }
+
+    return first;
+}
+
+compact_ast_t *compact_from_ast(struct decl *program) {
+    compact_ast_t *ast = calloc(1, sizeof(compact_ast_t));
+    if (!ast) return NULL;
+
+    ast->string_data = arena_create(0);
+
+    // Claim slot 0 of every pool for NODE_NONE.
+    POOL_PUSH(ast->exprs);
+    POOL_PUSH(ast->stmts);
+    POOL_PUSH(ast->types);
+    POOL_PUSH(ast->params);
+    POOL_PUSH(ast->decls);
+    POOL_PUSH(ast->strings);
+
+    ast->program = compact_decls(ast, program);
+
+    return ast;
+}
+
+/* Compact AST to pointer AST */
+
+static char *expand_string(compact_ast_t *ast, string_ref_t ref) {
+    const char *str = ast->strings.items[ref];
+    return str ? ast_strndup(str, strlen(str)) : NULL;
+}
+
+static struct expr *expand_expr(compact_ast_t *ast, node_ref_t ref);
+
+static struct expr *expand_arg_list(compact_ast_t *ast, node_ref_t ref) {
+    struct expr *first = NULL;
+    struct expr *previous = NULL;
+
+    for (; ref; ref = ast->exprs.items[ref].as.binary.right) {
+        struct expr *cell = create_expr(EXPR_ARG, expand_expr(ast, ast->exprs.items[ref].as.binary.left), NULL);
+
+        if (previous) {
+            previous->right = cell;
+        } else {
+            first = cell;
+        }
+        previous = cell;
+    }
+
+    return first;
+}
+
+static struct expr *expand_expr(compact_ast_t *ast, node_ref_t ref) {
+    if (!ref) return NULL;
+
+    struct compact_expr *node = &ast->exprs.items[ref];
+    struct expr *e = NULL;
+
+    switch (node->kind) {
+        case EXPR_NAME:
+            e = create_expr(EXPR_NAME, NULL, NULL);
+            e->name = ast->strings.items[node->as.name];
+            break;
+        case EXPR_INTEGER_LITERAL:
+        case EXPR_CHAR_LITERAL:
+        case EXPR_BOOL_LITERAL:
+            e = create_expr(node->kind, NULL, NULL);
+            e->integer_value = node->as.integer_value;
+            break;
+        case EXPR_STRING_LITERAL:
+            e = create_expr(EXPR_STRING_LITERAL, NULL, NULL);
+            e->string_literal = expand_string(ast, node->as.string_literal);
+            break;
+        case EXPR_UNARY_MINUS:
+        case EXPR_NOT:
+            e = create_expr(node->kind, NULL, expand_expr(ast, node->as.operand));
+            break;
+        case EXPR_ARRAY_LITERAL:
+            e = create_expr(EXPR_ARRAY_LITERAL, NULL, expand_arg_list(ast, node->as.elements));
+            break;
+        case EXPR_ARG:
+            e = expand_arg_list(ast, ref);
+            break;
+        case EXPR_CALL:
+            e = create_expr(EXPR_CALL, expand_expr(ast, node->as.binary.left),
+                            expand_arg_list(ast, node->as.binary.right));
+            break;
+        default:
+            e = create_expr(node->kind, expand_expr(ast, node->as.binary.left),
+                            expand_expr(ast, node->as.binary.right));
+            break;
+    }
+
+    return e;
+}
+
+static struct type *expand_type(compact_ast_t *ast, node_ref_t ref);
+
+static struct param_list *expand_params(compact_ast_t *ast, node_ref_t ref) {
+    struct param_list *first = NULL;
+    struct param_list *previous = NULL;
+
+    for (; ref; ref = ast->params.items[ref].next) {
+        struct compact_param *node = &ast->params.items[ref];
+        struct param_list *p = create_param(ast->strings.items[node->name], expand_type(ast, node->type), NULL);
+
+        if (previous) {
+            previous->next = p;
+        } else {
+            first = p;
+        }
+        previous = p;
+    }
+
+    return first;
+}
+
+static struct type *expand_type(compact_ast_t *ast, node_ref_t ref) {
+    if (!ref) return NULL;
+
+    struct compact_type *node = &ast->types.items[ref];
+    struct type *t = create_type(node->kind, expand_type(ast, node->subtype), expand_params(ast, node->params));
+    t->array_size = expand_expr(ast, node->array_size);
+
+    return t;
+}
+
+static struct decl *expand_decls(compact_ast_t *ast, node_ref_t ref);
+
+static struct stmt *expand_stmts(compact_ast_t *ast, node_ref_t ref) {
+    struct stmt *first = NULL;
+    struct stmt *previous = NULL;
+
+    for (; ref; ref = ast->stmts.items[ref].next) {
+        struct compact_stmt *node = &ast->stmts.items[ref];
+        struct stmt *s = create_stmt(node->kind);
+
+        switch (node->kind) {
+            case STMT_DECL:
+                s->decl = expand_decls(ast, node->as.decl);
+                break;
+            case STMT_EXPR:
+            case STMT_PRINT:
+            case STMT_RETURN:
+                s->expr = expand_expr(ast, node->as.expr);
+                break;
+            case STMT_IF_ELSE:
+                s->expr = expand_expr(ast, node->as.if_else.condition);
+                s->body = expand_stmts(ast, node->as.if_else.body);
+                s->else_body = expand_stmts(ast, node->as.if_else.else_body);
+                break;
+            case STMT_FOR:
+                s->init_expr = expand_expr(ast, node->as.for_loop.init);
+                s->expr = expand_expr(ast, node->as.for_loop.condition);
+                s->next_expr = expand_expr(ast, node->as.for_loop.step);
+                s->body = expand_stmts(ast, node->as.for_loop.body);
+                break;
+            case STMT_BLOCK:
+                s->body = expand_stmts(ast, node->as.body);
+                break;
+            case STMT_COMMENT:
+            case STMT_MULTI_COMMENT:
+                s->comment_text = expand_string(ast, node->as.comment_text);
+                break;
+        }
+
+        if (previous) {
+            previous->next = s;
+        } else {
+            first = s;
+        }
+        previous = s;
+    }
+
+    return first;
+}
+
+static struct decl *expand_decls(compact_ast_t *ast, node_ref_t ref) {
+    struct decl *first = NULL;
+    struct decl *previous = NULL;
+
+    for (; ref; ref = ast->decls.items[ref].next) {
+        struct compact_decl *node = &ast->decls.items[ref];
+        struct decl *d;
+
+        if (node->kind == DECL_COMMENT || node->kind == DECL_MULTI_COMMENT) {
+            d = create_comment_decl(expand_string(ast, node->name), node->kind == DECL_MULTI_COMMENT, NULL);
+        } else {
+            d = create_decl(ast->strings.items[node->name], expand_type(ast, node->type),
+                            expand_expr(ast, node->value), expand_stmts(ast, node->code), NULL);
+            d->kind = node->kind;
+        }
+
+        if (previous) {
+            previous->next = d;
+        } else {
+            first = d;
+        }
+        previous = d;
+    }
+
+    return first;
+}
+
+struct decl *compact_to_ast(compact_ast_t *ast) {
+    if (!ast) return NULL;
+    return expand_decls(ast, ast->program);
+}
+
+void free_compact_ast(compact_ast_t *ast) {
+    if (!ast) return;
+
+    free(ast->exprs.items);
+    free(ast->stmts.items);
+    free(ast->types.items);
+    free(ast->params.items);
+    free(ast->decls.items);
+    free(ast->strings.items);
+    arena_destroy(ast->string_data);
+    free(ast);
+}
+
+/* Size accounting */
+
+size_t compact_ast_size(compact_ast_t *ast) {
+    if (!ast) return 0;
+
+    size_t size = sizeof(compact_ast_t);
+    size += ast->exprs.count * sizeof(struct compact_expr);
+    size += ast->stmts.count * sizeof(struct compact_stmt);
+    size += ast->types.count * sizeof(struct compact_type);
+    size += ast->params.count * sizeof(struct compact_param);
+    size += ast->decls.count * sizeof(struct compact_decl);
+    size += ast->strings.count * sizeof(const char *);
+
+    for (arena_block_t *block = ast->string_data ? ast->string_data->head : NULL; block; block = block->next) {
+        size += block->used;
+    }
+
+    return size;
+}
+
+static size_t string_size(const char *str) {
+    return str ? strlen(str) + 1 : 0;
+}
+
+static size_t expr_size(struct expr *e) {
+    size_t size = 0;
+
+    // Argument lists hang off right, so walk that side in a loop.
+    for (; e; e = e->right) {
+        size += sizeof(struct expr);
+        if (!expr_has_operands(e)) {
+            if (e->kind == EXPR_STRING_LITERAL) {
+                size += string_size(e->string_literal);
+            }
+            break;
+        }
+        size += expr_size(e->left);
+    }
+
+    return size;
+}
+
+static size_t type_size(struct type *t) {
+    size_t size = 0;
+
+    for (; t; t = t->subtype) {
+        size += sizeof(struct type) + expr_size(t->array_size);
+        for (struct param_list *p = t->params; p; p = p->next) {
+            size += sizeof(struct param_list) + type_size(p->type);
+        }
+    }
+
+    return size;
+}
+
+static size_t stmt_size(struct stmt *s) {
+    size_t size = 0;
+
+    for (; s; s = s->next) {
+        size += sizeof(struct stmt) + expr_size(s->expr) + stmt_size(s->body);
+
+        switch (s->kind) {
+            case STMT_DECL:
+                size += ast_size(s->decl);
+                break;
+            case STMT_IF_ELSE:
+                size += stmt_size(s->else_body);
+                break;
+            case STMT_FOR:
+                size += expr_size(s->init_expr) + expr_size(s->next_expr);
+                break;
+            case STMT_COMMENT:
+            case STMT_MULTI_COMMENT:
+                size += string_size(s->comment_text);
+                break;
+            default:
+                break;
+        }
+    }
+
+    return size;
+}
+
+size_t ast_size(struct decl *program) {
+    size_t size = 0;
+
+    for (struct decl *d = program; d; d = d->next) {
+        size += sizeof(struct decl) + string_size(d->comment_text);
+        size += type_size(d->type) + expr_size(d->value) + stmt_size(d->code);
+    }
+
+    return size;
+}
@@ -0,0 +1,109 @@
+#ifndef AST_COMPACT_H
+#define AST_COMPACT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+#include "ast.h"
+
+// Compact AST. Nodes live in one pool per node type and refer to each other
+// by 32-bit index; index 0 is the null reference in every pool. Each node
+// keeps only the fields its kind uses, in a union, and literals are stored
+// inline. Names, string literals and comments are indices into a string
+// table whose bytes the compact AST owns, so the pointer AST and its arena
+// can be released once it has been converted.
+//
+// compact_from_ast and compact_to_ast convert in both directions, so passes
+// still written against struct expr/stmt/decl keep working while the
+// compiler moves over.
+
+typedef uint32_t node_ref_t;
+typedef uint32_t string_ref_t;
+
+#define NODE_NONE 0
+
+struct compact_expr {
+    uint8_t kind;
+    union {
+        // Binary operators, assignment, subscript and call (callee, first
+        // argument). Argument and element lists are EXPR_ARG cells holding
+        // the value in left and the next cell in right.
+        struct {
+            node_ref_t left;
+            node_ref_t right;
+        } binary;
+        node_ref_t operand;         // EXPR_UNARY_MINUS, EXPR_NOT
+        node_ref_t elements;        // EXPR_ARRAY_LITERAL
+        int32_t integer_value;      // integer, character and boolean literals
+        string_ref_t name;          // EXPR_NAME
+        string_ref_t string_literal;
+    } as;
+};
+
+struct compact_stmt {
+    uint8_t kind;
+    node_ref_t next;
+    union {
+        node_ref_t expr;            // STMT_EXPR, STMT_PRINT, STMT_RETURN
+        struct {
+            node_ref_t condition;
+            node_ref_t body;
+            node_ref_t else_body;
+        } if_else;
+        struct {
+            node_ref_t init;
+            node_ref_t condition;
+            node_ref_t step;
+            node_ref_t body;
+        } for_loop;
+        node_ref_t body;            // STMT_BLOCK
+        node_ref_t decl;            // STMT_DECL
+        string_ref_t comment_text;  // STMT_COMMENT, STMT_MULTI_COMMENT
+    } as;
+};
+
+struct compact_type {
+    uint8_t kind;
+    node_ref_t subtype;
+    node_ref_t params;
+    node_ref_t array_size;
+};
+
+struct compact_param {
+    string_ref_t name;
+    node_ref_t type;
+    node_ref_t next;
+};
+
+struct compact_decl {
+    uint8_t kind;
+    string_ref_t name;              // comment text for comment declarations
+    node_ref_t type;
+    node_ref_t value;
+    node_ref_t code;
+    node_ref_t next;
+};
+
+#define COMPACT_POOL(node_type) struct { node_type *items; uint32_t count; uint32_t capacity; }
+
+typedef struct {
+    COMPACT_POOL(struct compact_expr) exprs;
+    COMPACT_POOL(struct compact_stmt) stmts;
+    COMPACT_POOL(struct compact_type) types;
+    COMPACT_POOL(struct compact_param) params;
+    COMPACT_POOL(struct compact_decl) decls;
+    COMPACT_POOL(const char *) strings;
+    arena_t *string_data;
+    node_ref_t program;
+} compact_ast_t;
+
+compact_ast_t *compact_from_ast(struct decl *program);
+struct decl *compact_to_ast(compact_ast_t *ast);
+void free_compact_ast(compact_ast_t *ast);
+
+// Bytes held by the pools of a compact AST, and by the nodes of a pointer
+// AST, for comparing the two layouts.
+size_t compact_ast_size(compact_ast_t *ast);
+size_t ast_size(struct decl *program);
+
+#endif
@@ -1,80 +1,21 @@
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "codegen.h"
-
-typedef struct symbol_entry {
-    char *name;
-    type_kind_t type;
-    struct symbol_entry *next;
-} symbol_entry_t;
-
-typedef struct symbol_table {
-    symbol_entry_t *head;
-} symbol_table_t;
-
-static symbol_table_t *global_symbols = NULL;
-
-static symbol_table_t *create_symbol_table() {
-    symbol_table_t *table = malloc(sizeof(symbol_table_t));
-    if (table) {
-        table->head = NULL;
-    }
-    return table;
-}
-
-static void add_symbol(symbol_table_t *table, const char *name, type_kind_t type) {
-    if (!table) return;
-
-    symbol_entry_t *current = table->head;
-    while (current) {
-        if (strcmp(current->name, name) == 0) {
-            current->type = type;
-            return;
-        }
-        current = current->next;
-    }
-
-    symbol_entry_t *entry = malloc(sizeof(symbol_entry_t));
-    if (entry) {
-        entry->name = strdup(name);
-        entry->type = type;
-        entry->next = table->head;
-        table->head = entry;
-    }
-}
-
-static type_kind_t lookup_symbol(symbol_table_t *table, const char *name) {
-    if (!table) return TYPE_INTEGER;
-
-    symbol_entry_t *current = table->head;
-    while (current) {
-        if (strcmp(current->name, name) == 0) {
-            return current->type;
-        }
-        current = current->next;
-    }
-
-    return TYPE_INTEGER;
-}
-
-static void free_symbol_table(symbol_table_t *table) {
-    if (!table) return;
-
-    symbol_entry_t *current = table->head;
-    while (current) {
-        symbol_entry_t *next = current->next;
-        free(current->name);
-        free(current);
-        current = next;
-    }
-
-    free(table);
-}
+#include "effects.h"
+#include "fold.h"
+#include "intern.h"
+#include "ir.h"
+#include "memo.h"
+#include "runtime.h"
+#include "scope.h"
+#include "work_stack.h"
 
 static void generate_expr_c(struct expr *e, FILE *output);
 
-static void process_string_for_c(const char *str, FILE *output) {
+void process_string_for_c(const char *str, FILE *output) {
     if (!str) return;
 
     while (*str) {
@@ -126,7 +67,7 @@ static void generate_comment(const char *comment_text, FILE *output, int is_mult
     }
 }
 
-static void generate_type_c(struct type *t, FILE *output) {
+void generate_type_c(struct type *t, FILE *output) {
     if (!t) return;
 
     switch (t->kind) {
@@ -154,160 +95,282 @@ static void generate_type_c(struct type *t, FILE *output) {
     }
 }
 
-static void generate_array_initializer(struct expr *e, FILE *output) {
-    if (!e) {
-        return;
+// Expressions are emitted from an explicit stack of pending pieces rather
+// than by recursion, so neither deep nesting nor long operator chains use
+// the call stack. Each node pushes its pieces in reverse so they pop in
+// output order.
+typedef enum {
+    EMIT_EXPR,
+    EMIT_TEXT,
+    EMIT_LIST                   // EXPR_ARG cells, separated by ", "
+} emit_kind_t;
+
+typedef struct {
+    emit_kind_t kind;
+    struct expr *e;
+    const char *text;
+} emit_t;
+
+static void push_emit(work_stack_t *stack, emit_kind_t kind, struct expr *e, const char *text) {
+    emit_t *item = work_stack_push(stack);
+    item->kind = kind;
+    item->e = e;
+    item->text = text;
+}
+
+static const char *binary_operator_c(expr_kind_t kind) {
+    switch (kind) {
+        case EXPR_ADD: return " + ";
+        case EXPR_SUB: return " - ";
+        case EXPR_MUL: return " * ";
+        case EXPR_DIV: return " / ";
+        case EXPR_MOD: return " % ";
+        case EXPR_EQ: return " == ";
+        case EXPR_NEQ: return " != ";
+        case EXPR_LT: return " < ";
+        case EXPR_GT: return " > ";
+        case EXPR_LE: return " <= ";
+        case EXPR_GE: return " >= ";
+        case EXPR_AND: return " && ";
+        case EXPR_OR: return " || ";
+        default: return "";
     }
+}
 
-    fprintf(output, "{");
+static power_form_t power_form(struct expr *e) {
+    struct expr *base = e->left;
+    struct expr *exponent = e->right;
 
-    struct expr *element = e->right;
-    if (!element) {
-        fprintf(output, "0, 0, 0");
-    } else {
-        int first = 1;
-        while (element) {
-            if (!first) fprintf(output, ", ");
-            generate_expr_c(element, output);
-            element = element->right;
-            first = 0;
-        }
-    }
+    return choose_power_form(base->kind == EXPR_NAME || base->kind == EXPR_INTEGER_LITERAL,
+                             base->kind == EXPR_INTEGER_LITERAL && base->integer_value == 2,
+                             exponent->kind == EXPR_INTEGER_LITERAL, exponent->integer_value);
+}
 
-    fprintf(output, "}");
+static int is_zero_divisor(struct expr *e) {
+    return (e->kind == EXPR_DIV || e->kind == EXPR_MOD) && e->right->kind == EXPR_INTEGER_LITERAL &&
+           e->right->integer_value == 0;
 }
 
-static void generate_expr_c(struct expr *e, FILE *output) {
-    if (!e) return;
+static void note_runtime_needs(struct expr *e, void *context) {
+    runtime_needs_t *needs = context;
+    if (e->kind == EXPR_POWER) {
+        note_power_form(needs, power_form(e));
+    }
+    needs->zero_divisor |= is_zero_divisor(e);
+}
 
-    switch (e->kind) {
-        case EXPR_INTEGER_LITERAL:
-            fprintf(output, "%d", e->integer_value);
-            break;
-        case EXPR_STRING_LITERAL:
-            fprintf(output, "\"");
-            process_string_for_c(e->string_literal, output);
-            fprintf(output, "\"");
-            break;
-        case EXPR_CHAR_LITERAL:
-            fprintf(output, "'%c'", e->integer_value);
-            break;
-        case EXPR_BOOL_LITERAL:
-            fprintf(output, "%s", e->integer_value ? "1" : "0");
-            break;
-        case EXPR_NAME:
-            fprintf(output, "%s", e->name);
-            break;
-        case EXPR_CALL:
-            generate_expr_c(e->left, output);
-            fprintf(output, "(");
+static void generate_expr_c(struct expr *root, FILE *output) {
+    if (!root) return;
 
-            struct expr *arg = e->right;
-            while (arg) {
-                generate_expr_c(arg, output);
-                arg = arg->right;
-                if (arg) fprintf(output, ", ");
-            }
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(emit_t));
+    push_emit(&stack, EMIT_EXPR, root, NULL);
 
-            fprintf(output, ")");
-            break;
-        case EXPR_SUBSCRIPT:
-            generate_expr_c(e->left, output);
-            fprintf(output, "[");
-            generate_expr_c(e->right, output);
-            fprintf(output, "]");
-            break;
-        case EXPR_UNARY_MINUS:
-            fprintf(output, "(-");
-            generate_expr_c(e->right, output);
-            fprintf(output, ")");
-            break;
-        case EXPR_NOT:
-            fprintf(output, "!");
-            generate_expr_c(e->right, output);
-            break;
-        case EXPR_POWER:
-            fprintf(output, "pow(");
-            generate_expr_c(e->left, output);
-            fprintf(output, ", ");
-            generate_expr_c(e->right, output);
-            fprintf(output, ")");
-            break;
-        case EXPR_ARRAY_LITERAL:
-            generate_array_initializer(e, output);
-            break;
-        case EXPR_ASSIGN:
-            generate_expr_c(e->left, output);
-            fprintf(output, " = ");
-            generate_expr_c(e->right, output);
-            break;
-        case EXPR_ARG:
-            generate_expr_c(e->left, output);
-            break;
-        default:
-            fprintf(output, "(");
-            generate_expr_c(e->left, output);
-
-            switch (e->kind) {
-                case EXPR_ADD: fprintf(output, " + "); break;
-                case EXPR_SUB: fprintf(output, " - "); break;
-                case EXPR_MUL: fprintf(output, " * "); break;
-                case EXPR_DIV: fprintf(output, " / "); break;
-                case EXPR_MOD: fprintf(output, " %% "); break;
-                case EXPR_EQ: fprintf(output, " == "); break;
-                case EXPR_NEQ: fprintf(output, " != "); break;
-                case EXPR_LT: fprintf(output, " < "); break;
-                case EXPR_GT: fprintf(output, " > "); break;
-                case EXPR_LE: fprintf(output, " <= "); break;
-                case EXPR_GE: fprintf(output, " >= "); break;
-                case EXPR_AND: fprintf(output, " && "); break;
-                case EXPR_OR: fprintf(output, " || "); break;
-                default: break;
+    emit_t item;
+    while (work_stack_pop(&stack, &item)) {
+        struct expr *e = item.e;
+
+        if (item.kind == EMIT_TEXT) {
+            fputs(item.text, output);
+            continue;
+        }
+
+        if (item.kind == EMIT_LIST) {
+            if (e->right) {
+                push_emit(&stack, EMIT_LIST, e->right, NULL);
+                push_emit(&stack, EMIT_TEXT, NULL, ", ");
             }
+            push_emit(&stack, EMIT_EXPR, e->left, NULL);
+            continue;
+        }
 
-            generate_expr_c(e->right, output);
-            fprintf(output, ")");
-            break;
+        if (!e) continue;
+
+        switch (e->kind) {
+            case EXPR_INTEGER_LITERAL:
+                // Folding can produce INT_MIN, which has no literal in C.
+                if (e->integer_value == INT_MIN) {
+                    fprintf(output, "(-%d - 1)", INT_MAX);
+                } else {
+                    fprintf(output, "%d", e->integer_value);
+                }
+                break;
+            case EXPR_STRING_LITERAL:
+                fprintf(output, "\"");
+                process_string_for_c(e->string_literal, output);
+                fprintf(output, "\"");
+                break;
+            case EXPR_CHAR_LITERAL:
+                // Evaluated calls can produce any char, not only ones with
+                // a literal of their own.
+                if (e->integer_value >= ' ' && e->integer_value <= '~' && e->integer_value != '\'' &&
+                    e->integer_value != '\\') {
+                    fprintf(output, "'%c'", e->integer_value);
+                } else {
+                    fprintf(output, "%d", e->integer_value);
+                }
+                break;
+            case EXPR_BOOL_LITERAL:
+                fprintf(output, "%s", e->integer_value ? "1" : "0");
+                break;
+            case EXPR_NAME:
+                fprintf(output, "%s", e->symbol && e->symbol->emitted_name ? e->symbol->emitted_name : c_name(e->name));
+                break;
+            case EXPR_CALL:
+                push_emit(&stack, EMIT_TEXT, NULL, ")");
+                if (e->right) {
+                    push_emit(&stack, EMIT_LIST, e->right, NULL);
+                }
+                push_emit(&stack, EMIT_TEXT, NULL, "(");
+                push_emit(&stack, EMIT_EXPR, e->left, NULL);
+                break;
+            case EXPR_SUBSCRIPT:
+                push_emit(&stack, EMIT_TEXT, NULL, "]");
+                push_emit(&stack, EMIT_EXPR, e->right, NULL);
+                push_emit(&stack, EMIT_TEXT, NULL, "[");
+                push_emit(&stack, EMIT_EXPR, e->left, NULL);
+                break;
+            case EXPR_UNARY_MINUS:
+                push_emit(&stack, EMIT_TEXT, NULL, ")");
+                push_emit(&stack, EMIT_EXPR, e->right, NULL);
+                fprintf(output, "(-");
+                break;
+            case EXPR_NOT:
+                push_emit(&stack, EMIT_EXPR, e->right, NULL);
+                fprintf(output, "!");
+                break;
+            case EXPR_POWER:
+                push_emit(&stack, EMIT_TEXT, NULL, ")");
+                switch (power_form(e)) {
+                    case POWER_PRODUCT:
+                        push_emit(&stack, EMIT_TEXT, NULL, ")");
+                        for (int i = 1; i < e->right->integer_value; i++) {
+                            push_emit(&stack, EMIT_EXPR, e->left, NULL);
+                            push_emit(&stack, EMIT_TEXT, NULL, " * (unsigned int) ");
+                        }
+                        push_emit(&stack, EMIT_EXPR, e->left, NULL);
+                        fprintf(output, "((int) ((unsigned int) ");
+                        break;
+                    case POWER_PRODUCT_CALL:
+                        push_emit(&stack, EMIT_EXPR, e->right, NULL);
+                        push_emit(&stack, EMIT_TEXT, NULL, ", ");
+                        push_emit(&stack, EMIT_EXPR, e->left, NULL);
+                        fprintf(output, "%s(", power_helper_name(POWER_PRODUCT_CALL));
+                        break;
+                    case POWER_SHIFT:
+                        push_emit(&stack, EMIT_EXPR, e->right, NULL);
+                        fprintf(output, "%s(", power_helper_name(POWER_SHIFT));
+                        break;
+                    case POWER_CALL:
+                        push_emit(&stack, EMIT_EXPR, e->right, NULL);
+                        push_emit(&stack, EMIT_TEXT, NULL, ", ");
+                        push_emit(&stack, EMIT_EXPR, e->left, NULL);
+                        fprintf(output, "%s(", power_helper_name(POWER_CALL));
+                        break;
+                }
+                break;
+            case EXPR_ARRAY_LITERAL:
+                push_emit(&stack, EMIT_TEXT, NULL, "}");
+                if (e->right) {
+                    push_emit(&stack, EMIT_LIST, e->right, NULL);
+                } else {
+                    push_emit(&stack, EMIT_TEXT, NULL, "0, 0, 0");
+                }
+                fprintf(output, "{");
+                break;
+            case EXPR_ASSIGN:
+                push_emit(&stack, EMIT_EXPR, e->right, NULL);
+                push_emit(&stack, EMIT_TEXT, NULL, " = ");
+                push_emit(&stack, EMIT_EXPR, e->left, NULL);
+                break;
+            case EXPR_ARG:
+                push_emit(&stack, EMIT_EXPR, e->left, NULL);
+                break;
+            default:
+                if (is_zero_divisor(e)) {
+                    push_emit(&stack, EMIT_TEXT, NULL, e->kind == EXPR_MOD ? ", 1)" : ", 0)");
+                    push_emit(&stack, EMIT_EXPR, e->left, NULL);
+                    fprintf(output, "%s(", ZERO_DIVISION_HELPER);
+                    break;
+                }
+                push_emit(&stack, EMIT_TEXT, NULL, ")");
+                push_emit(&stack, EMIT_EXPR, e->right, NULL);
+                push_emit(&stack, EMIT_TEXT, NULL, binary_operator_c(e->kind));
+                push_emit(&stack, EMIT_EXPR, e->left, NULL);
+                fprintf(output, "(");
+                break;
+        }
     }
+
+    work_stack_free(&stack);
 }
 
+// Indentation stops growing past this depth, so that pathologically deep
+// nesting does not make the output quadratic in size.
+#define MAX_INDENT 64
+
 static void print_indent(FILE *output, int indent) {
+    if (indent > MAX_INDENT) {
+        indent = MAX_INDENT;
+    }
+
     for (int i = 0; i < indent; i++) {
         fprintf(output, "\t");
     }
 }
 
+// Format for one print argument, from the type the checker assigned it.
+// String literals without a % are copied into the format itself and get
+// NULL here.
 static const char *get_format_specifier(struct expr *expr) {
     if (!expr) return "%d";
 
-    if (expr->kind == EXPR_ARG && expr->left) {
-        return get_format_specifier(expr->left);
+    if (expr->kind == EXPR_STRING_LITERAL && !strchr(expr->string_literal, '%')) {
+        return NULL;
     }
 
-    switch (expr->kind) {
-        case EXPR_STRING_LITERAL:
-            return NULL;
-        case EXPR_NAME:
-            if (global_symbols) {
-                type_kind_t type = lookup_symbol(global_symbols, expr->name);
-                if (type == TYPE_STRING) {
-                    return "%s";
-                }
-            }
-            return "%d";
-        case EXPR_SUBSCRIPT:
-            if (expr->left && expr->left->kind == EXPR_NAME && global_symbols) {
-                type_kind_t type = lookup_symbol(global_symbols, expr->left->name);
-                if (type == TYPE_STRING) {
-                    return "%c";
-                }
-            }
-            return "%d";
+    switch (expr->type ? expr->type->kind : TYPE_INTEGER) {
+        case TYPE_STRING:
+        case TYPE_BOOLEAN:
+            return "%s";
+        case TYPE_CHARACTER:
+            return "%c";
         default:
             return "%d";
     }
 }
 
+// One printf for the arguments in [first, end).
+static void generate_printf(const char **format_strings, struct expr **arg_exprs, int first, int end,
+                            FILE *output, int indent) {
+    print_indent(output, indent);
+    fprintf(output, "printf(\"");
+
+    for (int i = first; i < end; i++) {
+        if (format_strings[i]) {
+            fprintf(output, "%s", format_strings[i]);
+        } else {
+            process_string_for_c(arg_exprs[i]->string_literal, output);
+        }
+    }
+    fprintf(output, "\"");
+
+    for (int i = first; i < end; i++) {
+        if (!format_strings[i]) continue;
+
+        fprintf(output, ", ");
+        if (arg_exprs[i]->type && arg_exprs[i]->type->kind == TYPE_BOOLEAN) {
+            fprintf(output, "(");
+            generate_expr_c(arg_exprs[i], output);
+            fprintf(output, ") ? \"true\" : \"false\"");
+        } else {
+            generate_expr_c(arg_exprs[i], output);
+        }
+    }
+
+    fprintf(output, ");\n");
+}
+
 static void generate_print_stmt(struct expr *expr_list, FILE *output, int indent) {
     if (!expr_list) return;
 
@@ -315,7 +378,7 @@ static void generate_print_stmt(struct expr *expr_list, FILE *output, int indent
     struct expr *current = expr_list;
     while (current) {
         arg_count++;
-        current = current->right;
+        current = current->kind == EXPR_ARG ? current->right : NULL;
     }
 
     const char **format_strings = malloc(sizeof(char*) * arg_count);
@@ -323,6 +386,7 @@ static void generate_print_stmt(struct expr *expr_list, FILE *output, int indent
 
     current = expr_list;
     int i = 0;
+    int ordered = 0;
     while (current && i < arg_count) {
         if (current->kind == EXPR_ARG && current->left) {
             format_strings[i] = get_format_specifier(current->left);
@@ -331,254 +395,348 @@ static void generate_print_stmt(struct expr *expr_list, FILE *output, int indent
             format_strings[i] = get_format_specifier(current);
             arg_exprs[i] = current;
         }
-        current = current->right;
+        ordered |= format_strings[i] && expr_has_side_effects(arg_exprs[i]);
+        current = current->kind == EXPR_ARG ? current->right : NULL;
         i++;
     }
 
-    print_indent(output, indent);
-    fprintf(output, "printf(\"");
-
-    for (i = 0; i < arg_count; i++) {
-        if (format_strings[i]) {
-            fprintf(output, "%s", format_strings[i]);
-        } else if (arg_exprs[i] && arg_exprs[i]->kind == EXPR_STRING_LITERAL) {
-            process_string_for_c(arg_exprs[i]->string_literal, output);
+    // C leaves the order of printf's arguments open, while B-minor prints
+    // left to right. When an argument has side effects, each value goes in
+    // a printf of its own, with the text after it.
+    if (!ordered) {
+        generate_printf(format_strings, arg_exprs, 0, arg_count, output, indent);
+    } else {
+        int first = 0;
+        while (first < arg_count) {
+            int end = first + 1;
+            while (end < arg_count && !format_strings[end]) {
+                end++;
+            }
+            generate_printf(format_strings, arg_exprs, first, end, output, indent);
+            first = end;
         }
     }
-    fprintf(output, "\"");
 
-    for (i = 0; i < arg_count; i++) {
-        if (arg_exprs[i] && arg_exprs[i]->kind != EXPR_STRING_LITERAL) {
-            fprintf(output, ", ");
-            generate_expr_c(arg_exprs[i], output);
+    free(format_strings);
+    free(arg_exprs);
+}
+
+// Statement lists are generated from a stack as well: a compound statement
+// prints its header and pushes its closing lines and body, above the rest
+// of the list it belongs to.
+typedef struct {
+    struct stmt *s;             // the rest of a statement list, or NULL for text
+    const char *text;           // a line to print at indent
+    int indent;
+} stmt_work_t;
+
+static void push_stmts(work_stack_t *stack, struct stmt *s, int indent) {
+    stmt_work_t *item = work_stack_push(stack);
+    item->s = s;
+    item->indent = indent;
+}
+
+static void push_line(work_stack_t *stack, const char *text, int indent) {
+    stmt_work_t *item = work_stack_push(stack);
+    item->text = text;
+    item->indent = indent;
+}
+
+// Bodies that are blocks are generated without their own braces.
+static void push_body(work_stack_t *stack, struct stmt *body, int indent) {
+    if (!body) return;
+
+    if (body->kind == STMT_BLOCK) {
+        if (body->body) {
+            push_stmts(stack, body->body, indent);
         }
+    } else {
+        push_stmts(stack, body, indent);
     }
+}
 
-    fprintf(output, ");\n");
+typedef struct {
+    struct decl *d;
+    int found;
+} shadowed_read_t;
 
-    free(format_strings);
-    free(arg_exprs);
+static void note_shadowed_read(struct expr *e, void *context) {
+    shadowed_read_t *r = context;
+    if (e->kind == EXPR_NAME && e->name == r->d->name && e->symbol != r->d->symbol) r->found = 1;
 }
 
-static void generate_stmt_c(struct stmt *s, FILE *output, int indent) {
-    if (!s) return;
-
-    switch (s->kind) {
-        case STMT_DECL:
-            print_indent(output, indent);
-            generate_type_c(s->decl->type, output);
-            fprintf(output, " %s", s->decl->name);
+// A C local is in scope from its own declarator on, so one whose
+// initializer reads the binding it shadows, as `h: integer = h + 1;` does
+// in an inner block, would read itself. Such a local gets a name of its
+// own in the reserved namespace, told apart from any other by its level.
+static const char *local_name_c(struct decl *d) {
+    shadowed_read_t r = {d, 0};
+    ast_visit_decl_exprs(d, note_shadowed_read, &r);
+    if (!r.found || !d->symbol) return c_name(d->name);
+
+    size_t size = snprintf(NULL, 0, RESERVED_PREFIX "local%d_%s", d->symbol->level, d->name) + 1;
+    char *name = malloc(size);
+    if (!name) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    snprintf(name, size, RESERVED_PREFIX "local%d_%s", d->symbol->level, d->name);
 
-            if (s->decl->type->kind == TYPE_ARRAY) {
-                fprintf(output, "[");
-                generate_expr_c(s->decl->type->array_size, output);
-                fprintf(output, "]");
-            }
+    d->symbol->emitted_name = intern(name, size - 1);
+    free(name);
+    return d->symbol->emitted_name;
+}
 
-            if (s->decl->value) {
-                fprintf(output, " = ");
-                generate_expr_c(s->decl->value, output);
-            }
+static void generate_stmt_c(struct stmt *list, FILE *output, int base_indent) {
+    if (!list) return;
 
-            fprintf(output, ";\n");
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(stmt_work_t));
+    push_stmts(&stack, list, base_indent);
 
-            if (s->decl->type->kind == TYPE_ARRAY) {
-                add_symbol(global_symbols, s->decl->name, s->decl->type->subtype->kind);
-            } else {
-                add_symbol(global_symbols, s->decl->name, s->decl->type->kind);
-            }
-            break;
+    stmt_work_t item;
+    while (work_stack_pop(&stack, &item)) {
+        int indent = item.indent;
 
-        case STMT_EXPR:
+        if (!item.s) {
             print_indent(output, indent);
-            generate_expr_c(s->expr, output);
-            fprintf(output, ";\n");
-            break;
+            fputs(item.text, output);
+            continue;
+        }
 
-        case STMT_IF_ELSE:
-            print_indent(output, indent);
-            fprintf(output, "if (");
-            generate_expr_c(s->expr, output);
-            fprintf(output, ") {\n");
-
-            if (s->body) {
-                if (s->body->kind == STMT_BLOCK) {
-                    if (s->body->body) {
-                        generate_stmt_c(s->body->body, output, indent + 1);
-                    }
-                } else {
-                    generate_stmt_c(s->body, output, indent + 1);
+        struct stmt *s = item.s;
+        if (s->next) {
+            push_stmts(&stack, s->next, indent);
+        }
+
+        switch (s->kind) {
+            case STMT_DECL:
+                print_indent(output, indent);
+                generate_type_c(s->decl->type, output);
+                fprintf(output, " %s", local_name_c(s->decl));
+
+                if (s->decl->type->kind == TYPE_ARRAY) {
+                    fprintf(output, "[");
+                    generate_expr_c(s->decl->type->array_size, output);
+                    fprintf(output, "]");
                 }
-            }
 
-            print_indent(output, indent);
-            fprintf(output, "}\n");
+                if (s->decl->value) {
+                    fprintf(output, " = ");
+                    generate_expr_c(s->decl->value, output);
+                }
+
+                fprintf(output, ";\n");
+                break;
 
-            if (s->else_body) {
+            case STMT_EXPR:
                 print_indent(output, indent);
-                fprintf(output, "else {\n");
+                generate_expr_c(s->expr, output);
+                fprintf(output, ";\n");
+                break;
 
-                if (s->else_body->kind == STMT_BLOCK) {
-                    if (s->else_body->body) {
-                        generate_stmt_c(s->else_body->body, output, indent + 1);
-                    }
-                } else {
-                    generate_stmt_c(s->else_body, output, indent + 1);
+            case STMT_IF_ELSE:
+                print_indent(output, indent);
+                fprintf(output, "if (");
+                generate_expr_c(s->expr, output);
+                fprintf(output, ") {\n");
+
+                if (s->else_body) {
+                    push_line(&stack, "}\n", indent);
+                    push_body(&stack, s->else_body, indent + 1);
+                    push_line(&stack, "else {\n", indent);
                 }
 
+                push_line(&stack, "}\n", indent);
+                push_body(&stack, s->body, indent + 1);
+                break;
+
+            case STMT_FOR:
                 print_indent(output, indent);
-                fprintf(output, "}\n");
-            }
-            break;
+                fprintf(output, "for (");
 
-        case STMT_FOR:
-            print_indent(output, indent);
-            fprintf(output, "for (");
+                if (s->init_expr) {
+                    generate_expr_c(s->init_expr, output);
+                }
+                fprintf(output, "; ");
 
-            if (s->init_expr) {
-                generate_expr_c(s->init_expr, output);
-            }
-            fprintf(output, "; ");
+                if (s->expr) {
+                    generate_expr_c(s->expr, output);
+                }
+                fprintf(output, "; ");
 
-            if (s->expr) {
-                generate_expr_c(s->expr, output);
-            }
-            fprintf(output, "; ");
+                if (s->next_expr) {
+                    generate_expr_c(s->next_expr, output);
+                }
 
-            if (s->next_expr) {
-                generate_expr_c(s->next_expr, output);
-            }
+                fprintf(output, ") {\n");
 
-            fprintf(output, ") {\n");
+                push_line(&stack, "}\n", indent);
+                push_body(&stack, s->body, indent + 1);
+                break;
 
-            if (s->body) {
-                if (s->body->kind == STMT_BLOCK) {
-                    if (s->body->body) {
-                        generate_stmt_c(s->body->body, output, indent + 1);
-                    }
-                } else {
-                    generate_stmt_c(s->body, output, indent + 1);
+            case STMT_PRINT:
+                generate_print_stmt(s->expr, output, indent);
+                break;
+
+            case STMT_RETURN:
+                print_indent(output, indent);
+                fprintf(output, "return");
+
+                if (s->expr) {
+                    fprintf(output, " ");
+                    generate_expr_c(s->expr, output);
                 }
-            }
 
-            print_indent(output, indent);
-            fprintf(output, "}\n");
-            break;
+                fprintf(output, ";\n");
+                break;
 
-        case STMT_PRINT:
-            generate_print_stmt(s->expr, output, indent);
-            break;
+            case STMT_BLOCK:
+                print_indent(output, indent);
+                fprintf(output, "{\n");
 
-        case STMT_RETURN:
-            print_indent(output, indent);
-            fprintf(output, "return");
+                push_line(&stack, "}\n", indent);
+                if (s->body) {
+                    push_stmts(&stack, s->body, indent + 1);
+                }
+                break;
 
-            if (s->expr) {
-                fprintf(output, " ");
-                generate_expr_c(s->expr, output);
-            }
+            case STMT_COMMENT:
+                print_indent(output, indent);
+                fprintf(output, "%s\n", s->comment_text);
+                break;
 
-            fprintf(output, ";\n");
-            break;
+            case STMT_MULTI_COMMENT:
+                print_indent(output, indent);
+                fprintf(output, "/*\n");
 
-        case STMT_BLOCK:
-            print_indent(output, indent);
-            fprintf(output, "{\n");
+                char comment_copy[4096];
+                strncpy(comment_copy, s->comment_text + 2, sizeof(comment_copy) - 1);
+                comment_copy[sizeof(comment_copy) - 1] = '\0';
 
-            if (s->body) {
-                generate_stmt_c(s->body, output, indent + 1);
-            }
+                int len = strlen(comment_copy);
+                if (len >= 2 && comment_copy[len-2] == '*' && comment_copy[len-1] == '/') {
+                    comment_copy[len-2] = '\0';
+                }
 
-            print_indent(output, indent);
-            fprintf(output, "}\n");
-            break;
+                char *saveptr;
+                char *line = strtok_r(comment_copy, "\n", &saveptr);
+                while (line) {
+                    print_indent(output, indent);
+                    fprintf(output, " * %s\n", line);
+                    line = strtok_r(NULL, "\n", &saveptr);
+                }
 
-        case STMT_COMMENT:
-            print_indent(output, indent);
-            fprintf(output, "%s\n", s->comment_text);
-            break;
+                print_indent(output, indent);
+                fprintf(output, " */\n");
+                break;
+        }
+    }
 
-        case STMT_MULTI_COMMENT:
-            print_indent(output, indent);
-            fprintf(output, "/*\n");
+    work_stack_free(&stack);
+}
 
-            char comment_copy[4096];
-            strncpy(comment_copy, s->comment_text + 2, sizeof(comment_copy) - 1);
-            comment_copy[sizeof(comment_copy) - 1] = '\0';
+void generate_signature_c(struct decl *d, const char *name, const char *specifiers, FILE *output) {
+    fputs(specifiers, output);
+    generate_type_c(d->type->subtype, output);
+    fprintf(output, " %s(", name);
+
+    struct param_list *p = d->type->params;
+    while (p) {
+        generate_type_c(p->type, output);
+        fprintf(output, " %s", c_name(p->name));
+        if (p->type->kind == TYPE_ARRAY) {
+            fprintf(output, "[]");
+        }
 
-            int len = strlen(comment_copy);
-            if (len >= 2 && comment_copy[len-2] == '*' && comment_copy[len-1] == '/') {
-                comment_copy[len-2] = '\0';
-            }
+        p = p->next;
+        if (p) fprintf(output, ", ");
+    }
+}
 
-            char *saveptr;
-            char *line = strtok_r(comment_copy, "\n", &saveptr);
-            while (line) {
-                print_indent(output, indent);
-                fprintf(output, " * %s\n", line);
-                line = strtok_r(NULL, "\n", &saveptr);
+// Assigns the globals initialized at run time, in declaration order, so
+// each initializer sees the globals before it.
+static void generate_global_initializers_c(struct decl *program, FILE *output) {
+    fprintf(output, "static void bminor_init_globals(void) {\n");
+
+    for (struct decl *d = program; d; d = d->next) {
+        if (!is_initialized_at_run_time(d)) continue;
+
+        if (d->value->kind == EXPR_ARRAY_LITERAL) {
+            int index = 0;
+            for (struct expr *arg = d->value->right; arg; arg = arg->right, index++) {
+                fprintf(output, "\t%s[%d] = ", c_name(d->name), index);
+                generate_expr_c(arg->left, output);
+                fprintf(output, ";\n");
             }
+        } else if (d->type->kind == TYPE_ARRAY) {
+            fprintf(output, "\tmemcpy(%s, ", c_name(d->name));
+            generate_expr_c(d->value, output);
+            fprintf(output, ", sizeof %s);\n", c_name(d->name));
+        } else {
+            fprintf(output, "\t%s = ", c_name(d->name));
+            generate_expr_c(d->value, output);
+            fprintf(output, ";\n");
+        }
+    }
 
-            print_indent(output, indent);
-            fprintf(output, " */\n");
-            break;
+    fprintf(output, "}\n\n");
+}
+
+// Emits a function under name: a prototype when it has no body, else its
+// body from ir, or from the AST when ir is NULL. specifiers, such as
+// linkage and attributes, go before the type, and prologue, when not
+// NULL, before the body's first statement.
+static void generate_function_c(struct decl *d, const char *name, ir_function_t *ir, const char *specifiers,
+                                const char *prologue, FILE *output) {
+    generate_signature_c(d, name, specifiers, output);
+
+    // A declaration without a body is a prototype.
+    if (!d->code) {
+        fprintf(output, ");\n\n");
+        return;
+    }
+
+    fprintf(output, ") {\n");
+    if (prologue) {
+        fputs(prologue, output);
     }
 
-    if (s->next) {
-        generate_stmt_c(s->next, output, indent);
+    if (ir) {
+        ir_emit_c(ir, output);
+    } else if (d->code->kind == STMT_BLOCK) {
+        if (d->code->body) {
+            generate_stmt_c(d->code->body, output, 1);
+        }
+    } else {
+        generate_stmt_c(d->code, output, 1);
     }
+
+    fprintf(output, "}\n\n");
 }
 
-static void generate_decl_c(struct decl *d, FILE *output) {
+static void generate_decl_c(struct decl *d, ir_function_t *ir, const char *specifiers, const char *prologue,
+                            FILE *output) {
     if (!d) return;
 
     switch (d->kind) {
         case DECL_FUNCTION:
         case DECL_VARIABLE:
             if (d->type && d->type->kind == TYPE_FUNCTION) {
-                generate_type_c(d->type->subtype, output);
-                fprintf(output, " %s(", d->name);
-
-                struct param_list *p = d->type->params;
-                while (p) {
-                    generate_type_c(p->type, output);
-                    fprintf(output, " %s", p->name);
-
-                    add_symbol(global_symbols, p->name, p->type->kind);
-
-                    p = p->next;
-                    if (p) fprintf(output, ", ");
-                }
-
-                fprintf(output, ") {\n");
-
-                if (d->code) {
-                    if (d->code->kind == STMT_BLOCK) {
-                        if (d->code->body) {
-                            generate_stmt_c(d->code->body, output, 1);
-                        }
-                    } else {
-                        generate_stmt_c(d->code, output, 1);
-                    }
-                }
-
-                fprintf(output, "}\n\n");
+                generate_function_c(d, c_name(d->name), ir, specifiers, prologue, output);
             } else {
+                fputs(specifiers, output);
                 generate_type_c(d->type, output);
 
                 if (d->type->kind == TYPE_ARRAY) {
-                    fprintf(output, " %s[", d->name);
+                    fprintf(output, " %s[", c_name(d->name));
                     generate_expr_c(d->type->array_size, output);
                     fprintf(output, "]");
-
-                    add_symbol(global_symbols, d->name, d->type->subtype->kind);
                 } else {
-                    fprintf(output, " %s", d->name);
-
-                    add_symbol(global_symbols, d->name, d->type->kind);
+                    fprintf(output, " %s", c_name(d->name));
                 }
 
-                if (d->value) {
+                if (d->value && !is_initialized_at_run_time(d)) {
                     fprintf(output, " = ");
                     generate_expr_c(d->value, output);
                 }
@@ -597,22 +755,423 @@ static void generate_decl_c(struct decl *d, FILE *output) {
             fprintf(output, "\n");
             break;
     }
+}
+
+// Lowers one function to the IR, or returns NULL when its body has to
+// come from the AST.
+static ir_function_t *lower_function(struct decl *d, int memoized, const codegen_options_t *options) {
+    const char *reason = NULL;
+    ir_function_t *ir = ir_lower_function(d, &reason);
 
-    if (d->next) {
-        generate_decl_c(d->next, output);
+    if (!ir) {
+        if (options->dump_ir) {
+            fprintf(options->dump_ir, "function %s: not lowered, it has %s\n", d->name, reason);
+        }
+        return NULL;
     }
+
+    // Before the call graph is built, so that a function whose only
+    // recursion was in tail calls can be inlined. A memoized function keeps
+    // its recursive calls, which go through its table.
+    if (!memoized) {
+        ir_eliminate_tail_calls(ir);
+    }
+    return ir;
 }
 
-void generate_c_code(struct decl *program, FILE *output) {
-    global_symbols = create_symbol_table();
+// Runs the IR passes over functions[index], after inlining the calls its
+// budget allows, and drops it when the result does not verify.
+static void optimize_function(ir_call_graph_t *graph, ir_function_t **functions, size_t index,
+                              const codegen_options_t *options) {
+    ir_function_t *ir = functions[index];
+
+    if (options->inline_budget > 0) {
+        ir_inline_calls(graph, index, options->inline_budget);
+    }
+    ir_fold_constants(ir);
+    ir_number_values(ir);
+    ir_hoist_loop_invariants(ir);
+    ir_cleanup(ir);
+
+    if (ir_verify(ir, stderr) > 0) {
+        fprintf(stderr, "internal error: invalid IR for %s, generating it from the AST\n", ir->decl->name);
+        ir_free_function(ir);
+        functions[index] = NULL;
+        return;
+    }
+
+    if (options->dump_ir) {
+        ir_print_function(ir, options->dump_ir);
+    }
+}
+
+static int compare_names(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t) *(const char * const *) a;
+    uintptr_t y = (uintptr_t) *(const char * const *) b;
+    return (x > y) - (x < y);
+}
+
+static int is_defined(const char **defined, size_t count, const char *name) {
+    return bsearch(&name, defined, count, sizeof(const char *), compare_names) != NULL;
+}
+
+// The linkage of a function declaration: everything defined here except
+// main is static once there is a main, and the small functions are inline
+// too. Prototypes follow their definition.
+static const char *function_linkage(struct decl *d, ir_function_t *ir, const char **defined, size_t count,
+                                    const codegen_options_t *options) {
+    if (!is_defined(defined, count, intern_string("main")) || d->name == intern_string("main") ||
+        !is_defined(defined, count, d->name)) {
+        return "";
+    }
+    if (ir && ir_function_size(ir) <= options->inline_budget) {
+        return "static inline ";
+    }
+    return "static ";
+}
+
+// Tells the C compiler that calls to a function without side effects can
+// be merged or hoisted. Functions without a result gain nothing from it.
+static const char *function_attribute(struct decl *d, const effects_t *effects) {
+    if (d->type->subtype->kind == TYPE_VOID || d->name == intern_string("main")) return "";
+
+    switch (function_effect(effects, d->name)) {
+        case EFFECT_CONST: return "__attribute__((const)) ";
+        case EFFECT_PURE: return "__attribute__((pure)) ";
+        default: return "";
+    }
+}
+
+// Globals of the basic types that nothing writes are const; arrays only
+// when no call is given them, so no parameter loses the qualifier. Strings
+// are left alone, since a const char * would not convert back, and so are
+// globals that main assigns.
+static int is_constant_global(struct decl *d, const effects_t *effects) {
+    struct type *t = d->type->kind == TYPE_ARRAY ? d->type->subtype : d->type;
+    if (t->kind == TYPE_STRING || t->kind == TYPE_ARRAY || global_is_written(effects, d->name) ||
+        is_initialized_at_run_time(d)) {
+        return 0;
+    }
+
+    return d->type->kind != TYPE_ARRAY || !global_is_passed(effects, d->name);
+}
+
+// Whether the definition d is memoized: asked for with options->memoize or
+// a pragma comment right before it, and allowed by can_memoize. A pragma
+// that cannot be honored gets a warning.
+static int is_memoized(struct decl *d, struct decl *previous, const effects_t *effects,
+                       const codegen_options_t *options) {
+    if (!d->code || !d->type || d->type->kind != TYPE_FUNCTION || d->name == intern_string("main")) return 0;
+
+    int pragma = previous && is_memo_pragma(previous);
+    if (!pragma && !options->memoize) return 0;
+
+    const char *reason = NULL;
+    if (!can_memoize(d, effects, &reason)) {
+        if (pragma) {
+            fprintf(stderr, "warning: function %s is not memoized: %s\n", d->name, reason);
+        }
+        return 0;
+    }
+    return 1;
+}
+
+// Memoized functions are wrappers around their table, so none of their
+// declarations gets the attribute of the body.
+static int is_memoized_name(const char *name, const char **memoized_names, size_t count) {
+    return is_defined(memoized_names, count, name);
+}
+
+// Calls to each defined function, by its place in the sorted names. When
+// first_calls is not NULL, the place of each function called for the
+// first time is pushed on it.
+typedef struct {
+    const char **defined;
+    size_t count;
+    int *calls;
+    work_stack_t *first_calls;
+} call_count_t;
+
+static void note_call(call_count_t *c, const char *name) {
+    const char **found = bsearch(&name, c->defined, c->count, sizeof(const char *), compare_names);
+    if (!found) return;
+
+    size_t k = (size_t) (found - c->defined);
+    if (c->calls[k]++ == 0 && c->first_calls) {
+        *(size_t *) work_stack_push(c->first_calls) = k;
+    }
+}
+
+static void count_ast_call(struct expr *e, void *context) {
+    if (e->kind == EXPR_CALL && e->left->kind == EXPR_NAME) {
+        note_call(context, e->left->name);
+    }
+}
+
+static void count_calls(struct decl *d, ir_function_t *ir, call_count_t *c) {
+    if (!ir) {
+        ast_visit_decl_exprs(d, count_ast_call, c);
+        return;
+    }
+    for (ir_block_t *b = ir->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            if (i->op == IR_CALL) {
+                note_call(c, i->text);
+            }
+        }
+    }
+}
+
+// Whether the body of d calls a memoized function, whose wrapper writes its
+// table; the body then keeps no attribute either.
+static int calls_memoized(struct decl *d, ir_function_t *ir, const char **memoized_names, size_t count) {
+    int *calls = calloc(count ? count : 1, sizeof(int));
+    if (!calls) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    call_count_t c = {memoized_names, count, calls, NULL};
+    count_calls(d, ir, &c);
+
+    int found = 0;
+    for (size_t m = 0; m < count; m++) {
+        found |= calls[m] > 0;
+    }
+    free(calls);
+    return found;
+}
+
+// Marks in dropped, by place in the sorted names, the functions that were
+// called before inlining and can no longer be reached from main, so they
+// are not emitted as unused static functions: those whose every call was
+// inlined, and what only they called, cycles included. Functions nothing
+// called to begin with stay, as --no-tree-shake asks, and so does what
+// they call.
+static void drop_inlined_functions(struct decl *program, ir_function_t **bodies, const char **defined,
+                                   size_t defined_count, char *dropped) {
+    if (!is_defined(defined, defined_count, intern_string("main"))) return;
+
+    int *before = calloc(defined_count ? defined_count : 1, sizeof(int));
+    int *reached = calloc(defined_count ? defined_count : 1, sizeof(int));
+    struct decl **definitions = calloc(defined_count ? defined_count : 1, sizeof(struct decl *));
+    size_t *indexes = calloc(defined_count ? defined_count : 1, sizeof(size_t));
+    if (!before || !reached || !definitions || !indexes) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    call_count_t c = {defined, defined_count, before, NULL};
+    size_t index = 0;
+    for (struct decl *d = program; d; d = d->next, index++) {
+        count_calls(d, NULL, &c);
+        if (d->code && d->type && d->type->kind == TYPE_FUNCTION) {
+            const char **found = bsearch(&d->name, defined, defined_count, sizeof(const char *), compare_names);
+            definitions[found - defined] = d;
+            indexes[found - defined] = index;
+        }
+    }
+
+    work_stack_t pending;
+    work_stack_init(&pending, sizeof(size_t));
+    c.calls = reached;
+    c.first_calls = &pending;
+    for (size_t k = 0; k < defined_count; k++) {
+        if (!before[k] || defined[k] == intern_string("main")) {
+            note_call(&c, defined[k]);
+        }
+    }
+    for (struct decl *d = program; d; d = d->next) {
+        if (d->type && d->type->kind != TYPE_FUNCTION) {
+            count_calls(d, NULL, &c);
+        }
+    }
+
+    size_t k;
+    while (work_stack_pop(&pending, &k)) {
+        count_calls(definitions[k], bodies[indexes[k]], &c);
+    }
+    for (k = 0; k < defined_count; k++) {
+        dropped[k] = !reached[k];
+    }
+
+    work_stack_free(&pending);
+    free(before);
+    free(reached);
+    free(definitions);
+    free(indexes);
+}
+
+static int is_dropped(struct decl *d, const char **defined, size_t count, const char *dropped) {
+    if (!d->type || d->type->kind != TYPE_FUNCTION) return 0;
+
+    const char **found = bsearch(&d->name, defined, count, sizeof(const char *), compare_names);
+    return found && dropped[found - defined];
+}
+
+// A memoized function is its body under another name followed by the
+// wrapper, with a prototype first for the body's recursive calls. Only the
+// body can get the function's attribute: the wrapper reads and writes its
+// table, which a const or pure function may not.
+static void generate_memoized_c(struct decl *d, ir_function_t *ir, const char *attribute, const char *linkage,
+                                int stats, FILE *output) {
+    char body[256];
+    char specifiers[64];
+    memo_body_name(d, body, sizeof(body));
+    snprintf(specifiers, sizeof(specifiers), "%sstatic ", attribute);
+
+    generate_signature_c(d, c_name(d->name), linkage, output);
+    fprintf(output, ");\n\n");
+    generate_function_c(d, body, ir, specifiers, NULL, output);
+    emit_memo_wrapper(d, linkage, stats, output);
+}
+
+int generate_c_code(struct decl *program, const codegen_options_t *options, FILE *output) {
+    // Globals initialized at run time need a main to do it.
+    struct decl *main_decl = NULL;
+    struct decl *run_time_global = NULL;
+    for (struct decl *d = program; d; d = d->next) {
+        if (d->name == intern_string("main") && d->code) {
+            main_decl = d;
+        } else if (!run_time_global && is_initialized_at_run_time(d)) {
+            run_time_global = d;
+        }
+    }
+    if (run_time_global && !main_decl) {
+        fprintf(stderr, "error: global %s is not initialized with a constant, and there is no main to initialize it\n",
+                run_time_global->name);
+        return 1;
+    }
 
     fprintf(output, "#include <stdio.h>\n");
     fprintf(output, "#include <stdlib.h>\n");
-    fprintf(output, "#include <string.h>\n");
-    fprintf(output, "#include <math.h>\n\n");
+    fprintf(output, "#include <string.h>\n\n");
 
-    generate_decl_c(program, output);
+    size_t count = 0;
+    for (struct decl *d = program; d; d = d->next) {
+        count++;
+    }
+
+    ir_function_t **bodies = calloc(count ? count : 1, sizeof(ir_function_t *));
+    const char **defined = calloc(count ? count : 1, sizeof(const char *));
+    struct decl **memoized = calloc(count ? count : 1, sizeof(struct decl *));
+    const char **memoized_names = calloc(count ? count : 1, sizeof(const char *));
+    if (!bodies || !defined || !memoized || !memoized_names) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
 
-    free_symbol_table(global_symbols);
-    global_symbols = NULL;
-}
\ No newline at end of file
+    effects_t *effects = analyze_effects(program, 0);
+    runtime_needs_t needs = {0, 0, 0, 0, 0, 0};
+
+    size_t defined_count = 0;
+    size_t memoized_count = 0;
+    size_t index = 0;
+    struct decl *previous = NULL;
+    for (struct decl *d = program; d; previous = d, d = d->next, index++) {
+        if (!d->code || !d->type || d->type->kind != TYPE_FUNCTION) continue;
+
+        int memo = is_memoized(d, previous, effects, options);
+        if (memo) {
+            memoized[memoized_count++] = d;
+            needs.memo |= d->type->params != NULL;
+        }
+
+        defined[defined_count++] = d->name;
+        if (options->use_ir) {
+            bodies[index] = lower_function(d, memo, options);
+        }
+    }
+    qsort(defined, defined_count, sizeof(const char *), compare_names);
+    for (size_t m = 0; m < memoized_count; m++) {
+        memoized_names[m] = memoized[m]->name;
+    }
+    qsort(memoized_names, memoized_count, sizeof(const char *), compare_names);
+    needs.memo_stats = options->memo_stats && memoized_count > 0;
+
+    if (options->use_ir) {
+        ir_call_graph_t *graph = ir_build_call_graph(bodies, count);
+
+        // Inlined, a memoized function would skip its table.
+        size_t next_memoized = 0;
+        index = 0;
+        for (struct decl *d = program; d && next_memoized < memoized_count; d = d->next, index++) {
+            if (d == memoized[next_memoized]) {
+                ir_keep_calls(graph, index);
+                next_memoized++;
+            }
+        }
+        size_t order_count;
+        const size_t *order = ir_call_order(graph, &order_count);
+
+        for (size_t o = 0; o < order_count; o++) {
+            optimize_function(graph, bodies, order[o], options);
+        }
+        ir_free_call_graph(graph);
+    }
+
+    char *dropped = calloc(defined_count ? defined_count : 1, sizeof(char));
+    if (!dropped) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    if (options->use_ir) {
+        drop_inlined_functions(program, bodies, defined, defined_count, dropped);
+    }
+
+    index = 0;
+    for (struct decl *d = program; d; d = d->next, index++) {
+        if (is_dropped(d, defined, defined_count, dropped)) {
+            continue;
+        } else if (bodies[index]) {
+            ir_note_runtime_needs(bodies[index], &needs);
+        } else {
+            ast_visit_decl_exprs(d, note_runtime_needs, &needs);
+        }
+    }
+    emit_runtime(&needs, output);
+
+    size_t next_memoized = 0;
+    index = 0;
+    for (struct decl *d = program; d; d = d->next, index++) {
+        if (is_dropped(d, defined, defined_count, dropped)) {
+            ir_free_function(bodies[index]);
+            continue;
+        }
+
+        char specifiers[64] = "";
+        const char *attribute = "";
+        const char *linkage = "";
+        if (d->type && d->type->kind == TYPE_FUNCTION) {
+            attribute = is_memoized_name(d->name, memoized_names, memoized_count) ? "" : function_attribute(d, effects);
+            linkage = function_linkage(d, bodies[index], defined, defined_count, options);
+            snprintf(specifiers, sizeof(specifiers), "%s%s", attribute, linkage);
+        } else if (d->type && is_constant_global(d, effects)) {
+            snprintf(specifiers, sizeof(specifiers), "const ");
+        }
+
+        if (next_memoized < memoized_count && d == memoized[next_memoized]) {
+            attribute = calls_memoized(d, bodies[index], memoized_names, memoized_count) ? ""
+                                                                                        : function_attribute(d, effects);
+            generate_memoized_c(d, bodies[index], attribute, linkage, options->memo_stats, output);
+            next_memoized++;
+        } else if (d == main_decl && run_time_global) {
+            generate_global_initializers_c(program, output);
+            generate_decl_c(d, bodies[index], specifiers, "\tbminor_init_globals();\n", output);
+        } else {
+            generate_decl_c(d, bodies[index], specifiers, NULL, output);
+        }
+        ir_free_function(bodies[index]);
+    }
+    if (needs.memo_stats) {
+        emit_memo_report(memoized, memoized_count, output);
+    }
+
+    free_effects(effects);
+    free(bodies);
+    free(defined);
+    free(memoized);
+    free(memoized_names);
+    free(dropped);
+    return 0;
+}
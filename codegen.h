@@ -4,6 +4,37 @@
 #include <stdio.h>
 #include "ast.h"
 
-void generate_c_code(struct decl *program, FILE *output);
+typedef struct {
+    int use_ir;                     // emit function bodies from the SSA IR
+    FILE *dump_ir;                  // where to print each function's IR, or NULL
+    int inline_budget;              // largest function, in IR instructions, inlined at its calls
+    int memoize;                    // memoize every function that qualifies, not only those with a pragma
+    int memo_stats;                 // report memoization hit rates at exit
+} codegen_options_t;
+
+#define DEFAULT_INLINE_BUDGET 40
+
+// Function bodies go through the IR when options->use_ir is set, callees
+// before their callers so that small ones can be inlined; a function the
+// IR cannot represent, or whose IR fails verification, is generated from
+// the AST instead. In a program with a main, every other function it
+// defines is static, and static inline when it fits the inline budget.
+// Functions without side effects are marked const or pure for the C
+// compiler, and globals that are never written are const (see effects.h).
+// Functions after a "pragma memoize" comment, or all of them with
+// options->memoize, cache their results when they qualify (see memo.h).
+// A global whose initializer is not a constant C takes at file scope is
+// assigned at the start of main instead; without a main that is an
+// error, reported on stderr. Returns the number of errors, and emits
+// nothing when there are any.
+int generate_c_code(struct decl *program, const codegen_options_t *options, FILE *output);
+
+// Shared with the IR emitter and the memoization wrappers.
+void generate_type_c(struct type *t, FILE *output);
+void process_string_for_c(const char *str, FILE *output);
+
+// Emits the function's signature under name, up to the closing
+// parenthesis, after specifiers.
+void generate_signature_c(struct decl *d, const char *name, const char *specifiers, FILE *output);
 
 #endif
\ No newline at end of file
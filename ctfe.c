@@ -0,0 +1,939 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ctfe.h"
+#include "arena.h"
+#include "effects.h"
+#include "fold.h"
+#include "scope.h"
+#include "typecheck.h"
+#include "work_stack.h"
+
+// The interpreter is a machine over explicit stacks, so neither deep
+// expressions nor deep recursion in the evaluated code touch the C stack:
+// a control stack of things left to do, a stack of computed values, the
+// variables bound by the running calls, and one frame per call. A return
+// unwinds the control and value stacks to where its call started.
+//
+// Variables are found by their symbol in the bindings of the current call.
+// Arrays are shared by reference, as in the generated code; those of
+// globals are read-only, and all of an evaluation's other arrays go in one
+// arena released after it.
+
+#define MAX_CTFE_STEPS (1 << 20)            // per evaluation
+#define MAX_CTFE_TOTAL_STEPS (1L << 25)     // for the whole program
+#define MAX_CTFE_DEPTH 4096                 // calls in progress
+#define MAX_CTFE_CELLS (1 << 20)            // array elements per evaluation
+
+typedef enum {
+    VALUE_UNSET,                    // a variable never assigned, or a void result
+    VALUE_SCALAR,                   // integer, char or boolean
+    VALUE_STRING,
+    VALUE_ARRAY
+} value_kind_t;
+
+typedef struct array array_t;
+
+typedef struct {
+    value_kind_t kind;
+    int scalar;
+    const char *string;
+    array_t *array;
+} value_t;
+
+struct array {
+    value_t *cells;
+    int length;
+    int read_only;                  // a global's
+};
+
+typedef struct {
+    struct symbol *symbol;
+    value_t value;
+} binding_t;
+
+typedef struct {
+    struct decl *function;
+    size_t binding_start;
+    size_t control_height;
+    size_t value_height;
+} frame_t;
+
+typedef enum {
+    RUN_EXPR,                       // pushes the value of e
+    RUN_OPERATOR,                   // applies e to the values of its operands
+    RUN_SHORT_CIRCUIT,              // && or ||, after its left operand
+    RUN_CALL,                       // enters the callee, after the arguments
+    RUN_INDEX,                      // after the array and the index
+    RUN_STORE,                      // assigns a variable, after the value
+    RUN_STORE_INDEX,                // assigns an element, after array, index and value
+    RUN_ARRAY,                      // builds an array literal, after its elements
+    RUN_STMTS,                      // runs s and the statements after it
+    RUN_DECLARE,                    // binds a local, after its size and value
+    RUN_DISCARD,                    // drops a value
+    RUN_BRANCH,                     // picks a branch of s, after its condition
+    RUN_LOOP,                       // starts an iteration of s
+    RUN_LOOP_TEST,                  // after the condition of s
+    RUN_RETURN,                     // leaves the call, after the value
+    RUN_FALL_OFF                    // reached the end of a function body
+} run_kind_t;
+
+typedef struct {
+    run_kind_t kind;
+    struct expr *e;
+    struct stmt *s;
+} run_t;
+
+typedef struct {
+    const char *name;
+    struct decl *d;
+    int built;
+    value_t value;
+} global_t;
+
+typedef struct {
+    const char *name;
+    struct decl *d;
+} function_t;
+
+typedef struct {
+    effects_t *effects;
+    function_t *functions;          // definitions, sorted by interned name
+    size_t function_count;
+    global_t *globals;              // global variables, sorted by interned name
+    size_t global_count;
+    arena_t *arena;                 // values of globals, for the whole pass
+    long total_steps;               // left for the whole pass
+
+    int initializer;                // evaluating a global initializer
+
+    // One evaluation.
+    arena_t *scratch;
+    long steps;
+    long cells;
+    work_stack_t control;           // run_t
+    work_stack_t values;            // value_t
+    work_stack_t bindings;          // binding_t
+    work_stack_t frames;            // frame_t
+} ctfe_t;
+
+static void *allocate(size_t count, size_t size) {
+    void *memory = calloc(count ? count : 1, size);
+    if (!memory) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return memory;
+}
+
+// Both tables start with the interned name.
+static int compare_names(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t) *(const char * const *) a;
+    uintptr_t y = (uintptr_t) *(const char * const *) b;
+    return (x > y) - (x < y);
+}
+
+static function_t *find_function(ctfe_t *ctfe, const char *name) {
+    return bsearch(&name, ctfe->functions, ctfe->function_count, sizeof(function_t), compare_names);
+}
+
+static global_t *find_global(ctfe_t *ctfe, const char *name) {
+    return bsearch(&name, ctfe->globals, ctfe->global_count, sizeof(global_t), compare_names);
+}
+
+static int is_scalar_type(struct type *t) {
+    return t && (t->kind == TYPE_INTEGER || t->kind == TYPE_CHARACTER || t->kind == TYPE_BOOLEAN);
+}
+
+static int is_literal(struct expr *e) {
+    return e->kind == EXPR_INTEGER_LITERAL || e->kind == EXPR_CHAR_LITERAL || e->kind == EXPR_BOOL_LITERAL;
+}
+
+static value_t scalar(int value) {
+    return (value_t) {VALUE_SCALAR, value, NULL, NULL};
+}
+
+// An array of length unset elements, or NULL past the limit on cells.
+static array_t *new_array(ctfe_t *ctfe, arena_t *arena, long length) {
+    if (length < 0 || length > MAX_CTFE_CELLS - ctfe->cells) return NULL;
+    ctfe->cells += length;
+
+    array_t *array = arena_alloc(arena, sizeof(array_t));
+    array->cells = arena_alloc(arena, (size_t) (length ? length : 1) * sizeof(value_t));
+    memset(array->cells, 0, (size_t) (length ? length : 1) * sizeof(value_t));
+    array->length = (int) length;
+    array->read_only = 0;
+    return array;
+}
+
+static int literal_value(struct expr *e, value_t *value) {
+    if (is_literal(e)) {
+        *value = scalar(e->integer_value);
+        return 1;
+    }
+    if (e->kind == EXPR_STRING_LITERAL) {
+        *value = (value_t) {VALUE_STRING, 0, e->string_literal, NULL};
+        return 1;
+    }
+    return 0;
+}
+
+// What a global holds before main runs: its initializer, which must be a
+// literal by now, or zeros.
+static int build_global(ctfe_t *ctfe, global_t *global) {
+    struct decl *d = global->d;
+    struct expr *value = d->value;
+
+    if (d->type->kind != TYPE_ARRAY) {
+        if (!value) {
+            if (!is_scalar_type(d->type)) return 0;
+            global->value = scalar(0);
+            return 1;
+        }
+        return literal_value(value, &global->value);
+    }
+
+    struct expr *size = d->type->array_size;
+    if (!is_scalar_type(d->type->subtype) || !size || size->kind != EXPR_INTEGER_LITERAL) return 0;
+    if (value && value->kind != EXPR_ARRAY_LITERAL) return 0;
+
+    int length = 0;
+    for (struct expr *cell = value ? value->right : NULL; cell; cell = cell->right, length++) {
+        if (!is_literal(cell->left)) return 0;
+    }
+    if (length > size->integer_value) return 0;
+
+    // Globals count against the limit of the evaluation that reads them
+    // first.
+    array_t *array = new_array(ctfe, ctfe->arena, size->integer_value);
+    if (!array) return 0;
+
+    int n = 0;
+    for (struct expr *cell = value ? value->right : NULL; cell; cell = cell->right, n++) {
+        array->cells[n] = scalar(cell->left->integer_value);
+    }
+    for (; n < array->length; n++) {
+        array->cells[n] = scalar(0);
+    }
+
+    array->read_only = 1;
+    global->value = (value_t) {VALUE_ARRAY, 0, NULL, array};
+    return 1;
+}
+
+// A global can be read when its value is the one it starts with: always in
+// an initializer, and otherwise when nothing writes it.
+static int read_global(ctfe_t *ctfe, const char *name, value_t *value) {
+    global_t *global = find_global(ctfe, name);
+    if (!global || (!ctfe->initializer && global_is_written(ctfe->effects, name))) return 0;
+
+    if (!global->built && !build_global(ctfe, global)) return 0;
+    global->built = 1;
+    *value = global->value;
+    return 1;
+}
+
+static binding_t *find_binding(ctfe_t *ctfe, struct symbol *symbol) {
+    frame_t *frame = work_stack_top(&ctfe->frames);
+    if (!frame) return NULL;
+
+    binding_t *bindings = (binding_t *) ctfe->bindings.items;
+    for (size_t b = ctfe->bindings.count; b > frame->binding_start; b--) {
+        if (bindings[b - 1].symbol == symbol) {
+            return &bindings[b - 1];
+        }
+    }
+    return NULL;
+}
+
+static void bind(ctfe_t *ctfe, struct symbol *symbol, value_t value) {
+    binding_t *binding = find_binding(ctfe, symbol);
+    if (!binding) {
+        binding = work_stack_push(&ctfe->bindings);
+        binding->symbol = symbol;
+    }
+    binding->value = value;
+}
+
+static int read_name(ctfe_t *ctfe, struct expr *e, value_t *value) {
+    if (!e->symbol) return 0;
+
+    if (e->symbol->kind == SYMBOL_GLOBAL) {
+        return read_global(ctfe, e->name, value);
+    }
+
+    binding_t *binding = find_binding(ctfe, e->symbol);
+    if (!binding || binding->value.kind == VALUE_UNSET) return 0;
+    *value = binding->value;
+    return 1;
+}
+
+static void push_run(ctfe_t *ctfe, run_kind_t kind, struct expr *e, struct stmt *s) {
+    run_t *item = work_stack_push(&ctfe->control);
+    item->kind = kind;
+    item->e = e;
+    item->s = s;
+}
+
+static void push_value(ctfe_t *ctfe, value_t value) {
+    *(value_t *) work_stack_push(&ctfe->values) = value;
+}
+
+static value_t pop_value(ctfe_t *ctfe) {
+    value_t value = {VALUE_UNSET, 0, NULL, NULL};
+    work_stack_pop(&ctfe->values, &value);
+    return value;
+}
+
+static arena_t *scratch(ctfe_t *ctfe) {
+    if (!ctfe->scratch) {
+        ctfe->scratch = arena_create(0);
+    }
+    return ctfe->scratch;
+}
+
+// Schedules the evaluation of e. Returns 0 when e cannot be evaluated.
+static int run_expr(ctfe_t *ctfe, struct expr *e) {
+    value_t value;
+
+    switch (e->kind) {
+        case EXPR_INTEGER_LITERAL:
+        case EXPR_CHAR_LITERAL:
+        case EXPR_BOOL_LITERAL:
+        case EXPR_STRING_LITERAL:
+            literal_value(e, &value);
+            push_value(ctfe, value);
+            return 1;
+
+        case EXPR_NAME:
+            if (!read_name(ctfe, e, &value)) return 0;
+            push_value(ctfe, value);
+            return 1;
+
+        case EXPR_CALL:
+            push_run(ctfe, RUN_CALL, e, NULL);
+            for (struct expr *arg = e->right; arg; arg = arg->right) {
+                push_run(ctfe, RUN_EXPR, arg->left, NULL);
+            }
+            return 1;
+
+        case EXPR_ARRAY_LITERAL:
+            push_run(ctfe, RUN_ARRAY, e, NULL);
+            for (struct expr *cell = e->right; cell; cell = cell->right) {
+                push_run(ctfe, RUN_EXPR, cell->left, NULL);
+            }
+            return 1;
+
+        case EXPR_SUBSCRIPT:
+            push_run(ctfe, RUN_INDEX, e, NULL);
+            push_run(ctfe, RUN_EXPR, e->right, NULL);
+            push_run(ctfe, RUN_EXPR, e->left, NULL);
+            return 1;
+
+        case EXPR_ASSIGN:
+            if (e->left->kind == EXPR_NAME) {
+                push_run(ctfe, RUN_STORE, e, NULL);
+                push_run(ctfe, RUN_EXPR, e->right, NULL);
+                return 1;
+            }
+            if (e->left->kind == EXPR_SUBSCRIPT) {
+                push_run(ctfe, RUN_STORE_INDEX, e, NULL);
+                push_run(ctfe, RUN_EXPR, e->right, NULL);
+                push_run(ctfe, RUN_EXPR, e->left->right, NULL);
+                push_run(ctfe, RUN_EXPR, e->left->left, NULL);
+                return 1;
+            }
+            return 0;
+
+        case EXPR_AND:
+        case EXPR_OR:
+            push_run(ctfe, RUN_SHORT_CIRCUIT, e, NULL);
+            push_run(ctfe, RUN_EXPR, e->left, NULL);
+            return 1;
+
+        case EXPR_ARG:
+            return 0;
+
+        default:
+            push_run(ctfe, RUN_OPERATOR, e, NULL);
+            push_run(ctfe, RUN_EXPR, e->right, NULL);
+            if (e->left) {
+                push_run(ctfe, RUN_EXPR, e->left, NULL);
+            }
+            return 1;
+    }
+}
+
+static int run_operator(ctfe_t *ctfe, struct expr *e) {
+    value_t right = pop_value(ctfe);
+    value_t left = e->left ? pop_value(ctfe) : scalar(0);
+    if (left.kind != VALUE_SCALAR || right.kind != VALUE_SCALAR) return 0;
+
+    int a = left.scalar;
+    int b = right.scalar;
+    int result;
+
+    switch (e->kind) {
+        case EXPR_UNARY_MINUS:
+            if (!evaluate_integer_operator(EXPR_SUB, 0, b, &result)) return 0;
+            break;
+        case EXPR_NOT: result = !b; break;
+        case EXPR_LT: result = a < b; break;
+        case EXPR_LE: result = a <= b; break;
+        case EXPR_GT: result = a > b; break;
+        case EXPR_GE: result = a >= b; break;
+        case EXPR_EQ: result = a == b; break;
+        case EXPR_NEQ: result = a != b; break;
+        default:
+            if (!evaluate_integer_operator(e->kind, a, b, &result)) return 0;
+            break;
+    }
+
+    push_value(ctfe, scalar(result));
+    return 1;
+}
+
+// Enters the function e calls, binding its parameters to the arguments
+// on the value stack, the first on top.
+static int run_call(ctfe_t *ctfe, struct expr *e) {
+    function_t *callee = e->left->kind == EXPR_NAME ? find_function(ctfe, e->left->name) : NULL;
+    if (!callee || ctfe->frames.count >= MAX_CTFE_DEPTH) return 0;
+
+    // The bindings go on top of the caller's; the arguments are taken off
+    // the value stack first, so the frame starts below them.
+    frame_t frame;
+    frame.function = callee->d;
+    frame.binding_start = ctfe->bindings.count;
+
+    work_stack_t *bindings = &ctfe->bindings;
+    for (struct param_list *p = callee->d->type->params; p; p = p->next) {
+        binding_t *binding = work_stack_push(bindings);
+        binding->symbol = p->symbol;
+        binding->value = pop_value(ctfe);
+    }
+
+    frame.control_height = ctfe->control.count;
+    frame.value_height = ctfe->values.count;
+    *(frame_t *) work_stack_push(&ctfe->frames) = frame;
+
+    push_run(ctfe, RUN_FALL_OFF, NULL, NULL);
+    push_run(ctfe, RUN_STMTS, NULL, callee->d->code);
+    return 1;
+}
+
+static int run_return(ctfe_t *ctfe, value_t result) {
+    frame_t frame;
+    if (!work_stack_pop(&ctfe->frames, &frame)) return 0;
+
+    ctfe->control.count = frame.control_height;
+    ctfe->values.count = frame.value_height;
+    ctfe->bindings.count = frame.binding_start;
+
+    push_value(ctfe, result);
+    return 1;
+}
+
+static int run_index(ctfe_t *ctfe) {
+    value_t index = pop_value(ctfe);
+    value_t array = pop_value(ctfe);
+    if (array.kind != VALUE_ARRAY || index.kind != VALUE_SCALAR) return 0;
+    if (index.scalar < 0 || index.scalar >= array.array->length) return 0;
+
+    value_t cell = array.array->cells[index.scalar];
+    if (cell.kind == VALUE_UNSET) return 0;
+    push_value(ctfe, cell);
+    return 1;
+}
+
+static int run_store(ctfe_t *ctfe, struct expr *e) {
+    value_t value = pop_value(ctfe);
+    struct expr *target = e->left;
+    if (!target->symbol || target->symbol->kind == SYMBOL_GLOBAL) return 0;
+
+    binding_t *binding = find_binding(ctfe, target->symbol);
+    if (!binding) return 0;
+    binding->value = value;
+    push_value(ctfe, value);
+    return 1;
+}
+
+static int run_store_index(ctfe_t *ctfe) {
+    value_t value = pop_value(ctfe);
+    value_t index = pop_value(ctfe);
+    value_t array = pop_value(ctfe);
+    if (array.kind != VALUE_ARRAY || array.array->read_only || index.kind != VALUE_SCALAR) return 0;
+    if (index.scalar < 0 || index.scalar >= array.array->length) return 0;
+
+    array.array->cells[index.scalar] = value;
+    push_value(ctfe, value);
+    return 1;
+}
+
+// The elements are on the value stack, the first on top.
+static int run_array(ctfe_t *ctfe, struct expr *e) {
+    long length = 0;
+    for (struct expr *cell = e->right; cell; cell = cell->right) {
+        length++;
+    }
+
+    array_t *array = new_array(ctfe, scratch(ctfe), length);
+    if (!array) return 0;
+    for (int n = 0; n < array->length; n++) {
+        array->cells[n] = pop_value(ctfe);
+    }
+
+    push_value(ctfe, (value_t) {VALUE_ARRAY, 0, NULL, array});
+    return 1;
+}
+
+// A local array gets its size and initializer, with the elements past the
+// initializer zero as in C; one without an initializer starts unset.
+static int run_declare(ctfe_t *ctfe, struct decl *d) {
+    value_t value = d->value ? pop_value(ctfe) : (value_t) {VALUE_UNSET, 0, NULL, NULL};
+
+    if (d->type->kind == TYPE_ARRAY) {
+        if (!is_scalar_type(d->type->subtype) && d->type->subtype->kind != TYPE_STRING) return 0;
+        if (d->value && value.kind != VALUE_ARRAY) return 0;
+
+        value_t size = d->type->array_size ? pop_value(ctfe) : scalar(value.array ? value.array->length : 0);
+        if (size.kind != VALUE_SCALAR || (value.array && value.array->length > size.scalar)) return 0;
+
+        array_t *array = new_array(ctfe, scratch(ctfe), size.scalar);
+        if (!array) return 0;
+        for (int n = 0; value.array && n < array->length; n++) {
+            array->cells[n] = n < value.array->length ? value.array->cells[n] : scalar(0);
+        }
+        value = (value_t) {VALUE_ARRAY, 0, NULL, array};
+    }
+
+    bind(ctfe, d->symbol, value);
+    return 1;
+}
+
+static int run_stmt(ctfe_t *ctfe, struct stmt *s) {
+    if (s->next) {
+        push_run(ctfe, RUN_STMTS, NULL, s->next);
+    }
+
+    switch (s->kind) {
+        case STMT_DECL: {
+            struct decl *d = s->decl;
+            if (!d) return 1;
+            if (d->code || d->type->kind == TYPE_FUNCTION) return 0;
+
+            push_run(ctfe, RUN_DECLARE, NULL, s);
+            if (d->value) {
+                push_run(ctfe, RUN_EXPR, d->value, NULL);
+            }
+            if (d->type->kind == TYPE_ARRAY && d->type->array_size) {
+                push_run(ctfe, RUN_EXPR, d->type->array_size, NULL);
+            }
+            return 1;
+        }
+
+        case STMT_EXPR:
+            push_run(ctfe, RUN_DISCARD, NULL, NULL);
+            push_run(ctfe, RUN_EXPR, s->expr, NULL);
+            return 1;
+
+        case STMT_IF_ELSE:
+            push_run(ctfe, RUN_BRANCH, NULL, s);
+            push_run(ctfe, RUN_EXPR, s->expr, NULL);
+            return 1;
+
+        case STMT_FOR:
+            push_run(ctfe, RUN_LOOP, NULL, s);
+            if (s->init_expr) {
+                push_run(ctfe, RUN_DISCARD, NULL, NULL);
+                push_run(ctfe, RUN_EXPR, s->init_expr, NULL);
+            }
+            return 1;
+
+        case STMT_RETURN:
+            push_run(ctfe, RUN_RETURN, NULL, s);
+            if (s->expr) {
+                push_run(ctfe, RUN_EXPR, s->expr, NULL);
+            }
+            return 1;
+
+        case STMT_BLOCK:
+            if (s->body) {
+                push_run(ctfe, RUN_STMTS, NULL, s->body);
+            }
+            return 1;
+
+        case STMT_PRINT:
+            return 0;
+
+        case STMT_COMMENT:
+        case STMT_MULTI_COMMENT:
+            return 1;
+    }
+    return 0;
+}
+
+// One more iteration of the loop s: its body, its next expression, and
+// the test for the one after.
+static void run_iteration(ctfe_t *ctfe, struct stmt *s) {
+    push_run(ctfe, RUN_LOOP, NULL, s);
+    if (s->next_expr) {
+        push_run(ctfe, RUN_DISCARD, NULL, NULL);
+        push_run(ctfe, RUN_EXPR, s->next_expr, NULL);
+    }
+    if (s->body) {
+        push_run(ctfe, RUN_STMTS, NULL, s->body);
+    }
+}
+
+static int step(ctfe_t *ctfe, run_t *item) {
+    struct stmt *s = item->s;
+    value_t value;
+
+    switch (item->kind) {
+        case RUN_EXPR: return run_expr(ctfe, item->e);
+        case RUN_OPERATOR: return run_operator(ctfe, item->e);
+        case RUN_CALL: return run_call(ctfe, item->e);
+        case RUN_INDEX: return run_index(ctfe);
+        case RUN_STORE: return run_store(ctfe, item->e);
+        case RUN_STORE_INDEX: return run_store_index(ctfe);
+        case RUN_ARRAY: return run_array(ctfe, item->e);
+        case RUN_STMTS: return run_stmt(ctfe, s);
+        case RUN_DECLARE: return run_declare(ctfe, s->decl);
+
+        case RUN_SHORT_CIRCUIT:
+            value = pop_value(ctfe);
+            if (value.kind != VALUE_SCALAR) return 0;
+            if (value.scalar == (item->e->kind == EXPR_OR)) {
+                push_value(ctfe, value);
+            } else {
+                push_run(ctfe, RUN_EXPR, item->e->right, NULL);
+            }
+            return 1;
+
+        case RUN_DISCARD:
+            pop_value(ctfe);
+            return 1;
+
+        case RUN_BRANCH:
+            value = pop_value(ctfe);
+            if (value.kind != VALUE_SCALAR) return 0;
+            if (value.scalar && s->body) {
+                push_run(ctfe, RUN_STMTS, NULL, s->body);
+            } else if (!value.scalar && s->else_body) {
+                push_run(ctfe, RUN_STMTS, NULL, s->else_body);
+            }
+            return 1;
+
+        case RUN_LOOP:
+            if (s->expr) {
+                push_run(ctfe, RUN_LOOP_TEST, NULL, s);
+                push_run(ctfe, RUN_EXPR, s->expr, NULL);
+            } else {
+                run_iteration(ctfe, s);
+            }
+            return 1;
+
+        case RUN_LOOP_TEST:
+            value = pop_value(ctfe);
+            if (value.kind != VALUE_SCALAR) return 0;
+            if (value.scalar) {
+                run_iteration(ctfe, s);
+            }
+            return 1;
+
+        case RUN_RETURN:
+            value = s->expr ? pop_value(ctfe) : (value_t) {VALUE_UNSET, 0, NULL, NULL};
+            return run_return(ctfe, value);
+
+        case RUN_FALL_OFF: {
+            // Only a void function may end without a return.
+            frame_t *frame = work_stack_top(&ctfe->frames);
+            if (frame->function->type->subtype->kind != TYPE_VOID) return 0;
+            return run_return(ctfe, (value_t) {VALUE_UNSET, 0, NULL, NULL});
+        }
+    }
+    return 0;
+}
+
+// Evaluates e, which must give an integer, char or boolean. Returns 0 when
+// it cannot be done at compile time.
+static int evaluate(ctfe_t *ctfe, struct expr *e, int *result) {
+    ctfe->control.count = 0;
+    ctfe->values.count = 0;
+    ctfe->bindings.count = 0;
+    ctfe->frames.count = 0;
+    ctfe->steps = MAX_CTFE_STEPS;
+    ctfe->cells = 0;
+
+    push_run(ctfe, RUN_EXPR, e, NULL);
+
+    int ok = 1;
+    run_t item;
+    while (ok && work_stack_pop(&ctfe->control, &item)) {
+        if (ctfe->steps-- == 0 || ctfe->total_steps-- <= 0) {
+            ok = 0;
+            break;
+        }
+        ok = step(ctfe, &item);
+    }
+
+    value_t value = pop_value(ctfe);
+    ok = ok && value.kind == VALUE_SCALAR;
+    if (ok) {
+        *result = value.scalar;
+    }
+
+    if (ctfe->scratch) {
+        arena_destroy(ctfe->scratch);
+        ctfe->scratch = NULL;
+    }
+    return ok;
+}
+
+// The search for subexpressions worth evaluating. The nodes of an
+// expression are laid out in post-order, each with the size of its
+// subtree, so that its operands can be found again going down.
+
+typedef struct {
+    struct expr *e;
+    int children_done;
+} walk_t;
+
+typedef struct {
+    struct expr *e;
+    int closed;                     // made only of what evaluate can see
+    int has_call;
+    size_t size;                    // nodes in the subtree
+} node_t;
+
+// Whether e itself, not counting its operands, can be evaluated here.
+static int is_closed_node(ctfe_t *ctfe, struct expr *e) {
+    switch (e->kind) {
+        case EXPR_NAME:
+            if (!e->symbol || e->symbol->kind != SYMBOL_GLOBAL) return 0;
+            if (e->type && e->type->kind == TYPE_FUNCTION) return 1;
+            return ctfe->initializer || !global_is_written(ctfe->effects, e->name);
+
+        case EXPR_CALL: {
+            if (e->left->kind != EXPR_NAME || !find_function(ctfe, e->left->name)) return 0;
+
+            effect_t effect = function_effect(ctfe->effects, e->left->name);
+            return effect == EFFECT_CONST || (ctfe->initializer && effect == EFFECT_PURE);
+        }
+
+        case EXPR_ASSIGN:
+            return 0;
+
+        default:
+            return 1;
+    }
+}
+
+// Worth evaluating as a whole: a scalar that is not a literal yet, with a
+// call in it unless it initializes a global.
+static int is_candidate(ctfe_t *ctfe, node_t *node) {
+    struct expr *e = node->e;
+    return node->closed && e->kind != EXPR_ARG && is_scalar_type(e->type) && !is_literal(e) &&
+           (node->has_call || ctfe->initializer);
+}
+
+static void replace_with_literal(struct expr *e, int value) {
+    switch (e->type->kind) {
+        case TYPE_BOOLEAN: e->kind = EXPR_BOOL_LITERAL; break;
+        case TYPE_CHARACTER: e->kind = EXPR_CHAR_LITERAL; break;
+        default: e->kind = EXPR_INTEGER_LITERAL; break;
+    }
+    e->left = NULL;
+    e->right = NULL;
+    e->integer_value = value;
+    e->type = type_basic(e->type->kind);
+}
+
+static void lay_out(ctfe_t *ctfe, struct expr *root, work_stack_t *nodes) {
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(walk_t));
+    ((walk_t *) work_stack_push(&stack))->e = root;
+
+    walk_t item;
+    while (work_stack_pop(&stack, &item)) {
+        struct expr *e = item.e;
+
+        if (!item.children_done) {
+            walk_t *again = work_stack_push(&stack);
+            again->e = e;
+            again->children_done = 1;
+
+            if (expr_has_operands(e)) {
+                if (e->right) ((walk_t *) work_stack_push(&stack))->e = e->right;
+                if (e->left) ((walk_t *) work_stack_push(&stack))->e = e->left;
+            }
+            continue;
+        }
+
+        ctfe->total_steps--;
+
+        node_t node = {e, is_closed_node(ctfe, e), e->kind == EXPR_CALL, 1};
+        size_t child = nodes->count;
+        int operands = expr_has_operands(e) ? (e->left != NULL) + (e->right != NULL) : 0;
+        for (int c = operands; c > 0; c--) {
+            node_t *operand = (node_t *) nodes->items + child - 1;
+            node.closed &= operand->closed;
+            node.has_call |= operand->has_call;
+            node.size += operand->size;
+            child -= operand->size;
+        }
+        *(node_t *) work_stack_push(nodes) = node;
+    }
+
+    work_stack_free(&stack);
+}
+
+// Replaces the largest candidates in root by their values, going into a
+// candidate that cannot be evaluated as a whole for parts that can.
+static void evaluate_expr(ctfe_t *ctfe, struct expr *root) {
+    if (!root || ctfe->total_steps <= 0) return;
+
+    work_stack_t nodes;
+    work_stack_t stack;
+    work_stack_init(&nodes, sizeof(node_t));
+    work_stack_init(&stack, sizeof(size_t));
+    lay_out(ctfe, root, &nodes);
+    *(size_t *) work_stack_push(&stack) = nodes.count - 1;
+
+    size_t index;
+    while (ctfe->total_steps > 0 && work_stack_pop(&stack, &index)) {
+        node_t *node = (node_t *) nodes.items + index;
+        struct expr *e = node->e;
+
+        int value;
+        if (is_candidate(ctfe, node) && evaluate(ctfe, e, &value)) {
+            replace_with_literal(e, value);
+            continue;
+        }
+        if ((!node->has_call && !ctfe->initializer) || !expr_has_operands(e)) continue;
+
+        size_t child = index;
+        if (e->right) {
+            *(size_t *) work_stack_push(&stack) = child - 1;
+            child -= ((node_t *) nodes.items + child - 1)->size;
+        }
+        if (e->left) {
+            *(size_t *) work_stack_push(&stack) = child - 1;
+        }
+    }
+
+    work_stack_free(&nodes);
+    work_stack_free(&stack);
+}
+
+static void evaluate_decl(ctfe_t *ctfe, struct decl *d) {
+    if (d->type && d->type->kind == TYPE_ARRAY) {
+        evaluate_expr(ctfe, d->type->array_size);
+    }
+    evaluate_expr(ctfe, d->value);
+}
+
+static void evaluate_body(ctfe_t *ctfe, struct stmt *body) {
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(struct stmt *));
+    if (body) {
+        *(struct stmt **) work_stack_push(&stack) = body;
+    }
+
+    struct stmt *s;
+    while (work_stack_pop(&stack, &s)) {
+        if (s->next) *(struct stmt **) work_stack_push(&stack) = s->next;
+
+        switch (s->kind) {
+            case STMT_DECL:
+                if (s->decl) {
+                    evaluate_decl(ctfe, s->decl);
+                    if (s->decl->code) *(struct stmt **) work_stack_push(&stack) = s->decl->code;
+                }
+                break;
+            case STMT_IF_ELSE:
+                evaluate_expr(ctfe, s->expr);
+                if (s->else_body) *(struct stmt **) work_stack_push(&stack) = s->else_body;
+                if (s->body) *(struct stmt **) work_stack_push(&stack) = s->body;
+                break;
+            case STMT_FOR:
+                evaluate_expr(ctfe, s->init_expr);
+                evaluate_expr(ctfe, s->expr);
+                evaluate_expr(ctfe, s->next_expr);
+                if (s->body) *(struct stmt **) work_stack_push(&stack) = s->body;
+                break;
+            case STMT_BLOCK:
+                if (s->body) *(struct stmt **) work_stack_push(&stack) = s->body;
+                break;
+            case STMT_EXPR:
+            case STMT_PRINT:
+            case STMT_RETURN:
+                evaluate_expr(ctfe, s->expr);
+                break;
+            case STMT_COMMENT:
+            case STMT_MULTI_COMMENT:
+                break;
+        }
+    }
+
+    work_stack_free(&stack);
+}
+
+void evaluate_constant_calls(struct decl *program) {
+    ctfe_t ctfe;
+    memset(&ctfe, 0, sizeof(ctfe));
+
+    size_t count = 0;
+    for (struct decl *d = program; d; d = d->next) {
+        count++;
+    }
+    ctfe.functions = allocate(count, sizeof(function_t));
+    ctfe.globals = allocate(count, sizeof(global_t));
+
+    for (struct decl *d = program; d; d = d->next) {
+        if (!d->type) continue;
+
+        if (d->type->kind == TYPE_FUNCTION) {
+            if (d->code) {
+                ctfe.functions[ctfe.function_count++] = (function_t) {d->name, d};
+            }
+        } else {
+            global_t *global = &ctfe.globals[ctfe.global_count++];
+            global->name = d->name;
+            global->d = d;
+        }
+    }
+    qsort(ctfe.functions, ctfe.function_count, sizeof(function_t), compare_names);
+    qsort(ctfe.globals, ctfe.global_count, sizeof(global_t), compare_names);
+
+    ctfe.effects = analyze_effects(program, 1);
+    ctfe.arena = arena_create(0);
+    ctfe.total_steps = MAX_CTFE_TOTAL_STEPS;
+    work_stack_init(&ctfe.control, sizeof(run_t));
+    work_stack_init(&ctfe.values, sizeof(value_t));
+    work_stack_init(&ctfe.bindings, sizeof(binding_t));
+    work_stack_init(&ctfe.frames, sizeof(frame_t));
+
+    // Globals in order, so an initializer sees the ones before it already
+    // evaluated.
+    for (struct decl *d = program; d; d = d->next) {
+        if (!d->type) continue;
+
+        if (d->type->kind == TYPE_FUNCTION) {
+            ctfe.initializer = 0;
+            evaluate_body(&ctfe, d->code);
+        } else {
+            ctfe.initializer = 1;
+            evaluate_decl(&ctfe, d);
+        }
+    }
+
+    work_stack_free(&ctfe.control);
+    work_stack_free(&ctfe.values);
+    work_stack_free(&ctfe.bindings);
+    work_stack_free(&ctfe.frames);
+    arena_destroy(ctfe.arena);
+    free_effects(ctfe.effects);
+    free(ctfe.functions);
+    free(ctfe.globals);
+}
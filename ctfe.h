@@ -0,0 +1,27 @@
+#ifndef CTFE_H
+#define CTFE_H
+
+#include "ast.h"
+
+// Compile-time function evaluation, run on a type-checked program before
+// fold_program. A small interpreter over the AST runs calls whose
+// arguments are all known, and the expression around them is replaced by
+// the literal it computes:
+//
+//  - in function bodies, the largest subexpressions made of literals,
+//    operators, globals that are never written and calls to const
+//    functions (see effects.h), when they contain such a call and have an
+//    integer, char or boolean value;
+//  - in global initializers, every such subexpression, calls to pure
+//    functions and reads of any global included, since they run before
+//    anything is written. A global array initializer has each element
+//    evaluated, so a lookup table computed by a function is baked in.
+//
+// Evaluation is abandoned, leaving the expression for run time, when it
+// would print, write a global, call a function without a body, divide by
+// zero, index out of bounds, read a variable that was never assigned, or
+// exceed the step, call depth or array size limits; a limit on the steps
+// of the whole pass keeps it from slowing compilation down.
+void evaluate_constant_calls(struct decl *program);
+
+#endif
@@ -0,0 +1,330 @@
+#include "dce.h"
+#include "fold.h"
+#include "scope.h"
+#include "work_stack.h"
+
+// Enough for chains of stores feeding each other a few levels deep;
+// longer chains are left partly in place rather than costing more passes.
+#define MAX_ROUNDS 8
+
+// Collects a link to every statement list in the program's function
+// bodies, outer lists before the lists nested in them. A link is the
+// pointer that holds the head of the list, so lists can be edited in
+// place.
+static void collect_lists(struct decl *program, work_stack_t *lists) {
+    work_stack_t pending;
+    work_stack_init(&pending, sizeof(struct stmt **));
+
+    for (struct decl *d = program; d; d = d->next) {
+        if (d->code) {
+            *(struct stmt ***) work_stack_push(&pending) = &d->code;
+        }
+    }
+
+    struct stmt **link;
+    while (work_stack_pop(&pending, &link)) {
+        *(struct stmt ***) work_stack_push(lists) = link;
+
+        for (struct stmt *s = *link; s; s = s->next) {
+            if (s->body) {
+                *(struct stmt ***) work_stack_push(&pending) = &s->body;
+            }
+            if (s->kind == STMT_IF_ELSE && s->else_body) {
+                *(struct stmt ***) work_stack_push(&pending) = &s->else_body;
+            }
+            if (s->kind == STMT_DECL && s->decl && s->decl->code) {
+                *(struct stmt ***) work_stack_push(&pending) = &s->decl->code;
+            }
+        }
+    }
+
+    work_stack_free(&pending);
+}
+
+static struct stmt *last_stmt(struct stmt *list) {
+    while (list && list->next) {
+        list = list->next;
+    }
+    return list;
+}
+
+// Whether control never reaches the statement after s. Lists are trimmed
+// innermost first, so a list that never falls through ends in the
+// statement that does not.
+static int never_falls_through(struct stmt *s) {
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(struct stmt *));
+    *(struct stmt **) work_stack_push(&stack) = s;
+
+    // Every statement on the stack has to be one that never falls through.
+    int result = 1;
+    while (result && work_stack_pop(&stack, &s)) {
+        if (!s) {
+            result = 0;
+            break;
+        }
+
+        switch (s->kind) {
+            case STMT_RETURN:
+                break;
+            case STMT_FOR:
+                // There is no break, so a loop without a condition only
+                // ends by returning.
+                result = !s->expr;
+                break;
+            case STMT_BLOCK:
+                *(struct stmt **) work_stack_push(&stack) = last_stmt(s->body);
+                break;
+            case STMT_IF_ELSE:
+                *(struct stmt **) work_stack_push(&stack) = last_stmt(s->body);
+                *(struct stmt **) work_stack_push(&stack) = last_stmt(s->else_body);
+                break;
+            default:
+                result = 0;
+                break;
+        }
+    }
+
+    work_stack_free(&stack);
+    return result;
+}
+
+static int is_bool_literal(struct expr *e) {
+    return e && e->kind == EXPR_BOOL_LITERAL;
+}
+
+static int declares_names(struct stmt *list) {
+    for (struct stmt *s = list; s; s = s->next) {
+        if (s->kind == STMT_DECL) return 1;
+    }
+    return 0;
+}
+
+// Replaces the statement at *link with branch, the body that runs. A block
+// that declares nothing is spliced in statement by statement; a lone
+// declaration gets a block so its scope stays the same.
+static void replace_with_branch(struct stmt **link, struct stmt *branch) {
+    struct stmt *rest = (*link)->next;
+
+    if (!branch) {
+        *link = rest;
+        return;
+    }
+
+    if (branch->kind == STMT_BLOCK && !declares_names(branch->body)) {
+        if (!branch->body) {
+            *link = rest;
+            return;
+        }
+        last_stmt(branch->body)->next = rest;
+        *link = branch->body;
+        return;
+    }
+
+    if (branch->kind == STMT_DECL) {
+        struct stmt *block = create_stmt(STMT_BLOCK);
+        block->body = branch;
+        branch = block;
+    }
+
+    branch->next = rest;
+    *link = branch;
+}
+
+// Folds constant conditions and drops unreachable statements in one list.
+// Returns whether anything changed.
+static int trim_list(struct stmt **link) {
+    int changed = 0;
+
+    while (*link) {
+        struct stmt *s = *link;
+
+        if (s->kind == STMT_IF_ELSE && is_bool_literal(s->expr)) {
+            replace_with_branch(link, s->expr->integer_value ? s->body : s->else_body);
+            changed = 1;
+            continue;
+        }
+
+        if (s->kind == STMT_FOR && is_bool_literal(s->expr)) {
+            if (s->expr->integer_value) {
+                s->expr = NULL;
+            } else if (s->init_expr) {
+                struct stmt *init = create_stmt(STMT_EXPR);
+                init->expr = s->init_expr;
+                init->next = s->next;
+                *link = init;
+            } else {
+                *link = s->next;
+            }
+            changed = 1;
+            continue;
+        }
+
+        if (s->next && never_falls_through(s)) {
+            s->next = NULL;
+            changed = 1;
+        }
+
+        link = &s->next;
+    }
+
+    return changed;
+}
+
+static void reset_symbol(struct symbol *sym) {
+    if (sym) {
+        sym->reads = 0;
+        sym->writes = 0;
+    }
+}
+
+static void reset_function(struct decl *d) {
+    for (struct param_list *p = d->type->params; p; p = p->next) {
+        reset_symbol(p->symbol);
+    }
+}
+
+// Clears the counts of every local and parameter, including ones whose
+// last reference was just removed.
+static void reset_uses(struct decl *program, work_stack_t *lists) {
+    for (struct decl *d = program; d; d = d->next) {
+        if (d->code) {
+            reset_function(d);
+        }
+    }
+
+    for (size_t i = 0; i < lists->count; i++) {
+        for (struct stmt *s = *((struct stmt ***) lists->items)[i]; s; s = s->next) {
+            if (s->kind == STMT_DECL && s->decl) {
+                reset_symbol(s->decl->symbol);
+                if (s->decl->code) {
+                    reset_function(s->decl);
+                }
+            }
+        }
+    }
+}
+
+static void count_uses(struct expr *e, void *context) {
+    (void) context;
+
+    if (e->kind == EXPR_NAME && e->symbol) {
+        e->symbol->reads++;
+    } else if (e->kind == EXPR_ASSIGN && e->left->kind == EXPR_NAME && e->left->symbol) {
+        // The name is visited as well; a plain store is not a read.
+        e->left->symbol->reads--;
+        e->left->symbol->writes++;
+    }
+}
+
+// A store `name = value` to a local or parameter that is never read.
+static int is_dead_store(struct expr *e) {
+    if (!e || e->kind != EXPR_ASSIGN || e->left->kind != EXPR_NAME) return 0;
+
+    struct symbol *sym = e->left->symbol;
+    return sym && (sym->kind == SYMBOL_LOCAL || sym->kind == SYMBOL_PARAM) && sym->reads == 0;
+}
+
+// Reduces a dead store to what still has to happen: its right-hand side
+// when that has side effects, or nothing.
+static struct expr *without_store(struct expr *e) {
+    e->left->symbol->writes--;
+    return expr_has_side_effects(e->right) ? e->right : NULL;
+}
+
+static int remove_dead_stores(struct stmt **link) {
+    int changed = 0;
+
+    while (*link) {
+        struct stmt *s = *link;
+
+        if (s->kind == STMT_EXPR && is_dead_store(s->expr)) {
+            s->expr = without_store(s->expr);
+            changed = 1;
+
+            if (!s->expr) {
+                *link = s->next;
+                continue;
+            }
+        }
+
+        if (s->kind == STMT_FOR) {
+            if (is_dead_store(s->init_expr)) {
+                s->init_expr = without_store(s->init_expr);
+                changed = 1;
+            }
+            if (is_dead_store(s->next_expr)) {
+                s->next_expr = without_store(s->next_expr);
+                changed = 1;
+            }
+        }
+
+        link = &s->next;
+    }
+
+    return changed;
+}
+
+// Removes declarations of locals that nothing refers to any more. An
+// initializer with side effects stays behind as a statement, unless it
+// is an array literal, which cannot stand alone in C.
+static int remove_unused_locals(struct stmt **link) {
+    int changed = 0;
+
+    while (*link) {
+        struct stmt *s = *link;
+        struct decl *d = s->kind == STMT_DECL ? s->decl : NULL;
+        struct symbol *sym = d ? d->symbol : NULL;
+
+        if (sym && sym->kind == SYMBOL_LOCAL && !d->code && sym->reads == 0 && sym->writes == 0) {
+            if (!d->value || !expr_has_side_effects(d->value)) {
+                *link = s->next;
+                changed = 1;
+                continue;
+            }
+            if (d->value->kind != EXPR_ARRAY_LITERAL) {
+                s->kind = STMT_EXPR;
+                s->expr = d->value;
+                s->decl = NULL;
+                changed = 1;
+            }
+        }
+
+        link = &s->next;
+    }
+
+    return changed;
+}
+
+static int run_round(struct decl *program) {
+    int changed = 0;
+    work_stack_t lists;
+    struct stmt **link;
+
+    // Innermost lists first, so never_falls_through sees trimmed bodies.
+    work_stack_init(&lists, sizeof(struct stmt **));
+    collect_lists(program, &lists);
+    while (work_stack_pop(&lists, &link)) {
+        changed |= trim_list(link);
+    }
+
+    // Stores first, since removing them can leave a local unreferenced.
+    collect_lists(program, &lists);
+    reset_uses(program, &lists);
+    ast_visit_exprs(program, count_uses, NULL);
+
+    for (size_t i = 0; i < lists.count; i++) {
+        changed |= remove_dead_stores(((struct stmt ***) lists.items)[i]);
+    }
+    for (size_t i = 0; i < lists.count; i++) {
+        changed |= remove_unused_locals(((struct stmt ***) lists.items)[i]);
+    }
+
+    work_stack_free(&lists);
+    return changed;
+}
+
+void eliminate_dead_code(struct decl *program) {
+    for (int round = 0; round < MAX_ROUNDS && run_round(program); round++) {
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef DCE_H
+#define DCE_H
+
+#include "ast.h"
+
+// Dead-code elimination over function bodies, run after fold_program so
+// that conditions are already reduced to literals where possible:
+//
+//  - if (true) and if (false) are replaced by the branch that runs;
+//  - a for loop whose condition is false becomes its init expression, and
+//    a true condition is dropped, leaving for (init; ; next);
+//  - statements after one that never falls through (a return, a for loop
+//    without a condition, or a block or if-else ending in one) are removed;
+//  - stores to locals and parameters that are never read are removed, or
+//    reduced to their right-hand side when it has side effects, and then
+//    locals that are no longer referenced lose their declaration.
+//
+// Removing statements can make more stores dead, so the pass repeats a
+// bounded number of times until nothing changes. Globals are left alone.
+void eliminate_dead_code(struct decl *program);
+
+#endif
@@ -0,0 +1,422 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "effects.h"
+#include "scope.h"
+#include "work_stack.h"
+
+// Each function is scanned once for what its own body does, and for its
+// calls with the arrays passed to them. The summaries are then solved with
+// a worklist, a function going back on it when a callee's summary grows.
+// What a callee does through its array parameters lands on the caller's
+// arguments: nothing for a local array, the caller's own parameters for a
+// parameter, and the global for a global array.
+//
+// Writes are solved first, since whether reading a global is a read of
+// memory that changes depends on every write to it; reads follow.
+
+enum {
+    WRITES_OUTSIDE = 1,             // prints, writes a global or calls unknown code
+    WRITES_PARAMS = 2,              // writes through an array parameter
+    READS_OUTSIDE = 4,              // reads a global that is written somewhere
+    READS_PARAMS = 8                // reads through an array parameter
+};
+
+typedef struct {
+    long callee;                    // index of the function, or -1 when it is not defined
+    size_t first_arg;               // its array arguments, in effects->args
+    size_t arg_count;
+} call_site_t;
+
+typedef struct {
+    const char *name;
+    struct decl *d;
+    int direct;                     // what the body does itself
+    int bits;                       // with its callees
+    size_t first_call;
+    size_t call_count;
+    size_t first_read;              // globals it names, in effects->reads
+    size_t read_count;
+    int queued;
+} function_t;
+
+typedef struct {
+    const char *name;
+    int written;
+    int passed;
+    int initialized_at_run_time;
+} global_t;
+
+struct effects {
+    function_t *functions;          // defined functions, sorted by interned name
+    size_t function_count;
+    global_t *globals;              // global variables, sorted by interned name
+    size_t global_count;
+
+    work_stack_t calls;             // call_site_t
+    work_stack_t args;              // const char *: a global array, or NULL for a parameter
+    work_stack_t reads;             // const char *
+
+    size_t *caller_start;           // callers of function i: callers[caller_start[i] .. caller_start[i + 1])
+    size_t *callers;
+};
+
+typedef struct {
+    effects_t *effects;
+    function_t *function;
+} scan_t;
+
+static void *allocate(size_t count, size_t size) {
+    void *memory = calloc(count ? count : 1, size);
+    if (!memory) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return memory;
+}
+
+// Both tables start with the interned name.
+static int compare_names(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t) *(const char * const *) a;
+    uintptr_t y = (uintptr_t) *(const char * const *) b;
+    return (x > y) - (x < y);
+}
+
+static function_t *find_function(const effects_t *effects, const char *name) {
+    return bsearch(&name, effects->functions, effects->function_count, sizeof(function_t), compare_names);
+}
+
+static global_t *find_global(const effects_t *effects, const char *name) {
+    return bsearch(&name, effects->globals, effects->global_count, sizeof(global_t), compare_names);
+}
+
+// A global assigned at the start of main holds zero until then, so reading
+// it reads memory that changes as much as reading one the program writes.
+static int global_changes(const effects_t *effects, const char *name) {
+    global_t *global = find_global(effects, name);
+    return !global || global->written || global->initialized_at_run_time;
+}
+
+static void mark_written(effects_t *effects, const char *name) {
+    global_t *global = find_global(effects, name);
+    if (global) {
+        global->written = 1;
+    }
+}
+
+// Reading or writing the array named by e, where e is the base of a
+// subscript or an argument.
+static int array_bits(effects_t *effects, struct expr *e, int param_bit, int write) {
+    if (e->kind != EXPR_NAME || !e->symbol) return write ? WRITES_OUTSIDE : READS_OUTSIDE;
+
+    switch (e->symbol->kind) {
+        case SYMBOL_PARAM:
+            return param_bit;
+        case SYMBOL_GLOBAL:
+            if (write) {
+                mark_written(effects, e->name);
+                return WRITES_OUTSIDE;
+            }
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+static void record_call(scan_t *scan, struct expr *e) {
+    effects_t *effects = scan->effects;
+    struct expr *callee = e->left;
+
+    // A nested function's body is scanned as part of the one around it.
+    if (callee->kind != EXPR_NAME || !callee->symbol || callee->symbol->kind != SYMBOL_GLOBAL) return;
+
+    function_t *function = find_function(effects, callee->name);
+    call_site_t *site = work_stack_push(&effects->calls);
+    site->callee = function ? (long) (function - effects->functions) : -1;
+    site->first_arg = effects->args.count;
+
+    for (struct expr *cell = e->right; cell; cell = cell->kind == EXPR_ARG ? cell->right : NULL) {
+        struct expr *arg = cell->kind == EXPR_ARG ? cell->left : cell;
+        if (arg->kind != EXPR_NAME || !arg->symbol || arg->symbol->type->kind != TYPE_ARRAY ||
+            arg->symbol->kind == SYMBOL_LOCAL) {
+            continue;
+        }
+
+        int is_global = arg->symbol->kind == SYMBOL_GLOBAL;
+        *(const char **) work_stack_push(&effects->args) = is_global ? arg->name : NULL;
+        if (is_global) {
+            global_t *global = find_global(effects, arg->name);
+            if (global) {
+                global->passed = 1;
+            }
+        }
+    }
+
+    site->arg_count = effects->args.count - site->first_arg;
+}
+
+static void scan_expr(struct expr *e, void *context) {
+    scan_t *scan = context;
+    function_t *function = scan->function;
+
+    switch (e->kind) {
+        case EXPR_ASSIGN:
+            if (e->left->kind == EXPR_SUBSCRIPT) {
+                function->direct |= array_bits(scan->effects, e->left->left, WRITES_PARAMS, 1);
+            } else if (e->left->kind == EXPR_NAME && e->left->symbol && e->left->symbol->kind == SYMBOL_GLOBAL) {
+                mark_written(scan->effects, e->left->name);
+                function->direct |= WRITES_OUTSIDE;
+            }
+            break;
+        case EXPR_SUBSCRIPT:
+            function->direct |= array_bits(scan->effects, e->left, READS_PARAMS, 0);
+            break;
+        case EXPR_NAME:
+            if (e->symbol && e->symbol->kind == SYMBOL_GLOBAL && e->symbol->type->kind != TYPE_FUNCTION) {
+                *(const char **) work_stack_push(&scan->effects->reads) = e->name;
+            }
+            break;
+        case EXPR_CALL:
+            record_call(scan, e);
+            break;
+        default:
+            break;
+    }
+}
+
+static int prints(struct stmt *code) {
+    work_stack_t pending;
+    work_stack_init(&pending, sizeof(struct stmt *));
+    *(struct stmt **) work_stack_push(&pending) = code;
+
+    int found = 0;
+    struct stmt *list;
+    while (!found && work_stack_pop(&pending, &list)) {
+        for (struct stmt *s = list; s && !found; s = s->next) {
+            found = s->kind == STMT_PRINT;
+            if (s->body) {
+                *(struct stmt **) work_stack_push(&pending) = s->body;
+            }
+            if (s->kind == STMT_IF_ELSE && s->else_body) {
+                *(struct stmt **) work_stack_push(&pending) = s->else_body;
+            }
+            if (s->kind == STMT_DECL && s->decl && s->decl->code) {
+                *(struct stmt **) work_stack_push(&pending) = s->decl->code;
+            }
+        }
+    }
+
+    work_stack_free(&pending);
+    return found;
+}
+
+static void link_callers(effects_t *effects) {
+    call_site_t *calls = (call_site_t *) effects->calls.items;
+    effects->caller_start = allocate(effects->function_count + 1, sizeof(size_t));
+    effects->callers = allocate(effects->calls.count, sizeof(size_t));
+
+    for (size_t c = 0; c < effects->calls.count; c++) {
+        if (calls[c].callee >= 0) {
+            effects->caller_start[calls[c].callee + 1]++;
+        }
+    }
+    for (size_t f = 0; f < effects->function_count; f++) {
+        effects->caller_start[f + 1] += effects->caller_start[f];
+    }
+
+    size_t *next = allocate(effects->function_count, sizeof(size_t));
+    memcpy(next, effects->caller_start, effects->function_count * sizeof(size_t));
+    for (size_t f = 0; f < effects->function_count; f++) {
+        function_t *function = &effects->functions[f];
+        for (size_t c = function->first_call; c < function->first_call + function->call_count; c++) {
+            if (calls[c].callee >= 0) {
+                effects->callers[next[calls[c].callee]++] = f;
+            }
+        }
+    }
+    free(next);
+}
+
+static int evaluate(effects_t *effects, function_t *function, int with_reads) {
+    call_site_t *calls = (call_site_t *) effects->calls.items;
+    const char **args = (const char **) effects->args.items;
+    int bits = function->bits | function->direct;
+
+    for (size_t c = function->first_call; c < function->first_call + function->call_count; c++) {
+        // Code the program does not define may write what it is given.
+        if (calls[c].callee < 0) {
+            for (size_t a = calls[c].first_arg; a < calls[c].first_arg + calls[c].arg_count; a++) {
+                if (args[a]) {
+                    mark_written(effects, args[a]);
+                }
+            }
+            bits |= WRITES_OUTSIDE;
+            continue;
+        }
+
+        int callee = effects->functions[calls[c].callee].bits;
+        bits |= callee & (WRITES_OUTSIDE | READS_OUTSIDE);
+
+        for (size_t a = calls[c].first_arg; a < calls[c].first_arg + calls[c].arg_count; a++) {
+            if (callee & WRITES_PARAMS) {
+                if (args[a]) {
+                    mark_written(effects, args[a]);
+                    bits |= WRITES_OUTSIDE;
+                } else {
+                    bits |= WRITES_PARAMS;
+                }
+            }
+            if ((callee & READS_PARAMS) && !args[a]) {
+                bits |= READS_PARAMS;
+            }
+        }
+    }
+
+    // A global array passed on is read through its name, so it is covered
+    // here.
+    if (with_reads) {
+        const char **reads = (const char **) effects->reads.items;
+        for (size_t r = function->first_read; r < function->first_read + function->read_count; r++) {
+            if (global_changes(effects, reads[r])) {
+                bits |= READS_OUTSIDE;
+                break;
+            }
+        }
+    }
+
+    int changed = bits != function->bits;
+    function->bits = bits;
+    return changed;
+}
+
+static void solve(effects_t *effects, int with_reads) {
+    work_stack_t queue;
+    work_stack_init(&queue, sizeof(size_t));
+
+    for (size_t f = effects->function_count; f-- > 0;) {
+        effects->functions[f].queued = 1;
+        *(size_t *) work_stack_push(&queue) = f;
+    }
+
+    size_t f;
+    while (work_stack_pop(&queue, &f)) {
+        function_t *function = &effects->functions[f];
+        function->queued = 0;
+        if (!evaluate(effects, function, with_reads)) continue;
+
+        for (size_t c = effects->caller_start[f]; c < effects->caller_start[f + 1]; c++) {
+            function_t *caller = &effects->functions[effects->callers[c]];
+            if (!caller->queued) {
+                caller->queued = 1;
+                *(size_t *) work_stack_push(&queue) = effects->callers[c];
+            }
+        }
+    }
+
+    work_stack_free(&queue);
+}
+
+effects_t *analyze_effects(struct decl *program, int initial_values) {
+    effects_t *effects = allocate(1, sizeof(effects_t));
+    work_stack_init(&effects->calls, sizeof(call_site_t));
+    work_stack_init(&effects->args, sizeof(const char *));
+    work_stack_init(&effects->reads, sizeof(const char *));
+
+    size_t count = 0;
+    for (struct decl *d = program; d; d = d->next) {
+        count++;
+    }
+    effects->functions = allocate(count, sizeof(function_t));
+    effects->globals = allocate(count, sizeof(global_t));
+
+    for (struct decl *d = program; d; d = d->next) {
+        if (!d->name || !d->type) continue;
+
+        if (d->type->kind != TYPE_FUNCTION) {
+            global_t *global = &effects->globals[effects->global_count++];
+            global->name = d->name;
+            global->initialized_at_run_time = !initial_values && is_initialized_at_run_time(d);
+        } else if (d->code) {
+            function_t *function = &effects->functions[effects->function_count++];
+            function->name = d->name;
+            function->d = d;
+        }
+    }
+    qsort(effects->functions, effects->function_count, sizeof(function_t), compare_names);
+    qsort(effects->globals, effects->global_count, sizeof(global_t), compare_names);
+
+    for (size_t f = 0; f < effects->function_count; f++) {
+        function_t *function = &effects->functions[f];
+        scan_t scan = {effects, function};
+
+        function->first_call = effects->calls.count;
+        function->first_read = effects->reads.count;
+        ast_visit_decl_exprs(function->d, scan_expr, &scan);
+        function->call_count = effects->calls.count - function->first_call;
+        function->read_count = effects->reads.count - function->first_read;
+
+        if (prints(function->d->code)) {
+            function->direct |= WRITES_OUTSIDE;
+        }
+    }
+
+    link_callers(effects);
+    solve(effects, 0);
+    solve(effects, 1);
+
+    return effects;
+}
+
+void free_effects(effects_t *effects) {
+    if (!effects) return;
+
+    free(effects->functions);
+    free(effects->globals);
+    free(effects->caller_start);
+    free(effects->callers);
+    work_stack_free(&effects->calls);
+    work_stack_free(&effects->args);
+    work_stack_free(&effects->reads);
+    free(effects);
+}
+
+effect_t function_effect(const effects_t *effects, const char *name) {
+    function_t *function = find_function(effects, name);
+    if (!function || (function->bits & (WRITES_OUTSIDE | WRITES_PARAMS))) return EFFECT_SIDE;
+    if (function->bits & (READS_OUTSIDE | READS_PARAMS)) return EFFECT_PURE;
+    return EFFECT_CONST;
+}
+
+int global_is_written(const effects_t *effects, const char *name) {
+    global_t *global = find_global(effects, name);
+    return !global || global->written;
+}
+
+int global_is_passed(const effects_t *effects, const char *name) {
+    global_t *global = find_global(effects, name);
+    return !global || global->passed;
+}
+
+static void note_run_time_initializer(struct expr *e, void *context) {
+    switch (e->kind) {
+        case EXPR_INTEGER_LITERAL:
+        case EXPR_STRING_LITERAL:
+        case EXPR_CHAR_LITERAL:
+        case EXPR_BOOL_LITERAL:
+        case EXPR_UNARY_MINUS:
+        case EXPR_ARRAY_LITERAL:
+        case EXPR_ARG:
+            break;
+        default:
+            *(int *) context = 1;
+            break;
+    }
+}
+
+int is_initialized_at_run_time(struct decl *d) {
+    if (!d->value || !d->type || d->type->kind == TYPE_FUNCTION) return 0;
+
+    int run_time = 0;
+    ast_visit_decl_exprs(d, note_run_time_initializer, &run_time);
+    return run_time;
+}
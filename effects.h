@@ -0,0 +1,54 @@
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include "ast.h"
+
+// Interprocedural effect analysis over a type-checked program. Each
+// function defined in the program is summarized by what it reads and
+// writes outside its own locals, its callees included:
+//
+//  - const: it reads nothing but its arguments, its locals and globals
+//    that hold their initial value from the start;
+//  - pure: it also reads globals that are written somewhere or
+//    initialized at run time, or the arrays passed to it, but writes
+//    neither and prints nothing;
+//  - effectful: it prints, writes a global, writes through an array
+//    parameter, or calls a function the program does not define.
+//
+// Writing a local array is not an effect, even through a callee. The
+// summaries are solved to a fixpoint over the call graph, so recursion is
+// handled, and like GCC's attributes they assume every call returns.
+
+typedef enum {
+    EFFECT_CONST,
+    EFFECT_PURE,
+    EFFECT_SIDE
+} effect_t;
+
+typedef struct effects effects_t;
+
+// Globals initialized at run time are read as memory that changes unless
+// initial_values is set: compile-time evaluation works those values out
+// itself, before it has replaced the initializers it can.
+effects_t *analyze_effects(struct decl *program, int initial_values);
+void free_effects(effects_t *effects);
+
+// The class of the function defined under name; EFFECT_SIDE for names
+// without a definition.
+effect_t function_effect(const effects_t *effects, const char *name);
+
+// Whether the global is assigned anywhere, or, for an array, has an
+// element assigned or is passed to a function that writes its array
+// parameters.
+int global_is_written(const effects_t *effects, const char *name);
+
+// Whether the global array is passed to any call.
+int global_is_passed(const effects_t *effects, const char *name);
+
+// Whether the global d has an initializer C does not take at file scope:
+// anything but literals, negated or in an array literal. Those are the
+// calls compile-time evaluation gave up on, or was not asked to run, and
+// the globals they read; the global is assigned at the start of main.
+int is_initialized_at_run_time(struct decl *d);
+
+#endif
@@ -0,0 +1,401 @@
+#include <limits.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "fold.h"
+#include "typecheck.h"
+#include "work_stack.h"
+
+static const char *current_function = NULL;
+static int quiet = 0;
+
+static void fold_warning(const char *format, ...) {
+    if (quiet) return;
+
+    va_list args;
+    va_start(args, format);
+
+    fprintf(stderr, "warning: ");
+    if (current_function) {
+        fprintf(stderr, "in function %s: ", current_function);
+    }
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+
+    va_end(args);
+}
+
+// Arithmetic is done on uint32_t, where overflow is defined, and the
+// result mapped back to the two's complement int the generated code holds.
+static int wrap(uint32_t value) {
+    if (value <= INT32_MAX) {
+        return (int) value;
+    }
+    return (int) (value - 0x80000000u) + INT32_MIN;
+}
+
+// Integer power by squaring. A negative exponent gives what the C pow()
+// truncates to: 1 and -1 keep their magnitude, anything else goes to 0.
+// The caller rules out 0 raised to a negative power.
+static int integer_power(int base, int exponent) {
+    if (exponent < 0) {
+        if (base == 1) return 1;
+        if (base == -1) return exponent % 2 ? -1 : 1;
+        return 0;
+    }
+
+    uint32_t result = 1;
+    uint32_t factor = (uint32_t) base;
+    for (unsigned int n = (unsigned int) exponent; n; n >>= 1) {
+        if (n & 1) result *= factor;
+        factor *= factor;
+    }
+
+    return wrap(result);
+}
+
+static int is_literal(struct expr *e) {
+    return e && (e->kind == EXPR_INTEGER_LITERAL || e->kind == EXPR_CHAR_LITERAL || e->kind == EXPR_BOOL_LITERAL);
+}
+
+static int is_integer(struct expr *e, int value) {
+    return e && e->kind == EXPR_INTEGER_LITERAL && e->integer_value == value;
+}
+
+static int is_boolean(struct expr *e, int value) {
+    return e && e->kind == EXPR_BOOL_LITERAL && e->integer_value == value;
+}
+
+static void make_literal(struct expr *e, expr_kind_t kind, int value) {
+    e->kind = kind;
+    e->left = NULL;
+    e->right = NULL;
+    e->integer_value = value;
+    e->type = type_basic(kind == EXPR_BOOL_LITERAL ? TYPE_BOOLEAN : TYPE_INTEGER);
+}
+
+// Makes e the given subtree, which has the same type as e.
+static void replace_with(struct expr *e, struct expr *subtree) {
+    *e = *subtree;
+}
+
+int expr_has_side_effects(struct expr *root) {
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(struct expr *));
+    *(struct expr **) work_stack_push(&stack) = root;
+
+    int found = 0;
+    struct expr *e;
+    while (!found && work_stack_pop(&stack, &e)) {
+        switch (e->kind) {
+            case EXPR_CALL:
+            case EXPR_ASSIGN:
+                found = 1;
+                break;
+            case EXPR_DIV:
+            case EXPR_MOD:
+                found = !e->right || e->right->kind != EXPR_INTEGER_LITERAL || e->right->integer_value == 0;
+                break;
+            default:
+                break;
+        }
+
+        if (!expr_has_operands(e)) continue;
+        if (e->left) *(struct expr **) work_stack_push(&stack) = e->left;
+        if (e->right) *(struct expr **) work_stack_push(&stack) = e->right;
+    }
+
+    work_stack_free(&stack);
+    return found;
+}
+
+int evaluate_integer_operator(expr_kind_t kind, int a, int b, int *value) {
+    uint32_t ua = (uint32_t) a;
+    uint32_t ub = (uint32_t) b;
+
+    switch (kind) {
+        case EXPR_ADD: *value = wrap(ua + ub); return 1;
+        case EXPR_SUB: *value = wrap(ua - ub); return 1;
+        case EXPR_MUL: *value = wrap(ua * ub); return 1;
+        case EXPR_DIV:
+        case EXPR_MOD:
+            // INT_MIN / -1 traps in C; leave it for run time as well.
+            if (b == 0 || (a == INT_MIN && b == -1)) return 0;
+            *value = kind == EXPR_DIV ? a / b : a % b;
+            return 1;
+        case EXPR_POWER:
+            if (a == 0 && b < 0) return 0;
+            *value = integer_power(a, b);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Evaluates an arithmetic operator on two literals. Returns 0, leaving the
+// node alone, when the result is left for run time.
+static int fold_arithmetic(struct expr *e, int a, int b) {
+    int value;
+    if (!evaluate_integer_operator(e->kind, a, b, &value)) return 0;
+
+    make_literal(e, EXPR_INTEGER_LITERAL, value);
+    return 1;
+}
+
+static int compare(expr_kind_t kind, int a, int b) {
+    switch (kind) {
+        case EXPR_LT: return a < b;
+        case EXPR_LE: return a <= b;
+        case EXPR_GT: return a > b;
+        case EXPR_GE: return a >= b;
+        case EXPR_EQ: return a == b;
+        case EXPR_NEQ: return a != b;
+        default: return 0;
+    }
+}
+
+// Identities for an integer operator with at most one literal operand.
+static void simplify_arithmetic(struct expr *e) {
+    struct expr *left = e->left;
+    struct expr *right = e->right;
+
+    switch (e->kind) {
+        case EXPR_ADD:
+            if (is_integer(right, 0)) replace_with(e, left);
+            else if (is_integer(left, 0)) replace_with(e, right);
+            break;
+
+        case EXPR_SUB:
+            if (is_integer(right, 0)) {
+                replace_with(e, left);
+            } else if (is_integer(left, 0)) {
+                e->kind = EXPR_UNARY_MINUS;
+                e->left = NULL;
+            }
+            break;
+
+        case EXPR_MUL:
+            if (is_integer(right, 1)) replace_with(e, left);
+            else if (is_integer(left, 1)) replace_with(e, right);
+            else if (is_integer(right, 0) && !expr_has_side_effects(left)) make_literal(e, EXPR_INTEGER_LITERAL, 0);
+            else if (is_integer(left, 0) && !expr_has_side_effects(right)) make_literal(e, EXPR_INTEGER_LITERAL, 0);
+            break;
+
+        case EXPR_DIV:
+            if (is_integer(right, 1)) replace_with(e, left);
+            break;
+
+        case EXPR_MOD:
+            if (is_integer(right, 1) && !expr_has_side_effects(left)) make_literal(e, EXPR_INTEGER_LITERAL, 0);
+            break;
+
+        case EXPR_POWER:
+            if (is_integer(right, 1)) replace_with(e, left);
+            else if (is_integer(right, 0) && !expr_has_side_effects(left)) make_literal(e, EXPR_INTEGER_LITERAL, 1);
+            else if (is_integer(left, 1) && !expr_has_side_effects(right)) make_literal(e, EXPR_INTEGER_LITERAL, 1);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// x / 0, x % 0 and 0 ^ -n, which are left for run time.
+static int divides_by_zero(struct expr *e) {
+    if (e->kind == EXPR_POWER) {
+        return is_integer(e->left, 0) && e->right->kind == EXPR_INTEGER_LITERAL && e->right->integer_value < 0;
+    }
+    return (e->kind == EXPR_DIV || e->kind == EXPR_MOD) && is_integer(e->right, 0);
+}
+
+// Folds e, whose operands are already folded.
+static void fold_node(struct expr *e) {
+    struct expr *left = e->left;
+    struct expr *right = e->right;
+
+    switch (e->kind) {
+        case EXPR_UNARY_MINUS:
+            if (right->kind == EXPR_INTEGER_LITERAL) {
+                make_literal(e, EXPR_INTEGER_LITERAL, wrap(0u - (uint32_t) right->integer_value));
+            } else if (right->kind == EXPR_UNARY_MINUS) {
+                replace_with(e, right->right);
+            }
+            break;
+
+        case EXPR_NOT:
+            if (right->kind == EXPR_BOOL_LITERAL) {
+                make_literal(e, EXPR_BOOL_LITERAL, !right->integer_value);
+            } else if (right->kind == EXPR_NOT) {
+                replace_with(e, right->right);
+            }
+            break;
+
+        case EXPR_POWER:
+        case EXPR_MUL:
+        case EXPR_DIV:
+        case EXPR_MOD:
+        case EXPR_ADD:
+        case EXPR_SUB:
+            if (divides_by_zero(e)) {
+                fold_warning("division by zero");
+            } else if (left->kind == EXPR_INTEGER_LITERAL && right->kind == EXPR_INTEGER_LITERAL) {
+                fold_arithmetic(e, left->integer_value, right->integer_value);
+            } else {
+                simplify_arithmetic(e);
+            }
+            break;
+
+        case EXPR_LT:
+        case EXPR_LE:
+        case EXPR_GT:
+        case EXPR_GE:
+        case EXPR_EQ:
+        case EXPR_NEQ:
+            if (is_literal(left) && is_literal(right) && left->kind == right->kind) {
+                make_literal(e, EXPR_BOOL_LITERAL, compare(e->kind, left->integer_value, right->integer_value));
+            }
+            break;
+
+        case EXPR_AND:
+            if (is_boolean(left, 0)) make_literal(e, EXPR_BOOL_LITERAL, 0);
+            else if (is_boolean(left, 1)) replace_with(e, right);
+            else if (is_boolean(right, 1)) replace_with(e, left);
+            else if (is_boolean(right, 0) && !expr_has_side_effects(left)) make_literal(e, EXPR_BOOL_LITERAL, 0);
+            break;
+
+        case EXPR_OR:
+            if (is_boolean(left, 1)) make_literal(e, EXPR_BOOL_LITERAL, 1);
+            else if (is_boolean(left, 0)) replace_with(e, right);
+            else if (is_boolean(right, 0)) replace_with(e, left);
+            else if (is_boolean(right, 1) && !expr_has_side_effects(left)) make_literal(e, EXPR_BOOL_LITERAL, 1);
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Folds the tree bottom-up from an explicit stack, like check_expr.
+static void fold_expr(struct expr *root) {
+    if (!root) return;
+
+    typedef struct {
+        struct expr *e;
+        int children_done;
+    } fold_work_t;
+
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(fold_work_t));
+    ((fold_work_t *) work_stack_push(&stack))->e = root;
+
+    fold_work_t item;
+    while (work_stack_pop(&stack, &item)) {
+        struct expr *e = item.e;
+
+        if (item.children_done) {
+            fold_node(e);
+            continue;
+        }
+
+        fold_work_t *again = work_stack_push(&stack);
+        again->e = e;
+        again->children_done = 1;
+
+        if (!expr_has_operands(e)) {
+            continue;
+        }
+        if (e->right) {
+            ((fold_work_t *) work_stack_push(&stack))->e = e->right;
+        }
+        if (e->left) {
+            ((fold_work_t *) work_stack_push(&stack))->e = e->left;
+        }
+    }
+
+    work_stack_free(&stack);
+}
+
+void fold_expression(struct expr *e) {
+    quiet = 1;
+    fold_expr(e);
+    quiet = 0;
+}
+
+typedef struct {
+    struct stmt *s;             // the rest of a statement list
+    struct decl *function;
+} fold_stmt_work_t;
+
+static void push_stmts(work_stack_t *stack, struct stmt *s, struct decl *function) {
+    if (!s) return;
+
+    fold_stmt_work_t *item = work_stack_push(stack);
+    item->s = s;
+    item->function = function;
+}
+
+static void fold_decl(work_stack_t *stack, struct decl *d) {
+    if (d->type && d->type->kind == TYPE_ARRAY) {
+        fold_expr(d->type->array_size);
+    }
+    fold_expr(d->value);
+
+    if (d->code) {
+        push_stmts(stack, d->code, d);
+    }
+}
+
+void fold_program(struct decl *program) {
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(fold_stmt_work_t));
+
+    for (struct decl *d = program; d; d = d->next) {
+        if (d->kind == DECL_COMMENT || d->kind == DECL_MULTI_COMMENT) {
+            continue;
+        }
+
+        current_function = NULL;
+        fold_decl(&stack, d);
+
+        fold_stmt_work_t item;
+        while (work_stack_pop(&stack, &item)) {
+            struct stmt *s = item.s;
+            current_function = item.function->name;
+
+            push_stmts(&stack, s->next, item.function);
+
+            switch (s->kind) {
+                case STMT_DECL:
+                    if (s->decl) {
+                        fold_decl(&stack, s->decl);
+                    }
+                    break;
+                case STMT_IF_ELSE:
+                    fold_expr(s->expr);
+                    push_stmts(&stack, s->else_body, item.function);
+                    push_stmts(&stack, s->body, item.function);
+                    break;
+                case STMT_FOR:
+                    fold_expr(s->init_expr);
+                    fold_expr(s->expr);
+                    fold_expr(s->next_expr);
+                    push_stmts(&stack, s->body, item.function);
+                    break;
+                case STMT_BLOCK:
+                    push_stmts(&stack, s->body, item.function);
+                    break;
+                case STMT_EXPR:
+                case STMT_PRINT:
+                case STMT_RETURN:
+                    fold_expr(s->expr);
+                    break;
+                case STMT_COMMENT:
+                case STMT_MULTI_COMMENT:
+                    break;
+            }
+        }
+    }
+
+    work_stack_free(&stack);
+    current_function = NULL;
+}
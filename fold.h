@@ -0,0 +1,33 @@
+#ifndef FOLD_H
+#define FOLD_H
+
+#include "ast.h"
+
+// Constant folding and algebraic simplification, run on a type-checked
+// program. Literal subtrees are evaluated at compile time: integer
+// arithmetic (+ - * / % ^ and unary -), comparisons of integers, chars and
+// booleans, and && || !. Identities that cannot change behaviour are
+// applied as well, such as x*1, x+0, x-0, x/1, x^1, -(-x) and !!b; ones that
+// would drop an operand (x*0, b && false) are only applied when the
+// dropped operand has no side effects.
+//
+// Arithmetic follows the generated code: integers are 32-bit C ints and
+// wrap around instead of overflowing. A division or modulo by zero, or
+// zero raised to a negative power, is reported as a warning and left for
+// run time. Expressions are rewritten in place, keeping their types.
+void fold_program(struct decl *program);
+
+// Folds the one expression e the same way, for passes that put literals
+// where names were. Division by zero is not reported again.
+void fold_expression(struct expr *e);
+
+// Whether dropping e could change what the program does: it calls a
+// function, assigns, or divides by something that may be zero.
+int expr_has_side_effects(struct expr *e);
+
+// Evaluates the integer operator kind (+ - * / % ^) on a and b as the
+// generated code does. Returns 0 when the result is left for run time: a
+// division by zero, INT_MIN / -1, or zero raised to a negative power.
+int evaluate_integer_operator(expr_kind_t kind, int a, int b, int *value);
+
+#endif
@@ -0,0 +1,123 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "intern.h"
+
+typedef struct {
+    const char *str;
+    uint32_t hash;
+    size_t length;
+    int tag;
+} intern_entry_t;
+
+typedef struct {
+    intern_entry_t *entries;
+    uint32_t capacity;
+    uint32_t count;
+    arena_t *strings;
+} intern_table_t;
+
+static intern_table_t table = {NULL, 0, 0, NULL};
+
+static uint32_t hash_bytes(const char *str, size_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char) str[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int grow(void) {
+    uint32_t capacity = table.capacity ? table.capacity * 2 : 1024;
+    intern_entry_t *entries = calloc(capacity, sizeof(intern_entry_t));
+    if (!entries) return 0;
+
+    for (uint32_t i = 0; i < table.capacity; i++) {
+        intern_entry_t *entry = &table.entries[i];
+        if (!entry->str) continue;
+
+        uint32_t slot = entry->hash & (capacity - 1);
+        while (entries[slot].str) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        entries[slot] = *entry;
+    }
+
+    free(table.entries);
+    table.entries = entries;
+    table.capacity = capacity;
+
+    if (!table.strings) {
+        table.strings = arena_create(0);
+    }
+
+    return table.strings != NULL;
+}
+
+static intern_entry_t *lookup(const char *str, size_t length) {
+    // Keep the load factor at or below one half so probe runs stay short.
+    if ((table.count + 1) * 2 > table.capacity && !grow()) {
+        return NULL;
+    }
+
+    uint32_t hash = hash_bytes(str, length);
+    uint32_t slot = hash & (table.capacity - 1);
+
+    for (;;) {
+        intern_entry_t *entry = &table.entries[slot];
+
+        if (!entry->str) {
+            entry->str = arena_strndup(table.strings, str, length);
+            if (!entry->str) return NULL;
+            entry->hash = hash;
+            entry->length = length;
+            entry->tag = 0;
+            table.count++;
+            return entry;
+        }
+
+        if (entry->hash == hash && entry->length == length &&
+            memcmp(entry->str, str, length) == 0) {
+            return entry;
+        }
+
+        slot = (slot + 1) & (table.capacity - 1);
+    }
+}
+
+const char *intern(const char *str, size_t length) {
+    intern_entry_t *entry = lookup(str, length);
+    return entry ? entry->str : NULL;
+}
+
+const char *intern_string(const char *str) {
+    return intern(str, strlen(str));
+}
+
+const char *intern_tagged(const char *str, size_t length, int *tag) {
+    intern_entry_t *entry = lookup(str, length);
+    if (!entry) return NULL;
+
+    *tag = entry->tag;
+    return entry->str;
+}
+
+void intern_define(const char *str, int tag) {
+    intern_entry_t *entry = lookup(str, strlen(str));
+    if (entry) {
+        entry->tag = tag;
+    }
+}
+
+void intern_reset(void) {
+    free(table.entries);
+    arena_destroy(table.strings);
+
+    table.entries = NULL;
+    table.capacity = 0;
+    table.count = 0;
+    table.strings = NULL;
+}
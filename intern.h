@@ -0,0 +1,18 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+// Global string interner. Equal strings intern to the same pointer, so
+// interned names can be compared with ==. Each entry also carries an integer
+// tag; the lexer seeds the table with the keywords tagged with their token
+// types, so one probe both interns an identifier and recognises a keyword.
+// Interned strings live until intern_reset.
+
+#include <stddef.h>
+
+const char *intern(const char *str, size_t length);
+const char *intern_string(const char *str);
+const char *intern_tagged(const char *str, size_t length, int *tag);
+void intern_define(const char *str, int tag);
+void intern_reset(void);
+
+#endif
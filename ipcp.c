@@ -0,0 +1,1103 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ipcp.h"
+#include "effects.h"
+#include "fold.h"
+#include "intern.h"
+#include "memo.h"
+#include "scope.h"
+#include "typecheck.h"
+#include "work_stack.h"
+
+// Globals are resolved in declaration order, so an initializer that
+// becomes a literal makes its global a constant for the ones after it.
+// Calls are then collected with a key per call: for each parameter that
+// can be replaced, whether the argument is a literal and which. The
+// parameters every call agrees on are replaced first; the calls are then
+// collected again and sorted by function and key, and each run of equal
+// keys with a literal in them is a group that may be specialized.
+//
+// A specialized copy gets fresh symbols for its parameters and locals, so
+// later passes see it as a function of its own. Its prototype goes right
+// before the original's first declaration, where every call can see it.
+
+// A call nested in more loops than this counts as much as one at this
+// depth; each level multiplies its weight by 8.
+#define MAX_LOOP_WEIGHT_DEPTH 4
+
+// A group of calls is hot from this weight on: two calls, or one in a loop.
+#define HOT_WEIGHT 2
+
+typedef struct {
+    const char *name;
+    struct decl *d;
+    int constant;                   // reads can be replaced by its initial value
+} global_t;
+
+typedef struct {
+    const char *name;
+    struct decl *d;                 // the definition
+    struct decl *before;            // the declaration before its first one, or NULL
+    int declared;                   // before has been found
+    int eligible;                   // its parameters and calls may be rewritten
+    int specializable;
+    int param_count;
+    struct param_list **params;     // by position
+    int *substitutable;             // by position: a scalar the body never assigns
+    int size;                       // AST nodes in the body, or -1 before it is needed
+    int clones;
+} function_t;
+
+// Per parameter, in a call's key.
+typedef struct {
+    int literal;
+    int kind;
+    int value;
+} arg_key_t;
+
+typedef struct {
+    struct expr *call;
+    size_t callee;
+    long weight;
+    size_t key_start;
+    const arg_key_t *key;
+} site_t;
+
+typedef struct {
+    effects_t *effects;
+    global_t *globals;              // global variables, sorted by interned name
+    size_t global_count;
+    function_t *functions;          // eligible definitions, sorted by interned name
+    size_t function_count;
+    const char **names;             // every name declared in the program, sorted
+    size_t name_count;
+
+    work_stack_t sites;             // site_t
+    work_stack_t keys;              // arg_key_t, param_count per site
+} ipcp_t;
+
+typedef void (*visit_root_t)(ipcp_t *ipcp, struct expr *root, int loop_depth, int printed, void *context);
+
+static void *allocate(size_t count, size_t size) {
+    void *memory = calloc(count ? count : 1, size);
+    if (!memory) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return memory;
+}
+
+// The tables start with the interned name.
+static int compare_names(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t) *(const char * const *) a;
+    uintptr_t y = (uintptr_t) *(const char * const *) b;
+    return (x > y) - (x < y);
+}
+
+static global_t *find_global(ipcp_t *ipcp, const char *name) {
+    return bsearch(&name, ipcp->globals, ipcp->global_count, sizeof(global_t), compare_names);
+}
+
+static function_t *find_function(ipcp_t *ipcp, const char *name) {
+    return bsearch(&name, ipcp->functions, ipcp->function_count, sizeof(function_t), compare_names);
+}
+
+static int is_scalar_type(struct type *t) {
+    return t && (t->kind == TYPE_INTEGER || t->kind == TYPE_CHARACTER || t->kind == TYPE_BOOLEAN);
+}
+
+static int is_literal(struct expr *e) {
+    return e && (e->kind == EXPR_INTEGER_LITERAL || e->kind == EXPR_CHAR_LITERAL || e->kind == EXPR_BOOL_LITERAL);
+}
+
+static void make_literal(struct expr *e, expr_kind_t kind, int value) {
+    e->kind = kind;
+    e->left = NULL;
+    e->right = NULL;
+    e->integer_value = value;
+    e->type = type_basic(kind == EXPR_BOOL_LITERAL ? TYPE_BOOLEAN :
+                         kind == EXPR_CHAR_LITERAL ? TYPE_CHARACTER : TYPE_INTEGER);
+}
+
+// Calls visit on every expression at the top of a statement in body,
+// with the number of loops around it. Returns the number of statements.
+static size_t visit_body(ipcp_t *ipcp, struct stmt *body, visit_root_t visit, void *context) {
+    typedef struct {
+        struct stmt *s;
+        int depth;
+    } body_work_t;
+
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(body_work_t));
+    if (body) {
+        body_work_t *item = work_stack_push(&stack);
+        item->s = body;
+    }
+
+    size_t count = 0;
+    body_work_t item;
+    while (work_stack_pop(&stack, &item)) {
+        struct stmt *s = item.s;
+        int depth = item.depth;
+        count++;
+
+        body_work_t *next;
+        if (s->next) {
+            next = work_stack_push(&stack);
+            next->s = s->next;
+            next->depth = depth;
+        }
+
+        switch (s->kind) {
+            case STMT_DECL:
+                if (!s->decl) break;
+                if (s->decl->type && s->decl->type->kind == TYPE_ARRAY && s->decl->type->array_size) {
+                    visit(ipcp, s->decl->type->array_size, depth, 0, context);
+                }
+                if (s->decl->value) {
+                    visit(ipcp, s->decl->value, depth, 0, context);
+                }
+                if (s->decl->code) {
+                    next = work_stack_push(&stack);
+                    next->s = s->decl->code;
+                    next->depth = 0;
+                }
+                break;
+            case STMT_IF_ELSE:
+                visit(ipcp, s->expr, depth, 0, context);
+                if (s->else_body) {
+                    next = work_stack_push(&stack);
+                    next->s = s->else_body;
+                    next->depth = depth;
+                }
+                if (s->body) {
+                    next = work_stack_push(&stack);
+                    next->s = s->body;
+                    next->depth = depth;
+                }
+                break;
+            case STMT_FOR:
+                if (s->init_expr) visit(ipcp, s->init_expr, depth, 0, context);
+                if (s->expr) visit(ipcp, s->expr, depth + 1, 0, context);
+                if (s->next_expr) visit(ipcp, s->next_expr, depth + 1, 0, context);
+                if (s->body) {
+                    next = work_stack_push(&stack);
+                    next->s = s->body;
+                    next->depth = depth + 1;
+                }
+                break;
+            case STMT_BLOCK:
+                if (s->body) {
+                    next = work_stack_push(&stack);
+                    next->s = s->body;
+                    next->depth = depth;
+                }
+                break;
+            case STMT_EXPR:
+            case STMT_PRINT:
+            case STMT_RETURN:
+                if (s->expr) visit(ipcp, s->expr, depth, s->kind == STMT_PRINT, context);
+                break;
+            case STMT_COMMENT:
+            case STMT_MULTI_COMMENT:
+                break;
+        }
+    }
+
+    work_stack_free(&stack);
+    return count;
+}
+
+// The same over the initializers and array sizes of the global d, or the
+// body of the function d.
+static void visit_decl(ipcp_t *ipcp, struct decl *d, visit_root_t visit, void *context) {
+    if (!d->type) return;
+
+    if (d->type->kind == TYPE_ARRAY && d->type->array_size) {
+        visit(ipcp, d->type->array_size, 0, 0, context);
+    }
+    if (d->value) {
+        visit(ipcp, d->value, 0, 0, context);
+    }
+    visit_body(ipcp, d->code, visit, context);
+}
+
+// Calls visit on every node of the tree, parents first.
+static void visit_nodes(struct expr *root, void (*visit)(struct expr *e, void *context), void *context) {
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(struct expr *));
+    *(struct expr **) work_stack_push(&stack) = root;
+
+    struct expr *e;
+    while (work_stack_pop(&stack, &e)) {
+        visit(e, context);
+        if (!expr_has_operands(e)) continue;
+        if (e->right) *(struct expr **) work_stack_push(&stack) = e->right;
+        if (e->left) *(struct expr **) work_stack_push(&stack) = e->left;
+    }
+
+    work_stack_free(&stack);
+}
+
+// Globals.
+
+typedef struct {
+    ipcp_t *ipcp;
+    int changed;
+} rewrite_t;
+
+static global_t *constant_global(ipcp_t *ipcp, struct expr *e) {
+    if (e->kind != EXPR_NAME || !e->symbol || e->symbol->kind != SYMBOL_GLOBAL) return NULL;
+
+    global_t *global = find_global(ipcp, e->name);
+    return global && global->constant ? global : NULL;
+}
+
+static void replace_global_read(struct expr *e, void *context) {
+    rewrite_t *rewrite = context;
+    global_t *global = constant_global(rewrite->ipcp, e);
+    if (!global || !is_scalar_type(global->d->type)) return;
+
+    struct expr *value = global->d->value;
+    if (value) {
+        make_literal(e, value->kind, value->integer_value);
+    } else {
+        make_literal(e, global->d->type->kind == TYPE_BOOLEAN ? EXPR_BOOL_LITERAL :
+                        global->d->type->kind == TYPE_CHARACTER ? EXPR_CHAR_LITERAL : EXPR_INTEGER_LITERAL, 0);
+    }
+    rewrite->changed = 1;
+}
+
+// array[literal], where array is a constant global.
+static void replace_element_read(struct expr *e, void *context) {
+    rewrite_t *rewrite = context;
+    if (e->kind != EXPR_SUBSCRIPT || e->right->kind != EXPR_INTEGER_LITERAL) return;
+
+    global_t *global = constant_global(rewrite->ipcp, e->left);
+    if (!global || global->d->type->kind != TYPE_ARRAY) return;
+
+    struct type *t = global->d->type;
+    int index = e->right->integer_value;
+    if (index < 0 || index >= t->array_size->integer_value) return;
+
+    struct expr *cell = global->d->value ? global->d->value->right : NULL;
+    for (int n = 0; cell && n < index; n++) {
+        cell = cell->right;
+    }
+    if (cell) {
+        make_literal(e, cell->left->kind, cell->left->integer_value);
+    } else {
+        make_literal(e, t->subtype->kind == TYPE_BOOLEAN ? EXPR_BOOL_LITERAL :
+                        t->subtype->kind == TYPE_CHARACTER ? EXPR_CHAR_LITERAL : EXPR_INTEGER_LITERAL, 0);
+    }
+    rewrite->changed = 1;
+}
+
+static void replace_globals(ipcp_t *ipcp, struct expr *root, int loop_depth, int printed, void *context) {
+    (void) loop_depth;
+    (void) context;
+    rewrite_t rewrite = {ipcp, 0};
+
+    // A string is only put in place where it is printed, where it can
+    // become part of the format; elsewhere it might be compared as a
+    // pointer.
+    for (struct expr *arg = printed ? root : NULL; arg; arg = arg->right) {
+        global_t *global = constant_global(ipcp, arg->left);
+        if (global && global->d->type->kind == TYPE_STRING) {
+            struct expr *name = arg->left;
+            name->kind = EXPR_STRING_LITERAL;
+            name->symbol = NULL;
+            name->string_literal = global->d->value->string_literal;
+            rewrite.changed = 1;
+        }
+    }
+
+    visit_nodes(root, replace_global_read, &rewrite);
+    if (rewrite.changed) {
+        fold_expression(root);
+        rewrite.changed = 0;
+        visit_nodes(root, replace_element_read, &rewrite);
+        if (rewrite.changed) {
+            fold_expression(root);
+        }
+    }
+}
+
+// Whether reads of d can be replaced: it is never written and starts as a
+// literal, a string literal, or an array of literals.
+static int is_constant(ipcp_t *ipcp, struct decl *d) {
+    struct type *t = d->type;
+    struct expr *value = d->value;
+    if (global_is_written(ipcp->effects, d->name)) return 0;
+
+    if (is_scalar_type(t)) return !value || is_literal(value);
+    if (t->kind == TYPE_STRING) return value && value->kind == EXPR_STRING_LITERAL;
+    if (t->kind != TYPE_ARRAY || !is_scalar_type(t->subtype)) return 0;
+
+    if (!t->array_size || t->array_size->kind != EXPR_INTEGER_LITERAL) return 0;
+    if (!value) return 1;
+    if (value->kind != EXPR_ARRAY_LITERAL) return 0;
+
+    int length = 0;
+    for (struct expr *cell = value->right; cell; cell = cell->right, length++) {
+        if (!is_literal(cell->left)) return 0;
+    }
+    return length <= t->array_size->integer_value;
+}
+
+static void propagate_globals(ipcp_t *ipcp, struct decl *program) {
+    for (struct decl *d = program; d; d = d->next) {
+        if (!d->type || d->type->kind == TYPE_FUNCTION) continue;
+
+        visit_decl(ipcp, d, replace_globals, NULL);
+        find_global(ipcp, d->name)->constant = is_constant(ipcp, d);
+    }
+
+    for (struct decl *d = program; d; d = d->next) {
+        if (d->code) {
+            visit_body(ipcp, d->code, replace_globals, NULL);
+        }
+    }
+}
+
+// Functions and their calls.
+
+static void note_assignments(struct expr *e, void *context) {
+    function_t *function = context;
+    if (e->kind != EXPR_ASSIGN || e->left->kind != EXPR_NAME) return;
+
+    for (int p = 0; p < function->param_count; p++) {
+        if (e->left->symbol == function->params[p]->symbol) {
+            function->substitutable[p] = 0;
+        }
+    }
+}
+
+static void scan_root(ipcp_t *ipcp, struct expr *root, int loop_depth, int printed, void *context) {
+    (void) ipcp;
+    (void) loop_depth;
+    (void) printed;
+    visit_nodes(root, note_assignments, context);
+}
+
+static int has_nested_function(struct stmt *body) {
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(struct stmt *));
+    if (body) *(struct stmt **) work_stack_push(&stack) = body;
+
+    int found = 0;
+    struct stmt *s;
+    while (!found && work_stack_pop(&stack, &s)) {
+        found = s->kind == STMT_DECL && s->decl && s->decl->type && s->decl->type->kind == TYPE_FUNCTION;
+        if (s->next) *(struct stmt **) work_stack_push(&stack) = s->next;
+        if (s->body) *(struct stmt **) work_stack_push(&stack) = s->body;
+        if (s->kind == STMT_IF_ELSE && s->else_body) *(struct stmt **) work_stack_push(&stack) = s->else_body;
+    }
+
+    work_stack_free(&stack);
+    return found;
+}
+
+// Which parameters of the function can be replaced.
+static void scan_function(ipcp_t *ipcp, function_t *function) {
+    struct decl *d = function->d;
+    for (struct param_list *p = d->type->params; p; p = p->next) {
+        function->param_count++;
+    }
+
+    function->params = allocate((size_t) function->param_count, sizeof(struct param_list *));
+    function->substitutable = allocate((size_t) function->param_count, sizeof(int));
+    int n = 0;
+    for (struct param_list *p = d->type->params; p; p = p->next, n++) {
+        function->params[n] = p;
+        function->substitutable[n] = is_scalar_type(p->type);
+    }
+
+    visit_body(ipcp, d->code, scan_root, function);
+    function->size = -1;
+}
+
+typedef struct {
+    ipcp_t *ipcp;
+    long weight;
+} collect_t;
+
+static void note_call(struct expr *e, void *context) {
+    collect_t *collect = context;
+    ipcp_t *ipcp = collect->ipcp;
+    if (e->kind != EXPR_CALL || e->left->kind != EXPR_NAME) return;
+
+    // A nested function may shadow a global one.
+    if (!e->left->symbol || e->left->symbol->kind != SYMBOL_GLOBAL) return;
+
+    function_t *function = find_function(ipcp, e->left->name);
+    if (!function || !function->eligible) return;
+
+    site_t *site = work_stack_push(&ipcp->sites);
+    site->call = e;
+    site->callee = (size_t) (function - ipcp->functions);
+    site->weight = collect->weight;
+    site->key_start = ipcp->keys.count;
+
+    struct expr *arg = e->right;
+    for (int p = 0; p < function->param_count; p++, arg = arg ? arg->right : NULL) {
+        arg_key_t *key = work_stack_push(&ipcp->keys);
+        if (arg && function->substitutable[p] && is_literal(arg->left)) {
+            key->literal = 1;
+            key->kind = arg->left->kind;
+            key->value = arg->left->integer_value;
+        }
+    }
+}
+
+static void collect_root(ipcp_t *ipcp, struct expr *root, int loop_depth, int printed, void *context) {
+    (void) printed;
+    (void) context;
+    int depth = loop_depth < MAX_LOOP_WEIGHT_DEPTH ? loop_depth : MAX_LOOP_WEIGHT_DEPTH;
+
+    collect_t collect = {ipcp, 1L << (3 * depth)};
+    visit_nodes(root, note_call, &collect);
+}
+
+static const function_t *sorted_functions;
+
+static int compare_sites(const void *a, const void *b) {
+    const site_t *x = a;
+    const site_t *y = b;
+    if (x->callee != y->callee) return x->callee < y->callee ? -1 : 1;
+
+    int n = sorted_functions[x->callee].param_count;
+    int order = memcmp(x->key, y->key, (size_t) n * sizeof(arg_key_t));
+    if (order) return order;
+    return x->key_start < y->key_start ? -1 : x->key_start > y->key_start;
+}
+
+// Collects every call to an eligible function, sorted by function and key.
+static void collect_sites(ipcp_t *ipcp, struct decl *program) {
+    ipcp->sites.count = 0;
+    ipcp->keys.count = 0;
+    for (struct decl *d = program; d; d = d->next) {
+        visit_decl(ipcp, d, collect_root, NULL);
+    }
+
+    site_t *sites = (site_t *) ipcp->sites.items;
+    for (size_t s = 0; s < ipcp->sites.count; s++) {
+        sites[s].key = (const arg_key_t *) ipcp->keys.items + sites[s].key_start;
+    }
+    if (ipcp->sites.count > 1) {
+        sorted_functions = ipcp->functions;
+        qsort(sites, ipcp->sites.count, sizeof(site_t), compare_sites);
+        sorted_functions = NULL;
+    }
+}
+
+typedef struct {
+    struct symbol **symbols;
+    const arg_key_t *values;
+    int count;
+    int changed;
+} binding_rewrite_t;
+
+static void replace_param_read(struct expr *e, void *context) {
+    binding_rewrite_t *rewrite = context;
+    if (e->kind != EXPR_NAME || !e->symbol) return;
+
+    for (int p = 0; p < rewrite->count; p++) {
+        if (e->symbol == rewrite->symbols[p]) {
+            make_literal(e, rewrite->values[p].kind, rewrite->values[p].value);
+            rewrite->changed = 1;
+            return;
+        }
+    }
+}
+
+static void replace_params(ipcp_t *ipcp, struct expr *root, int loop_depth, int printed, void *context) {
+    (void) ipcp;
+    (void) loop_depth;
+    (void) printed;
+    binding_rewrite_t *rewrite = context;
+
+    rewrite->changed = 0;
+    visit_nodes(root, replace_param_read, rewrite);
+    if (rewrite->changed) {
+        fold_expression(root);
+    }
+}
+
+// Replaces, in body, the parameters of function whose key entry is a
+// literal.
+static void bind_params(ipcp_t *ipcp, function_t *function, struct param_list *params, struct stmt *body,
+                        const arg_key_t *key) {
+    struct symbol **symbols = allocate((size_t) function->param_count, sizeof(struct symbol *));
+    arg_key_t *values = allocate((size_t) function->param_count, sizeof(arg_key_t));
+
+    int count = 0;
+    int p = 0;
+    for (struct param_list *param = params; param; param = param->next, p++) {
+        if (key[p].literal) {
+            symbols[count] = param->symbol;
+            values[count++] = key[p];
+        }
+    }
+
+    binding_rewrite_t rewrite = {symbols, values, count, 0};
+    if (count) {
+        visit_body(ipcp, body, replace_params, &rewrite);
+    }
+    free(symbols);
+    free(values);
+}
+
+// The parameters whose key entry is a literal go from the signature, and
+// the arguments from the calls: the body reads the literal instead, and
+// the arguments are literals too, so no side effect goes with them.
+static struct param_list *drop_bound_params(struct param_list *params, const arg_key_t *key) {
+    struct param_list **link = &params;
+    for (int p = 0; *link; p++) {
+        if (key[p].literal) {
+            *link = (*link)->next;
+        } else {
+            link = &(*link)->next;
+        }
+    }
+    return params;
+}
+
+static void drop_bound_args(struct expr *call, const arg_key_t *key) {
+    struct expr **link = &call->right;
+    for (int p = 0; *link; p++) {
+        if (key[p].literal) {
+            *link = (*link)->right;
+        } else {
+            link = &(*link)->right;
+        }
+    }
+}
+
+// Replaces the parameters that every call of each function passes the
+// same literal, and drops them from its declarations and calls.
+static void propagate_params(ipcp_t *ipcp, struct decl *program) {
+    site_t *sites = (site_t *) ipcp->sites.items;
+    size_t s = 0;
+
+    while (s < ipcp->sites.count) {
+        function_t *function = &ipcp->functions[sites[s].callee];
+        size_t end = s;
+        while (end < ipcp->sites.count && sites[end].callee == sites[s].callee) {
+            end++;
+        }
+
+        arg_key_t *uniform = allocate((size_t) function->param_count, sizeof(arg_key_t));
+        for (int p = 0; p < function->param_count; p++) {
+            uniform[p] = sites[s].key[p];
+            for (size_t c = s + 1; c < end && uniform[p].literal; c++) {
+                const arg_key_t *key = &sites[c].key[p];
+                uniform[p].literal = key->literal && key->kind == uniform[p].kind && key->value == uniform[p].value;
+            }
+            if (uniform[p].literal) {
+                function->substitutable[p] = 0;
+            }
+        }
+
+        bind_params(ipcp, function, function->d->type->params, function->d->code, uniform);
+
+        // Prototypes have a type of their own.
+        struct type *type = function->d->type;
+        for (struct decl *d = program; d; d = d->next) {
+            if (d->name == function->name && d->type && d->type->kind == TYPE_FUNCTION &&
+                (d == function->d || d->type != type)) {
+                d->type->params = drop_bound_params(d->type->params, uniform);
+            }
+        }
+        for (size_t c = s; c < end; c++) {
+            drop_bound_args(sites[c].call, uniform);
+        }
+
+        int kept = 0;
+        for (int p = 0; p < function->param_count; p++) {
+            if (!uniform[p].literal) {
+                function->params[kept] = function->params[p];
+                function->substitutable[kept++] = function->substitutable[p];
+            }
+        }
+        function->param_count = kept;
+
+        free(uniform);
+        s = end;
+    }
+}
+
+// Specialization.
+
+typedef struct {
+    struct symbol **from;           // the original's symbols, sorted
+    struct symbol **to;
+    size_t count;
+} symbol_map_t;
+
+static int compare_symbols(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t) *(struct symbol * const *) a;
+    uintptr_t y = (uintptr_t) *(struct symbol * const *) b;
+    return (x > y) - (x < y);
+}
+
+static struct symbol *map_symbol(symbol_map_t *map, struct symbol *symbol) {
+    struct symbol **found = bsearch(&symbol, map->from, map->count, sizeof(struct symbol *), compare_symbols);
+    return found ? map->to[found - map->from] : symbol;
+}
+
+static struct expr *copy_expr(symbol_map_t *map, struct expr *root) {
+    if (!root) return NULL;
+
+    typedef struct {
+        struct expr *from;
+        struct expr **to;
+    } copy_t;
+
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(copy_t));
+
+    struct expr *result;
+    copy_t *first = work_stack_push(&stack);
+    first->from = root;
+    first->to = &result;
+
+    copy_t item;
+    while (work_stack_pop(&stack, &item)) {
+        struct expr *e = ast_alloc(sizeof(struct expr));
+        *e = *item.from;
+        *item.to = e;
+        if (!expr_has_operands(e)) {
+            if (e->kind == EXPR_NAME && e->symbol) {
+                e->symbol = map_symbol(map, e->symbol);
+            }
+            continue;
+        }
+
+        copy_t *child;
+        if (e->right) {
+            child = work_stack_push(&stack);
+            child->from = e->right;
+            child->to = &e->right;
+        }
+        if (e->left) {
+            child = work_stack_push(&stack);
+            child->from = e->left;
+            child->to = &e->left;
+        }
+    }
+
+    work_stack_free(&stack);
+    return result;
+}
+
+static struct decl *copy_local(symbol_map_t *map, struct decl *local) {
+    struct decl *d = ast_alloc(sizeof(struct decl));
+    *d = *local;
+    d->value = copy_expr(map, local->value);
+    d->symbol = map_symbol(map, local->symbol);
+
+    // An array's size may name a parameter.
+    if (local->type && local->type->kind == TYPE_ARRAY && local->type->array_size) {
+        d->type = create_type(TYPE_ARRAY, local->type->subtype, NULL);
+        d->type->array_size = copy_expr(map, local->type->array_size);
+    }
+    return d;
+}
+
+static struct stmt *copy_body(symbol_map_t *map, struct stmt *root) {
+    typedef struct {
+        struct stmt *from;
+        struct stmt **to;
+    } copy_t;
+
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(copy_t));
+
+    struct stmt *result = NULL;
+    if (root) {
+        copy_t *first = work_stack_push(&stack);
+        first->from = root;
+        first->to = &result;
+    }
+
+    copy_t item;
+    while (work_stack_pop(&stack, &item)) {
+        struct stmt *s = ast_alloc(sizeof(struct stmt));
+        *s = *item.from;
+        s->expr = copy_expr(map, s->expr);
+        if (s->kind == STMT_FOR) {
+            s->init_expr = copy_expr(map, s->init_expr);
+            s->next_expr = copy_expr(map, s->next_expr);
+        }
+        if (s->kind == STMT_DECL && s->decl) {
+            s->decl = copy_local(map, s->decl);
+        }
+        *item.to = s;
+
+        struct stmt **children[3] = {&s->next, &s->body, &s->else_body};
+        int child_count = s->kind == STMT_IF_ELSE ? 3 : 2;
+        for (int c = 0; c < child_count; c++) {
+            if (*children[c]) {
+                copy_t *child = work_stack_push(&stack);
+                child->from = *children[c];
+                child->to = children[c];
+            }
+        }
+    }
+
+    work_stack_free(&stack);
+    return result;
+}
+
+// The parameters and locals of d, each with a fresh symbol.
+static void map_symbols(struct decl *d, symbol_map_t *map) {
+    work_stack_t symbols;
+    work_stack_init(&symbols, sizeof(struct symbol *));
+    for (struct param_list *p = d->type->params; p; p = p->next) {
+        *(struct symbol **) work_stack_push(&symbols) = p->symbol;
+    }
+
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(struct stmt *));
+    if (d->code) *(struct stmt **) work_stack_push(&stack) = d->code;
+
+    struct stmt *s;
+    while (work_stack_pop(&stack, &s)) {
+        if (s->kind == STMT_DECL && s->decl && s->decl->symbol) {
+            *(struct symbol **) work_stack_push(&symbols) = s->decl->symbol;
+        }
+        if (s->next) *(struct stmt **) work_stack_push(&stack) = s->next;
+        if (s->body) *(struct stmt **) work_stack_push(&stack) = s->body;
+        if (s->kind == STMT_IF_ELSE && s->else_body) *(struct stmt **) work_stack_push(&stack) = s->else_body;
+    }
+    work_stack_free(&stack);
+
+    map->count = symbols.count;
+    map->from = (struct symbol **) symbols.items;
+    map->to = allocate(map->count, sizeof(struct symbol *));
+    if (map->count > 1) {
+        qsort(map->from, map->count, sizeof(struct symbol *), compare_symbols);
+    }
+    for (size_t i = 0; i < map->count; i++) {
+        struct symbol *from = map->from[i];
+        map->to[i] = symbol_create(from->kind, from->name, from->type);
+        map->to[i]->level = from->level;
+    }
+}
+
+static int is_declared(ipcp_t *ipcp, const char *name) {
+    return bsearch(&name, ipcp->names, ipcp->name_count, sizeof(const char *), compare_names) != NULL;
+}
+
+// f_1, f_2 and so on, skipping names the program already uses.
+static const char *clone_name(ipcp_t *ipcp, function_t *function) {
+    char buffer[256];
+    const char *name;
+    do {
+        snprintf(buffer, sizeof(buffer), "%s_%d", function->name, ++function->clones);
+        name = intern_string(buffer);
+    } while (is_declared(ipcp, name));
+    return name;
+}
+
+static void count_nodes(struct expr *e, void *context) {
+    (void) e;
+    (*(int *) context)++;
+}
+
+static void count_root(ipcp_t *ipcp, struct expr *root, int loop_depth, int printed, void *context) {
+    (void) ipcp;
+    (void) loop_depth;
+    (void) printed;
+    visit_nodes(root, count_nodes, context);
+}
+
+static int function_size(ipcp_t *ipcp, function_t *function) {
+    if (function->size < 0) {
+        int nodes = 0;
+        function->size = (int) visit_body(ipcp, function->d->code, count_root, &nodes) + nodes;
+    }
+    return function->size;
+}
+
+static void fold_root(ipcp_t *ipcp, struct expr *root, int loop_depth, int printed, void *context) {
+    (void) ipcp;
+    (void) loop_depth;
+    (void) printed;
+    (void) context;
+    fold_expression(root);
+}
+
+static void redirect_call(struct expr *call, struct decl *clone, const arg_key_t *key) {
+    call->left->name = clone->name;
+    call->left->symbol = clone->symbol;
+    drop_bound_args(call, key);
+}
+
+typedef struct {
+    function_t *function;
+    struct decl *clone;
+    const arg_key_t *key;
+} redirect_t;
+
+static void redirect_same_key(struct expr *e, void *context) {
+    redirect_t *redirect = context;
+    function_t *function = redirect->function;
+    if (e->kind != EXPR_CALL || e->left->kind != EXPR_NAME || e->left->name != function->name ||
+        !e->left->symbol || e->left->symbol->kind != SYMBOL_GLOBAL) {
+        return;
+    }
+
+    struct expr *arg = e->right;
+    for (int p = 0; p < function->param_count; p++, arg = arg->right) {
+        if (!arg) return;
+
+        const arg_key_t *key = &redirect->key[p];
+        if (key->literal && (!is_literal(arg->left) || (int) arg->left->kind != key->kind ||
+                             arg->left->integer_value != key->value)) {
+            return;
+        }
+    }
+    redirect_call(e, redirect->clone, redirect->key);
+}
+
+static void redirect_root(ipcp_t *ipcp, struct expr *root, int loop_depth, int printed, void *context) {
+    (void) ipcp;
+    (void) loop_depth;
+    (void) printed;
+    visit_nodes(root, redirect_same_key, context);
+}
+
+// Copies the function for the calls sites[first .. end), whose key it
+// binds, and points those calls at the copy, without the bound arguments. Returns the new head of the
+// declaration list.
+static struct decl *specialize(ipcp_t *ipcp, struct decl *program, site_t *sites, size_t first, size_t end) {
+    function_t *function = &ipcp->functions[sites[first].callee];
+    struct decl *original = function->d;
+    const char *name = clone_name(ipcp, function);
+
+    symbol_map_t map;
+    map_symbols(original, &map);
+
+    struct param_list *params = NULL;
+    for (int p = function->param_count; p > 0; p--) {
+        struct param_list *from = function->params[p - 1];
+        params = create_param(from->name, from->type, params);
+        params->symbol = map_symbol(&map, from->symbol);
+    }
+    struct type *type = create_type(TYPE_FUNCTION, original->type->subtype, params);
+
+    struct decl *clone = create_decl(name, type, NULL, copy_body(&map, original->code), original->next);
+    clone->symbol = symbol_create(SYMBOL_GLOBAL, name, type);
+    original->next = clone;
+
+    struct decl *prototype = create_decl(name, type, NULL, NULL, NULL);
+    prototype->symbol = clone->symbol;
+    if (function->before) {
+        prototype->next = function->before->next;
+        function->before->next = prototype;
+    } else {
+        prototype->next = program;
+        program = prototype;
+    }
+
+    const arg_key_t *key = sites[first].key;
+    bind_params(ipcp, function, params, clone->code, key);
+    visit_body(ipcp, clone->code, fold_root, NULL);
+    type->params = drop_bound_params(params, key);
+
+    for (size_t s = first; s < end; s++) {
+        redirect_call(sites[s].call, clone, key);
+    }
+
+    // Recursive calls with the same literals stay in the copy.
+    redirect_t redirect = {function, clone, key};
+    visit_body(ipcp, clone->code, redirect_root, &redirect);
+
+    free(map.from);
+    free(map.to);
+    return program;
+}
+
+typedef struct {
+    size_t first;
+    size_t end;
+    long weight;
+} group_t;
+
+static int compare_groups(const void *a, const void *b) {
+    const group_t *x = a;
+    const group_t *y = b;
+    if (x->weight != y->weight) return x->weight > y->weight ? -1 : 1;
+    return x->first < y->first ? -1 : x->first > y->first;
+}
+
+static struct decl *specialize_hot_calls(ipcp_t *ipcp, struct decl *program, int budget) {
+    site_t *sites = (site_t *) ipcp->sites.items;
+    work_stack_t groups;
+    work_stack_init(&groups, sizeof(group_t));
+
+    size_t s = 0;
+    while (s < ipcp->sites.count) {
+        function_t *function = &ipcp->functions[sites[s].callee];
+        size_t key_size = (size_t) function->param_count * sizeof(arg_key_t);
+
+        group_t group = {s, s, 0};
+        while (group.end < ipcp->sites.count && sites[group.end].callee == sites[s].callee &&
+               memcmp(sites[group.end].key, sites[s].key, key_size) == 0) {
+            group.weight += sites[group.end].weight;
+            group.end++;
+        }
+        s = group.end;
+
+        int literal = 0;
+        for (int p = 0; p < function->param_count; p++) {
+            literal |= sites[group.first].key[p].literal;
+        }
+        if (literal && function->specializable && group.weight >= HOT_WEIGHT) {
+            *(group_t *) work_stack_push(&groups) = group;
+        }
+    }
+
+    group_t *hot = (group_t *) groups.items;
+    if (groups.count > 1) {
+        qsort(hot, groups.count, sizeof(group_t), compare_groups);
+    }
+
+    for (size_t g = 0; g < groups.count; g++) {
+        function_t *function = &ipcp->functions[sites[hot[g].first].callee];
+        int size = function_size(ipcp, function);
+        if (size > budget) continue;
+
+        budget -= size;
+        program = specialize(ipcp, program, sites, hot[g].first, hot[g].end);
+    }
+
+    work_stack_free(&groups);
+    return program;
+}
+
+// Setup.
+
+static void collect_names(ipcp_t *ipcp, struct decl *program) {
+    work_stack_t names;
+    work_stack_init(&names, sizeof(const char *));
+
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(struct stmt *));
+    for (struct decl *d = program; d; d = d->next) {
+        if (!d->name) continue;
+
+        *(const char **) work_stack_push(&names) = d->name;
+        if (d->type) {
+            for (struct param_list *p = d->type->params; p; p = p->next) {
+                *(const char **) work_stack_push(&names) = p->name;
+            }
+        }
+        if (d->code) *(struct stmt **) work_stack_push(&stack) = d->code;
+
+        struct stmt *s;
+        while (work_stack_pop(&stack, &s)) {
+            if (s->kind == STMT_DECL && s->decl) {
+                struct decl *local = s->decl;
+                *(const char **) work_stack_push(&names) = local->name;
+                if (local->type && local->type->kind == TYPE_FUNCTION) {
+                    for (struct param_list *p = local->type->params; p; p = p->next) {
+                        *(const char **) work_stack_push(&names) = p->name;
+                    }
+                }
+                if (local->code) *(struct stmt **) work_stack_push(&stack) = local->code;
+            }
+            if (s->next) *(struct stmt **) work_stack_push(&stack) = s->next;
+            if (s->body) *(struct stmt **) work_stack_push(&stack) = s->body;
+            if (s->kind == STMT_IF_ELSE && s->else_body) *(struct stmt **) work_stack_push(&stack) = s->else_body;
+        }
+    }
+    work_stack_free(&stack);
+
+    ipcp->names = (const char **) names.items;
+    ipcp->name_count = names.count;
+    if (ipcp->name_count > 1) {
+        qsort(ipcp->names, ipcp->name_count, sizeof(const char *), compare_names);
+    }
+}
+
+static void build_tables(ipcp_t *ipcp, struct decl *program) {
+    size_t count = 0;
+    int has_main = 0;
+    for (struct decl *d = program; d; d = d->next) {
+        count++;
+        has_main |= d->code && d->name == intern_string("main");
+    }
+    ipcp->globals = allocate(count, sizeof(global_t));
+    ipcp->functions = allocate(count, sizeof(function_t));
+
+    struct decl *previous = NULL;
+    for (struct decl *d = program; d; previous = d, d = d->next) {
+        if (!d->type) continue;
+
+        if (d->type->kind != TYPE_FUNCTION) {
+            ipcp->globals[ipcp->global_count++] = (global_t) {d->name, d, 0};
+        } else if (d->code) {
+            function_t *function = &ipcp->functions[ipcp->function_count++];
+            function->name = d->name;
+            function->d = d;
+
+            // Without a main, the functions may be called from elsewhere.
+            function->eligible = has_main && d->name != intern_string("main") && !has_nested_function(d->code);
+            function->specializable = function->eligible && !(previous && is_memo_pragma(previous));
+        }
+    }
+    qsort(ipcp->globals, ipcp->global_count, sizeof(global_t), compare_names);
+    qsort(ipcp->functions, ipcp->function_count, sizeof(function_t), compare_names);
+
+    for (size_t f = 0; f < ipcp->function_count; f++) {
+        scan_function(ipcp, &ipcp->functions[f]);
+    }
+
+    // Where a prototype for a copy has to go.
+    previous = NULL;
+    for (struct decl *d = program; d; previous = d, d = d->next) {
+        function_t *function = d->type && d->type->kind == TYPE_FUNCTION ? find_function(ipcp, d->name) : NULL;
+        if (function && !function->declared) {
+            function->before = previous;
+            function->declared = 1;
+        }
+    }
+
+    collect_names(ipcp, program);
+}
+
+struct decl *propagate_constants(struct decl *program, int specialize_budget) {
+    ipcp_t ipcp;
+    memset(&ipcp, 0, sizeof(ipcp));
+    ipcp.effects = analyze_effects(program, 0);
+    work_stack_init(&ipcp.sites, sizeof(site_t));
+    work_stack_init(&ipcp.keys, sizeof(arg_key_t));
+
+    build_tables(&ipcp, program);
+    propagate_globals(&ipcp, program);
+
+    collect_sites(&ipcp, program);
+    propagate_params(&ipcp, program);
+
+    if (specialize_budget > 0) {
+        collect_sites(&ipcp, program);
+        program = specialize_hot_calls(&ipcp, program, specialize_budget);
+    }
+
+    for (size_t f = 0; f < ipcp.function_count; f++) {
+        free(ipcp.functions[f].params);
+        free(ipcp.functions[f].substitutable);
+    }
+    free(ipcp.functions);
+    free(ipcp.globals);
+    free(ipcp.names);
+    work_stack_free(&ipcp.sites);
+    work_stack_free(&ipcp.keys);
+    free_effects(ipcp.effects);
+    return program;
+}
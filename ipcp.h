@@ -0,0 +1,32 @@
+#ifndef IPCP_H
+#define IPCP_H
+
+#include "ast.h"
+
+// Interprocedural constant propagation, run on a type-checked program
+// after fold_program:
+//
+//  - globals that are never written (see effects.h) and start as a
+//    literal are replaced by it wherever they are read: integers, chars
+//    and booleans everywhere, elements of such arrays at literal indexes,
+//    and strings where they are printed;
+//  - in a program with a main, a parameter that every call passes the
+//    same literal, and that the function never assigns, is replaced by
+//    that literal in the body, and dropped from its declarations and
+//    from the calls;
+//  - the functions' other calls with literal arguments are grouped by
+//    function and arguments, and the hottest groups, counting calls in
+//    loops more, get a copy of the function specialized for those
+//    arguments, as long as the copies add at most specialize_budget AST
+//    nodes in all. A copy takes only the other parameters, and its
+//    recursive calls with the same literals call the copy; an original
+//    left without calls is then dropped by tree shaking.
+//
+// Rewritten expressions are folded again. A function with a "pragma
+// memoize" comment is not specialized, since a copy would miss its table.
+// Returns the new head of the declaration list.
+struct decl *propagate_constants(struct decl *program, int specialize_budget);
+
+#define DEFAULT_SPECIALIZE_BUDGET 200
+
+#endif
@@ -0,0 +1,765 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+#include "work_stack.h"
+
+// Zeroed memory from the function's arena. Running out is fatal, as it is
+// for the work stacks.
+static void *ir_alloc(ir_function_t *fn, size_t size) {
+    void *memory = arena_alloc(fn->arena, size);
+    if (!memory) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    memset(memory, 0, size);
+    return memory;
+}
+
+// Doubles an arena-allocated array; the old copy stays in the arena.
+static void *grow_array(ir_function_t *fn, void *items, int count, int *capacity, size_t item_size) {
+    int new_capacity = *capacity ? *capacity * 2 : 4;
+    void *grown = ir_alloc(fn, (size_t) new_capacity * item_size);
+    if (count) {
+        memcpy(grown, items, (size_t) count * item_size);
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+ir_function_t *ir_create_function(struct decl *d) {
+    ir_function_t *fn = calloc(1, sizeof(ir_function_t));
+    if (!fn) return NULL;
+
+    fn->arena = arena_create(0);
+    if (!fn->arena) {
+        free(fn);
+        return NULL;
+    }
+    fn->decl = d;
+
+    return fn;
+}
+
+void ir_free_function(ir_function_t *fn) {
+    if (!fn) return;
+
+    arena_destroy(fn->arena);
+    free(fn);
+}
+
+ir_block_t *ir_new_block(ir_function_t *fn) {
+    ir_block_t *block = ir_alloc(fn, sizeof(ir_block_t));
+    block->id = fn->next_block++;
+    block->order = -1;
+
+    if (fn->last_block) {
+        fn->last_block->next = block;
+    } else {
+        fn->entry = block;
+    }
+    fn->last_block = block;
+
+    return block;
+}
+
+ir_instr_t *ir_new_instr(ir_function_t *fn, ir_opcode_t op, struct type *type) {
+    ir_instr_t *instr = ir_alloc(fn, sizeof(ir_instr_t));
+    instr->op = op;
+    instr->type = type;
+    instr->id = fn->next_value++;
+    return instr;
+}
+
+ir_array_t *ir_new_array(ir_function_t *fn, const char *name, struct type *element, int size) {
+    ir_array_t *array = ir_alloc(fn, sizeof(ir_array_t));
+    array->id = fn->array_count;
+    array->name = name;
+    array->element = element;
+    array->size = size;
+
+    if (fn->array_count == fn->array_capacity) {
+        fn->arrays = grow_array(fn, fn->arrays, fn->array_count, &fn->array_capacity, sizeof(ir_array_t *));
+    }
+    fn->arrays[fn->array_count++] = array;
+
+    return array;
+}
+
+void ir_add_operand(ir_function_t *fn, ir_instr_t *instr, ir_instr_t *operand) {
+    if (instr->operand_count == instr->operand_capacity) {
+        instr->operands = grow_array(fn, instr->operands, instr->operand_count,
+                                     &instr->operand_capacity, sizeof(ir_instr_t *));
+    }
+    instr->operands[instr->operand_count++] = operand;
+}
+
+void ir_add_pred(ir_function_t *fn, ir_block_t *block, ir_block_t *pred) {
+    if (block->pred_count == block->pred_capacity) {
+        block->preds = grow_array(fn, block->preds, block->pred_count,
+                                  &block->pred_capacity, sizeof(ir_block_t *));
+    }
+    block->preds[block->pred_count++] = pred;
+}
+
+void ir_append(ir_block_t *block, ir_instr_t *instr) {
+    instr->block = block;
+
+    ir_instr_t *after = block->last;
+    if (instr->op == IR_PHI && after && after->op != IR_PHI) {
+        after = NULL;
+        for (ir_instr_t *i = block->first; i && i->op == IR_PHI; i = i->next) {
+            after = i;
+        }
+    }
+
+    instr->prev = after;
+    instr->next = after ? after->next : block->first;
+    if (instr->next) {
+        instr->next->prev = instr;
+    } else {
+        block->last = instr;
+    }
+    if (after) {
+        after->next = instr;
+    } else {
+        block->first = instr;
+    }
+}
+
+void ir_insert_before(ir_instr_t *position, ir_instr_t *instr) {
+    ir_block_t *block = position->block;
+    instr->block = block;
+
+    instr->prev = position->prev;
+    instr->next = position;
+    if (position->prev) {
+        position->prev->next = instr;
+    } else {
+        block->first = instr;
+    }
+    position->prev = instr;
+}
+
+void ir_remove(ir_instr_t *instr) {
+    ir_block_t *block = instr->block;
+
+    if (instr->prev) {
+        instr->prev->next = instr->next;
+    } else {
+        block->first = instr->next;
+    }
+    if (instr->next) {
+        instr->next->prev = instr->prev;
+    } else {
+        block->last = instr->prev;
+    }
+
+    instr->prev = NULL;
+    instr->next = NULL;
+    instr->block = NULL;
+}
+
+int ir_is_terminator(ir_opcode_t op) {
+    return op == IR_JUMP || op == IR_BRANCH || op == IR_RETURN;
+}
+
+int ir_has_side_effects(ir_opcode_t op) {
+    switch (op) {
+        case IR_STORE_GLOBAL:
+        case IR_STORE:
+        case IR_CALL:
+        case IR_PRINT:
+        case IR_JUMP:
+        case IR_BRANCH:
+        case IR_RETURN:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+int ir_successors(ir_block_t *block, ir_block_t *successors[2]) {
+    ir_instr_t *last = block->last;
+    if (!last) return 0;
+
+    switch (last->op) {
+        case IR_JUMP:
+            successors[0] = last->targets[0];
+            return 1;
+        case IR_BRANCH:
+            successors[0] = last->targets[0];
+            successors[1] = last->targets[1];
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+int ir_pred_index(ir_block_t *block, ir_block_t *pred) {
+    for (int i = 0; i < block->pred_count; i++) {
+        if (block->preds[i] == pred) return i;
+    }
+    return -1;
+}
+
+void ir_remove_pred(ir_block_t *block, int index) {
+    for (ir_instr_t *phi = block->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        memmove(&phi->operands[index], &phi->operands[index + 1],
+                sizeof(ir_instr_t *) * (size_t) (phi->operand_count - index - 1));
+        phi->operand_count--;
+    }
+    memmove(&block->preds[index], &block->preds[index + 1],
+            sizeof(ir_block_t *) * (size_t) (block->pred_count - index - 1));
+    block->pred_count--;
+}
+
+void ir_mark_escaping_arrays(ir_function_t *fn) {
+    for (int a = 0; a < fn->array_count; a++) {
+        fn->arrays[a]->escapes = 0;
+    }
+
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            if (i->op != IR_CALL) continue;
+
+            for (int o = 0; o < i->operand_count; o++) {
+                if (i->operands[o]->op == IR_ADDRESS && i->operands[o]->array) {
+                    i->operands[o]->array->escapes = 1;
+                }
+            }
+        }
+    }
+}
+
+// Numbers the blocks reachable from the entry in reverse postorder, and
+// returns them in that order. Unreachable blocks keep order -1.
+static ir_block_t **reverse_postorder(ir_function_t *fn, int *count) {
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        b->order = -1;
+        b->idom = NULL;
+    }
+
+    ir_block_t **postorder = malloc(sizeof(ir_block_t *) * (size_t) (fn->next_block ? fn->next_block : 1));
+    if (!postorder) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    // An item is a block and how many of its successors were visited.
+    typedef struct {
+        ir_block_t *block;
+        int visited;
+    } dfs_item_t;
+
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(dfs_item_t));
+    *count = 0;
+
+    if (fn->entry) {
+        fn->entry->order = 0;   // on the stack
+        ((dfs_item_t *) work_stack_push(&stack))->block = fn->entry;
+    }
+
+    dfs_item_t *top;
+    while ((top = work_stack_top(&stack))) {
+        ir_block_t *successors[2];
+        int n = ir_successors(top->block, successors);
+
+        if (top->visited < n) {
+            ir_block_t *next = successors[top->visited++];
+            if (next->order == -1) {
+                next->order = 0;
+                ((dfs_item_t *) work_stack_push(&stack))->block = next;
+            }
+            continue;
+        }
+
+        postorder[(*count)++] = top->block;
+        work_stack_pop(&stack, NULL);
+    }
+
+    work_stack_free(&stack);
+
+    // Reverse in place.
+    for (int i = 0, j = *count - 1; i < j; i++, j--) {
+        ir_block_t *swap = postorder[i];
+        postorder[i] = postorder[j];
+        postorder[j] = swap;
+    }
+    for (int i = 0; i < *count; i++) {
+        postorder[i]->order = i;
+    }
+
+    return postorder;
+}
+
+static ir_block_t *intersect(ir_block_t *a, ir_block_t *b) {
+    while (a != b) {
+        while (a->order > b->order) a = a->idom;
+        while (b->order > a->order) b = b->idom;
+    }
+    return a;
+}
+
+void ir_compute_dominators(ir_function_t *fn) {
+    int count;
+    ir_block_t **blocks = reverse_postorder(fn, &count);
+    if (count == 0) {
+        free(blocks);
+        return;
+    }
+
+    blocks[0]->idom = blocks[0];
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+
+        for (int i = 1; i < count; i++) {
+            ir_block_t *b = blocks[i];
+            ir_block_t *idom = NULL;
+
+            for (int p = 0; p < b->pred_count; p++) {
+                ir_block_t *pred = b->preds[p];
+                if (pred->order < 0 || !pred->idom) continue;
+                idom = idom ? intersect(pred, idom) : pred;
+            }
+
+            if (idom && b->idom != idom) {
+                b->idom = idom;
+                changed = 1;
+            }
+        }
+    }
+
+    free(blocks);
+}
+
+int ir_dominates(ir_block_t *a, ir_block_t *b) {
+    if (a->order < 0 || b->order < 0) return 0;
+
+    while (b->order > a->order) {
+        b = b->idom;
+    }
+    return a == b;
+}
+
+// Drops blocks the entry cannot reach, with their edges into live blocks
+// and the matching phi operands.
+static void remove_unreachable_blocks(ir_function_t *fn) {
+    int count;
+    free(reverse_postorder(fn, &count));
+
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        if (b->order < 0) continue;
+
+        for (int p = 0; p < b->pred_count;) {
+            if (b->preds[p]->order >= 0) {
+                p++;
+            } else {
+                ir_remove_pred(b, p);
+            }
+        }
+    }
+
+    ir_block_t **link = &fn->entry;
+    fn->last_block = NULL;
+    while (*link) {
+        if ((*link)->order < 0) {
+            *link = (*link)->next;
+        } else {
+            fn->last_block = *link;
+            link = &(*link)->next;
+        }
+    }
+}
+
+ir_instr_t *ir_resolve(ir_instr_t *value) {
+    while (value->replacement) {
+        value = value->replacement;
+    }
+    return value;
+}
+
+void ir_resolve_operands(ir_function_t *fn) {
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            for (int o = 0; o < i->operand_count; o++) {
+                i->operands[o] = ir_resolve(i->operands[o]);
+            }
+        }
+    }
+}
+
+// A phi whose operands are all one value, or itself, is that value
+// (Braun et al.). Replacing one can make others trivial, so this repeats.
+static void remove_trivial_phis(ir_function_t *fn) {
+    int changed = 1;
+
+    while (changed) {
+        changed = 0;
+
+        for (ir_block_t *b = fn->entry; b; b = b->next) {
+            for (ir_instr_t *i = b->first; i; i = i->next) {
+                for (int o = 0; o < i->operand_count; o++) {
+                    i->operands[o] = ir_resolve(i->operands[o]);
+                }
+            }
+
+            ir_instr_t *phi = b->first;
+            while (phi && phi->op == IR_PHI) {
+                ir_instr_t *next = phi->next;
+                ir_instr_t *same = NULL;
+                int trivial = 1;
+
+                for (int o = 0; o < phi->operand_count && trivial; o++) {
+                    ir_instr_t *operand = phi->operands[o];
+                    if (operand == phi || operand == same) continue;
+                    if (same) {
+                        trivial = 0;
+                    } else {
+                        same = operand;
+                    }
+                }
+
+                if (trivial && same) {
+                    phi->replacement = same;
+                    ir_remove(phi);
+                    changed = 1;
+                }
+                phi = next;
+            }
+        }
+    }
+
+    // A last pass, so no operand points at a removed phi.
+    ir_resolve_operands(fn);
+}
+
+// Folds a block that only its predecessor jumps to into that predecessor.
+// Merged blocks are left empty and dropped from the layout at the end.
+static void merge_blocks(ir_function_t *fn) {
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        while (b->last && b->last->op == IR_JUMP) {
+            ir_block_t *target = b->last->targets[0];
+            if (target == b || target == fn->entry || target->pred_count != 1 || !target->last) break;
+
+            ir_remove(b->last);
+            while (target->first) {
+                ir_instr_t *instr = target->first;
+                ir_remove(instr);
+                ir_append(b, instr);
+            }
+
+            ir_block_t *successors[2];
+            int n = ir_successors(b, successors);
+            for (int i = 0; i < n; i++) {
+                successors[i]->preds[ir_pred_index(successors[i], target)] = b;
+            }
+            target->pred_count = 0;
+        }
+    }
+
+    ir_block_t **link = &fn->entry;
+    fn->last_block = NULL;
+    while (*link) {
+        if (!(*link)->last) {
+            *link = (*link)->next;
+        } else {
+            fn->last_block = *link;
+            link = &(*link)->next;
+        }
+    }
+}
+
+// A local array that no call is given, as the base of a load or store.
+static ir_array_t *private_array(ir_instr_t *base) {
+    return base->op == IR_ADDRESS && base->array && !base->array->escapes ? base->array : NULL;
+}
+
+// Marks everything that side effects and control flow depend on, and
+// removes the rest. Dead cycles of phis go too, and so do stores into a
+// private array nothing loads from, which forwarding stored values to
+// loads can leave behind.
+static void remove_dead_values(ir_function_t *fn) {
+    work_stack_t live;
+    work_stack_init(&live, sizeof(ir_instr_t *));
+
+    char *loaded = calloc((size_t) fn->array_count + 1, 1);
+    if (!loaded) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    ir_mark_escaping_arrays(fn);
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            if (i->op == IR_LOAD && private_array(i->operands[0])) {
+                loaded[i->operands[0]->array->id] = 1;
+            }
+        }
+    }
+
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            ir_array_t *array = i->op == IR_STORE ? private_array(i->operands[0]) : NULL;
+            i->mark = ir_has_side_effects(i->op) && !(array && !loaded[array->id]);
+            if (i->mark) {
+                *(ir_instr_t **) work_stack_push(&live) = i;
+            }
+        }
+    }
+
+    ir_instr_t *instr;
+    while (work_stack_pop(&live, &instr)) {
+        for (int o = 0; o < instr->operand_count; o++) {
+            ir_instr_t *operand = instr->operands[o];
+            if (!operand->mark) {
+                operand->mark = 1;
+                *(ir_instr_t **) work_stack_push(&live) = operand;
+            }
+        }
+    }
+
+    work_stack_free(&live);
+    free(loaded);
+
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        ir_instr_t *i = b->first;
+        while (i) {
+            ir_instr_t *next = i->next;
+            if (!i->mark) {
+                ir_remove(i);
+            }
+            i = next;
+        }
+    }
+}
+
+void ir_cleanup(ir_function_t *fn) {
+    remove_unreachable_blocks(fn);
+    remove_trivial_phis(fn);
+    merge_blocks(fn);
+    remove_dead_values(fn);
+}
+
+static const char *opcode_name(ir_opcode_t op) {
+    switch (op) {
+        case IR_CONST: return "const";
+        case IR_STRING: return "string";
+        case IR_PARAM: return "param";
+        case IR_PHI: return "phi";
+        case IR_NEG: return "neg";
+        case IR_NOT: return "not";
+        case IR_ADD: return "add";
+        case IR_SUB: return "sub";
+        case IR_MUL: return "mul";
+        case IR_DIV: return "div";
+        case IR_MOD: return "mod";
+        case IR_POW: return "pow";
+        case IR_LT: return "lt";
+        case IR_LE: return "le";
+        case IR_GT: return "gt";
+        case IR_GE: return "ge";
+        case IR_EQ: return "eq";
+        case IR_NE: return "ne";
+        case IR_LOAD_GLOBAL: return "load_global";
+        case IR_STORE_GLOBAL: return "store_global";
+        case IR_ADDRESS: return "address";
+        case IR_LOAD: return "load";
+        case IR_STORE: return "store";
+        case IR_CALL: return "call";
+        case IR_PRINT: return "print";
+        case IR_JUMP: return "jump";
+        case IR_BRANCH: return "branch";
+        case IR_RETURN: return "return";
+    }
+    return "?";
+}
+
+static void print_instr(ir_instr_t *i, FILE *output) {
+    fprintf(output, "    ");
+    if (i->type && i->type->kind != TYPE_VOID) {
+        fprintf(output, "v%d = ", i->id);
+    }
+    fprintf(output, "%s", opcode_name(i->op));
+
+    switch (i->op) {
+        case IR_CONST:
+            fprintf(output, " %d", i->value);
+            break;
+        case IR_STRING:
+            fprintf(output, " \"%s\"", i->text);
+            break;
+        case IR_ADDRESS:
+            if (i->array) {
+                fprintf(output, " %s.a%d", i->array->name, i->array->id);
+            } else {
+                fprintf(output, " @%s", i->text);
+            }
+            break;
+        case IR_PARAM:
+            fprintf(output, " %s", i->text);
+            break;
+        case IR_LOAD_GLOBAL:
+        case IR_STORE_GLOBAL:
+            fprintf(output, " @%s", i->text);
+            break;
+        case IR_CALL:
+            fprintf(output, " %s", i->text);
+            break;
+        default:
+            break;
+    }
+
+    for (int o = 0; o < i->operand_count; o++) {
+        fprintf(output, "%s v%d", o ? "," : "", i->operands[o]->id);
+        if (i->op == IR_PHI && i->block && o < i->block->pred_count) {
+            fprintf(output, " (b%d)", i->block->preds[o]->id);
+        }
+    }
+
+    if (i->op == IR_JUMP) {
+        fprintf(output, " b%d", i->targets[0]->id);
+    } else if (i->op == IR_BRANCH) {
+        fprintf(output, ", b%d, b%d", i->targets[0]->id, i->targets[1]->id);
+    }
+
+    fprintf(output, "\n");
+}
+
+void ir_print_function(ir_function_t *fn, FILE *output) {
+    fprintf(output, "function %s\n", fn->decl->name);
+
+    for (int a = 0; a < fn->array_count; a++) {
+        ir_array_t *array = fn->arrays[a];
+        fprintf(output, "  array %s.a%d [%d]\n", array->name, array->id, array->size);
+    }
+
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        fprintf(output, "  b%d:", b->id);
+        if (b->pred_count) {
+            fprintf(output, "  ; preds");
+            for (int p = 0; p < b->pred_count; p++) {
+                fprintf(output, " b%d", b->preds[p]->id);
+            }
+        }
+        fprintf(output, "\n");
+
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            print_instr(i, output);
+        }
+    }
+}
+
+static int verify_errors;
+
+static void verify_error(FILE *errors, ir_function_t *fn, const char *format, int a, int b) {
+    fprintf(errors, "IR error in %s: ", fn->decl->name);
+    fprintf(errors, format, a, b);
+    fprintf(errors, "\n");
+    verify_errors++;
+}
+
+// Dominance checks walk the dominator tree, which is slow on very deeply
+// nested code; past this many blocks only the structure is checked.
+#define MAX_VERIFY_DOMINANCE_BLOCKS 4096
+
+int ir_verify(ir_function_t *fn, FILE *errors) {
+    verify_errors = 0;
+
+    int block_count = 0;
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        block_count++;
+        if (!b->last || !ir_is_terminator(b->last->op)) {
+            verify_error(errors, fn, "block b%d does not end in a terminator", b->id, 0);
+        }
+
+        int past_phis = 0;
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            if (i->block != b) {
+                verify_error(errors, fn, "v%d is listed in block b%d but belongs elsewhere", i->id, b->id);
+            }
+            if (i != b->last && ir_is_terminator(i->op)) {
+                verify_error(errors, fn, "terminator v%d in the middle of block b%d", i->id, b->id);
+            }
+
+            if (i->op == IR_PHI) {
+                if (past_phis) {
+                    verify_error(errors, fn, "phi v%d after other instructions in block b%d", i->id, b->id);
+                }
+                if (i->operand_count != b->pred_count) {
+                    verify_error(errors, fn, "phi v%d has %d operands for its block's predecessors", i->id, i->operand_count);
+                }
+            } else {
+                past_phis = 1;
+            }
+
+            for (int o = 0; o < i->operand_count; o++) {
+                if (!i->operands[o]->block) {
+                    verify_error(errors, fn, "v%d uses v%d, which was removed", i->id, i->operands[o]->id);
+                } else if (!i->operands[o]->type || i->operands[o]->type->kind == TYPE_VOID) {
+                    verify_error(errors, fn, "v%d uses v%d, which has no value", i->id, i->operands[o]->id);
+                }
+            }
+        }
+
+        // Every edge is recorded at both ends.
+        ir_block_t *successors[2];
+        int n = ir_successors(b, successors);
+        for (int s = 0; s < n; s++) {
+            if (ir_pred_index(successors[s], b) < 0) {
+                verify_error(errors, fn, "b%d jumps to b%d but is not its predecessor", b->id, successors[s]->id);
+            }
+        }
+        for (int p = 0; p < b->pred_count; p++) {
+            int found = 0;
+            n = ir_successors(b->preds[p], successors);
+            for (int s = 0; s < n; s++) {
+                found |= successors[s] == b;
+            }
+            if (!found) {
+                verify_error(errors, fn, "b%d lists b%d as a predecessor", b->id, b->preds[p]->id);
+            }
+        }
+    }
+
+    if (verify_errors || block_count > MAX_VERIFY_DOMINANCE_BLOCKS) {
+        return verify_errors;
+    }
+
+    // Definitions dominate their uses; a phi operand is used at the end of
+    // the matching predecessor.
+    ir_compute_dominators(fn);
+
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        if (b->order < 0) continue;
+
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            i->mark = 0;
+        }
+
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            for (int o = 0; o < i->operand_count; o++) {
+                ir_instr_t *def = i->operands[o];
+                ir_block_t *at = i->op == IR_PHI ? b->preds[o] : b;
+                int ok;
+
+                if (def->block == at) {
+                    // Earlier in the same block, or anywhere in a
+                    // predecessor for a phi.
+                    ok = i->op == IR_PHI || def->mark;
+                } else {
+                    ok = ir_dominates(def->block, at);
+                }
+
+                if (!ok) {
+                    verify_error(errors, fn, "v%d uses v%d where its definition does not dominate", i->id, def->id);
+                }
+            }
+            i->mark = 1;
+        }
+    }
+
+    return verify_errors;
+}
@@ -0,0 +1,225 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+#include "arena.h"
+#include "ast.h"
+#include "runtime.h"
+
+// Mid-level IR: one function at a time, as a control-flow graph of basic
+// blocks holding instructions in SSA form. Every instruction that produces
+// a value is that value; scalar locals and parameters are SSA values, with
+// phis where control flow merges, while globals and arrays stay in memory
+// and are reached through loads and stores.
+//
+// A function is lowered from the type-checked AST, tidied by ir_cleanup,
+// and emitted as C by ir_emit_c. Everything a function owns comes from its
+// arena and goes with ir_free_function.
+
+typedef enum {
+    IR_CONST,           // integer, char or boolean constant: value
+    IR_STRING,          // string literal: text
+    IR_PARAM,           // incoming parameter: text is its name
+    IR_PHI,             // one operand per predecessor, in predecessor order
+    IR_NEG,
+    IR_NOT,
+    IR_ADD,
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,
+    IR_MOD,
+    IR_POW,
+    IR_LT,
+    IR_LE,
+    IR_GT,
+    IR_GE,
+    IR_EQ,
+    IR_NE,
+    IR_LOAD_GLOBAL,     // scalar global named text
+    IR_STORE_GLOBAL,    // global named text = operand 0
+    IR_ADDRESS,         // array: the global named text, or a local array
+    IR_LOAD,            // operand 0 [operand 1]
+    IR_STORE,           // operand 0 [operand 1] = operand 2
+    IR_CALL,            // function named text, operands are the arguments
+    IR_PRINT,           // operands are printed in order
+    IR_JUMP,            // to targets[0]
+    IR_BRANCH,          // to targets[0] if operand 0, else targets[1]
+    IR_RETURN           // operand 0 if the function returns a value
+} ir_opcode_t;
+
+typedef struct ir_instr ir_instr_t;
+typedef struct ir_block ir_block_t;
+
+// A local array, which lives in memory for the whole function.
+typedef struct {
+    int id;
+    const char *name;               // source name, for the printer
+    struct type *element;
+    int size;
+    int escapes;                    // passed to a call; set by ir_mark_escaping_arrays
+} ir_array_t;
+
+struct ir_instr {
+    ir_opcode_t op;
+    int id;                         // value number, unique in the function
+    struct type *type;              // of the result; NULL when there is none
+
+    ir_instr_t **operands;
+    int operand_count;
+    int operand_capacity;
+
+    int value;                      // IR_CONST
+    const char *text;               // string, parameter, global or callee
+    ir_array_t *array;              // IR_ADDRESS of a local array
+    ir_block_t *targets[2];         // IR_JUMP and IR_BRANCH
+
+    ir_block_t *block;
+    ir_instr_t *prev;
+    ir_instr_t *next;
+
+    // Scratch space for passes; ir_cleanup and ir_verify clobber it.
+    int mark;
+    ir_instr_t *replacement;
+};
+
+struct ir_block {
+    int id;
+    ir_instr_t *first;              // phis come first, the terminator last
+    ir_instr_t *last;
+
+    ir_block_t **preds;
+    int pred_count;
+    int pred_capacity;
+
+    ir_block_t *next;               // in layout order, which the emitter follows
+
+    // Filled in by ir_compute_dominators.
+    ir_block_t *idom;
+    int order;                      // reverse postorder index, -1 if unreachable
+};
+
+typedef struct {
+    struct decl *decl;
+    arena_t *arena;
+
+    ir_block_t *entry;              // first block in layout order
+    ir_block_t *last_block;
+
+    ir_array_t **arrays;
+    int array_count;
+    int array_capacity;
+
+    int next_value;
+    int next_block;
+} ir_function_t;
+
+// Building and editing. New blocks go at the end of the layout.
+ir_function_t *ir_create_function(struct decl *d);
+void ir_free_function(ir_function_t *fn);
+ir_block_t *ir_new_block(ir_function_t *fn);
+ir_instr_t *ir_new_instr(ir_function_t *fn, ir_opcode_t op, struct type *type);
+ir_array_t *ir_new_array(ir_function_t *fn, const char *name, struct type *element, int size);
+void ir_add_operand(ir_function_t *fn, ir_instr_t *instr, ir_instr_t *operand);
+void ir_add_pred(ir_function_t *fn, ir_block_t *block, ir_block_t *pred);
+
+// Appends to the end of the block, or puts a phi after the other phis.
+void ir_append(ir_block_t *block, ir_instr_t *instr);
+void ir_insert_before(ir_instr_t *position, ir_instr_t *instr);
+void ir_remove(ir_instr_t *instr);
+
+// A pass that removes an instruction points its replacement at the value
+// that stands in for it; ir_resolve follows those links, and
+// ir_resolve_operands rewrites every operand through them.
+ir_instr_t *ir_resolve(ir_instr_t *value);
+void ir_resolve_operands(ir_function_t *fn);
+
+int ir_is_terminator(ir_opcode_t op);
+int ir_has_side_effects(ir_opcode_t op);
+
+// Successors of a block: up to two, from its terminator.
+int ir_successors(ir_block_t *block, ir_block_t *successors[2]);
+
+// Index of pred in block's predecessor list, or -1.
+int ir_pred_index(ir_block_t *block, ir_block_t *pred);
+
+// Drops predecessor index from block, with the matching phi operands.
+void ir_remove_pred(ir_block_t *block, int index);
+
+// Flags the local arrays that are passed to a call, which can then read
+// and write them. The others are only reached through this function's own
+// loads and stores.
+void ir_mark_escaping_arrays(ir_function_t *fn);
+
+// Removes unreachable blocks, phis that merge a single value and values
+// nothing uses, and merges blocks into a predecessor that only jumps to
+// them.
+void ir_cleanup(ir_function_t *fn);
+
+// Sets idom and order on every block (Cooper, Harvey and Kennedy's
+// iterative algorithm over reverse postorder).
+void ir_compute_dominators(ir_function_t *fn);
+int ir_dominates(ir_block_t *a, ir_block_t *b);
+
+// Folds operations on constants, branches on constants and phis that
+// merge one constant, cleaning up after folded branches until nothing
+// more folds.
+void ir_fold_constants(ir_function_t *fn);
+
+// Local value numbering: within each block, an instruction that computes
+// what an earlier one already did is replaced by it. Loads are numbered
+// too, until a store that may alias them or a call; a load after a store
+// to the same place takes the stored value.
+void ir_number_values(ir_function_t *fn);
+
+// Turns calls of the function to itself in tail position, and ones whose
+// result is only added to or multiplied by something before it is
+// returned, into jumps back to its start. Returns the number converted.
+int ir_eliminate_tail_calls(ir_function_t *fn);
+
+// Loop-invariant code motion: moves computations and loads whose value
+// cannot change inside a loop to the block that enters it, when that is
+// safe with respect to the loop's stores and calls and cannot fault.
+void ir_hoist_loop_invariants(ir_function_t *fn);
+
+// Inlining. The call graph covers a program's lowered functions, given by
+// declaration with NULL for those left to the AST code generator; entries
+// may be set to NULL later, and are then no longer inlined.
+typedef struct ir_call_graph ir_call_graph_t;
+
+ir_call_graph_t *ir_build_call_graph(ir_function_t **functions, size_t count);
+void ir_free_call_graph(ir_call_graph_t *graph);
+
+// Indexes of the lowered functions, with every function after the ones it
+// calls unless they call each other.
+const size_t *ir_call_order(ir_call_graph_t *graph, size_t *count);
+
+// Replaces the calls in function index to functions that are not recursive
+// and have at most budget instructions with a copy of their body. Returns
+// the number of calls inlined.
+int ir_inline_calls(ir_call_graph_t *graph, size_t index, int budget);
+
+// Keeps the calls to function index as calls, as if it were recursive.
+void ir_keep_calls(ir_call_graph_t *graph, size_t index);
+
+// Instructions in the function, not counting its parameters.
+int ir_function_size(ir_function_t *fn);
+
+void ir_print_function(ir_function_t *fn, FILE *output);
+
+// Checks the structural and SSA invariants and reports every violation on
+// errors. Returns the number found.
+int ir_verify(ir_function_t *fn, FILE *errors);
+
+// Lowers a type-checked function. Returns NULL, with the construct that
+// stopped it in *reason, when the function uses something the IR does not
+// model; such functions keep going through the AST code generator.
+ir_function_t *ir_lower_function(struct decl *d, const char **reason);
+
+// Emits the function's body as C statements, without the surrounding
+// braces or signature.
+void ir_emit_c(ir_function_t *fn, FILE *output);
+
+// Notes the runtime helpers ir_emit_c will call.
+void ir_note_runtime_needs(ir_function_t *fn, runtime_needs_t *needs);
+
+#endif
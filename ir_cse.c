@@ -0,0 +1,293 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+
+// Local value numbering. Each block is scanned in order with a table from
+// what an instruction computes (its opcode, result type, operands and
+// constant parts) to the first instruction that computed it. The table is
+// emptied between blocks by stamping entries with the block they belong
+// to rather than clearing it. Entries keep only the instruction and the
+// generation; the rest of the key is rebuilt from the instruction when a
+// probe needs it, so the table stays small on very long blocks.
+//
+// Memory is split into classes, each with a generation that is part of
+// the key of a load: every local array that is never passed to a call has
+// a class of its own, and everything else (globals, array parameters and
+// arrays passed to calls) shares one, since array parameters may alias any
+// of it. Scalar globals have one more. A store moves its class to a new
+// generation, which retires the loads numbered before it; a call moves
+// every class it can reach.
+
+#define MAX_KEY_OPERANDS 3
+
+typedef struct {
+    ir_opcode_t op;
+    int kind;                       // of the result type
+    int operand_count;
+    ir_instr_t *operands[MAX_KEY_OPERANDS];
+    int value;
+    const void *ref;                // text or local array
+    unsigned int generation;
+} value_key_t;
+
+// instr is the instruction numbered, or a store whose value a later load
+// of the same place is.
+typedef struct {
+    ir_instr_t *instr;
+    unsigned int generation;        // of the key, when it was added
+    unsigned int block;             // stamp of the block it was added in
+} value_entry_t;
+
+typedef struct {
+    value_entry_t *entries;
+    size_t capacity;
+    unsigned int block;
+
+    unsigned int next_generation;
+    unsigned int shared;            // global arrays, array parameters, escaped arrays
+    unsigned int globals;           // scalar globals
+    unsigned int *arrays;           // by local array id
+} numbering_t;
+
+static int is_numbered(ir_opcode_t op) {
+    switch (op) {
+        case IR_CONST:
+        case IR_ADDRESS:
+        case IR_PHI:
+        case IR_NEG:
+        case IR_NOT:
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+        case IR_MOD:
+        case IR_POW:
+        case IR_LT:
+        case IR_LE:
+        case IR_GT:
+        case IR_GE:
+        case IR_EQ:
+        case IR_NE:
+        case IR_LOAD_GLOBAL:
+        case IR_LOAD:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int is_commutative(ir_opcode_t op) {
+    return op == IR_ADD || op == IR_MUL || op == IR_EQ || op == IR_NE;
+}
+
+static int is_store(ir_opcode_t op) {
+    return op == IR_STORE || op == IR_STORE_GLOBAL;
+}
+
+// A local array that no call can see has its own memory class.
+static unsigned int *array_generation(numbering_t *n, ir_instr_t *base) {
+    if (base->op == IR_ADDRESS && base->array && !base->array->escapes) {
+        return &n->arrays[base->array->id];
+    }
+    return &n->shared;
+}
+
+static void make_key(numbering_t *n, ir_instr_t *instr, value_key_t *key) {
+    memset(key, 0, sizeof(*key));
+    key->op = instr->op;
+    key->kind = instr->type ? (int) instr->type->kind : -1;
+    key->operand_count = instr->operand_count;
+
+    for (int o = 0; o < instr->operand_count; o++) {
+        key->operands[o] = instr->operands[o];
+    }
+    if (is_commutative(instr->op) && (uintptr_t) key->operands[0] > (uintptr_t) key->operands[1]) {
+        ir_instr_t *swap = key->operands[0];
+        key->operands[0] = key->operands[1];
+        key->operands[1] = swap;
+    }
+
+    switch (instr->op) {
+        case IR_CONST:
+            key->value = instr->value;
+            break;
+        case IR_ADDRESS:
+            key->ref = instr->array ? (const void *) instr->array : (const void *) instr->text;
+            break;
+        case IR_LOAD_GLOBAL:
+            key->ref = instr->text;
+            key->generation = n->globals;
+            break;
+        case IR_LOAD:
+            key->generation = *array_generation(n, instr->operands[0]);
+            break;
+        default:
+            break;
+    }
+}
+
+static size_t hash_key(const value_key_t *key, size_t capacity) {
+    uint64_t h = (uint64_t) key->op * 0x9E3779B97F4A7C15ull;
+    h ^= (uint64_t) (key->kind + 1) * 0xC2B2AE3D27D4EB4Full;
+    for (int o = 0; o < key->operand_count; o++) {
+        h = (h ^ (uint64_t) (uintptr_t) key->operands[o]) * 0x100000001B3ull;
+    }
+    h = (h ^ (uint32_t) key->value) * 0x100000001B3ull;
+    h = (h ^ (uint64_t) (uintptr_t) key->ref) * 0x100000001B3ull;
+    h = (h ^ key->generation) * 0x100000001B3ull;
+    return (size_t) (h ^ (h >> 29)) & (capacity - 1);
+}
+
+static int same_key(const value_key_t *a, const value_key_t *b) {
+    if (a->op != b->op || a->kind != b->kind || a->operand_count != b->operand_count ||
+        a->value != b->value || a->ref != b->ref || a->generation != b->generation) {
+        return 0;
+    }
+    for (int o = 0; o < a->operand_count; o++) {
+        if (a->operands[o] != b->operands[o]) return 0;
+    }
+    return 1;
+}
+
+// The key under which a load of the place store writes finds its value.
+static void forward_key(numbering_t *n, ir_instr_t *store, value_key_t *key) {
+    memset(key, 0, sizeof(*key));
+    key->op = store->op == IR_STORE ? IR_LOAD : IR_LOAD_GLOBAL;
+    key->kind = (int) store->operands[store->operand_count - 1]->type->kind;
+
+    if (store->op == IR_STORE_GLOBAL) {
+        key->ref = store->text;
+        key->generation = n->globals;
+    } else {
+        key->operand_count = 2;
+        key->operands[0] = store->operands[0];
+        key->operands[1] = store->operands[1];
+        key->generation = *array_generation(n, store->operands[0]);
+    }
+}
+
+static void entry_key(numbering_t *n, const value_entry_t *entry, value_key_t *key) {
+    if (is_store(entry->instr->op)) {
+        forward_key(n, entry->instr, key);
+    } else {
+        make_key(n, entry->instr, key);
+    }
+    key->generation = entry->generation;
+}
+
+// The value already recorded under key in this block, or NULL after
+// recording instr under it.
+static ir_instr_t *find_or_add(numbering_t *n, const value_key_t *key, ir_instr_t *instr) {
+    size_t slot = hash_key(key, n->capacity);
+
+    while (n->entries[slot].block == n->block) {
+        value_key_t recorded;
+        entry_key(n, &n->entries[slot], &recorded);
+        if (same_key(&recorded, key)) {
+            ir_instr_t *found = n->entries[slot].instr;
+            return is_store(found->op) ? found->operands[found->operand_count - 1] : found;
+        }
+        slot = (slot + 1) & (n->capacity - 1);
+    }
+
+    n->entries[slot].instr = instr;
+    n->entries[slot].generation = key->generation;
+    n->entries[slot].block = n->block;
+    return NULL;
+}
+
+// After a store, a load of the same place is the stored value.
+static void forward_store(numbering_t *n, ir_instr_t *store) {
+    value_key_t key;
+    forward_key(n, store, &key);
+    find_or_add(n, &key, store);
+}
+
+static void number_block(numbering_t *n, ir_block_t *b) {
+    n->block++;
+
+    ir_instr_t *instr = b->first;
+    while (instr) {
+        ir_instr_t *next = instr->next;
+
+        for (int o = 0; o < instr->operand_count; o++) {
+            instr->operands[o] = ir_resolve(instr->operands[o]);
+        }
+
+        switch (instr->op) {
+            case IR_STORE:
+                *array_generation(n, instr->operands[0]) = ++n->next_generation;
+                forward_store(n, instr);
+                break;
+            case IR_STORE_GLOBAL:
+                n->globals = ++n->next_generation;
+                forward_store(n, instr);
+                break;
+            case IR_CALL:
+                n->shared = ++n->next_generation;
+                n->globals = ++n->next_generation;
+                break;
+            default:
+                break;
+        }
+
+        if (is_numbered(instr->op) && instr->operand_count <= MAX_KEY_OPERANDS) {
+            value_key_t key;
+            make_key(n, instr, &key);
+
+            ir_instr_t *earlier = find_or_add(n, &key, instr);
+            if (earlier) {
+                instr->replacement = earlier;
+                ir_remove(instr);
+            }
+        }
+
+        instr = next;
+    }
+}
+
+void ir_number_values(ir_function_t *fn) {
+    numbering_t n;
+    memset(&n, 0, sizeof(n));
+
+    size_t largest = 0;
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        size_t count = 0;
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            i->replacement = NULL;
+            count++;
+
+            // Stores forward into the table too.
+            if (is_store(i->op)) {
+                count++;
+            }
+        }
+        if (count > largest) {
+            largest = count;
+        }
+    }
+
+    n.capacity = 16;
+    while (n.capacity < largest * 2) {
+        n.capacity *= 2;
+    }
+
+    n.entries = calloc(n.capacity, sizeof(value_entry_t));
+    n.arrays = calloc((size_t) fn->array_count + 1, sizeof(unsigned int));
+    if (!n.entries || !n.arrays) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    ir_mark_escaping_arrays(fn);
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        number_block(&n, b);
+    }
+
+    // Phi operands on back edges can name values removed later on.
+    ir_resolve_operands(fn);
+
+    free(n.entries);
+    free(n.arrays);
+}
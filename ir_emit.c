@@ -0,0 +1,851 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "codegen.h"
+#include "ir.h"
+#include "work_stack.h"
+
+// Every value that is not a constant, a parameter or an address lives in
+// a C local _vN, declared at the top of the body, and every local array
+// in an _aN. Values that are never live at the same time share a local:
+// liveness is found per value by walking back from its uses (SSA values
+// are live from their definition to their uses, and a phi operand is used
+// at the end of the matching predecessor), and the values are then given
+// locals greedily in reverse postorder, which needs no more locals than
+// there are values live at once. Only values of the same type share.
+//
+// Blocks are emitted in layout order, with a label LN only where a goto
+// lands. Phis are resolved by copies at the end of each incoming edge; a
+// phi that another phi of its block reads on the same edge is saved to _pN
+// first, so the copies act as if done all at once. For the same reason a
+// phi never shares a local with what its siblings copy from.
+typedef struct {
+    ir_function_t *fn;
+    FILE *output;
+    int *uses;                      // by value id
+    char *labelled;                 // by block id
+    char *saved;                    // by value id: a phi read by a sibling phi
+    int *read_on;                   // by value id: last edge it was read on
+    int edge;
+
+    int *variable;                  // by value id: its local, or -1
+    struct type **variable_types;   // by local
+    int variable_count;
+} emitter_t;
+
+static void *emit_alloc(size_t count, size_t size) {
+    void *memory = calloc(count ? count : 1, size);
+    if (!memory) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return memory;
+}
+
+static int is_inlined(ir_instr_t *v) {
+    return v->op == IR_CONST || v->op == IR_STRING || v->op == IR_PARAM || v->op == IR_ADDRESS;
+}
+
+static int has_phis(ir_block_t *block) {
+    return block->first && block->first->op == IR_PHI;
+}
+
+static void emit_value(emitter_t *em, ir_instr_t *v) {
+    FILE *output = em->output;
+
+    switch (v->op) {
+        case IR_CONST:
+            if (v->type->kind == TYPE_CHARACTER && v->value >= ' ' && v->value <= '~' &&
+                v->value != '\'' && v->value != '\\') {
+                fprintf(output, "'%c'", v->value);
+            } else if (v->value == INT_MIN) {
+                fprintf(output, "(-%d - 1)", INT_MAX);
+            } else if (v->value < 0) {
+                fprintf(output, "(%d)", v->value);
+            } else {
+                fprintf(output, "%d", v->value);
+            }
+            break;
+        case IR_STRING:
+            fprintf(output, "\"");
+            process_string_for_c(v->text, output);
+            fprintf(output, "\"");
+            break;
+        case IR_PARAM:
+            fprintf(output, "%s", c_name(v->text));
+            break;
+        case IR_ADDRESS:
+            if (v->array) {
+                fprintf(output, "_a%d", v->array->id);
+            } else {
+                fprintf(output, "%s", c_name(v->text));
+            }
+            break;
+        default:
+            fprintf(output, "_v%d", em->variable[v->id]);
+            break;
+    }
+}
+
+static void emit_declaration(emitter_t *em, struct type *type, char prefix, int id) {
+    fprintf(em->output, "\t");
+    generate_type_c(type, em->output);
+    fprintf(em->output, "%s _%c%d;\n", type->kind == TYPE_ARRAY ? "*" : "", prefix, id);
+}
+
+// Local arrays whose stores were all dead are not declared.
+static void emit_declarations(emitter_t *em) {
+    ir_function_t *fn = em->fn;
+
+    char *addressed = emit_alloc((size_t) fn->array_count, 1);
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            if (i->op == IR_ADDRESS && i->array) {
+                addressed[i->array->id] = 1;
+            }
+        }
+    }
+
+    for (int a = 0; a < fn->array_count; a++) {
+        ir_array_t *array = fn->arrays[a];
+        if (!addressed[array->id]) continue;
+
+        fprintf(em->output, "\t");
+        generate_type_c(array->element, em->output);
+        fprintf(em->output, " _a%d[%d];\n", array->id, array->size);
+    }
+    free(addressed);
+
+    for (int v = 0; v < em->variable_count; v++) {
+        emit_declaration(em, em->variable_types[v], 'v', v);
+    }
+
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i && i->op == IR_PHI; i = i->next) {
+            if (em->saved[i->id]) {
+                emit_declaration(em, i->type, 'p', i->id);
+            }
+        }
+    }
+}
+
+// Counts uses, and finds the phis whose copies may need saving.
+static void plan_values(emitter_t *em) {
+    for (ir_block_t *b = em->fn->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            for (int o = 0; o < i->operand_count; o++) {
+                ir_instr_t *operand = i->operands[o];
+                em->uses[operand->id]++;
+
+                if (i->op == IR_PHI && operand != i && operand->op == IR_PHI && operand->block == b) {
+                    em->saved[operand->id] = 1;
+                }
+            }
+        }
+    }
+}
+
+static int needs_variable(emitter_t *em, ir_instr_t *v) {
+    return v->type && v->type->kind != TYPE_VOID && !is_inlined(v) && em->uses[v->id];
+}
+
+// Scalar and string locals are shared; anything else gets its own.
+static int is_shared_type(struct type *type) {
+    return type->kind != TYPE_ARRAY;
+}
+
+// A use of value in block: at the end of it for a phi operand, otherwise
+// inside it.
+typedef struct {
+    ir_instr_t *value;
+    ir_block_t *block;
+    int at_end;
+} use_t;
+
+static int compare_uses(const void *a, const void *b) {
+    return ((const use_t *) a)->value->id - ((const use_t *) b)->value->id;
+}
+
+static int compare_order(const void *a, const void *b) {
+    return (*(ir_block_t * const *) a)->order - (*(ir_block_t * const *) b)->order;
+}
+
+// The live-in and live-out sets of every block are lists in one pool, as
+// most blocks have only a few live values.
+typedef struct {
+    ir_instr_t *value;
+    int next;                       // next item of the same list, or -1
+} live_item_t;
+
+typedef struct {
+    work_stack_t items;             // live_item_t
+    int *live_in;                   // by block id: first item, or -1
+    int *live_out;
+    int *in_stamp;                  // by block id: last value marked, plus one
+    int *out_stamp;
+} liveness_t;
+
+static void add_live(liveness_t *l, int *list, ir_instr_t *value) {
+    live_item_t *item = work_stack_push(&l->items);
+    item->value = value;
+    item->next = *list;
+    *list = (int) l->items.count - 1;
+}
+
+static void mark_live_out(liveness_t *l, ir_block_t *b, ir_instr_t *value) {
+    if (l->out_stamp[b->id] == value->id + 1) return;
+    l->out_stamp[b->id] = value->id + 1;
+    add_live(l, &l->live_out[b->id], value);
+}
+
+// The value is live into block, and so out of its predecessors, up to its
+// definition.
+static void mark_live_in(liveness_t *l, ir_block_t *block, ir_instr_t *value, work_stack_t *pending) {
+    *(ir_block_t **) work_stack_push(pending) = block;
+
+    ir_block_t *b;
+    while (work_stack_pop(pending, &b)) {
+        if (b == value->block || l->in_stamp[b->id] == value->id + 1) continue;
+        l->in_stamp[b->id] = value->id + 1;
+        add_live(l, &l->live_in[b->id], value);
+
+        for (int p = 0; p < b->pred_count; p++) {
+            mark_live_out(l, b->preds[p], value);
+            if (b->preds[p] != value->block) {
+                *(ir_block_t **) work_stack_push(pending) = b->preds[p];
+            }
+        }
+    }
+}
+
+// Uses are taken value by value, so each block is marked once per value.
+static void compute_liveness(emitter_t *em, liveness_t *l) {
+    ir_function_t *fn = em->fn;
+    work_stack_t uses;
+    work_stack_init(&uses, sizeof(use_t));
+
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            for (int o = 0; o < i->operand_count; o++) {
+                if (!needs_variable(em, i->operands[o])) continue;
+
+                use_t *use = work_stack_push(&uses);
+                use->value = i->operands[o];
+                use->block = i->op == IR_PHI ? b->preds[o] : b;
+                use->at_end = i->op == IR_PHI;
+            }
+        }
+    }
+    if (uses.count > 1) {
+        qsort(uses.items, uses.count, sizeof(use_t), compare_uses);
+    }
+
+    work_stack_t pending;
+    work_stack_init(&pending, sizeof(ir_block_t *));
+    for (size_t u = 0; u < uses.count; u++) {
+        use_t *use = (use_t *) uses.items + u;
+        if (use->at_end) {
+            mark_live_out(l, use->block, use->value);
+        }
+        if (!use->at_end || use->block != use->value->block) {
+            mark_live_in(l, use->block, use->value, &pending);
+        }
+    }
+
+    work_stack_free(&pending);
+    work_stack_free(&uses);
+}
+
+typedef struct {
+    int *busy;                      // by local: stamp of the block it is taken in
+    int *forbidden;                 // by local: stamp of the value it may not go to
+    int stamp;
+    int forbid_stamp;
+    work_stack_t free[TYPE_FUNCTION + 1];   // int, free locals by type kind
+    work_stack_t phi_users;         // ir_instr_t *, the phis that read each value
+    int *first_phi_user;            // by value id: index in phi_users, or -1
+    int *phi_user_count;
+    work_stack_t set_aside;
+    int capacity;
+} allocator_t;
+
+static int new_variable(emitter_t *em, allocator_t *a, struct type *type) {
+    if (em->variable_count == a->capacity) {
+        a->capacity = a->capacity ? a->capacity * 2 : 16;
+        em->variable_types = realloc(em->variable_types, sizeof(struct type *) * (size_t) a->capacity);
+        a->busy = realloc(a->busy, sizeof(int) * (size_t) a->capacity);
+        a->forbidden = realloc(a->forbidden, sizeof(int) * (size_t) a->capacity);
+        if (!em->variable_types || !a->busy || !a->forbidden) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    em->variable_types[em->variable_count] = type;
+    a->busy[em->variable_count] = 0;
+    a->forbidden[em->variable_count] = 0;
+    return em->variable_count++;
+}
+
+static void forbid(emitter_t *em, allocator_t *a, ir_instr_t *v) {
+    if (!is_inlined(v) && em->variable[v->id] >= 0) {
+        a->forbidden[em->variable[v->id]] = a->forbid_stamp;
+    }
+}
+
+// The locals the value may not take: a phi's siblings write theirs while
+// the edge copies still read the sources of the others.
+static void forbid_for(emitter_t *em, allocator_t *a, ir_instr_t *value) {
+    a->forbid_stamp++;
+
+    if (value->op == IR_PHI) {
+        for (ir_instr_t *sibling = value->block->first; sibling && sibling->op == IR_PHI; sibling = sibling->next) {
+            if (sibling == value) continue;
+            for (int o = 0; o < sibling->operand_count; o++) {
+                if (sibling->operands[o] != value) forbid(em, a, sibling->operands[o]);
+            }
+        }
+    }
+
+    int first = a->first_phi_user[value->id];
+    for (int u = 0; first >= 0 && u < a->phi_user_count[value->id]; u++) {
+        ir_instr_t *user = ((ir_instr_t **) a->phi_users.items)[first + u];
+        for (ir_instr_t *sibling = user->block->first; sibling && sibling->op == IR_PHI; sibling = sibling->next) {
+            if (sibling != user && sibling != value) forbid(em, a, sibling);
+        }
+    }
+}
+
+static void assign_variable(emitter_t *em, allocator_t *a, ir_instr_t *value) {
+    int variable = -1;
+
+    if (is_shared_type(value->type)) {
+        forbid_for(em, a, value);
+
+        work_stack_t *pool = &a->free[value->type->kind];
+        int candidate;
+        while (variable < 0 && work_stack_pop(pool, &candidate)) {
+            if (a->busy[candidate] == a->stamp) continue;
+            if (a->forbidden[candidate] == a->forbid_stamp) {
+                *(int *) work_stack_push(&a->set_aside) = candidate;
+            } else {
+                variable = candidate;
+            }
+        }
+        while (work_stack_pop(&a->set_aside, &candidate)) {
+            *(int *) work_stack_push(pool) = candidate;
+        }
+    }
+
+    if (variable < 0) {
+        variable = new_variable(em, a, value->type);
+    }
+    em->variable[value->id] = variable;
+    a->busy[variable] = a->stamp;
+}
+
+static void release_variable(emitter_t *em, allocator_t *a, ir_instr_t *value) {
+    int variable = em->variable[value->id];
+    if (a->busy[variable] != a->stamp) return;
+
+    a->busy[variable] = 0;
+    if (is_shared_type(value->type)) {
+        *(int *) work_stack_push(&a->free[value->type->kind]) = variable;
+    }
+}
+
+typedef struct {
+    ir_instr_t *value;
+    ir_instr_t *phi;
+} phi_use_t;
+
+static int compare_phi_uses(const void *a, const void *b) {
+    return ((const phi_use_t *) a)->value->id - ((const phi_use_t *) b)->value->id;
+}
+
+static void index_phi_users(emitter_t *em, allocator_t *a) {
+    ir_function_t *fn = em->fn;
+    work_stack_t pairs;
+    work_stack_init(&pairs, sizeof(phi_use_t));
+
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        for (ir_instr_t *phi = b->first; phi && phi->op == IR_PHI; phi = phi->next) {
+            for (int o = 0; o < phi->operand_count; o++) {
+                if (!needs_variable(em, phi->operands[o])) continue;
+                phi_use_t *pair = work_stack_push(&pairs);
+                pair->value = phi->operands[o];
+                pair->phi = phi;
+            }
+        }
+    }
+    if (pairs.count > 1) {
+        qsort(pairs.items, pairs.count, sizeof(phi_use_t), compare_phi_uses);
+    }
+
+    for (size_t p = 0; p < pairs.count; p++) {
+        phi_use_t *pair = (phi_use_t *) pairs.items + p;
+        if (a->first_phi_user[pair->value->id] < 0) {
+            a->first_phi_user[pair->value->id] = (int) a->phi_users.count;
+        }
+        a->phi_user_count[pair->value->id]++;
+        *(ir_instr_t **) work_stack_push(&a->phi_users) = pair->phi;
+    }
+
+    work_stack_free(&pairs);
+}
+
+static void plan_variables(emitter_t *em) {
+    ir_function_t *fn = em->fn;
+    size_t values = (size_t) fn->next_value;
+    size_t blocks = (size_t) fn->next_block;
+
+    em->variable = emit_alloc(values, sizeof(int));
+    for (size_t v = 0; v < values; v++) {
+        em->variable[v] = -1;
+    }
+
+    liveness_t l;
+    work_stack_init(&l.items, sizeof(live_item_t));
+    l.live_in = emit_alloc(blocks, sizeof(int));
+    l.live_out = emit_alloc(blocks, sizeof(int));
+    l.in_stamp = emit_alloc(blocks, sizeof(int));
+    l.out_stamp = emit_alloc(blocks, sizeof(int));
+    for (size_t b = 0; b < blocks; b++) {
+        l.live_in[b] = -1;
+        l.live_out[b] = -1;
+    }
+    compute_liveness(em, &l);
+
+    allocator_t a;
+    memset(&a, 0, sizeof(a));
+    for (int k = 0; k <= TYPE_FUNCTION; k++) {
+        work_stack_init(&a.free[k], sizeof(int));
+    }
+    work_stack_init(&a.phi_users, sizeof(ir_instr_t *));
+    work_stack_init(&a.set_aside, sizeof(int));
+    a.first_phi_user = emit_alloc(values, sizeof(int));
+    a.phi_user_count = emit_alloc(values, sizeof(int));
+    for (size_t v = 0; v < values; v++) {
+        a.first_phi_user[v] = -1;
+    }
+    index_phi_users(em, &a);
+
+    // A definition comes before its uses in reverse postorder, so whatever
+    // is live into a block already has its local.
+    ir_compute_dominators(fn);
+    size_t count = 0;
+    ir_block_t **order = emit_alloc(blocks, sizeof(ir_block_t *));
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        order[count++] = b;
+    }
+    qsort(order, count, sizeof(ir_block_t *), compare_order);
+
+    // Last use of each value in the block being walked, if it dies there.
+    ir_instr_t **last_user = emit_alloc(values, sizeof(ir_instr_t *));
+    int *last_stamp = emit_alloc(values, sizeof(int));
+    int *live_out_stamp = emit_alloc(values, sizeof(int));
+
+    for (size_t n = 0; n < count; n++) {
+        ir_block_t *b = order[n];
+        a.stamp++;
+
+        live_item_t *items = (live_item_t *) l.items.items;
+        for (int item = l.live_in[b->id]; item >= 0; item = items[item].next) {
+            a.busy[em->variable[items[item].value->id]] = a.stamp;
+        }
+        for (int item = l.live_out[b->id]; item >= 0; item = items[item].next) {
+            live_out_stamp[items[item].value->id] = a.stamp;
+        }
+        for (ir_instr_t *i = b->last; i && i->op != IR_PHI; i = i->prev) {
+            for (int o = 0; o < i->operand_count; o++) {
+                ir_instr_t *value = i->operands[o];
+                if (last_stamp[value->id] != a.stamp && live_out_stamp[value->id] != a.stamp) {
+                    last_stamp[value->id] = a.stamp;
+                    last_user[value->id] = i;
+                }
+            }
+        }
+
+        for (int k = 0; k <= TYPE_FUNCTION; k++) {
+            a.free[k].count = 0;
+        }
+        for (int v = 0; v < em->variable_count; v++) {
+            if (a.busy[v] != a.stamp && is_shared_type(em->variable_types[v])) {
+                *(int *) work_stack_push(&a.free[em->variable_types[v]->kind]) = v;
+            }
+        }
+
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            if (i->op != IR_PHI) {
+                for (int o = 0; o < i->operand_count; o++) {
+                    ir_instr_t *value = i->operands[o];
+                    if (needs_variable(em, value) && last_stamp[value->id] == a.stamp && last_user[value->id] == i) {
+                        release_variable(em, &a, value);
+                    }
+                }
+            }
+            if (needs_variable(em, i)) {
+                assign_variable(em, &a, i);
+            }
+        }
+    }
+
+    free(order);
+    free(last_user);
+    free(last_stamp);
+    free(live_out_stamp);
+    work_stack_free(&l.items);
+    free(l.live_in);
+    free(l.live_out);
+    free(l.in_stamp);
+    free(l.out_stamp);
+    for (int k = 0; k <= TYPE_FUNCTION; k++) {
+        work_stack_free(&a.free[k]);
+    }
+    work_stack_free(&a.phi_users);
+    work_stack_free(&a.set_aside);
+    free(a.first_phi_user);
+    free(a.phi_user_count);
+    free(a.busy);
+    free(a.forbidden);
+}
+
+// Which target of b's branch is reached by falling into the next block:
+// 0, 1, or -1 for neither. The first target only falls through when its
+// edge needs no copies, since those have to go under the condition.
+static int branch_fallthrough(ir_block_t *b) {
+    ir_instr_t *branch = b->last;
+
+    if (branch->targets[0] == b->next && !has_phis(b->next)) return 0;
+    if (branch->targets[1] == b->next) return 1;
+    return -1;
+}
+
+static void plan_labels(emitter_t *em) {
+    for (ir_block_t *b = em->fn->entry; b; b = b->next) {
+        ir_instr_t *last = b->last;
+
+        if (last->op == IR_JUMP) {
+            if (last->targets[0] != b->next) {
+                em->labelled[last->targets[0]->id] = 1;
+            }
+        } else if (last->op == IR_BRANCH) {
+            int fallthrough = branch_fallthrough(b);
+            for (int t = 0; t < 2; t++) {
+                if (t != fallthrough) {
+                    em->labelled[last->targets[t]->id] = 1;
+                }
+            }
+        }
+    }
+}
+
+static int is_sibling_phi(ir_instr_t *v, ir_block_t *block) {
+    return v->op == IR_PHI && v->block == block;
+}
+
+static void emit_copies(emitter_t *em, ir_block_t *from, ir_block_t *to, const char *indent) {
+    int p = ir_pred_index(to, from);
+    int edge = ++em->edge;
+
+    for (ir_instr_t *phi = to->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        ir_instr_t *source = phi->operands[p];
+        if (source != phi && is_sibling_phi(source, to)) {
+            em->read_on[source->id] = edge;
+        }
+    }
+    for (ir_instr_t *phi = to->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        if (em->read_on[phi->id] == edge) {
+            fprintf(em->output, "%s_p%d = _v%d;\n", indent, phi->id, em->variable[phi->id]);
+        }
+    }
+
+    for (ir_instr_t *phi = to->first; phi && phi->op == IR_PHI; phi = phi->next) {
+        ir_instr_t *source = phi->operands[p];
+        if (source == phi || (!is_inlined(source) && em->variable[source->id] == em->variable[phi->id])) continue;
+
+        fprintf(em->output, "%s_v%d = ", indent, em->variable[phi->id]);
+        if (is_sibling_phi(source, to)) {
+            fprintf(em->output, "_p%d", source->id);
+        } else {
+            emit_value(em, source);
+        }
+        fprintf(em->output, ";\n");
+    }
+}
+
+static void emit_edge(emitter_t *em, ir_block_t *from, ir_block_t *to, int falls_through) {
+    emit_copies(em, from, to, "\t");
+    if (!falls_through) {
+        fprintf(em->output, "\tgoto L%d;\n", to->id);
+    }
+}
+
+static void emit_terminator(emitter_t *em, ir_block_t *b) {
+    ir_instr_t *last = b->last;
+    FILE *output = em->output;
+
+    switch (last->op) {
+        case IR_RETURN:
+            fprintf(output, "\treturn");
+            if (last->operand_count) {
+                fprintf(output, " ");
+                emit_value(em, last->operands[0]);
+            }
+            fprintf(output, ";\n");
+            break;
+
+        case IR_JUMP:
+            emit_edge(em, b, last->targets[0], last->targets[0] == b->next);
+            break;
+
+        case IR_BRANCH: {
+            // The condition guards the target that does not fall through.
+            int fallthrough = branch_fallthrough(b);
+            int guarded = fallthrough == 0 ? 1 : 0;
+            ir_block_t *target = last->targets[guarded];
+
+            fprintf(output, "\tif (%s", guarded ? "!" : "");
+            emit_value(em, last->operands[0]);
+            if (has_phis(target)) {
+                fprintf(output, ") {\n");
+                emit_copies(em, b, target, "\t\t");
+                fprintf(output, "\t\tgoto L%d;\n\t}\n", target->id);
+            } else {
+                fprintf(output, ") goto L%d;\n", target->id);
+            }
+
+            emit_edge(em, b, last->targets[!guarded], fallthrough == !guarded);
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+static const char *binary_operator(ir_opcode_t op) {
+    switch (op) {
+        case IR_ADD: return " + ";
+        case IR_SUB: return " - ";
+        case IR_MUL: return " * ";
+        case IR_DIV: return " / ";
+        case IR_MOD: return " % ";
+        case IR_LT: return " < ";
+        case IR_LE: return " <= ";
+        case IR_GT: return " > ";
+        case IR_GE: return " >= ";
+        case IR_EQ: return " == ";
+        case IR_NE: return " != ";
+        default: return NULL;
+    }
+}
+
+// Operands are always constants or variables, so a small constant power
+// can repeat its base.
+static power_form_t power_form(ir_instr_t *i) {
+    ir_instr_t *base = i->operands[0];
+    ir_instr_t *exponent = i->operands[1];
+
+    return choose_power_form(1, base->op == IR_CONST && base->value == 2,
+                             exponent->op == IR_CONST, exponent->value);
+}
+
+static void emit_power(emitter_t *em, ir_instr_t *i) {
+    power_form_t form = power_form(i);
+
+    if (form == POWER_PRODUCT) {
+        fprintf(em->output, "(int) (");
+        for (int n = 0; n < i->operands[1]->value; n++) {
+            fprintf(em->output, "%s(unsigned int) ", n ? " * " : "");
+            emit_value(em, i->operands[0]);
+        }
+        fprintf(em->output, ")");
+        return;
+    }
+
+    fprintf(em->output, "%s(", power_helper_name(form));
+    if (form == POWER_CALL) {
+        emit_value(em, i->operands[0]);
+        fprintf(em->output, ", ");
+    }
+    emit_value(em, i->operands[1]);
+    fprintf(em->output, ")");
+}
+
+// The same formats as the AST code generator: string constants without a
+// % go straight into the format, booleans print as true or false.
+static void emit_print(emitter_t *em, ir_instr_t *i) {
+    FILE *output = em->output;
+
+    fprintf(output, "\tprintf(\"");
+    for (int o = 0; o < i->operand_count; o++) {
+        ir_instr_t *v = i->operands[o];
+
+        if (v->op == IR_STRING && !strchr(v->text, '%')) {
+            process_string_for_c(v->text, output);
+            continue;
+        }
+        switch (v->type->kind) {
+            case TYPE_STRING:
+            case TYPE_BOOLEAN:
+                fprintf(output, "%%s");
+                break;
+            case TYPE_CHARACTER:
+                fprintf(output, "%%c");
+                break;
+            default:
+                fprintf(output, "%%d");
+                break;
+        }
+    }
+    fprintf(output, "\"");
+
+    for (int o = 0; o < i->operand_count; o++) {
+        ir_instr_t *v = i->operands[o];
+        if (v->op == IR_STRING && !strchr(v->text, '%')) continue;
+
+        fprintf(output, ", ");
+        emit_value(em, v);
+        if (v->type->kind == TYPE_BOOLEAN) {
+            fprintf(output, " ? \"true\" : \"false\"");
+        }
+    }
+    fprintf(output, ");\n");
+}
+
+static int is_zero_divisor(ir_instr_t *i) {
+    return (i->op == IR_DIV || i->op == IR_MOD) && i->operands[1]->op == IR_CONST && i->operands[1]->value == 0;
+}
+
+static void emit_instr(emitter_t *em, ir_instr_t *i) {
+    FILE *output = em->output;
+    const char *operator = binary_operator(i->op);
+
+    if (is_zero_divisor(i)) {
+        fprintf(output, "\t_v%d = %s(", em->variable[i->id], ZERO_DIVISION_HELPER);
+        emit_value(em, i->operands[0]);
+        fprintf(output, ", %d);\n", i->op == IR_MOD);
+        return;
+    }
+    if (operator) {
+        fprintf(output, "\t_v%d = ", em->variable[i->id]);
+        emit_value(em, i->operands[0]);
+        fprintf(output, "%s", operator);
+        emit_value(em, i->operands[1]);
+        fprintf(output, ";\n");
+        return;
+    }
+
+    switch (i->op) {
+        case IR_NEG:
+        case IR_NOT:
+            fprintf(output, "\t_v%d = %s", em->variable[i->id], i->op == IR_NEG ? "-" : "!");
+            emit_value(em, i->operands[0]);
+            fprintf(output, ";\n");
+            break;
+
+        case IR_POW:
+            fprintf(output, "\t_v%d = ", em->variable[i->id]);
+            emit_power(em, i);
+            fprintf(output, ";\n");
+            break;
+
+        case IR_LOAD_GLOBAL:
+            fprintf(output, "\t_v%d = %s;\n", em->variable[i->id], c_name(i->text));
+            break;
+
+        case IR_STORE_GLOBAL:
+            fprintf(output, "\t%s = ", c_name(i->text));
+            emit_value(em, i->operands[0]);
+            fprintf(output, ";\n");
+            break;
+
+        case IR_LOAD:
+            fprintf(output, "\t_v%d = ", em->variable[i->id]);
+            emit_value(em, i->operands[0]);
+            fprintf(output, "[");
+            emit_value(em, i->operands[1]);
+            fprintf(output, "];\n");
+            break;
+
+        case IR_STORE:
+            fprintf(output, "\t");
+            emit_value(em, i->operands[0]);
+            fprintf(output, "[");
+            emit_value(em, i->operands[1]);
+            fprintf(output, "] = ");
+            emit_value(em, i->operands[2]);
+            fprintf(output, ";\n");
+            break;
+
+        case IR_CALL:
+            fprintf(output, "\t");
+            if (em->uses[i->id]) {
+                fprintf(output, "_v%d = ", em->variable[i->id]);
+            }
+            fprintf(output, "%s(", c_name(i->text));
+            for (int o = 0; o < i->operand_count; o++) {
+                if (o) fprintf(output, ", ");
+                emit_value(em, i->operands[o]);
+            }
+            fprintf(output, ");\n");
+            break;
+
+        case IR_PRINT:
+            emit_print(em, i);
+            break;
+
+        default:
+            // Constants, strings, parameters and addresses are written
+            // where they are used, phis on the edges into their block, and
+            // terminators by emit_terminator.
+            break;
+    }
+}
+
+void ir_emit_c(ir_function_t *fn, FILE *output) {
+    emitter_t em;
+    em.fn = fn;
+    em.output = output;
+    em.uses = emit_alloc((size_t) fn->next_value, sizeof(int));
+    em.labelled = emit_alloc((size_t) fn->next_block, sizeof(char));
+    em.saved = emit_alloc((size_t) fn->next_value, sizeof(char));
+    em.read_on = emit_alloc((size_t) fn->next_value, sizeof(int));
+    em.edge = 0;
+
+    em.variable_types = NULL;
+    em.variable_count = 0;
+
+    plan_values(&em);
+    plan_variables(&em);
+    plan_labels(&em);
+    emit_declarations(&em);
+
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        if (em.labelled[b->id]) {
+            fprintf(output, "L%d:\n", b->id);
+        }
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            emit_instr(&em, i);
+        }
+        emit_terminator(&em, b);
+    }
+
+    free(em.uses);
+    free(em.labelled);
+    free(em.saved);
+    free(em.read_on);
+    free(em.variable);
+    free(em.variable_types);
+}
+
+void ir_note_runtime_needs(ir_function_t *fn, runtime_needs_t *needs) {
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            if (i->op == IR_POW) {
+                note_power_form(needs, power_form(i));
+            }
+            needs->zero_divisor |= is_zero_divisor(i);
+        }
+    }
+}
@@ -0,0 +1,187 @@
+#include "fold.h"
+#include "ir.h"
+#include "work_stack.h"
+
+// Constant folding on the IR, for what lowering, inlining and the AST
+// passes leave behind: an operation on constants becomes a constant in
+// place, a branch on a constant becomes a jump, and a phi that merges one
+// constant value from every side becomes that constant. Arithmetic goes
+// through the same evaluator as fold.c, so it wraps the same way and
+// leaves division by zero and INT_MIN / -1 to run time. Folding a branch
+// can make blocks unreachable and phis trivial, which ir_cleanup removes
+// before the next round.
+
+static expr_kind_t arithmetic_kind(ir_opcode_t op) {
+    switch (op) {
+        case IR_ADD: return EXPR_ADD;
+        case IR_SUB: return EXPR_SUB;
+        case IR_MUL: return EXPR_MUL;
+        case IR_DIV: return EXPR_DIV;
+        case IR_MOD: return EXPR_MOD;
+        case IR_POW: return EXPR_POWER;
+        default: return EXPR_NAME;
+    }
+}
+
+static int compare(ir_opcode_t op, int a, int b, int *value) {
+    switch (op) {
+        case IR_LT: *value = a < b; return 1;
+        case IR_LE: *value = a <= b; return 1;
+        case IR_GT: *value = a > b; return 1;
+        case IR_GE: *value = a >= b; return 1;
+        case IR_EQ: *value = a == b; return 1;
+        case IR_NE: *value = a != b; return 1;
+        default: return 0;
+    }
+}
+
+static void make_constant(ir_instr_t *i, int value) {
+    i->op = IR_CONST;
+    i->value = value;
+    i->operand_count = 0;
+}
+
+static int is_constant(ir_instr_t *v) {
+    return v->op == IR_CONST;
+}
+
+static int is_operation(ir_opcode_t op) {
+    return op == IR_NEG || op == IR_NOT || arithmetic_kind(op) != EXPR_NAME ||
+           (op >= IR_LT && op <= IR_NE);
+}
+
+// The value of an operation whose operands are constants. Returns 0 when
+// it is not one, or is left for run time.
+static int evaluate(ir_instr_t *i, int *value) {
+    for (int o = 0; o < i->operand_count; o++) {
+        if (!is_constant(i->operands[o])) return 0;
+    }
+
+    switch (i->op) {
+        case IR_NEG:
+            *value = (int) (0u - (unsigned int) i->operands[0]->value);
+            return 1;
+        case IR_NOT:
+            *value = !i->operands[0]->value;
+            return 1;
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+        case IR_MOD:
+        case IR_POW:
+            return evaluate_integer_operator(arithmetic_kind(i->op), i->operands[0]->value,
+                                             i->operands[1]->value, value);
+        default:
+            return compare(i->op, i->operands[0]->value, i->operands[1]->value, value);
+    }
+}
+
+static int fold_phi(ir_instr_t *phi, ir_instr_t *first_non_phi) {
+    ir_instr_t *constant = NULL;
+    for (int o = 0; o < phi->operand_count; o++) {
+        ir_instr_t *operand = phi->operands[o];
+        if (operand == phi) continue;
+        if (!is_constant(operand) || (constant && operand->value != constant->value)) return 0;
+        constant = operand;
+    }
+    if (!constant) return 0;
+
+    // Constants go with the other instructions, after the phis.
+    ir_remove(phi);
+    make_constant(phi, constant->value);
+    ir_insert_before(first_non_phi, phi);
+    return 1;
+}
+
+// Drops the edge from -> to. A block left without predecessors drops its
+// own edges in turn, so the phis after it see only live edges in this
+// round instead of after the next cleanup.
+static void drop_edge(ir_function_t *fn, ir_block_t *from, ir_block_t *to) {
+    work_stack_t dead;
+    work_stack_init(&dead, sizeof(ir_block_t *[2]));
+    ir_block_t **edge = work_stack_push(&dead);
+    edge[0] = from;
+    edge[1] = to;
+
+    ir_block_t *item[2];
+    while (work_stack_pop(&dead, item)) {
+        ir_block_t *source = item[0];
+        ir_block_t *target = item[1];
+
+        int index = -1;
+        for (int p = 0; p < target->pred_count; p++) {
+            if (target->preds[p] == source) index = p;
+        }
+        if (index < 0) continue;
+        ir_remove_pred(target, index);
+
+        if (target->pred_count == 0 && target != fn->entry) {
+            ir_block_t *successors[2];
+            int n = ir_successors(target, successors);
+            for (int s = 0; s < n; s++) {
+                edge = work_stack_push(&dead);
+                edge[0] = target;
+                edge[1] = successors[s];
+            }
+        }
+    }
+
+    work_stack_free(&dead);
+}
+
+static void fold_branch(ir_function_t *fn, ir_block_t *b) {
+    ir_instr_t *branch = b->last;
+    ir_block_t *taken = branch->targets[branch->operands[0]->value ? 0 : 1];
+    ir_block_t *dropped = branch->targets[branch->operands[0]->value ? 1 : 0];
+
+    branch->op = IR_JUMP;
+    branch->operand_count = 0;
+    branch->targets[0] = taken;
+    branch->targets[1] = NULL;
+    drop_edge(fn, b, dropped);
+}
+
+static int fold_once(ir_function_t *fn) {
+    int folded_branch = 0;
+    int changed = 1;
+
+    while (changed) {
+        changed = 0;
+
+        for (ir_block_t *b = fn->entry; b; b = b->next) {
+            ir_instr_t *first_non_phi = b->first;
+            while (first_non_phi->op == IR_PHI) {
+                first_non_phi = first_non_phi->next;
+            }
+
+            ir_instr_t *i = b->first;
+            while (i) {
+                ir_instr_t *next = i->next;
+                int value;
+
+                if (i->op == IR_PHI) {
+                    changed |= fold_phi(i, first_non_phi);
+                } else if (i->op == IR_BRANCH) {
+                    if (is_constant(i->operands[0])) {
+                        fold_branch(fn, b);
+                        folded_branch = 1;
+                        changed = 1;
+                    }
+                } else if (is_operation(i->op) && evaluate(i, &value)) {
+                    make_constant(i, value);
+                    changed = 1;
+                }
+                i = next;
+            }
+        }
+    }
+
+    return folded_branch;
+}
+
+void ir_fold_constants(ir_function_t *fn) {
+    while (fold_once(fn)) {
+        ir_cleanup(fn);
+    }
+}
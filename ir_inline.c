@@ -0,0 +1,446 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+#include "work_stack.h"
+
+// Inlining across the lowered functions of a program. The call graph is
+// read from the IR_CALL instructions as lowered, before any inlining, and
+// split into strongly connected components (Tarjan's algorithm, with an
+// explicit stack); a function in a cycle, or calling itself, is recursive
+// and is never inlined. Tarjan's algorithm finishes a component only after
+// every component it calls, which is the order callers need: each callee
+// is inlined in its final, optimized form.
+//
+// Inlining a call splits its block in two: the code before the call jumps
+// to a copy of the callee's blocks, whose returns jump to the rest of the
+// block, where a phi collects the returned values.
+
+// Calls stop being inlined into a function once they have added this many
+// instructions to it.
+#define MAX_INLINE_GROWTH (1 << 16)
+
+typedef struct {
+    const char *name;
+    size_t index;
+} callee_entry_t;
+
+typedef struct {
+    size_t from;
+    size_t to;
+} call_edge_t;
+
+struct ir_call_graph {
+    ir_function_t **functions;
+    size_t count;
+
+    callee_entry_t *callees;        // the lowered functions, sorted by interned name
+    size_t callee_count;
+
+    size_t *edge_start;             // calls of function i: edges[edge_start[i] .. edge_start[i + 1])
+    size_t *edges;
+    int *recursive;
+    int *sizes;                     // by function, once it is final; -1 before
+    size_t *order;                  // callees before their callers
+    size_t order_count;
+};
+
+typedef struct {
+    size_t node;
+    size_t edge;
+} tarjan_frame_t;
+
+static void *allocate(size_t count, size_t size) {
+    void *memory = calloc(count ? count : 1, size);
+    if (!memory) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return memory;
+}
+
+static int compare_callees(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t) ((const callee_entry_t *) a)->name;
+    uintptr_t y = (uintptr_t) ((const callee_entry_t *) b)->name;
+    return (x > y) - (x < y);
+}
+
+// Index of the lowered function called name, or -1.
+static long find_callee(ir_call_graph_t *graph, const char *name) {
+    size_t low = 0;
+    size_t high = graph->callee_count;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if ((uintptr_t) graph->callees[middle].name < (uintptr_t) name) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low < graph->callee_count && graph->callees[low].name == name) {
+        return (long) graph->callees[low].index;
+    }
+    return -1;
+}
+
+static void collect_edges(ir_call_graph_t *graph) {
+    work_stack_t edges;
+    work_stack_init(&edges, sizeof(call_edge_t));
+
+    for (size_t f = 0; f < graph->count; f++) {
+        if (!graph->functions[f]) continue;
+
+        for (ir_block_t *b = graph->functions[f]->entry; b; b = b->next) {
+            for (ir_instr_t *i = b->first; i; i = i->next) {
+                long callee = i->op == IR_CALL ? find_callee(graph, i->text) : -1;
+                if (callee < 0) continue;
+
+                call_edge_t *edge = work_stack_push(&edges);
+                edge->from = f;
+                edge->to = (size_t) callee;
+            }
+        }
+    }
+
+    // Edges were pushed grouped by caller, in caller order.
+    graph->edge_start = allocate(graph->count + 1, sizeof(size_t));
+    graph->edges = allocate(edges.count, sizeof(size_t));
+
+    call_edge_t *items = (call_edge_t *) edges.items;
+    for (size_t e = 0; e < edges.count; e++) {
+        graph->edge_start[items[e].from + 1]++;
+        graph->edges[e] = items[e].to;
+    }
+    for (size_t f = 0; f < graph->count; f++) {
+        graph->edge_start[f + 1] += graph->edge_start[f];
+    }
+
+    work_stack_free(&edges);
+}
+
+static void find_components(ir_call_graph_t *graph) {
+    size_t unvisited = SIZE_MAX;
+    size_t *index = allocate(graph->count, sizeof(size_t));
+    size_t *low = allocate(graph->count, sizeof(size_t));
+    char *on_stack = allocate(graph->count, 1);
+    size_t next_index = 0;
+
+    for (size_t f = 0; f < graph->count; f++) {
+        index[f] = unvisited;
+    }
+
+    work_stack_t frames, component;
+    work_stack_init(&frames, sizeof(tarjan_frame_t));
+    work_stack_init(&component, sizeof(size_t));
+
+    for (size_t root = 0; root < graph->count; root++) {
+        if (!graph->functions[root] || index[root] != unvisited) continue;
+
+        tarjan_frame_t *frame = work_stack_push(&frames);
+        frame->node = root;
+        index[root] = low[root] = next_index++;
+        on_stack[root] = 1;
+        *(size_t *) work_stack_push(&component) = root;
+
+        while ((frame = work_stack_top(&frames))) {
+            size_t v = frame->node;
+
+            if (graph->edge_start[v] + frame->edge < graph->edge_start[v + 1]) {
+                size_t w = graph->edges[graph->edge_start[v] + frame->edge++];
+
+                if (w == v) {
+                    graph->recursive[v] = 1;
+                } else if (index[w] == unvisited) {
+                    tarjan_frame_t *callee = work_stack_push(&frames);
+                    callee->node = w;
+                    index[w] = low[w] = next_index++;
+                    on_stack[w] = 1;
+                    *(size_t *) work_stack_push(&component) = w;
+                } else if (on_stack[w] && index[w] < low[v]) {
+                    low[v] = index[w];
+                }
+                continue;
+            }
+
+            work_stack_pop(&frames, NULL);
+            tarjan_frame_t *caller = work_stack_top(&frames);
+            if (caller && low[v] < low[caller->node]) {
+                low[caller->node] = low[v];
+            }
+            if (low[v] != index[v]) continue;
+
+            // v is the root of a component: everything above it on the
+            // component stack.
+            size_t w;
+            size_t first = graph->order_count;
+            do {
+                work_stack_pop(&component, &w);
+                on_stack[w] = 0;
+                graph->order[graph->order_count++] = w;
+            } while (w != v);
+
+            if (graph->order_count - first > 1) {
+                for (size_t o = first; o < graph->order_count; o++) {
+                    graph->recursive[graph->order[o]] = 1;
+                }
+            }
+        }
+    }
+
+    work_stack_free(&frames);
+    work_stack_free(&component);
+    free(index);
+    free(low);
+    free(on_stack);
+}
+
+ir_call_graph_t *ir_build_call_graph(ir_function_t **functions, size_t count) {
+    ir_call_graph_t *graph = allocate(1, sizeof(ir_call_graph_t));
+    graph->functions = functions;
+    graph->count = count;
+
+    graph->callees = allocate(count, sizeof(callee_entry_t));
+    for (size_t f = 0; f < count; f++) {
+        if (functions[f]) {
+            graph->callees[graph->callee_count++] = (callee_entry_t) {functions[f]->decl->name, f};
+        }
+    }
+    qsort(graph->callees, graph->callee_count, sizeof(callee_entry_t), compare_callees);
+
+    graph->recursive = allocate(count, sizeof(int));
+    graph->sizes = allocate(count, sizeof(int));
+    for (size_t f = 0; f < count; f++) {
+        graph->sizes[f] = -1;
+    }
+    graph->order = allocate(count, sizeof(size_t));
+    collect_edges(graph);
+    find_components(graph);
+
+    return graph;
+}
+
+void ir_free_call_graph(ir_call_graph_t *graph) {
+    if (!graph) return;
+
+    free(graph->callees);
+    free(graph->edge_start);
+    free(graph->edges);
+    free(graph->recursive);
+    free(graph->sizes);
+    free(graph->order);
+    free(graph);
+}
+
+const size_t *ir_call_order(ir_call_graph_t *graph, size_t *count) {
+    *count = graph->order_count;
+    return graph->order;
+}
+
+void ir_keep_calls(ir_call_graph_t *graph, size_t index) {
+    graph->recursive[index] = 1;
+}
+
+int ir_function_size(ir_function_t *fn) {
+    int size = 0;
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            size += i->op != IR_PARAM;
+        }
+    }
+    return size;
+}
+
+// Whether a name the callee's body refers to, a global or a function,
+// would be hidden in the caller by one of its parameters.
+static int is_shadowed(ir_function_t *caller, ir_function_t *callee) {
+    struct param_list *params = caller->decl->type->params;
+    if (!params) return 0;
+
+    for (ir_block_t *b = callee->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            int names_global = i->op == IR_LOAD_GLOBAL || i->op == IR_STORE_GLOBAL || i->op == IR_CALL ||
+                               (i->op == IR_ADDRESS && !i->array);
+            if (!names_global) continue;
+
+            for (struct param_list *p = params; p; p = p->next) {
+                if (strcmp(p->name, i->text) == 0) return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int param_index(ir_function_t *callee, const char *name) {
+    int index = 0;
+    for (struct param_list *p = callee->decl->type->params; p; p = p->next, index++) {
+        if (strcmp(p->name, name) == 0) return index;
+    }
+    return -1;
+}
+
+// Moves the blocks added to fn after last to follow position in the layout.
+static void move_new_blocks(ir_function_t *fn, ir_block_t *last, ir_block_t *position) {
+    if (position == last) return;
+
+    ir_block_t *first = last->next;
+    ir_block_t *end = fn->last_block;
+
+    last->next = NULL;
+    fn->last_block = last;
+
+    end->next = position->next;
+    position->next = first;
+    if (position == fn->last_block) {
+        fn->last_block = end;
+    }
+}
+
+static void inline_call(ir_function_t *fn, ir_instr_t *call, ir_function_t *callee) {
+    ir_block_t *block = call->block;
+    ir_block_t *last = fn->last_block;
+
+    ir_block_t **blocks = allocate((size_t) callee->next_block, sizeof(ir_block_t *));
+    ir_instr_t **values = allocate((size_t) callee->next_value, sizeof(ir_instr_t *));
+    ir_array_t **arrays = allocate((size_t) callee->array_count, sizeof(ir_array_t *));
+
+    for (int a = 0; a < callee->array_count; a++) {
+        ir_array_t *array = callee->arrays[a];
+        arrays[a] = ir_new_array(fn, array->name, array->element, array->size);
+    }
+
+    // Copies of every block and value first, so operands and targets can
+    // refer forward.
+    for (ir_block_t *b = callee->entry; b; b = b->next) {
+        blocks[b->id] = ir_new_block(fn);
+
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            if (i->op == IR_PARAM) {
+                values[i->id] = call->operands[param_index(callee, i->text)];
+                continue;
+            }
+
+            ir_instr_t *copy = ir_new_instr(fn, i->op, i->type);
+            copy->value = i->value;
+            copy->text = i->text;
+            copy->array = i->array ? arrays[i->array->id] : NULL;
+            values[i->id] = copy;
+        }
+    }
+
+    ir_block_t *rest = ir_new_block(fn);
+    ir_instr_t *result = NULL;
+    if (call->type && call->type->kind != TYPE_VOID) {
+        result = ir_new_instr(fn, IR_PHI, call->type);
+        ir_append(rest, result);
+    }
+
+    for (ir_block_t *b = callee->entry; b; b = b->next) {
+        ir_block_t *copy = blocks[b->id];
+
+        for (int p = 0; p < b->pred_count; p++) {
+            ir_add_pred(fn, copy, blocks[b->preds[p]->id]);
+        }
+
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            if (i->op == IR_PARAM) continue;
+
+            if (i->op == IR_RETURN) {
+                ir_instr_t *jump = ir_new_instr(fn, IR_JUMP, NULL);
+                jump->targets[0] = rest;
+                ir_append(copy, jump);
+                ir_add_pred(fn, rest, copy);
+                if (result) {
+                    ir_add_operand(fn, result, values[i->operands[0]->id]);
+                }
+                continue;
+            }
+
+            ir_instr_t *value = values[i->id];
+            for (int o = 0; o < i->operand_count; o++) {
+                ir_add_operand(fn, value, values[i->operands[o]->id]);
+            }
+            for (int t = 0; t < 2; t++) {
+                value->targets[t] = i->targets[t] ? blocks[i->targets[t]->id] : NULL;
+            }
+            ir_append(copy, value);
+        }
+    }
+
+    // What followed the call runs after the callee returns.
+    while (call->next) {
+        ir_instr_t *instr = call->next;
+        ir_remove(instr);
+        ir_append(rest, instr);
+    }
+
+    ir_block_t *successors[2];
+    int n = ir_successors(rest, successors);
+    for (int s = 0; s < n; s++) {
+        successors[s]->preds[ir_pred_index(successors[s], block)] = rest;
+    }
+
+    ir_block_t *entry = blocks[callee->entry->id];
+    ir_instr_t *jump = ir_new_instr(fn, IR_JUMP, NULL);
+    jump->targets[0] = entry;
+    ir_remove(call);
+    ir_append(block, jump);
+    ir_add_pred(fn, entry, block);
+
+    call->replacement = result;
+    move_new_blocks(fn, last, block);
+
+    free(blocks);
+    free(values);
+    free(arrays);
+}
+
+int ir_inline_calls(ir_call_graph_t *graph, size_t index, int budget) {
+    ir_function_t *fn = graph->functions[index];
+    work_stack_t calls;
+    work_stack_init(&calls, sizeof(ir_instr_t *));
+
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            if (i->op == IR_CALL) {
+                *(ir_instr_t **) work_stack_push(&calls) = i;
+            }
+        }
+    }
+
+    // Last call first, so that splitting a block only moves the code up to
+    // the call after it.
+    int inlined = 0;
+    int growth = 0;
+    ir_instr_t *call;
+    while (work_stack_pop(&calls, &call)) {
+        long found = find_callee(graph, call->text);
+        ir_function_t *callee = found >= 0 ? graph->functions[found] : NULL;
+        if (!callee || (size_t) found == index || graph->recursive[found]) continue;
+
+        // Callees are final by the time their callers are inlined into.
+        if (graph->sizes[found] < 0) {
+            graph->sizes[found] = ir_function_size(callee);
+        }
+
+        // A callee whose entry is a loop header has no block to enter from.
+        int size = graph->sizes[found];
+        if (size > budget || growth + size > MAX_INLINE_GROWTH || callee->entry->pred_count > 0 ||
+            is_shadowed(fn, callee)) {
+            continue;
+        }
+
+        inline_call(fn, call, callee);
+        growth += size;
+        inlined++;
+    }
+
+    work_stack_free(&calls);
+
+    if (inlined) {
+        ir_resolve_operands(fn);
+        ir_cleanup(fn);
+    }
+    return inlined;
+}
@@ -0,0 +1,303 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+#include "work_stack.h"
+
+// Loop-invariant code motion. A loop is found from each back edge (an
+// edge to a block that dominates its source); its body is every block
+// that reaches the back edge without passing through the header. Loops
+// are handled innermost first, so code hoisted out of an inner loop can
+// leave the outer one too.
+//
+// An instruction moves to the end of the loop's preheader, the one block
+// outside the loop that jumps to the header, when its operands are all
+// defined outside the loop and moving it cannot change what happens:
+//
+//  - arithmetic and comparisons, except division and modulo by something
+//    that may be zero or -1, which could trap where the loop would not
+//    have run them;
+//  - loads of globals when the loop neither stores to that global nor
+//    calls anything;
+//  - array loads when nothing in the loop may store to that memory (see
+//    ir_number_values for the classes), and the load runs on every entry
+//    to the loop (it is in the header) or is known to be in bounds.
+
+// Finding loop bodies costs the sum of their sizes, which deeply nested
+// loops make quadratic; past this much work the remaining loops are left.
+#define MAX_LOOP_WORK (1 << 22)
+
+typedef struct {
+    ir_block_t *header;
+    ir_block_t *preheader;
+    ir_block_t **blocks;            // by reverse postorder
+    int block_count;
+} loop_t;
+
+typedef struct {
+    ir_function_t *fn;
+    int *in_loop;                   // by block id: stamp of the loop it was last marked for
+    int *stored_array;              // by local array id: stamp of a loop storing to it
+    int stamp;
+
+    int has_call;
+    int stores_shared;              // global arrays, array parameters, escaped arrays
+    work_stack_t stored_globals;    // const char *, scalar globals the loop stores to
+} licm_t;
+
+static int compare_order(const void *a, const void *b) {
+    return (*(ir_block_t * const *) a)->order - (*(ir_block_t * const *) b)->order;
+}
+
+static int compare_size(const void *a, const void *b) {
+    return ((const loop_t *) a)->block_count - ((const loop_t *) b)->block_count;
+}
+
+// Adds the blocks of the loop closed by the back edge latch -> header to
+// body, marking them with the current stamp. The header is marked but left
+// for the caller to add, once for all of its back edges.
+static void collect_body(licm_t *m, ir_block_t *header, ir_block_t *latch, work_stack_t *body) {
+    work_stack_t pending;
+    work_stack_init(&pending, sizeof(ir_block_t *));
+
+    m->in_loop[header->id] = m->stamp;
+    if (m->in_loop[latch->id] != m->stamp) {
+        m->in_loop[latch->id] = m->stamp;
+        *(ir_block_t **) work_stack_push(&pending) = latch;
+    }
+
+    ir_block_t *b;
+    while (work_stack_pop(&pending, &b)) {
+        *(ir_block_t **) work_stack_push(body) = b;
+
+        for (int p = 0; p < b->pred_count; p++) {
+            ir_block_t *pred = b->preds[p];
+            if (pred->order >= 0 && m->in_loop[pred->id] != m->stamp) {
+                m->in_loop[pred->id] = m->stamp;
+                *(ir_block_t **) work_stack_push(&pending) = pred;
+            }
+        }
+    }
+
+    work_stack_free(&pending);
+}
+
+// The single block outside the loop that enters it, when it only jumps to
+// the header.
+static ir_block_t *find_preheader(licm_t *m, ir_block_t *header) {
+    ir_block_t *preheader = NULL;
+
+    for (int p = 0; p < header->pred_count; p++) {
+        ir_block_t *pred = header->preds[p];
+        if (m->in_loop[pred->id] == m->stamp) continue;
+        if (preheader) return NULL;
+        preheader = pred;
+    }
+
+    if (!preheader || preheader->last->op != IR_JUMP) return NULL;
+    return preheader;
+}
+
+static loop_t *find_loops(licm_t *m, int *count) {
+    ir_function_t *fn = m->fn;
+    work_stack_t loops;
+    work_stack_init(&loops, sizeof(loop_t));
+    size_t work = 0;
+
+    for (ir_block_t *header = fn->entry; header && work < MAX_LOOP_WORK; header = header->next) {
+        if (header->order < 0) continue;
+
+        work_stack_t body;
+        work_stack_init(&body, sizeof(ir_block_t *));
+        m->stamp++;
+
+        int is_header = 0;
+        for (int p = 0; p < header->pred_count; p++) {
+            ir_block_t *latch = header->preds[p];
+            if (latch->order >= 0 && ir_dominates(header, latch)) {
+                collect_body(m, header, latch, &body);
+                is_header = 1;
+            }
+        }
+
+        if (!is_header) {
+            work_stack_free(&body);
+            continue;
+        }
+        *(ir_block_t **) work_stack_push(&body) = header;
+        work += body.count;
+
+        loop_t *loop = work_stack_push(&loops);
+        loop->header = header;
+        loop->preheader = find_preheader(m, header);
+        loop->blocks = (ir_block_t **) body.items;
+        loop->block_count = (int) body.count;
+        qsort(loop->blocks, body.count, sizeof(ir_block_t *), compare_order);
+    }
+
+    *count = (int) loops.count;
+    if (loops.count > 1) {
+        qsort(loops.items, loops.count, sizeof(loop_t), compare_size);
+    }
+    return (loop_t *) loops.items;
+}
+
+static int is_outside(licm_t *m, ir_instr_t *v) {
+    return m->in_loop[v->block->id] != m->stamp;
+}
+
+static int operands_outside(licm_t *m, ir_instr_t *instr) {
+    for (int o = 0; o < instr->operand_count; o++) {
+        if (!is_outside(m, instr->operands[o])) return 0;
+    }
+    return 1;
+}
+
+static int is_private_array(ir_instr_t *base) {
+    return base->op == IR_ADDRESS && base->array && !base->array->escapes;
+}
+
+// Whether loading base[index] cannot fault: a constant index into an
+// array of known size.
+static int is_in_bounds(ir_instr_t *base, ir_instr_t *index) {
+    if (base->op != IR_ADDRESS || index->op != IR_CONST) return 0;
+
+    int size = -1;
+    if (base->array) {
+        size = base->array->size;
+    } else if (base->type->array_size && base->type->array_size->kind == EXPR_INTEGER_LITERAL) {
+        size = base->type->array_size->integer_value;
+    }
+    return index->value >= 0 && index->value < size;
+}
+
+static int global_is_stored(licm_t *m, const char *name) {
+    const char **names = (const char **) m->stored_globals.items;
+    for (size_t i = 0; i < m->stored_globals.count; i++) {
+        if (names[i] == name) return 1;
+    }
+    return 0;
+}
+
+static void scan_effects(licm_t *m, loop_t *loop) {
+    m->has_call = 0;
+    m->stores_shared = 0;
+    m->stored_globals.count = 0;
+
+    for (int b = 0; b < loop->block_count; b++) {
+        for (ir_instr_t *i = loop->blocks[b]->first; i; i = i->next) {
+            if (i->op == IR_CALL) {
+                m->has_call = 1;
+            } else if (i->op == IR_STORE_GLOBAL) {
+                *(const char **) work_stack_push(&m->stored_globals) = i->text;
+            } else if (i->op == IR_STORE) {
+                if (is_private_array(i->operands[0])) {
+                    m->stored_array[i->operands[0]->array->id] = m->stamp;
+                } else {
+                    m->stores_shared = 1;
+                }
+            }
+        }
+    }
+}
+
+static int is_hoistable(licm_t *m, loop_t *loop, ir_instr_t *instr) {
+    if (!operands_outside(m, instr)) return 0;
+
+    switch (instr->op) {
+        case IR_CONST:
+        case IR_STRING:
+        case IR_ADDRESS:
+        case IR_NEG:
+        case IR_NOT:
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_POW:
+        case IR_LT:
+        case IR_LE:
+        case IR_GT:
+        case IR_GE:
+        case IR_EQ:
+        case IR_NE:
+            return 1;
+
+        case IR_DIV:
+        case IR_MOD: {
+            ir_instr_t *divisor = instr->operands[1];
+            return divisor->op == IR_CONST && divisor->value != 0 && divisor->value != -1;
+        }
+
+        case IR_LOAD_GLOBAL:
+            return !m->has_call && !global_is_stored(m, instr->text);
+
+        case IR_LOAD: {
+            ir_instr_t *base = instr->operands[0];
+            int stored = is_private_array(base) ? m->stored_array[base->array->id] == m->stamp
+                                                : m->stores_shared || m->has_call;
+            return !stored && (instr->block == loop->header || is_in_bounds(base, instr->operands[1]));
+        }
+
+        default:
+            return 0;
+    }
+}
+
+static void hoist_loop(licm_t *m, loop_t *loop) {
+    m->stamp++;
+    for (int b = 0; b < loop->block_count; b++) {
+        m->in_loop[loop->blocks[b]->id] = m->stamp;
+    }
+    scan_effects(m, loop);
+
+    // Blocks are in reverse postorder, so operands are seen before their
+    // uses except around inner loops; repeat until nothing moves.
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+
+        for (int b = 0; b < loop->block_count; b++) {
+            ir_instr_t *instr = loop->blocks[b]->first;
+            while (instr) {
+                ir_instr_t *next = instr->next;
+
+                if (instr->op != IR_PHI && is_hoistable(m, loop, instr)) {
+                    ir_remove(instr);
+                    ir_insert_before(loop->preheader->last, instr);
+                    changed = 1;
+                }
+                instr = next;
+            }
+        }
+    }
+}
+
+void ir_hoist_loop_invariants(ir_function_t *fn) {
+    licm_t m;
+    memset(&m, 0, sizeof(m));
+    m.fn = fn;
+    m.in_loop = calloc((size_t) fn->next_block + 1, sizeof(int));
+    m.stored_array = calloc((size_t) fn->array_count + 1, sizeof(int));
+    if (!m.in_loop || !m.stored_array) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    work_stack_init(&m.stored_globals, sizeof(const char *));
+
+    ir_compute_dominators(fn);
+    ir_mark_escaping_arrays(fn);
+
+    int count;
+    loop_t *loops = find_loops(&m, &count);
+
+    for (int l = 0; l < count; l++) {
+        if (loops[l].preheader) {
+            hoist_loop(&m, &loops[l]);
+        }
+        free(loops[l].blocks);
+    }
+
+    free(loops);
+    free(m.in_loop);
+    free(m.stored_array);
+    work_stack_free(&m.stored_globals);
+}
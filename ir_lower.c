@@ -0,0 +1,868 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+#include "scope.h"
+#include "typecheck.h"
+#include "work_stack.h"
+
+// Lowering builds SSA form directly while walking the structured AST, as
+// in Braun et al.'s construction specialised to structured control flow:
+// the current value of every local and parameter is kept in a table, an
+// if-else or && / || forks the table and merges the two arms with phis,
+// and a loop header gets a phi for each variable the loop assigns, whose
+// back-edge operand is filled in once the body has been lowered. Phis that
+// turn out to merge one value are removed by ir_cleanup.
+
+// Local arrays with an initializer are filled element by element; larger
+// ones stay with the AST code generator.
+#define MAX_INITIALIZED_ARRAY 256
+
+// Every loop gets a phi for each variable assigned anywhere inside it, so
+// deeply nested loops that each assign their own variables need a number
+// of phis quadratic in the depth. Functions past this many stay with the
+// AST code generator.
+#define MAX_LOOP_PHIS (1 << 16)
+
+// The current definition of one variable. stamp and other are scratch
+// space for undo_to and fork_join.
+typedef struct {
+    struct symbol *symbol;
+    ir_instr_t *value;
+    unsigned int stamp;
+    ir_instr_t *other;
+} def_t;
+
+// Every change to the table is journaled with the value it replaced, so
+// an arm or a loop body can be undone once it has been lowered.
+typedef struct {
+    struct symbol *symbol;
+    ir_instr_t *old;
+} journal_entry_t;
+
+// A variable and the value an arm left it with.
+typedef struct {
+    struct symbol *symbol;
+    ir_instr_t *value;
+} change_t;
+
+// The two arms of an if-else, or of && and || (the right operand, and the
+// path that skips it). Each arm's changes are collected into the shared
+// changes stack as the arm is undone.
+typedef struct {
+    size_t journal;
+    size_t changes[3];              // arm 0 is [0, 1), arm 1 is [1, 2)
+    ir_block_t *ends[2];
+} fork_t;
+
+typedef struct {
+    ir_function_t *fn;
+    ir_block_t *current;
+    const char *unsupported;
+
+    def_t *defs;                    // open addressing on the symbol address
+    size_t def_count;
+    size_t def_capacity;
+    unsigned int stamp;
+
+    work_stack_t journal;           // journal_entry_t
+    work_stack_t changes;           // change_t
+    work_stack_t loop_phis;         // loop_phi_t
+    size_t loop_phi_total;
+    work_stack_t exprs;             // expr_frame_t
+    work_stack_t values;            // ir_instr_t *
+    work_stack_t stmts;             // stmt_frame_t
+} lower_t;
+
+typedef struct {
+    ir_instr_t *phi;
+    struct symbol *symbol;
+} loop_phi_t;
+
+static void unsupported(lower_t *l, const char *reason) {
+    if (!l->unsupported) {
+        l->unsupported = reason;
+    }
+}
+
+static size_t hash_symbol(struct symbol *sym, size_t capacity) {
+    return (size_t) (((uintptr_t) sym >> 4) * 0x9E3779B97F4A7C15ull) & (capacity - 1);
+}
+
+static def_t *find_def(lower_t *l, struct symbol *sym) {
+    if (l->def_count * 2 >= l->def_capacity) {
+        size_t old_capacity = l->def_capacity;
+        def_t *old = l->defs;
+
+        l->def_capacity = old_capacity ? old_capacity * 2 : 64;
+        l->defs = calloc(l->def_capacity, sizeof(def_t));
+        if (!l->defs) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+
+        for (size_t i = 0; i < old_capacity; i++) {
+            if (!old[i].symbol) continue;
+            size_t slot = hash_symbol(old[i].symbol, l->def_capacity);
+            while (l->defs[slot].symbol) {
+                slot = (slot + 1) & (l->def_capacity - 1);
+            }
+            l->defs[slot] = old[i];
+        }
+        free(old);
+    }
+
+    size_t slot = hash_symbol(sym, l->def_capacity);
+    while (l->defs[slot].symbol && l->defs[slot].symbol != sym) {
+        slot = (slot + 1) & (l->def_capacity - 1);
+    }
+    if (!l->defs[slot].symbol) {
+        l->defs[slot].symbol = sym;
+        l->def_count++;
+    }
+    return &l->defs[slot];
+}
+
+static ir_instr_t *read_var(lower_t *l, struct symbol *sym) {
+    return find_def(l, sym)->value;
+}
+
+static void write_var(lower_t *l, struct symbol *sym, ir_instr_t *value) {
+    def_t *def = find_def(l, sym);
+
+    journal_entry_t *entry = work_stack_push(&l->journal);
+    entry->symbol = sym;
+    entry->old = def->value;
+
+    def->value = value;
+}
+
+// Rolls the table back to where the journal was mark long. With record,
+// the final value of every variable that changed goes on the changes
+// stack, once per variable.
+static void undo_to(lower_t *l, size_t mark, int record) {
+    unsigned int stamp = ++l->stamp;
+    journal_entry_t entry;
+
+    while (l->journal.count > mark && work_stack_pop(&l->journal, &entry)) {
+        def_t *def = find_def(l, entry.symbol);
+
+        if (record && def->stamp != stamp) {
+            def->stamp = stamp;
+            change_t *change = work_stack_push(&l->changes);
+            change->symbol = entry.symbol;
+            change->value = def->value;
+        }
+        def->value = entry.old;
+    }
+}
+
+static ir_instr_t *append(lower_t *l, ir_opcode_t op, struct type *type) {
+    ir_instr_t *instr = ir_new_instr(l->fn, op, type);
+    ir_append(l->current, instr);
+    return instr;
+}
+
+static ir_instr_t *append1(lower_t *l, ir_opcode_t op, struct type *type, ir_instr_t *a) {
+    ir_instr_t *instr = append(l, op, type);
+    ir_add_operand(l->fn, instr, a);
+    return instr;
+}
+
+static ir_instr_t *append2(lower_t *l, ir_opcode_t op, struct type *type, ir_instr_t *a, ir_instr_t *b) {
+    ir_instr_t *instr = append1(l, op, type, a);
+    ir_add_operand(l->fn, instr, b);
+    return instr;
+}
+
+static ir_instr_t *constant(lower_t *l, struct type *type, int value) {
+    ir_instr_t *instr = append(l, IR_CONST, type);
+    instr->value = value;
+    return instr;
+}
+
+// What a variable holds before anything is stored in it.
+static ir_instr_t *zero_value(lower_t *l, struct type *type) {
+    if (type->kind == TYPE_STRING) {
+        ir_instr_t *instr = append(l, IR_STRING, type);
+        instr->text = "";
+        return instr;
+    }
+    return constant(l, type, 0);
+}
+
+static void jump(lower_t *l, ir_block_t *target) {
+    ir_instr_t *instr = append(l, IR_JUMP, NULL);
+    instr->targets[0] = target;
+    ir_add_pred(l->fn, target, l->current);
+}
+
+// Branches on condition to a new block and continues there. The other
+// target is filled in by patch_branch once it exists, so blocks are laid
+// out in source order.
+static ir_instr_t *branch_to_new_block(lower_t *l, ir_instr_t *condition, int taken_when) {
+    ir_block_t *next = ir_new_block(l->fn);
+    ir_instr_t *instr = append1(l, IR_BRANCH, NULL, condition);
+
+    instr->targets[taken_when ? 0 : 1] = next;
+    ir_add_pred(l->fn, next, l->current);
+    l->current = next;
+
+    return instr;
+}
+
+static void patch_branch(lower_t *l, ir_instr_t *branch, ir_block_t *target) {
+    branch->targets[branch->targets[0] ? 1 : 0] = target;
+    ir_add_pred(l->fn, target, branch->block);
+}
+
+static void fork_begin(lower_t *l, fork_t *fork) {
+    fork->journal = l->journal.count;
+    fork->changes[0] = l->changes.count;
+}
+
+// Ends an arm where the current block is. Arms that return end in a block
+// nothing reaches, which ir_cleanup drops along with its phi operands.
+static void fork_end_arm(lower_t *l, fork_t *fork, int arm) {
+    fork->ends[arm] = l->current;
+    undo_to(l, fork->journal, 1);
+    fork->changes[arm + 1] = l->changes.count;
+}
+
+static ir_instr_t *merge(lower_t *l, ir_block_t *join, struct symbol *sym, ir_instr_t *a, ir_instr_t *b) {
+    if (a == b) return a;
+
+    ir_instr_t *phi = ir_new_instr(l->fn, IR_PHI, sym->type);
+    ir_append(join, phi);
+    ir_add_operand(l->fn, phi, a);
+    ir_add_operand(l->fn, phi, b);
+    return phi;
+}
+
+// Joins both arms in a new block, with a phi for every variable the arms
+// left with different values. Variables declared inside an arm had no
+// value before it and are dropped.
+static ir_block_t *fork_join(lower_t *l, fork_t *fork) {
+    ir_block_t *join = ir_new_block(l->fn);
+    change_t *changes = (change_t *) l->changes.items;
+
+    for (int arm = 0; arm < 2; arm++) {
+        l->current = fork->ends[arm];
+        jump(l, join);
+    }
+
+    unsigned int in_arm1 = ++l->stamp;
+    for (size_t i = fork->changes[1]; i < fork->changes[2]; i++) {
+        def_t *def = find_def(l, changes[i].symbol);
+        def->stamp = in_arm1;
+        def->other = changes[i].value;
+    }
+
+    unsigned int merged = ++l->stamp;
+    for (size_t i = fork->changes[0]; i < fork->changes[1]; i++) {
+        struct symbol *sym = changes[i].symbol;
+        def_t *def = find_def(l, sym);
+        ir_instr_t *before = def->value;
+        if (!before) continue;
+
+        ir_instr_t *other = def->stamp == in_arm1 ? def->other : before;
+        def->stamp = merged;
+        write_var(l, sym, merge(l, join, sym, changes[i].value, other));
+    }
+
+    for (size_t i = fork->changes[1]; i < fork->changes[2]; i++) {
+        struct symbol *sym = changes[i].symbol;
+        def_t *def = find_def(l, sym);
+        if (def->stamp == merged || !def->value) continue;
+
+        write_var(l, sym, merge(l, join, sym, def->value, changes[i].value));
+    }
+
+    l->changes.count = fork->changes[0];
+    l->current = join;
+    return join;
+}
+
+static ir_instr_t *load_name(lower_t *l, struct expr *e) {
+    struct symbol *sym = e->symbol;
+
+    if (sym->kind != SYMBOL_GLOBAL) {
+        ir_instr_t *value = read_var(l, sym);
+        if (!value) {
+            unsupported(l, "a name from an enclosing function");
+            return zero_value(l, e->type);
+        }
+        return value;
+    }
+
+    if (sym->type->kind == TYPE_FUNCTION) {
+        unsupported(l, "a function used as a value");
+        return constant(l, type_basic(TYPE_INTEGER), 0);
+    }
+
+    ir_instr_t *instr = append(l, sym->type->kind == TYPE_ARRAY ? IR_ADDRESS : IR_LOAD_GLOBAL, sym->type);
+    instr->text = sym->name;
+    return instr;
+}
+
+static void store_name(lower_t *l, struct expr *e, ir_instr_t *value) {
+    struct symbol *sym = e->symbol;
+
+    if (sym->type->kind == TYPE_ARRAY || sym->type->kind == TYPE_FUNCTION) {
+        unsupported(l, "assignment to a whole array");
+        return;
+    }
+
+    if (sym->kind != SYMBOL_GLOBAL) {
+        write_var(l, sym, value);
+        return;
+    }
+
+    ir_instr_t *instr = append1(l, IR_STORE_GLOBAL, NULL, value);
+    instr->text = sym->name;
+}
+
+// Expressions are lowered from an explicit stack like the AST walks, with
+// the values computed so far on a second stack. A frame is revisited at
+// a later stage once the operands it pushed have been lowered.
+typedef struct {
+    struct expr *e;
+    int stage;
+    struct expr *arg;               // calls: the next argument cell
+    int count;                      // calls: arguments lowered so far
+    ir_instr_t *branch;             // && and ||: the branch around the right operand
+    fork_t fork;
+} expr_frame_t;
+
+static expr_frame_t *push_expr(lower_t *l, struct expr *e, int stage) {
+    expr_frame_t *frame = work_stack_push(&l->exprs);
+    frame->e = e;
+    frame->stage = stage;
+    return frame;
+}
+
+static void push_value(lower_t *l, ir_instr_t *value) {
+    *(ir_instr_t **) work_stack_push(&l->values) = value;
+}
+
+static ir_instr_t *pop_value(lower_t *l) {
+    ir_instr_t *value = NULL;
+    work_stack_pop(&l->values, &value);
+    return value;
+}
+
+static ir_opcode_t binary_opcode(expr_kind_t kind) {
+    switch (kind) {
+        case EXPR_ADD: return IR_ADD;
+        case EXPR_SUB: return IR_SUB;
+        case EXPR_MUL: return IR_MUL;
+        case EXPR_DIV: return IR_DIV;
+        case EXPR_MOD: return IR_MOD;
+        case EXPR_POWER: return IR_POW;
+        case EXPR_LT: return IR_LT;
+        case EXPR_LE: return IR_LE;
+        case EXPR_GT: return IR_GT;
+        case EXPR_GE: return IR_GE;
+        case EXPR_EQ: return IR_EQ;
+        default: return IR_NE;
+    }
+}
+
+static void lower_call(lower_t *l, expr_frame_t *frame) {
+    struct expr *cell = frame->arg;
+
+    if (cell) {
+        expr_frame_t *next = push_expr(l, frame->e, 1);
+        next->arg = cell->kind == EXPR_ARG ? cell->right : NULL;
+        next->count = frame->count + 1;
+        push_expr(l, cell->kind == EXPR_ARG ? cell->left : cell, 0);
+        return;
+    }
+
+    ir_instr_t *call = append(l, IR_CALL, frame->e->type);
+    call->text = frame->e->left->name;
+
+    ir_instr_t **args = (ir_instr_t **) l->values.items + (l->values.count - (size_t) frame->count);
+    for (int i = 0; i < frame->count; i++) {
+        ir_add_operand(l->fn, call, args[i]);
+    }
+    l->values.count -= (size_t) frame->count;
+
+    push_value(l, call);
+}
+
+// a && b branches around b when a is false, and a || b when a is true;
+// the skipping path supplies that constant to the phi at the join.
+static void lower_logical(lower_t *l, expr_frame_t *frame) {
+    struct expr *e = frame->e;
+    int is_and = e->kind == EXPR_AND;
+
+    if (frame->stage == 0) {
+        push_expr(l, e, 1);
+        push_expr(l, e->left, 0);
+        return;
+    }
+
+    if (frame->stage == 1) {
+        expr_frame_t next = *frame;
+        next.stage = 2;
+        next.branch = branch_to_new_block(l, pop_value(l), is_and);
+        fork_begin(l, &next.fork);
+        *(expr_frame_t *) work_stack_push(&l->exprs) = next;
+        push_expr(l, e->right, 0);
+        return;
+    }
+
+    ir_instr_t *right = pop_value(l);
+    fork_end_arm(l, &frame->fork, 0);
+
+    l->current = ir_new_block(l->fn);
+    patch_branch(l, frame->branch, l->current);
+    ir_instr_t *skipped = constant(l, e->type, !is_and);
+    fork_end_arm(l, &frame->fork, 1);
+
+    ir_block_t *join = fork_join(l, &frame->fork);
+    ir_instr_t *phi = ir_new_instr(l->fn, IR_PHI, e->type);
+    ir_append(join, phi);
+    ir_add_operand(l->fn, phi, right);
+    ir_add_operand(l->fn, phi, skipped);
+    push_value(l, phi);
+}
+
+static ir_instr_t *lower_expr(lower_t *l, struct expr *root) {
+    size_t base = l->values.count;
+    push_expr(l, root, 0);
+
+    expr_frame_t frame;
+    while (work_stack_pop(&l->exprs, &frame)) {
+        struct expr *e = frame.e;
+        ir_instr_t *a, *b, *c, *instr;
+
+        switch (e->kind) {
+            case EXPR_INTEGER_LITERAL:
+            case EXPR_CHAR_LITERAL:
+            case EXPR_BOOL_LITERAL:
+                push_value(l, constant(l, e->type, e->integer_value));
+                break;
+
+            case EXPR_STRING_LITERAL:
+                instr = append(l, IR_STRING, e->type);
+                instr->text = e->string_literal;
+                push_value(l, instr);
+                break;
+
+            case EXPR_NAME:
+                push_value(l, load_name(l, e));
+                break;
+
+            case EXPR_UNARY_MINUS:
+            case EXPR_NOT:
+                if (frame.stage == 0) {
+                    push_expr(l, e, 1);
+                    push_expr(l, e->right, 0);
+                    break;
+                }
+                a = pop_value(l);
+                push_value(l, append1(l, e->kind == EXPR_NOT ? IR_NOT : IR_NEG, e->type, a));
+                break;
+
+            case EXPR_AND:
+            case EXPR_OR:
+                lower_logical(l, &frame);
+                break;
+
+            case EXPR_CALL:
+                if (frame.stage == 0) {
+                    frame.arg = e->right;
+                    frame.count = 0;
+                }
+                lower_call(l, &frame);
+                break;
+
+            case EXPR_SUBSCRIPT:
+                if (e->type->kind == TYPE_ARRAY) {
+                    unsupported(l, "an array of arrays");
+                }
+                if (frame.stage == 0) {
+                    push_expr(l, e, 1);
+                    push_expr(l, e->right, 0);
+                    push_expr(l, e->left, 0);
+                    break;
+                }
+                b = pop_value(l);
+                a = pop_value(l);
+                push_value(l, append2(l, IR_LOAD, e->type, a, b));
+                break;
+
+            case EXPR_ASSIGN:
+                if (e->left->kind == EXPR_SUBSCRIPT) {
+                    if (frame.stage == 0) {
+                        push_expr(l, e, 1);
+                        push_expr(l, e->right, 0);
+                        push_expr(l, e->left->right, 0);
+                        push_expr(l, e->left->left, 0);
+                        break;
+                    }
+                    c = pop_value(l);
+                    b = pop_value(l);
+                    a = pop_value(l);
+                    instr = append2(l, IR_STORE, NULL, a, b);
+                    ir_add_operand(l->fn, instr, c);
+                    push_value(l, c);
+                    break;
+                }
+                if (frame.stage == 0) {
+                    push_expr(l, e, 1);
+                    push_expr(l, e->right, 0);
+                    break;
+                }
+                a = pop_value(l);
+                store_name(l, e->left, a);
+                push_value(l, a);
+                break;
+
+            case EXPR_ARRAY_LITERAL:
+                unsupported(l, "an array literal outside a declaration");
+                push_value(l, constant(l, type_basic(TYPE_INTEGER), 0));
+                break;
+
+            case EXPR_ARG:
+                push_expr(l, e->left, 0);
+                break;
+
+            default:
+                if (frame.stage == 0) {
+                    push_expr(l, e, 1);
+                    push_expr(l, e->right, 0);
+                    push_expr(l, e->left, 0);
+                    break;
+                }
+                b = pop_value(l);
+                a = pop_value(l);
+                push_value(l, append2(l, binary_opcode(e->kind), e->type, a, b));
+                break;
+        }
+    }
+
+    ir_instr_t *result = pop_value(l);
+    l->values.count = base;
+    return result;
+}
+
+// Local arrays live in memory for the whole function. An initializer is
+// stored element by element, and the elements it leaves out are zeroed
+// as C would.
+static void lower_array_decl(lower_t *l, struct decl *d) {
+    struct type *element = d->type->subtype;
+    struct expr *size = d->type->array_size;
+
+    if (!size || size->kind != EXPR_INTEGER_LITERAL || size->integer_value <= 0) {
+        unsupported(l, "a local array without a constant size");
+        return;
+    }
+    if (element->kind == TYPE_ARRAY) {
+        unsupported(l, "an array of arrays");
+        return;
+    }
+    if (d->value && (d->value->kind != EXPR_ARRAY_LITERAL || size->integer_value > MAX_INITIALIZED_ARRAY)) {
+        unsupported(l, "a local array initializer");
+        return;
+    }
+
+    ir_instr_t *address = append(l, IR_ADDRESS, d->type);
+    address->array = ir_new_array(l->fn, d->name, element, size->integer_value);
+    write_var(l, d->symbol, address);
+
+    if (!d->value) return;
+
+    int index = 0;
+    for (struct expr *cell = d->value->right; cell; cell = cell->right, index++) {
+        ir_instr_t *value = lower_expr(l, cell->kind == EXPR_ARG ? cell->left : cell);
+        if (index < size->integer_value) {
+            ir_instr_t *store = append2(l, IR_STORE, NULL, address, constant(l, type_basic(TYPE_INTEGER), index));
+            ir_add_operand(l->fn, store, value);
+        }
+        if (cell->kind != EXPR_ARG) break;
+    }
+    for (; index < size->integer_value; index++) {
+        ir_instr_t *zero = zero_value(l, element);
+        ir_instr_t *store = append2(l, IR_STORE, NULL, address, constant(l, type_basic(TYPE_INTEGER), index));
+        ir_add_operand(l->fn, store, zero);
+    }
+}
+
+static void lower_decl(lower_t *l, struct decl *d) {
+    if (d->type->kind == TYPE_FUNCTION) {
+        unsupported(l, "a nested function");
+        return;
+    }
+    if (d->type->kind == TYPE_ARRAY) {
+        lower_array_decl(l, d);
+        return;
+    }
+
+    write_var(l, d->symbol, d->value ? lower_expr(l, d->value) : zero_value(l, d->type));
+}
+
+static void lower_print(lower_t *l, struct expr *list) {
+    work_stack_t args;
+    work_stack_init(&args, sizeof(ir_instr_t *));
+
+    for (struct expr *cell = list; cell; cell = cell->kind == EXPR_ARG ? cell->right : NULL) {
+        *(ir_instr_t **) work_stack_push(&args) = lower_expr(l, cell->kind == EXPR_ARG ? cell->left : cell);
+    }
+
+    ir_instr_t *print = append(l, IR_PRINT, NULL);
+    for (size_t i = 0; i < args.count; i++) {
+        ir_add_operand(l->fn, print, ((ir_instr_t **) args.items)[i]);
+    }
+
+    work_stack_free(&args);
+}
+
+// Statements after a return are lowered into a block nothing reaches.
+static void lower_return(lower_t *l, struct expr *value) {
+    if (value) {
+        append1(l, IR_RETURN, NULL, lower_expr(l, value));
+    } else {
+        append(l, IR_RETURN, NULL);
+    }
+    l->current = ir_new_block(l->fn);
+}
+
+typedef enum {
+    LOWER_LIST,                     // the rest of a statement list
+    LOWER_THEN_DONE,
+    LOWER_ELSE_DONE,
+    LOWER_LOOP_DONE
+} lower_step_t;
+
+typedef struct {
+    lower_step_t step;
+    struct stmt *s;
+    ir_instr_t *branch;             // to patch with the else block or the loop exit
+    ir_block_t *header;             // loops
+    size_t journal;                 // loops: where the body's changes start
+    size_t phis;                    // loops: where the header phis start on loop_phis
+    fork_t fork;
+} stmt_frame_t;
+
+static void push_stmts(lower_t *l, struct stmt *s) {
+    if (!s) return;
+
+    stmt_frame_t *frame = work_stack_push(&l->stmts);
+    frame->step = LOWER_LIST;
+    frame->s = s;
+}
+
+typedef struct {
+    lower_t *l;
+    ir_block_t *header;
+} loop_scan_t;
+
+// Gives the loop header a phi for every variable the loop may assign that
+// already has a value on entry.
+static void add_header_phi(struct expr *e, void *context) {
+    loop_scan_t *scan = context;
+    lower_t *l = scan->l;
+
+    if (e->kind != EXPR_ASSIGN || e->left->kind != EXPR_NAME) return;
+
+    struct symbol *sym = e->left->symbol;
+    if (!sym || sym->kind == SYMBOL_GLOBAL) return;
+
+    ir_instr_t *value = read_var(l, sym);
+    if (!value || (value->op == IR_PHI && value->block == scan->header)) return;
+
+    if (++l->loop_phi_total > MAX_LOOP_PHIS) {
+        unsupported(l, "too many loop-carried variables");
+        return;
+    }
+
+    ir_instr_t *phi = ir_new_instr(l->fn, IR_PHI, sym->type);
+    ir_append(scan->header, phi);
+    ir_add_operand(l->fn, phi, value);
+    write_var(l, sym, phi);
+
+    loop_phi_t *entry = work_stack_push(&l->loop_phis);
+    entry->phi = phi;
+    entry->symbol = sym;
+}
+
+static void lower_for(lower_t *l, struct stmt *s) {
+    if (s->init_expr) {
+        lower_expr(l, s->init_expr);
+    }
+
+    stmt_frame_t frame = {0};
+    frame.step = LOWER_LOOP_DONE;
+    frame.s = s;
+    frame.header = ir_new_block(l->fn);
+    frame.phis = l->loop_phis.count;
+
+    jump(l, frame.header);
+    l->current = frame.header;
+
+    loop_scan_t scan = {l, frame.header};
+    ast_visit_stmt_exprs(s, add_header_phi, &scan);
+
+    if (s->expr) {
+        frame.branch = branch_to_new_block(l, lower_expr(l, s->expr), 1);
+    } else {
+        ir_block_t *body = ir_new_block(l->fn);
+        jump(l, body);
+        l->current = body;
+    }
+    frame.journal = l->journal.count;
+
+    *(stmt_frame_t *) work_stack_push(&l->stmts) = frame;
+    push_stmts(l, s->body);
+}
+
+static void finish_for(lower_t *l, stmt_frame_t *frame) {
+    struct stmt *s = frame->s;
+
+    if (s->next_expr) {
+        lower_expr(l, s->next_expr);
+    }
+    jump(l, frame->header);
+
+    loop_phi_t *phis = (loop_phi_t *) l->loop_phis.items;
+    for (size_t i = frame->phis; i < l->loop_phis.count; i++) {
+        ir_add_operand(l->fn, phis[i].phi, read_var(l, phis[i].symbol));
+    }
+    l->loop_phis.count = frame->phis;
+
+    // After the loop, variables hold what they held when the condition
+    // was last tested.
+    undo_to(l, frame->journal, 0);
+
+    l->current = ir_new_block(l->fn);
+    if (frame->branch) {
+        patch_branch(l, frame->branch, l->current);
+    }
+}
+
+static void lower_stmts(lower_t *l, struct stmt *list) {
+    push_stmts(l, list);
+
+    stmt_frame_t frame;
+    while (!l->unsupported && work_stack_pop(&l->stmts, &frame)) {
+        struct stmt *s = frame.s;
+
+        switch (frame.step) {
+            case LOWER_THEN_DONE:
+                fork_end_arm(l, &frame.fork, 0);
+                l->current = ir_new_block(l->fn);
+                patch_branch(l, frame.branch, l->current);
+                frame.step = LOWER_ELSE_DONE;
+                *(stmt_frame_t *) work_stack_push(&l->stmts) = frame;
+                push_stmts(l, s->else_body);
+                continue;
+
+            case LOWER_ELSE_DONE:
+                fork_end_arm(l, &frame.fork, 1);
+                fork_join(l, &frame.fork);
+                continue;
+
+            case LOWER_LOOP_DONE:
+                finish_for(l, &frame);
+                continue;
+
+            case LOWER_LIST:
+                break;
+        }
+
+        push_stmts(l, s->next);
+
+        switch (s->kind) {
+            case STMT_DECL:
+                lower_decl(l, s->decl);
+                break;
+
+            case STMT_EXPR:
+                lower_expr(l, s->expr);
+                break;
+
+            case STMT_IF_ELSE:
+                frame.step = LOWER_THEN_DONE;
+                frame.branch = branch_to_new_block(l, lower_expr(l, s->expr), 1);
+                fork_begin(l, &frame.fork);
+                *(stmt_frame_t *) work_stack_push(&l->stmts) = frame;
+                push_stmts(l, s->body);
+                break;
+
+            case STMT_FOR:
+                lower_for(l, s);
+                break;
+
+            case STMT_PRINT:
+                lower_print(l, s->expr);
+                break;
+
+            case STMT_RETURN:
+                lower_return(l, s->expr);
+                break;
+
+            case STMT_BLOCK:
+                push_stmts(l, s->body);
+                break;
+
+            case STMT_COMMENT:
+            case STMT_MULTI_COMMENT:
+                break;
+        }
+    }
+}
+
+ir_function_t *ir_lower_function(struct decl *d, const char **reason) {
+    ir_function_t *fn = ir_create_function(d);
+    if (!fn) {
+        *reason = "out of memory";
+        return NULL;
+    }
+
+    lower_t l;
+    memset(&l, 0, sizeof(l));
+    l.fn = fn;
+    work_stack_init(&l.journal, sizeof(journal_entry_t));
+    work_stack_init(&l.changes, sizeof(change_t));
+    work_stack_init(&l.loop_phis, sizeof(loop_phi_t));
+    work_stack_init(&l.exprs, sizeof(expr_frame_t));
+    work_stack_init(&l.values, sizeof(ir_instr_t *));
+    work_stack_init(&l.stmts, sizeof(stmt_frame_t));
+
+    l.current = ir_new_block(fn);
+    for (struct param_list *p = d->type->params; p; p = p->next) {
+        ir_instr_t *param = append(&l, IR_PARAM, p->type);
+        param->text = p->name;
+        write_var(&l, p->symbol, param);
+    }
+
+    lower_stmts(&l, d->code);
+
+    // Falling off the end returns nothing, or zero.
+    struct type *result = d->type->subtype;
+    if (result->kind == TYPE_VOID) {
+        append(&l, IR_RETURN, NULL);
+    } else {
+        append1(&l, IR_RETURN, NULL, zero_value(&l, result));
+    }
+
+    free(l.defs);
+    work_stack_free(&l.journal);
+    work_stack_free(&l.changes);
+    work_stack_free(&l.loop_phis);
+    work_stack_free(&l.exprs);
+    work_stack_free(&l.values);
+    work_stack_free(&l.stmts);
+
+    if (l.unsupported) {
+        *reason = l.unsupported;
+        ir_free_function(fn);
+        return NULL;
+    }
+
+    ir_cleanup(fn);
+    return fn;
+}
@@ -0,0 +1,263 @@
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+#include "work_stack.h"
+
+// Self tail calls become loops. The entry block is split so that its code
+// moves to a new loop header with a phi per parameter; a call to the
+// function itself whose result is returned at once then jumps back to the
+// header with its arguments as the parameters' next values.
+//
+// A call whose result is added to, or multiplied by, a value computed
+// before it and then returned (return n * f(n - 1)) is converted too, with
+// an accumulator: the header gets a phi starting at 0 or 1, such a call
+// folds its other operand into it before jumping back, and every other
+// return gives the accumulator combined with its value. Both operations
+// are associative and commutative in wrapping arithmetic, so the order in
+// which the factors are combined does not matter. One function uses one of
+// them; calls with the other stay calls.
+
+typedef struct {
+    ir_block_t *block;
+    ir_instr_t *call;
+    ir_instr_t *combine;            // the ADD or MUL around the call, or NULL
+    ir_block_t *return_block;       // when the block jumps to a shared return
+} tail_site_t;
+
+static int is_self_call(ir_function_t *fn, ir_instr_t *instr) {
+    return instr && instr->op == IR_CALL && instr->text == fn->decl->name;
+}
+
+// The block a tail call jumps to when it only returns the call's value,
+// through at most a phi.
+static int is_return_block(ir_block_t *target, ir_block_t *from, ir_instr_t *call) {
+    ir_instr_t *ret = target->last;
+    if (ret->op != IR_RETURN) return 0;
+
+    if (ret->operand_count == 0) {
+        return target->first == ret && call->type->kind == TYPE_VOID;
+    }
+
+    ir_instr_t *phi = ret->operands[0];
+    return target->first == phi && phi->next == ret && phi->op == IR_PHI &&
+           phi->operands[ir_pred_index(target, from)] == call;
+}
+
+// Whether the end of b is a tail call, recorded in site.
+static int find_site(ir_function_t *fn, ir_block_t *b, tail_site_t *site) {
+    ir_instr_t *last = b->last;
+    memset(site, 0, sizeof(*site));
+    site->block = b;
+
+    if (last->op == IR_JUMP) {
+        site->call = last->prev;
+        site->return_block = last->targets[0];
+        return is_self_call(fn, site->call) && is_return_block(site->return_block, b, site->call);
+    }
+
+    if (last->op != IR_RETURN) return 0;
+
+    if (last->operand_count == 0 || last->operands[0] == last->prev) {
+        site->call = last->prev;
+        if (is_self_call(fn, site->call)) return 1;
+    }
+
+    ir_instr_t *combine = last->operand_count ? last->operands[0] : NULL;
+    if (!combine || combine != last->prev || (combine->op != IR_ADD && combine->op != IR_MUL)) return 0;
+
+    site->call = combine->prev;
+    site->combine = combine;
+    return is_self_call(fn, site->call) && (combine->operands[0] == site->call) != (combine->operands[1] == site->call);
+}
+
+// Moves everything in the entry block except the parameters to a new block
+// after it, which it then jumps to.
+static ir_block_t *split_entry(ir_function_t *fn) {
+    ir_block_t *entry = fn->entry;
+    ir_block_t *last = fn->last_block;
+    ir_block_t *header = ir_new_block(fn);
+
+    ir_instr_t *instr = entry->first;
+    while (instr) {
+        ir_instr_t *next = instr->next;
+        if (instr->op != IR_PARAM) {
+            ir_remove(instr);
+            ir_append(header, instr);
+        }
+        instr = next;
+    }
+
+    ir_block_t *successors[2];
+    int n = ir_successors(header, successors);
+    for (int s = 0; s < n; s++) {
+        successors[s]->preds[ir_pred_index(successors[s], entry)] = header;
+    }
+
+    ir_instr_t *jump = ir_new_instr(fn, IR_JUMP, NULL);
+    jump->targets[0] = header;
+    ir_append(entry, jump);
+    ir_add_pred(fn, header, entry);
+
+    // Keep the header next to the entry in the layout.
+    if (last != entry) {
+        last->next = NULL;
+        fn->last_block = last;
+        header->next = entry->next;
+        entry->next = header;
+    }
+    return header;
+}
+
+// Points every use of old other than from skip at replacement.
+static void replace_uses(ir_function_t *fn, ir_instr_t *old, ir_instr_t *replacement, ir_instr_t *skip) {
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        for (ir_instr_t *i = b->first; i; i = i->next) {
+            if (i == skip) continue;
+
+            for (int o = 0; o < i->operand_count; o++) {
+                if (i->operands[o] == old) {
+                    i->operands[o] = replacement;
+                }
+            }
+        }
+    }
+}
+
+static ir_instr_t *new_const(ir_function_t *fn, struct type *type, int value) {
+    ir_instr_t *constant = ir_new_instr(fn, IR_CONST, type);
+    constant->value = value;
+    return constant;
+}
+
+static ir_instr_t *new_combine(ir_function_t *fn, ir_opcode_t op, ir_instr_t *a, ir_instr_t *b) {
+    ir_instr_t *combine = ir_new_instr(fn, op, a->type);
+    ir_add_operand(fn, combine, a);
+    ir_add_operand(fn, combine, b);
+    return combine;
+}
+
+int ir_eliminate_tail_calls(ir_function_t *fn) {
+    work_stack_t sites;
+    work_stack_init(&sites, sizeof(tail_site_t));
+
+    ir_opcode_t op = IR_ADD;
+    int accumulates = 0;
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        tail_site_t site;
+        if (!find_site(fn, b, &site)) continue;
+
+        if (site.combine) {
+            if (accumulates && site.combine->op != op) continue;
+            op = site.combine->op;
+            accumulates = 1;
+        }
+        *(tail_site_t *) work_stack_push(&sites) = site;
+    }
+
+    if (sites.count == 0) {
+        work_stack_free(&sites);
+        return 0;
+    }
+
+    ir_block_t *entry = fn->entry;
+    ir_block_t *header = split_entry(fn);
+
+    // Site terminators are marked, so the other returns can be told apart.
+    for (ir_block_t *b = fn->entry; b; b = b->next) {
+        b->last->mark = 0;
+    }
+    for (size_t s = 0; s < sites.count; s++) {
+        tail_site_t *site = (tail_site_t *) sites.items + s;
+        if (site->block == entry) {
+            site->block = header;
+        }
+        site->block->last->mark = 1;
+    }
+
+    // A phi per parameter, indexed by its position in the declaration;
+    // parameters the body never reads have no IR_PARAM and need none.
+    int param_count = 0;
+    for (struct param_list *p = fn->decl->type->params; p; p = p->next) {
+        param_count++;
+    }
+    ir_instr_t **phis = calloc((size_t) param_count + 1, sizeof(ir_instr_t *));
+    if (!phis) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    for (ir_instr_t *param = entry->first; param->op == IR_PARAM; param = param->next) {
+        int index = 0;
+        for (struct param_list *p = fn->decl->type->params; p->name != param->text; p = p->next) {
+            index++;
+        }
+
+        phis[index] = ir_new_instr(fn, IR_PHI, param->type);
+        ir_add_operand(fn, phis[index], param);
+        ir_append(header, phis[index]);
+        replace_uses(fn, param, phis[index], phis[index]);
+    }
+
+    // The accumulator is combined into every return that is not a site.
+    ir_instr_t *accumulator = NULL;
+    if (accumulates) {
+        struct type *type = fn->decl->type->subtype;
+        ir_instr_t *identity = new_const(fn, type, op == IR_MUL);
+        ir_insert_before(entry->last, identity);
+
+        accumulator = ir_new_instr(fn, IR_PHI, type);
+        ir_add_operand(fn, accumulator, identity);
+        ir_append(header, accumulator);
+
+        for (ir_block_t *b = fn->entry; b; b = b->next) {
+            ir_instr_t *ret = b->last;
+            if (ret->op == IR_RETURN && ret->operand_count && !ret->mark) {
+                ir_instr_t *result = new_combine(fn, op, accumulator, ret->operands[0]);
+                ir_insert_before(ret, result);
+                ret->operands[0] = result;
+            }
+        }
+    }
+
+    for (size_t s = 0; s < sites.count; s++) {
+        tail_site_t *site = (tail_site_t *) sites.items + s;
+        ir_block_t *b = site->block;
+        ir_instr_t *call = site->call;
+
+        if (site->return_block) {
+            ir_remove_pred(site->return_block, ir_pred_index(site->return_block, b));
+        }
+        ir_remove(b->last);
+        if (site->combine) {
+            ir_remove(site->combine);
+        }
+        ir_remove(call);
+
+        for (int p = 0; p < param_count; p++) {
+            if (phis[p]) {
+                ir_add_operand(fn, phis[p], call->operands[p]);
+            }
+        }
+        if (accumulator) {
+            ir_instr_t *next = accumulator;
+            if (site->combine) {
+                ir_instr_t *factor = site->combine->operands[site->combine->operands[0] == call];
+                next = new_combine(fn, op, accumulator, factor);
+                ir_append(b, next);
+            }
+            ir_add_operand(fn, accumulator, next);
+        }
+
+        ir_instr_t *jump = ir_new_instr(fn, IR_JUMP, NULL);
+        jump->targets[0] = header;
+        ir_append(b, jump);
+        ir_add_pred(fn, header, b);
+    }
+
+    int converted = (int) sites.count;
+    free(phis);
+    work_stack_free(&sites);
+
+    ir_cleanup(fn);
+    return converted;
+}
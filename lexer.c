@@ -1,326 +1,259 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
+#include "intern.h"
 #include "lexer.h"
+#include "lexer_simd.h"
+#include "lexer_tables.h"
+
+static void seed_keywords(void) {
+    intern_define("if", TOKEN_IF);
+    intern_define("else", TOKEN_ELSE);
+    intern_define("for", TOKEN_FOR);
+    intern_define("return", TOKEN_RETURN);
+    intern_define("print", TOKEN_PRINT);
+    intern_define("void", TOKEN_VOID);
+    intern_define("boolean", TOKEN_BOOLEAN);
+    intern_define("char", TOKEN_CHAR);
+    intern_define("integer", TOKEN_INT);
+    intern_define("string", TOKEN_STRING_TYPE);
+    intern_define("array", TOKEN_ARRAY);
+    intern_define("function", TOKEN_FUNCTION);
+    intern_define("true", TOKEN_TRUE);
+    intern_define("false", TOKEN_FALSE);
+}
 
-lexer_t *init_lexer(char *input) {
+lexer_t *init_lexer(const char *input, size_t length) {
     lexer_t *lexer = malloc(sizeof(lexer_t));
     if (!lexer) return NULL;
 
     lexer->input = input;
     lexer->position = 0;
-    lexer->line = 1;
-    lexer->column = 1;
-    lexer->length = strlen(input);
+    lexer->length = length;
+    lexer->scanners = lexer_scanners();
+    lexer->filename = NULL;
+    lexer->line_starts = NULL;
+    lexer->line_count = 0;
+
+    seed_keywords();
 
     return lexer;
 }
 
 void free_lexer(lexer_t *lexer) {
     if (lexer) {
+        free(lexer->line_starts);
         free(lexer);
     }
 }
 
-static char peek(lexer_t *lexer) {
-    if (lexer->position >= lexer->length) {
-        return '\0';
-    }
-    return lexer->input[lexer->position];
-}
-
-static char peek_next(lexer_t *lexer) {
-    if (lexer->position + 1 >= lexer->length) {
-        return '\0';
-    }
-    return lexer->input[lexer->position + 1];
-}
-
-static char advance(lexer_t *lexer) {
-    char c = peek(lexer);
-    lexer->position++;
-    lexer->column++;
-
-    if (c == '\n') {
-        lexer->line++;
-        lexer->column = 1;
-    }
-
-    return c;
-}
-
 static void skip_whitespace(lexer_t *lexer) {
-    while (isspace(peek(lexer))) {
-        advance(lexer);
-    }
+    lexer->position = lexer->scanners->skip_whitespace(lexer->input, lexer->position, lexer->length);
 }
 
-static token_t create_token(token_type_t type, char *value, int line, int column) {
+static token_t create_token(token_type_t type, size_t offset, size_t length) {
     token_t token;
     token.type = type;
-    token.value = value;
-    token.line = line;
-    token.column = column;
+    token.offset = offset;
+    token.length = length;
+    token.name = NULL;
     return token;
 }
 
-static int is_keyword(const char *str) {
-    if (strcmp(str, "if") == 0) return TOKEN_IF;
-    if (strcmp(str, "else") == 0) return TOKEN_ELSE;
-    if (strcmp(str, "for") == 0) return TOKEN_FOR;
-    if (strcmp(str, "return") == 0) return TOKEN_RETURN;
-    if (strcmp(str, "print") == 0) return TOKEN_PRINT;
-    if (strcmp(str, "void") == 0) return TOKEN_VOID;
-    if (strcmp(str, "boolean") == 0) return TOKEN_BOOLEAN;
-    if (strcmp(str, "char") == 0) return TOKEN_CHAR;
-    if (strcmp(str, "integer") == 0) return TOKEN_INT;
-    if (strcmp(str, "string") == 0) return TOKEN_STRING_TYPE;
-    if (strcmp(str, "array") == 0) return TOKEN_ARRAY;
-    if (strcmp(str, "function") == 0) return TOKEN_FUNCTION;
-    if (strcmp(str, "true") == 0) return TOKEN_TRUE;
-    if (strcmp(str, "false") == 0) return TOKEN_FALSE;
-    return 0;
-}
-
-static token_t read_identifier(lexer_t *lexer) {
-    int start_pos = lexer->position;
-    int start_column = lexer->column;
-    int line = lexer->line;
+static int build_line_index(lexer_t *lexer) {
+    const lexer_scanners_t *scanners = lexer->scanners;
+    size_t count = scanners->count_newlines(lexer->input, 0, lexer->length) + 1;
 
-    while (isalnum(peek(lexer)) || peek(lexer) == '_') {
-        advance(lexer);
-    }
+    lexer->line_starts = malloc(count * sizeof(size_t));
+    if (!lexer->line_starts) return 0;
 
-    int length = lexer->position - start_pos;
-    char *value = malloc(length + 1);
-    strncpy(value, lexer->input + start_pos, length);
-    value[length] = '\0';
+    lexer->line_starts[0] = 0;
+    lexer->line_count = 1;
 
-    int keyword_type = is_keyword(value);
-    if (keyword_type) {
-        free(value);
-        return create_token(keyword_type, NULL, line, start_column);
+    // find_newline also stops at NUL bytes; step over those.
+    size_t position = 0;
+    while ((position = scanners->find_newline(lexer->input, position, lexer->length)) < lexer->length) {
+        if (lexer->input[position] == '\n') {
+            lexer->line_starts[lexer->line_count++] = position + 1;
+        }
+        position++;
     }
 
-    return create_token(TOKEN_IDENTIFIER, value, line, start_column);
+    return 1;
 }
 
-static token_t read_number(lexer_t *lexer) {
-    int start_pos = lexer->position;
-    int start_column = lexer->column;
-    int line = lexer->line;
-
-    while (isdigit(peek(lexer))) {
-        advance(lexer);
+void lexer_location(lexer_t *lexer, uint64_t offset, size_t *line, size_t *column) {
+    if (!lexer->line_starts && !build_line_index(lexer)) {
+        *line = 0;
+        *column = 0;
+        return;
     }
 
-    int length = lexer->position - start_pos;
-    char *value = malloc(length + 1);
-    strncpy(value, lexer->input + start_pos, length);
-    value[length] = '\0';
-
-    return create_token(TOKEN_INTEGER, value, line, start_column);
-}
-
-static token_t read_string(lexer_t *lexer) {
-    int start_pos = lexer->position;
-    int start_column = lexer->column;
-    int line = lexer->line;
-
-    advance(lexer);
-
-    while (peek(lexer) != '"' && peek(lexer) != '\0') {
-        if (peek(lexer) == '\\' && peek_next(lexer) == '"') {
-            advance(lexer);
+    // Find the last line that starts at or before offset.
+    size_t low = 0;
+    size_t high = lexer->line_count;
+    while (high - low > 1) {
+        size_t middle = low + (high - low) / 2;
+        if (lexer->line_starts[middle] <= offset) {
+            low = middle;
+        } else {
+            high = middle;
         }
-        advance(lexer);
     }
 
-    if (peek(lexer) == '\0') {
-        return create_token(TOKEN_EOF, NULL, line, start_column);
-    }
+    *line = low + 1;
+    *column = offset - lexer->line_starts[low] + 1;
+}
 
-    advance(lexer);
+token_t get_next_token(lexer_t *lexer) {
+    skip_whitespace(lexer);
 
-    int length = lexer->position - start_pos - 2;
-    char *value = malloc(length + 1);
-    strncpy(value, lexer->input + start_pos + 1, length);
-    value[length] = '\0';
+    const unsigned char *input = (const unsigned char *) lexer->input;
+    const lexer_scanners_t *scanners = lexer->scanners;
+    size_t start_pos = lexer->position;
 
-    return create_token(TOKEN_STRING, value, line, start_column);
-}
+    // Run the DFA as far as it goes and keep the longest accepted prefix.
+    int state = LEX_STATE_START;
+    size_t position = start_pos;
+    int accept_type = LEX_NO_ACCEPT;
+    size_t accept_end = start_pos;
 
-static token_t read_character(lexer_t *lexer) {
-    int start_pos = lexer->position;
-    int start_column = lexer->column;
-    int line = lexer->line;
+    while (position < lexer->length) {
+        state = lex_transition[state][lex_char_class[input[position]]];
+        if (state == LEX_STATE_DEAD) {
+            break;
+        }
 
-    advance(lexer);
+        position++;
 
-    if (peek(lexer) == '\\') {
-        advance(lexer);
-        if (peek(lexer) == 'n' || peek(lexer) == 't' || peek(lexer) == '\\' || peek(lexer) == '\'') {
-            advance(lexer);
+        // Comment and string bodies are skipped in bulk up to the next byte
+        // that can change the state.
+        if (state == LEX_STATE_LINE_COMMENT) {
+            position = scanners->find_newline(lexer->input, position, lexer->length);
+        } else if (state == LEX_STATE_BLOCK_COMMENT) {
+            position = scanners->find_comment_end(lexer->input, position, lexer->length);
+        } else if (state == LEX_STATE_STRING) {
+            position = scanners->find_string_special(lexer->input, position, lexer->length);
         }
-    } else if (peek(lexer) != '\'') {
-        advance(lexer);
-    }
 
-    if (peek(lexer) != '\'') {
-        return create_token(TOKEN_EOF, NULL, line, start_column);
+        if (lex_accept[state] != LEX_NO_ACCEPT) {
+            accept_type = lex_accept[state];
+            accept_end = position;
+        }
     }
 
-    advance(lexer);
-
-    int length = lexer->position - start_pos - 2;
-    char *value = malloc(length + 1);
-    strncpy(value, lexer->input + start_pos + 1, length);
-    value[length] = '\0';
-
-    return create_token(TOKEN_CHARACTER, value, line, start_column);
-}
+    if (accept_type == LEX_NO_ACCEPT) {
+        // End of input, an unknown character or an unterminated literal or
+        // comment: report end of input with the offending text as the token.
+        if (position == start_pos && position < lexer->length && input[position] != '\0') {
+            position++;
+        }
+        lexer->position = position;
+        return create_token(TOKEN_EOF, start_pos, position - start_pos);
+    }
 
-static token_t read_comment(lexer_t *lexer) {
-    int start_pos = lexer->position;
-    int start_column = lexer->column;
-    int line = lexer->line;
-
-    // Skip the first two characters: '/' and either '/' or '*'
-    advance(lexer);
-    advance(lexer);
-
-    if (lexer->input[start_pos + 1] == '*') {
-        // Multi-line comment
-        // Continue until we find closing */
-        while (!(peek(lexer) == '*' && peek_next(lexer) == '/')) {
-            if (peek(lexer) == '\0') {
-                // Reached end of file without closing comment
-                return create_token(TOKEN_EOF, NULL, line, start_column);
+    lexer->position = accept_end;
+    size_t length = accept_end - start_pos;
+
+    switch (accept_type) {
+        case TOKEN_IDENTIFIER: {
+            // Keywords are pre-seeded in the interner with their token type
+            // as tag; plain identifiers have tag 0.
+            int keyword_type = 0;
+            const char *name = intern_tagged(lexer->input + start_pos, length, &keyword_type);
+            if (keyword_type) {
+                return create_token(keyword_type, start_pos, length);
             }
-            advance(lexer);
-        }
 
-        // Skip the closing */
-        advance(lexer); // Skip *
-        advance(lexer); // Skip /
-
-        // Calculate the length and create token
-        int length = lexer->position - start_pos;
-        char *value = malloc(length + 1);
-        strncpy(value, lexer->input + start_pos, length);
-        value[length] = '\0';
-
-        return create_token(TOKEN_MULTI_COMMENT, value, line, start_column);
-    } else {
-        // Single-line comment
-        while (peek(lexer) != '\n' && peek(lexer) != '\0') {
-            advance(lexer);
+            token_t token = create_token(TOKEN_IDENTIFIER, start_pos, length);
+            token.name = name;
+            return token;
         }
 
-        int length = lexer->position - start_pos;
-        char *value = malloc(length + 1);
-        strncpy(value, lexer->input + start_pos, length);
-        value[length] = '\0';
+        case TOKEN_STRING:
+            // The slice excludes the surrounding quotes.
+            return create_token(TOKEN_STRING, start_pos + 1, length - 2);
+
+        case TOKEN_CHARACTER:
+            return create_token(TOKEN_CHARACTER, start_pos + 1, length - 2);
 
-        return create_token(TOKEN_COMMENT, value, line, start_column);
+        default:
+            return create_token(accept_type, start_pos, length);
     }
 }
 
-token_t get_next_token(lexer_t *lexer) {
-    skip_whitespace(lexer);
+static int grow_token_buffer(token_buffer_t *tokens) {
+    size_t capacity = tokens->capacity * 2;
 
-    char c = peek(lexer);
-    int line = lexer->line;
-    int column = lexer->column;
+    unsigned char *kinds = realloc(tokens->kinds, capacity * sizeof(unsigned char));
+    if (kinds) tokens->kinds = kinds;
+    uint64_t *offsets = realloc(tokens->offsets, capacity * sizeof(uint64_t));
+    if (offsets) tokens->offsets = offsets;
+    size_t *lengths = realloc(tokens->lengths, capacity * sizeof(size_t));
+    if (lengths) tokens->lengths = lengths;
+    const char **names = realloc(tokens->names, capacity * sizeof(const char *));
+    if (names) tokens->names = names;
 
-    if (c == '\0') {
-        return create_token(TOKEN_EOF, NULL, line, column);
+    if (!kinds || !offsets || !lengths || !names) {
+        return 0;
     }
 
-    if (isalpha(c) || c == '_') {
-        return read_identifier(lexer);
-    }
+    tokens->capacity = capacity;
+    return 1;
+}
 
-    if (isdigit(c)) {
-        return read_number(lexer);
+token_buffer_t *create_token_buffer(size_t capacity) {
+    token_buffer_t *tokens = malloc(sizeof(token_buffer_t));
+    if (!tokens) return NULL;
+
+    tokens->capacity = capacity ? capacity : 1;
+    tokens->count = 0;
+    tokens->complete = 0;
+    tokens->kinds = malloc(tokens->capacity * sizeof(unsigned char));
+    tokens->offsets = malloc(tokens->capacity * sizeof(uint64_t));
+    tokens->lengths = malloc(tokens->capacity * sizeof(size_t));
+    tokens->names = malloc(tokens->capacity * sizeof(const char *));
+
+    if (!tokens->kinds || !tokens->offsets || !tokens->lengths || !tokens->names) {
+        free_token_buffer(tokens);
+        return NULL;
     }
 
-    if (c == '"') {
-        return read_string(lexer);
-    }
+    return tokens;
+}
 
-    if (c == '\'') {
-        return read_character(lexer);
-    }
+size_t fill_token_buffer(lexer_t *lexer, token_buffer_t *tokens, size_t first, size_t wanted) {
+    // Move the tokens still needed to the front.
+    size_t kept = tokens->count - first;
+    memmove(tokens->kinds, tokens->kinds + first, kept * sizeof(unsigned char));
+    memmove(tokens->offsets, tokens->offsets + first, kept * sizeof(uint64_t));
+    memmove(tokens->lengths, tokens->lengths + first, kept * sizeof(size_t));
+    memmove(tokens->names, tokens->names + first, kept * sizeof(const char *));
+    tokens->count = kept;
+
+    while (!tokens->complete && (tokens->count < tokens->capacity || tokens->count < wanted)) {
+        if (tokens->count == tokens->capacity && !grow_token_buffer(tokens)) {
+            break;
+        }
 
-    if (c == '/' && (peek_next(lexer) == '/' || peek_next(lexer) == '*')) {
-        return read_comment(lexer);
+        token_t token = get_next_token(lexer);
+        tokens->kinds[tokens->count] = token.type;
+        tokens->offsets[tokens->count] = token.offset;
+        tokens->lengths[tokens->count] = token.length;
+        tokens->names[tokens->count] = token.name;
+        tokens->count++;
+        tokens->complete = token.type == TOKEN_EOF;
     }
 
-    advance(lexer);
-
-    switch (c) {
-        case '+': return create_token(TOKEN_PLUS, NULL, line, column);
-        case '-': return create_token(TOKEN_MINUS, NULL, line, column);
-        case '*': return create_token(TOKEN_STAR, NULL, line, column);
-        case '/': return create_token(TOKEN_SLASH, NULL, line, column);
-        case '%': return create_token(TOKEN_PERCENT, NULL, line, column);
-        case '^': return create_token(TOKEN_CARET, NULL, line, column);
-        case '(': return create_token(TOKEN_LPAREN, NULL, line, column);
-        case ')': return create_token(TOKEN_RPAREN, NULL, line, column);
-        case '{': return create_token(TOKEN_LBRACE, NULL, line, column);
-        case '}': return create_token(TOKEN_RBRACE, NULL, line, column);
-        case '[': return create_token(TOKEN_LBRACKET, NULL, line, column);
-        case ']': return create_token(TOKEN_RBRACKET, NULL, line, column);
-        case ';': return create_token(TOKEN_SEMICOLON, NULL, line, column);
-        case ':': return create_token(TOKEN_COLON, NULL, line, column);
-        case ',': return create_token(TOKEN_COMMA, NULL, line, column);
-
-        case '=':
-            if (peek(lexer) == '=') {
-                advance(lexer);
-                return create_token(TOKEN_EQ, NULL, line, column);
-            }
-            return create_token(TOKEN_ASSIGN, NULL, line, column);
-
-        case '!':
-            if (peek(lexer) == '=') {
-                advance(lexer);
-                return create_token(TOKEN_NEQ, NULL, line, column);
-            }
-            return create_token(TOKEN_NOT, NULL, line, column);
-
-        case '<':
-            if (peek(lexer) == '=') {
-                advance(lexer);
-                return create_token(TOKEN_LE, NULL, line, column);
-            }
-            return create_token(TOKEN_LT, NULL, line, column);
-
-        case '>':
-            if (peek(lexer) == '=') {
-                advance(lexer);
-                return create_token(TOKEN_GE, NULL, line, column);
-            }
-            return create_token(TOKEN_GT, NULL, line, column);
-
-        case '&':
-            if (peek(lexer) == '&') {
-                advance(lexer);
-                return create_token(TOKEN_AND, NULL, line, column);
-            }
-            break;
+    return first;
+}
 
-        case '|':
-            if (peek(lexer) == '|') {
-                advance(lexer);
-                return create_token(TOKEN_OR, NULL, line, column);
-            }
-            break;
-    }
+void free_token_buffer(token_buffer_t *tokens) {
+    if (!tokens) return;
 
-    char unknown[2] = {c, '\0'};
-    char *value = strdup(unknown);
-    return create_token(TOKEN_EOF, value, line, column);
-}
\ No newline at end of file
+    free(tokens->kinds);
+    free(tokens->offsets);
+    free(tokens->lengths);
+    free(tokens->names);
+    free(tokens);
+}
@@ -1,6 +1,10 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include "lexer_simd.h"
+
 typedef enum {
     TOKEN_EOF,
     TOKEN_IDENTIFIER,
@@ -50,23 +54,59 @@ typedef enum {
     TOKEN_MULTI_COMMENT
 } token_type_t;
 
+// A token does not own its text: offset and length describe a slice of the
+// lexer input, which must outlive every token taken from it. Identifiers
+// also carry their interned name. Tokens record no line or column; use
+// lexer_location to resolve an offset when a diagnostic needs one.
 typedef struct {
     token_type_t type;
-    char *value;
-    int line;
-    int column;
+    uint64_t offset;
+    size_t length;
+    const char *name;
 } token_t;
 
 typedef struct {
-    char *input;
-    int position;
-    int line;
-    int column;
-    int length;
+    const char *input;
+    size_t position;
+    size_t length;
+    const lexer_scanners_t *scanners;
+
+    // Name used in diagnostics, set by the caller.
+    const char *filename;
+
+    // Offsets at which each line starts, built on first use.
+    size_t *line_starts;
+    size_t line_count;
 } lexer_t;
 
-lexer_t *init_lexer(char *input);
+// A window of the token stream, stored as parallel arrays. The parser
+// refills it as it goes, so only the tokens around the current one are in
+// memory however long the input is; it grows when asked to look further
+// ahead than it holds. complete is set once TOKEN_EOF is in the buffer,
+// and it is always the last token then.
+typedef struct {
+    unsigned char *kinds;
+    uint64_t *offsets;
+    size_t *lengths;
+    const char **names;
+    size_t count;
+    size_t capacity;
+    int complete;
+} token_buffer_t;
+
+lexer_t *init_lexer(const char *input, size_t length);
 void free_lexer(lexer_t *lexer);
 token_t get_next_token(lexer_t *lexer);
 
+// Resolves a byte offset to a 1-based line and column.
+void lexer_location(lexer_t *lexer, uint64_t offset, size_t *line, size_t *column);
+
+token_buffer_t *create_token_buffer(size_t capacity);
+void free_token_buffer(token_buffer_t *tokens);
+
+// Drops the tokens before index first and lexes more until the buffer is
+// full, holds at least wanted tokens, or ends with TOKEN_EOF. Returns the
+// number of tokens dropped, by which the caller's indices move down.
+size_t fill_token_buffer(lexer_t *lexer, token_buffer_t *tokens, size_t first, size_t wanted);
+
 #endif
\ No newline at end of file
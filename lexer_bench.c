@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "source.h"
+#include "lexer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#endif
+
+// Lexer throughput benchmark. Lexes a file (or a synthetic input built from
+// a B-minor snippet) repeatedly and reports the scanning rate. On x86 the
+// rate is given in bytes per TSC cycle, elsewhere in bytes per nanosecond.
+//
+//   lexer_bench [file.b] [iterations]
+
+static const char *synthetic_snippet =
+    "// generated helper: computes the area of a rectangle from its sides\n"
+    "/* multi-line comment\n"
+    " * describing the function below, as emitted by our generators\n"
+    " * for every helper they produce.\n"
+    " */\n"
+    "helper_fn: function integer (w: integer, h: integer) = {\n"
+    "    area: integer = w * h + 42;\n"
+    "    if (area >= 100 && area != 7 || !false) {\n"
+    "        print \"area is: \", area, \"\\n\";\n"
+    "    }\n"
+    "    return area ^ 2 % 13;\n"
+    "}\n";
+
+static char *build_synthetic_input(size_t target, size_t *length) {
+    size_t snippet_length = strlen(synthetic_snippet);
+    size_t copies = target / snippet_length + 1;
+    char *input = malloc(copies * snippet_length + 1);
+    if (!input) return NULL;
+
+    for (size_t i = 0; i < copies; i++) {
+        memcpy(input + i * snippet_length, synthetic_snippet, snippet_length);
+    }
+    input[copies * snippet_length] = '\0';
+
+    *length = copies * snippet_length;
+    return input;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static unsigned long long now_ticks(void) {
+#ifdef BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return (unsigned long long) now_ns();
+#endif
+}
+
+int main(int argc, char *argv[]) {
+    source_t *source = NULL;
+    char *synthetic = NULL;
+    const char *input;
+    size_t length;
+
+    if (argc >= 2) {
+        source = load_source(argv[1]);
+        if (!source) {
+            fprintf(stderr, "lexer_bench: cannot read %s\n", argv[1]);
+            return 1;
+        }
+        input = source->data;
+        length = source->length;
+    } else {
+        synthetic = build_synthetic_input(8 << 20, &length);
+        if (!synthetic) return 1;
+        input = synthetic;
+    }
+
+    int iterations = argc >= 3 ? atoi(argv[2]) : 10;
+    if (iterations < 1) iterations = 1;
+
+    unsigned long long best_ticks = 0;
+    double best_ns = 0;
+    long tokens = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        lexer_t *lexer = init_lexer(input, length);
+
+        double start_ns = now_ns();
+        unsigned long long start_ticks = now_ticks();
+
+        long count = 0;
+        token_t token;
+        do {
+            token = get_next_token(lexer);
+            count++;
+        } while (token.type != TOKEN_EOF);
+
+        unsigned long long ticks = now_ticks() - start_ticks;
+        double ns = now_ns() - start_ns;
+
+        if (i == 0 || ticks < best_ticks) {
+            best_ticks = ticks;
+            best_ns = ns;
+        }
+        tokens = count;
+
+        free_lexer(lexer);
+    }
+
+    printf("input:      %zu bytes, %ld tokens\n", length, tokens);
+    printf("scanners:   %s\n", lexer_scanners()->name);
+    printf("best run:   %.3f ms\n", best_ns / 1e6);
+#ifdef BENCH_HAVE_TSC
+    printf("cycles:     %llu\n", best_ticks);
+    printf("throughput: %.3f bytes/cycle\n", (double) length / (double) best_ticks);
+#else
+    printf("throughput: %.3f bytes/ns\n", (double) length / best_ns);
+#endif
+    printf("            %.1f MB/s\n", length / (best_ns / 1e9) / (1 << 20));
+
+    free(synthetic);
+    free_source(source);
+
+    return 0;
+}
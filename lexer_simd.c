@@ -0,0 +1,263 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lexer_simd.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define LEXER_HAVE_X86_SIMD 1
+#endif
+
+static int is_whitespace(unsigned char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/* Scalar versions, also used for the tails of the vector versions. */
+
+static size_t skip_whitespace_scalar(const char *input, size_t position, size_t length) {
+    while (position < length && is_whitespace((unsigned char) input[position])) {
+        position++;
+    }
+    return position;
+}
+
+static size_t find_newline_scalar(const char *input, size_t position, size_t length) {
+    while (position < length && input[position] != '\n' && input[position] != '\0') {
+        position++;
+    }
+    return position;
+}
+
+static size_t find_comment_end_scalar(const char *input, size_t position, size_t length) {
+    while (position < length && input[position] != '\0') {
+        if (input[position] == '*' && position + 1 < length && input[position + 1] == '/') {
+            break;
+        }
+        position++;
+    }
+    return position;
+}
+
+static size_t find_string_special_scalar(const char *input, size_t position, size_t length) {
+    while (position < length && input[position] != '"' && input[position] != '\\' &&
+           input[position] != '\0') {
+        position++;
+    }
+    return position;
+}
+
+static size_t count_newlines_scalar(const char *input, size_t position, size_t length) {
+    size_t count = 0;
+    for (; position < length; position++) {
+        count += input[position] == '\n';
+    }
+    return count;
+}
+
+static const lexer_scanners_t scalar_scanners = {
+    "scalar",
+    skip_whitespace_scalar,
+    find_newline_scalar,
+    find_comment_end_scalar,
+    find_string_special_scalar,
+    count_newlines_scalar
+};
+
+#ifdef LEXER_HAVE_X86_SIMD
+
+/* SSE2, 16 bytes at a time. */
+
+#define SSE2 __attribute__((target("sse2")))
+
+SSE2 static unsigned whitespace_mask_sse2(__m128i v) {
+    __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    __m128i control = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('\t' - 1)),
+                                    _mm_cmplt_epi8(v, _mm_set1_epi8('\r' + 1)));
+    return (unsigned) _mm_movemask_epi8(_mm_or_si128(space, control));
+}
+
+SSE2 static unsigned byte_mask_sse2(__m128i v, char c) {
+    return (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(c)));
+}
+
+SSE2 static size_t skip_whitespace_sse2(const char *input, size_t position, size_t length) {
+    while (position + 16 <= length) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (input + position));
+        unsigned stop = ~whitespace_mask_sse2(v) & 0xFFFF;
+        if (stop) {
+            return position + __builtin_ctz(stop);
+        }
+        position += 16;
+    }
+    return skip_whitespace_scalar(input, position, length);
+}
+
+SSE2 static size_t find_newline_sse2(const char *input, size_t position, size_t length) {
+    while (position + 16 <= length) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (input + position));
+        unsigned found = byte_mask_sse2(v, '\n') | byte_mask_sse2(v, '\0');
+        if (found) {
+            return position + __builtin_ctz(found);
+        }
+        position += 16;
+    }
+    return find_newline_scalar(input, position, length);
+}
+
+SSE2 static size_t find_comment_end_sse2(const char *input, size_t position, size_t length) {
+    // The second load is shifted by one byte so a '*' and the '/' after it
+    // line up in the same lane.
+    while (position + 17 <= length) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (input + position));
+        __m128i next = _mm_loadu_si128((const __m128i *) (input + position + 1));
+        unsigned found = (byte_mask_sse2(v, '*') & byte_mask_sse2(next, '/')) | byte_mask_sse2(v, '\0');
+        if (found) {
+            return position + __builtin_ctz(found);
+        }
+        position += 16;
+    }
+    return find_comment_end_scalar(input, position, length);
+}
+
+SSE2 static size_t find_string_special_sse2(const char *input, size_t position, size_t length) {
+    while (position + 16 <= length) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (input + position));
+        unsigned found = byte_mask_sse2(v, '"') | byte_mask_sse2(v, '\\') | byte_mask_sse2(v, '\0');
+        if (found) {
+            return position + __builtin_ctz(found);
+        }
+        position += 16;
+    }
+    return find_string_special_scalar(input, position, length);
+}
+
+SSE2 static size_t count_newlines_sse2(const char *input, size_t position, size_t length) {
+    size_t count = 0;
+    while (position + 16 <= length) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (input + position));
+        count += __builtin_popcount(byte_mask_sse2(v, '\n'));
+        position += 16;
+    }
+    return count + count_newlines_scalar(input, position, length);
+}
+
+static const lexer_scanners_t sse2_scanners = {
+    "sse2",
+    skip_whitespace_sse2,
+    find_newline_sse2,
+    find_comment_end_sse2,
+    find_string_special_sse2,
+    count_newlines_sse2
+};
+
+/* AVX2, 32 bytes at a time. */
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static unsigned whitespace_mask_avx2(__m256i v) {
+    __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    __m256i control = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('\t' - 1)),
+                                       _mm256_cmpgt_epi8(_mm256_set1_epi8('\r' + 1), v));
+    return (unsigned) _mm256_movemask_epi8(_mm256_or_si256(space, control));
+}
+
+AVX2 static unsigned byte_mask_avx2(__m256i v, char c) {
+    return (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c)));
+}
+
+AVX2 static size_t skip_whitespace_avx2(const char *input, size_t position, size_t length) {
+    while (position + 32 <= length) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (input + position));
+        unsigned stop = ~whitespace_mask_avx2(v);
+        if (stop) {
+            return position + __builtin_ctz(stop);
+        }
+        position += 32;
+    }
+    return skip_whitespace_sse2(input, position, length);
+}
+
+AVX2 static size_t find_newline_avx2(const char *input, size_t position, size_t length) {
+    while (position + 32 <= length) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (input + position));
+        unsigned found = byte_mask_avx2(v, '\n') | byte_mask_avx2(v, '\0');
+        if (found) {
+            return position + __builtin_ctz(found);
+        }
+        position += 32;
+    }
+    return find_newline_sse2(input, position, length);
+}
+
+AVX2 static size_t find_comment_end_avx2(const char *input, size_t position, size_t length) {
+    while (position + 33 <= length) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (input + position));
+        __m256i next = _mm256_loadu_si256((const __m256i *) (input + position + 1));
+        unsigned found = (byte_mask_avx2(v, '*') & byte_mask_avx2(next, '/')) | byte_mask_avx2(v, '\0');
+        if (found) {
+            return position + __builtin_ctz(found);
+        }
+        position += 32;
+    }
+    return find_comment_end_sse2(input, position, length);
+}
+
+AVX2 static size_t find_string_special_avx2(const char *input, size_t position, size_t length) {
+    while (position + 32 <= length) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (input + position));
+        unsigned found = byte_mask_avx2(v, '"') | byte_mask_avx2(v, '\\') | byte_mask_avx2(v, '\0');
+        if (found) {
+            return position + __builtin_ctz(found);
+        }
+        position += 32;
+    }
+    return find_string_special_sse2(input, position, length);
+}
+
+AVX2 static size_t count_newlines_avx2(const char *input, size_t position, size_t length) {
+    size_t count = 0;
+    while (position + 32 <= length) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (input + position));
+        count += __builtin_popcount(byte_mask_avx2(v, '\n'));
+        position += 32;
+    }
+    return count + count_newlines_sse2(input, position, length);
+}
+
+static const lexer_scanners_t avx2_scanners = {
+    "avx2",
+    skip_whitespace_avx2,
+    find_newline_avx2,
+    find_comment_end_avx2,
+    find_string_special_avx2,
+    count_newlines_avx2
+};
+
+#endif
+
+static const lexer_scanners_t *select_scanners(void) {
+    const char *limit = getenv("BMINOR_SIMD");
+    if (limit && strcmp(limit, "scalar") == 0) {
+        return &scalar_scanners;
+    }
+
+#ifdef LEXER_HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (!(limit && strcmp(limit, "sse2") == 0) && __builtin_cpu_supports("avx2")) {
+        return &avx2_scanners;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return &sse2_scanners;
+    }
+#endif
+
+    return &scalar_scanners;
+}
+
+const lexer_scanners_t *lexer_scanners(void) {
+    static const lexer_scanners_t *selected = NULL;
+
+    if (!selected) {
+        selected = select_scanners();
+    }
+    return selected;
+}
@@ -0,0 +1,36 @@
+#ifndef LEXER_SIMD_H
+#define LEXER_SIMD_H
+
+#include <stddef.h>
+
+// Bulk scanners for the parts of the input the lexer can skip without
+// looking at individual characters: whitespace runs, comment bodies and
+// string bodies. There are SSE2 and AVX2 versions on x86 and a portable
+// scalar version everywhere; lexer_scanners() picks the widest one the CPU
+// supports. Setting BMINOR_SIMD to "scalar", "sse2" or "avx2" caps the
+// choice, which is mostly useful for benchmarking.
+//
+// All scanners take [position, length) and never read at or past length.
+
+typedef struct {
+    const char *name;
+
+    // Returns the offset of the first non-whitespace byte.
+    size_t (*skip_whitespace)(const char *input, size_t position, size_t length);
+
+    // Returns the offset of the first '\n' or NUL.
+    size_t (*find_newline)(const char *input, size_t position, size_t length);
+
+    // Returns the offset of the '*' of the first "*/", or of the first NUL.
+    size_t (*find_comment_end)(const char *input, size_t position, size_t length);
+
+    // Returns the offset of the first '"', '\\' or NUL.
+    size_t (*find_string_special)(const char *input, size_t position, size_t length);
+
+    // Returns the number of newlines in [position, length).
+    size_t (*count_newlines)(const char *input, size_t position, size_t length);
+} lexer_scanners_t;
+
+const lexer_scanners_t *lexer_scanners(void);
+
+#endif
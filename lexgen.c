@@ -0,0 +1,337 @@
+#include <stdio.h>
+#include <string.h>
+#include "lexer.h"
+
+// Build-time generator for the lexer tables. It writes lexer_tables.h, which
+// holds a 256-entry character class table, the DFA transition table over
+// those classes and the token each state accepts. get_next_token runs the
+// DFA with maximal munch: it keeps stepping until the dead state and returns
+// the last accepting state it passed through.
+
+typedef enum {
+    C_OTHER,
+    C_NUL,
+    C_SPACE,
+    C_NEWLINE,
+    C_LETTER,
+    C_ESCAPE_LETTER,
+    C_DIGIT,
+    C_DQUOTE,
+    C_SQUOTE,
+    C_BACKSLASH,
+    C_SLASH,
+    C_STAR,
+    C_PLUS,
+    C_MINUS,
+    C_PERCENT,
+    C_CARET,
+    C_LPAREN,
+    C_RPAREN,
+    C_LBRACE,
+    C_RBRACE,
+    C_LBRACKET,
+    C_RBRACKET,
+    C_SEMICOLON,
+    C_COLON,
+    C_COMMA,
+    C_EQUALS,
+    C_BANG,
+    C_LESS,
+    C_GREATER,
+    C_AMPERSAND,
+    C_PIPE,
+    CLASS_COUNT
+} char_class_t;
+
+static const char *class_names[CLASS_COUNT] = {
+    "OTHER", "NUL", "SPACE", "NEWLINE", "LETTER", "ESCAPE_LETTER", "DIGIT",
+    "DQUOTE", "SQUOTE", "BACKSLASH", "SLASH", "STAR", "PLUS", "MINUS",
+    "PERCENT", "CARET", "LPAREN", "RPAREN", "LBRACE", "RBRACE", "LBRACKET",
+    "RBRACKET", "SEMICOLON", "COLON", "COMMA", "EQUALS", "BANG", "LESS",
+    "GREATER", "AMPERSAND", "PIPE"
+};
+
+typedef enum {
+    S_DEAD,
+    S_START,
+    S_IDENTIFIER,
+    S_INTEGER,
+    S_STRING,
+    S_STRING_ESCAPE,
+    S_STRING_END,
+    S_CHAR_OPEN,
+    S_CHAR_ESCAPE,
+    S_CHAR_BODY,
+    S_CHAR_END,
+    S_SLASH,
+    S_LINE_COMMENT,
+    S_BLOCK_COMMENT,
+    S_BLOCK_COMMENT_STAR,
+    S_BLOCK_COMMENT_END,
+    S_PLUS,
+    S_MINUS,
+    S_STAR,
+    S_PERCENT,
+    S_CARET,
+    S_LPAREN,
+    S_RPAREN,
+    S_LBRACE,
+    S_RBRACE,
+    S_LBRACKET,
+    S_RBRACKET,
+    S_SEMICOLON,
+    S_COLON,
+    S_COMMA,
+    S_ASSIGN,
+    S_EQ,
+    S_NOT,
+    S_NEQ,
+    S_LT,
+    S_LE,
+    S_GT,
+    S_GE,
+    S_AMPERSAND,
+    S_AND,
+    S_PIPE,
+    S_OR,
+    STATE_COUNT
+} lex_state_t;
+
+static const char *state_names[STATE_COUNT] = {
+    "DEAD", "START", "IDENTIFIER", "INTEGER", "STRING", "STRING_ESCAPE",
+    "STRING_END", "CHAR_OPEN", "CHAR_ESCAPE", "CHAR_BODY", "CHAR_END",
+    "SLASH", "LINE_COMMENT", "BLOCK_COMMENT", "BLOCK_COMMENT_STAR",
+    "BLOCK_COMMENT_END", "PLUS", "MINUS", "STAR", "PERCENT", "CARET",
+    "LPAREN", "RPAREN", "LBRACE", "RBRACE", "LBRACKET", "RBRACKET",
+    "SEMICOLON", "COLON", "COMMA", "ASSIGN", "EQ", "NOT", "NEQ", "LT", "LE",
+    "GT", "GE", "AMPERSAND", "AND", "PIPE", "OR"
+};
+
+#define NO_ACCEPT 255
+
+static unsigned char char_class[256];
+static unsigned char transition[STATE_COUNT][CLASS_COUNT];
+static unsigned char accept[STATE_COUNT];
+
+static void on(lex_state_t from, char_class_t c, lex_state_t to) {
+    transition[from][c] = to;
+}
+
+// Every class except NUL, which marks the end of the input.
+static void on_any(lex_state_t from, lex_state_t to) {
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        if (c != C_NUL) {
+            transition[from][c] = to;
+        }
+    }
+}
+
+static void single(char_class_t c, lex_state_t state, token_type_t type) {
+    on(S_START, c, state);
+    accept[state] = type;
+}
+
+static void build_classes(void) {
+    for (int c = 0; c < 256; c++) {
+        char_class[c] = C_OTHER;
+    }
+
+    for (int c = 'a'; c <= 'z'; c++) char_class[c] = C_LETTER;
+    for (int c = 'A'; c <= 'Z'; c++) char_class[c] = C_LETTER;
+    for (int c = '0'; c <= '9'; c++) char_class[c] = C_DIGIT;
+
+    // 'n' and 't' are letters everywhere except after a backslash in a
+    // character literal, where they form an escape.
+    char_class['n'] = C_ESCAPE_LETTER;
+    char_class['t'] = C_ESCAPE_LETTER;
+    char_class['_'] = C_LETTER;
+
+    char_class['\0'] = C_NUL;
+    char_class[' '] = C_SPACE;
+    char_class['\t'] = C_SPACE;
+    char_class['\v'] = C_SPACE;
+    char_class['\f'] = C_SPACE;
+    char_class['\r'] = C_SPACE;
+    char_class['\n'] = C_NEWLINE;
+
+    char_class['"'] = C_DQUOTE;
+    char_class['\''] = C_SQUOTE;
+    char_class['\\'] = C_BACKSLASH;
+    char_class['/'] = C_SLASH;
+    char_class['*'] = C_STAR;
+    char_class['+'] = C_PLUS;
+    char_class['-'] = C_MINUS;
+    char_class['%'] = C_PERCENT;
+    char_class['^'] = C_CARET;
+    char_class['('] = C_LPAREN;
+    char_class[')'] = C_RPAREN;
+    char_class['{'] = C_LBRACE;
+    char_class['}'] = C_RBRACE;
+    char_class['['] = C_LBRACKET;
+    char_class[']'] = C_RBRACKET;
+    char_class[';'] = C_SEMICOLON;
+    char_class[':'] = C_COLON;
+    char_class[','] = C_COMMA;
+    char_class['='] = C_EQUALS;
+    char_class['!'] = C_BANG;
+    char_class['<'] = C_LESS;
+    char_class['>'] = C_GREATER;
+    char_class['&'] = C_AMPERSAND;
+    char_class['|'] = C_PIPE;
+}
+
+static void build_states(void) {
+    memset(transition, S_DEAD, sizeof(transition));
+    memset(accept, NO_ACCEPT, sizeof(accept));
+
+    // Identifiers and keywords; keywords are told apart after the match.
+    on(S_START, C_LETTER, S_IDENTIFIER);
+    on(S_START, C_ESCAPE_LETTER, S_IDENTIFIER);
+    on(S_IDENTIFIER, C_LETTER, S_IDENTIFIER);
+    on(S_IDENTIFIER, C_ESCAPE_LETTER, S_IDENTIFIER);
+    on(S_IDENTIFIER, C_DIGIT, S_IDENTIFIER);
+    accept[S_IDENTIFIER] = TOKEN_IDENTIFIER;
+
+    on(S_START, C_DIGIT, S_INTEGER);
+    on(S_INTEGER, C_DIGIT, S_INTEGER);
+    accept[S_INTEGER] = TOKEN_INTEGER;
+
+    // "..." with backslash escaping the following character.
+    on(S_START, C_DQUOTE, S_STRING);
+    on_any(S_STRING, S_STRING);
+    on(S_STRING, C_BACKSLASH, S_STRING_ESCAPE);
+    on(S_STRING, C_DQUOTE, S_STRING_END);
+    on_any(S_STRING_ESCAPE, S_STRING);
+    accept[S_STRING_END] = TOKEN_STRING;
+
+    // 'c', '\n', '\t', '\\' and '\''.
+    on(S_START, C_SQUOTE, S_CHAR_OPEN);
+    on_any(S_CHAR_OPEN, S_CHAR_BODY);
+    on(S_CHAR_OPEN, C_SQUOTE, S_DEAD);
+    on(S_CHAR_OPEN, C_BACKSLASH, S_CHAR_ESCAPE);
+    on(S_CHAR_ESCAPE, C_ESCAPE_LETTER, S_CHAR_BODY);
+    on(S_CHAR_ESCAPE, C_BACKSLASH, S_CHAR_BODY);
+    on(S_CHAR_ESCAPE, C_SQUOTE, S_CHAR_BODY);
+    on(S_CHAR_BODY, C_SQUOTE, S_CHAR_END);
+    accept[S_CHAR_END] = TOKEN_CHARACTER;
+
+    // '/' is division unless it starts a // or /* comment.
+    single(C_SLASH, S_SLASH, TOKEN_SLASH);
+    on(S_SLASH, C_SLASH, S_LINE_COMMENT);
+    on_any(S_LINE_COMMENT, S_LINE_COMMENT);
+    on(S_LINE_COMMENT, C_NEWLINE, S_DEAD);
+    accept[S_LINE_COMMENT] = TOKEN_COMMENT;
+
+    on(S_SLASH, C_STAR, S_BLOCK_COMMENT);
+    on_any(S_BLOCK_COMMENT, S_BLOCK_COMMENT);
+    on(S_BLOCK_COMMENT, C_STAR, S_BLOCK_COMMENT_STAR);
+    on_any(S_BLOCK_COMMENT_STAR, S_BLOCK_COMMENT);
+    on(S_BLOCK_COMMENT_STAR, C_STAR, S_BLOCK_COMMENT_STAR);
+    on(S_BLOCK_COMMENT_STAR, C_SLASH, S_BLOCK_COMMENT_END);
+    accept[S_BLOCK_COMMENT_END] = TOKEN_MULTI_COMMENT;
+
+    single(C_PLUS, S_PLUS, TOKEN_PLUS);
+    single(C_MINUS, S_MINUS, TOKEN_MINUS);
+    single(C_STAR, S_STAR, TOKEN_STAR);
+    single(C_PERCENT, S_PERCENT, TOKEN_PERCENT);
+    single(C_CARET, S_CARET, TOKEN_CARET);
+    single(C_LPAREN, S_LPAREN, TOKEN_LPAREN);
+    single(C_RPAREN, S_RPAREN, TOKEN_RPAREN);
+    single(C_LBRACE, S_LBRACE, TOKEN_LBRACE);
+    single(C_RBRACE, S_RBRACE, TOKEN_RBRACE);
+    single(C_LBRACKET, S_LBRACKET, TOKEN_LBRACKET);
+    single(C_RBRACKET, S_RBRACKET, TOKEN_RBRACKET);
+    single(C_SEMICOLON, S_SEMICOLON, TOKEN_SEMICOLON);
+    single(C_COLON, S_COLON, TOKEN_COLON);
+    single(C_COMMA, S_COMMA, TOKEN_COMMA);
+
+    single(C_EQUALS, S_ASSIGN, TOKEN_ASSIGN);
+    on(S_ASSIGN, C_EQUALS, S_EQ);
+    accept[S_EQ] = TOKEN_EQ;
+
+    single(C_BANG, S_NOT, TOKEN_NOT);
+    on(S_NOT, C_EQUALS, S_NEQ);
+    accept[S_NEQ] = TOKEN_NEQ;
+
+    single(C_LESS, S_LT, TOKEN_LT);
+    on(S_LT, C_EQUALS, S_LE);
+    accept[S_LE] = TOKEN_LE;
+
+    single(C_GREATER, S_GT, TOKEN_GT);
+    on(S_GT, C_EQUALS, S_GE);
+    accept[S_GE] = TOKEN_GE;
+
+    // A lone '&' or '|' is not a token.
+    on(S_START, C_AMPERSAND, S_AMPERSAND);
+    on(S_AMPERSAND, C_AMPERSAND, S_AND);
+    accept[S_AND] = TOKEN_AND;
+
+    on(S_START, C_PIPE, S_PIPE);
+    on(S_PIPE, C_PIPE, S_OR);
+    accept[S_OR] = TOKEN_OR;
+}
+
+static void write_tables(FILE *output) {
+    fprintf(output, "/* Generated by lexgen from lexgen.c. Do not edit. */\n\n");
+    fprintf(output, "#ifndef LEXER_TABLES_H\n");
+    fprintf(output, "#define LEXER_TABLES_H\n\n");
+
+    fprintf(output, "#define LEX_CLASS_COUNT %d\n", CLASS_COUNT);
+    fprintf(output, "#define LEX_STATE_COUNT %d\n", STATE_COUNT);
+    fprintf(output, "#define LEX_NO_ACCEPT %d\n\n", NO_ACCEPT);
+
+    for (int c = 0; c < CLASS_COUNT; c++) {
+        fprintf(output, "#define LEX_CLASS_%s %d\n", class_names[c], c);
+    }
+    fprintf(output, "\n");
+
+    for (int s = 0; s < STATE_COUNT; s++) {
+        fprintf(output, "#define LEX_STATE_%s %d\n", state_names[s], s);
+    }
+    fprintf(output, "\n");
+
+    fprintf(output, "static const unsigned char lex_char_class[256] = {");
+    for (int c = 0; c < 256; c++) {
+        fprintf(output, "%s%2d,", c % 16 == 0 ? "\n    " : " ", char_class[c]);
+    }
+    fprintf(output, "\n};\n\n");
+
+    fprintf(output, "static const unsigned char lex_transition[LEX_STATE_COUNT][LEX_CLASS_COUNT] = {\n");
+    for (int s = 0; s < STATE_COUNT; s++) {
+        fprintf(output, "    /* %-18s */ {", state_names[s]);
+        for (int c = 0; c < CLASS_COUNT; c++) {
+            fprintf(output, "%s%2d", c ? ", " : "", transition[s][c]);
+        }
+        fprintf(output, "},\n");
+    }
+    fprintf(output, "};\n\n");
+
+    fprintf(output, "static const unsigned char lex_accept[LEX_STATE_COUNT] = {\n");
+    for (int s = 0; s < STATE_COUNT; s++) {
+        fprintf(output, "    /* %-18s */ %d,\n", state_names[s], accept[s]);
+    }
+    fprintf(output, "};\n\n");
+
+    fprintf(output, "#endif\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <output header>\n", argv[0]);
+        return 1;
+    }
+
+    build_classes();
+    build_states();
+
+    FILE *output = fopen(argv[1], "w");
+    if (!output) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    write_tables(output);
+    fclose(output);
+
+    return 0;
+}
@@ -1,49 +1,117 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "source.h"
+#include "arena.h"
+#include "intern.h"
 #include "lexer.h"
 #include "parser.h"
+#include "ast_compact.h"
+#include "typecheck.h"
+#include "ctfe.h"
+#include "fold.h"
+#include "ipcp.h"
+#include "dce.h"
+#include "shake.h"
 #include "codegen.h"
 
 int main(int argc, char *argv[]) {
     char input_file_name[256];
-    if (argc < 2) {
-        strcpy(input_file_name, "example.b");
-    } else {
-        strcpy(input_file_name, argv[1]);
+    int ast_stats = 0;
+    int tree_shake = 1;
+    int ctfe = 1;
+    int specialize_budget = DEFAULT_SPECIALIZE_BUDGET;
+    codegen_options_t codegen_options = {1, NULL, DEFAULT_INLINE_BUDGET, 0, 0};
+
+    strcpy(input_file_name, "example.b");
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ast-stats") == 0) {
+            ast_stats = 1;
+        } else if (strcmp(argv[i], "--no-tree-shake") == 0) {
+            tree_shake = 0;
+        } else if (strcmp(argv[i], "--no-ctfe") == 0) {
+            ctfe = 0;
+        } else if (strncmp(argv[i], "--specialize-budget=", 20) == 0) {
+            specialize_budget = atoi(argv[i] + 20);
+        } else if (strcmp(argv[i], "--ast-codegen") == 0) {
+            codegen_options.use_ir = 0;
+        } else if (strcmp(argv[i], "--dump-ir") == 0) {
+            codegen_options.dump_ir = stderr;
+        } else if (strncmp(argv[i], "--inline-budget=", 16) == 0) {
+            codegen_options.inline_budget = atoi(argv[i] + 16);
+        } else if (strcmp(argv[i], "--memoize") == 0) {
+            codegen_options.memoize = 1;
+        } else if (strcmp(argv[i], "--memo-stats") == 0) {
+            codegen_options.memo_stats = 1;
+        } else if (argv[i][0] == '-' && argv[i][1] == '-') {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 1;
+        } else {
+            snprintf(input_file_name, sizeof(input_file_name), "%s", argv[i]);
+        }
     }
-    
-    FILE *input_file = fopen(input_file_name, "r");
-    if (!input_file) {
+
+    source_t *source = load_source(input_file_name);
+    if (!source) {
         return 1;
     }
 
-    fseek(input_file, 0, SEEK_END);
-    long file_size = ftell(input_file);
-    fseek(input_file, 0, SEEK_SET);
-
-    char *input = malloc(file_size + 1);
-    fread(input, 1, file_size, input_file);
-    input[file_size] = '\0';
-    fclose(input_file);
+    // Everything the AST needs lives in this arena and goes in one release.
+    arena_t *ast_arena = arena_create(0);
+    ast_set_arena(ast_arena);
 
-    lexer_t *lexer = init_lexer(input);
+    lexer_t *lexer = init_lexer(source->data, source->length);
+    lexer->filename = input_file_name;
     parser_t *parser = init_parser(lexer);
     struct decl *program = parse_program(parser);
 
+    if (program && ast_stats) {
+        compact_ast_t *compact = compact_from_ast(program);
+        fprintf(stderr, "AST: %zu bytes as pointers, %zu bytes compact\n",
+                ast_size(program), compact_ast_size(compact));
+        free_compact_ast(compact);
+    }
+
+    int status = 0;
+    if (program && typecheck_program(program) > 0) {
+        status = 1;
+        program = NULL;
+    }
+
+    if (program) {
+        if (ctfe) {
+            evaluate_constant_calls(program);
+        }
+        fold_program(program);
+        program = propagate_constants(program, specialize_budget);
+        eliminate_dead_code(program);
+
+        if (tree_shake) {
+            program = shake_program(program);
+        }
+    }
+
     if (program) {
         char output_filename[256];
         snprintf(output_filename, sizeof(output_filename), "%s.c", input_file_name);
 
         FILE *output_file = fopen(output_filename, "w");
         if (output_file) {
-            generate_c_code(program, output_file);
+            int errors = generate_c_code(program, &codegen_options, output_file);
             fclose(output_file);
+            if (errors > 0) {
+                remove(output_filename);
+                status = 1;
+            }
         }
     }
 
     free_parser(parser);
-    free(input);
+    free_lexer(lexer);
+    free_source(source);
+    ast_set_arena(NULL);
+    arena_destroy(ast_arena);
+    intern_reset();
 
-    return 0;
+    return status;
 }
\ No newline at end of file
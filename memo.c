@@ -0,0 +1,123 @@
+#include <string.h>
+#include "memo.h"
+#include "codegen.h"
+#include "runtime.h"
+
+int is_memo_pragma(struct decl *comment) {
+    return (comment->kind == DECL_COMMENT || comment->kind == DECL_MULTI_COMMENT) && comment->comment_text &&
+           strstr(comment->comment_text, "pragma memoize") != NULL;
+}
+
+static int is_key_type(struct type *t) {
+    return t->kind == TYPE_INTEGER || t->kind == TYPE_CHARACTER || t->kind == TYPE_BOOLEAN;
+}
+
+int can_memoize(struct decl *d, const effects_t *effects, const char **reason) {
+    if (!d->code) {
+        *reason = "it has no body";
+        return 0;
+    }
+    if (!is_key_type(d->type->subtype)) {
+        *reason = "it does not return an integer, char or boolean";
+        return 0;
+    }
+    for (struct param_list *p = d->type->params; p; p = p->next) {
+        if (!is_key_type(p->type)) {
+            *reason = "it takes a parameter that is not an integer, char or boolean";
+            return 0;
+        }
+    }
+    if (function_effect(effects, d->name) != EFFECT_CONST) {
+        *reason = "its result depends on more than its arguments";
+        return 0;
+    }
+    return 1;
+}
+
+void memo_body_name(struct decl *d, char *name, size_t size) {
+    snprintf(name, size, "bminor_compute_%s", d->name);
+}
+
+static void emit_key_match(struct decl *d, FILE *output) {
+    int k = 0;
+    for (struct param_list *p = d->type->params; p; p = p->next, k++) {
+        fprintf(output, " && bminor_table_%s[bminor_slot].key%d == %s", d->name, k, c_name(p->name));
+    }
+}
+
+void emit_memo_wrapper(struct decl *d, const char *linkage, int stats, FILE *output) {
+    const char *name = d->name;
+    int key_count = 0;
+    for (struct param_list *p = d->type->params; p; p = p->next) {
+        key_count++;
+    }
+
+    fprintf(output, "static struct {\n\tint used;\n");
+    for (int k = 0; k < key_count; k++) {
+        fprintf(output, "\tint key%d;\n", k);
+    }
+    fprintf(output, "\t");
+    generate_type_c(d->type->subtype, output);
+    fprintf(output, " value;\n} bminor_table_%s[%d];\n", name, key_count ? MEMO_TABLE_SIZE : 1);
+    if (stats) {
+        fprintf(output, "static long bminor_hits_%s;\n", name);
+        fprintf(output, "static long bminor_misses_%s;\n", name);
+    }
+    fprintf(output, "\n");
+
+    generate_signature_c(d, c_name(name), linkage, output);
+    fprintf(output, ") {\n");
+
+    fprintf(output, "\tunsigned int bminor_slot = 0;\n");
+    for (struct param_list *p = d->type->params; p; p = p->next) {
+        fprintf(output, "\tbminor_slot = bminor_memo_hash(bminor_slot, %s);\n", c_name(p->name));
+    }
+    if (key_count) {
+        fprintf(output, "\tbminor_slot %%= %du;\n", MEMO_TABLE_SIZE);
+    }
+
+    fprintf(output, "\tif (bminor_table_%s[bminor_slot].used", name);
+    emit_key_match(d, output);
+    fprintf(output, ") {\n");
+    if (stats) {
+        fprintf(output, "\t\tbminor_hits_%s++;\n", name);
+    }
+    fprintf(output, "\t\treturn bminor_table_%s[bminor_slot].value;\n\t}\n", name);
+
+    if (stats) {
+        fprintf(output, "\tbminor_memo_start_report();\n");
+        fprintf(output, "\tbminor_misses_%s++;\n", name);
+    }
+
+    // The body may have reused the slot for other arguments on the way;
+    // the latest call wins.
+    char body[256];
+    memo_body_name(d, body, sizeof(body));
+    fprintf(output, "\t");
+    generate_type_c(d->type->subtype, output);
+    fprintf(output, " bminor_value = %s(", body);
+    for (struct param_list *p = d->type->params; p; p = p->next) {
+        fprintf(output, "%s%s", c_name(p->name), p->next ? ", " : "");
+    }
+    fprintf(output, ");\n");
+
+    fprintf(output, "\tbminor_table_%s[bminor_slot].used = 1;\n", name);
+    int k = 0;
+    for (struct param_list *p = d->type->params; p; p = p->next, k++) {
+        fprintf(output, "\tbminor_table_%s[bminor_slot].key%d = %s;\n", name, k, c_name(p->name));
+    }
+    fprintf(output, "\tbminor_table_%s[bminor_slot].value = bminor_value;\n", name);
+    fprintf(output, "\treturn bminor_value;\n}\n\n");
+}
+
+void emit_memo_report(struct decl **memoized, size_t count, FILE *output) {
+    fprintf(output, "static void bminor_memo_report(void) {\n");
+    for (size_t m = 0; m < count; m++) {
+        const char *name = memoized[m]->name;
+        fprintf(output, "\tfprintf(stderr, \"memo %s: %%ld hits, %%ld misses, %%.1f%%%% hit rate\\n\", "
+                        "bminor_hits_%s, bminor_misses_%s,\n", name, name, name);
+        fprintf(output, "\t        bminor_hits_%s ? 100.0 * bminor_hits_%s / "
+                        "(bminor_hits_%s + bminor_misses_%s) : 0.0);\n", name, name, name, name);
+    }
+    fprintf(output, "}\n\n");
+}
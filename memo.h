@@ -0,0 +1,38 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <stdio.h>
+#include "ast.h"
+#include "effects.h"
+
+// Memoization, opt-in per function or for the whole program. A memoized
+// function's body is emitted under another name, and the function itself
+// becomes a wrapper that looks its arguments up in a direct-mapped table
+// before calling the body. Recursive calls in the body go through the
+// wrapper, so a function like fib runs once per distinct argument.
+//
+// Only functions whose result depends on nothing but their arguments
+// qualify: const ones (see effects.h) returning a value, with integer,
+// char or boolean parameters.
+
+#define MEMO_TABLE_SIZE 4096
+
+// Whether the comment asks for the declaration after it to be memoized:
+// it contains "pragma memoize".
+int is_memo_pragma(struct decl *comment);
+
+// Whether d can be memoized; otherwise *reason says why not.
+int can_memoize(struct decl *d, const effects_t *effects, const char **reason);
+
+// Name the body of a memoized function is emitted under.
+void memo_body_name(struct decl *d, char *name, size_t size);
+
+// Emits the table and the wrapper for d, whose body is already out under
+// memo_body_name. The wrapper gets linkage only, never const or pure,
+// since it writes the table. With stats, it counts hits and misses.
+void emit_memo_wrapper(struct decl *d, const char *linkage, int stats, FILE *output);
+
+// Emits the report the runtime prints at exit for the memoized functions.
+void emit_memo_report(struct decl **memoized, size_t count, FILE *output);
+
+#endif
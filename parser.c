@@ -1,24 +1,93 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "parser.h"
+#include "work_stack.h"
 
 static void parse_error(parser_t *parser, const char *message) {
+    size_t line, column;
+    lexer_location(parser->lexer, parser->tokens->offsets[parser->position], &line, &column);
+
+    fprintf(stderr, "%s:%zu:%zu: error: %s\n",
+            parser->lexer->filename ? parser->lexer->filename : "<input>", line, column, message);
     exit(0);
 }
 
+// Tokens are lexed this many at a time as the parser reaches them.
+#define TOKEN_WINDOW 4096
+
+// Makes sure the token k positions past the current one is in the buffer,
+// unless the input ends before it. Everything before the current token has
+// been parsed and is dropped to make room.
+static void need_tokens(parser_t *parser, size_t k) {
+    token_buffer_t *tokens = parser->tokens;
+    if (parser->position + k < tokens->count || tokens->complete) return;
+
+    parser->position -= fill_token_buffer(parser->lexer, tokens, parser->position, k + 1);
+    if (parser->position + k >= tokens->count && !tokens->complete) {
+        parse_error(parser, "Out of memory while reading tokens");
+    }
+}
+
+// Type of the token k positions past the current one. Looking past the end
+// keeps returning the final TOKEN_EOF.
+static token_type_t peek_type(parser_t *parser, size_t k) {
+    need_tokens(parser, k);
+    size_t index = parser->position + k;
+    if (index >= parser->tokens->count) {
+        index = parser->tokens->count - 1;
+    }
+    return parser->tokens->kinds[index];
+}
+
+static token_type_t current_type(parser_t *parser) {
+    return parser->tokens->kinds[parser->position];
+}
+
+static const char *current_name(parser_t *parser) {
+    return parser->tokens->names[parser->position];
+}
+
+static const char *current_start(parser_t *parser) {
+    return parser->lexer->input + parser->tokens->offsets[parser->position];
+}
+
+static char *current_text(parser_t *parser) {
+    return ast_strndup(current_start(parser), parser->tokens->lengths[parser->position]);
+}
+
 static void eat(parser_t *parser, token_type_t type) {
-    if (parser->current_token.type == type) {
-        free(parser->current_token.value);
-        parser->current_token = get_next_token(parser->lexer);
+    if (current_type(parser) == type) {
+        if (type != TOKEN_EOF) {
+            parser->position++;
+            need_tokens(parser, 0);
+        }
     } else {
         char error[256];
         snprintf(error, sizeof(error), "Expected token type %d, got %d",
-                 type, parser->current_token.type);
+                 type, current_type(parser));
         parse_error(parser, error);
     }
 }
 
+// An integer is an int, so a literal past INT_MAX is an error; -INT_MAX - 1
+// can only be written as an expression.
+static int token_int_value(parser_t *parser) {
+    const char *digits = current_start(parser);
+    int value = 0;
+
+    for (size_t i = 0; i < parser->tokens->lengths[parser->position]; i++) {
+        int digit = digits[i] - '0';
+        if (value > (INT_MAX - digit) / 10) {
+            parse_error(parser, "Integer literal out of range");
+        }
+        value = value * 10 + digit;
+    }
+
+    return value;
+}
+
 static struct type *parse_type(parser_t *parser);
 static struct expr *parse_expr(parser_t *parser);
 static struct stmt *parse_stmt(parser_t *parser);
@@ -30,26 +99,38 @@ parser_t *init_parser(lexer_t *lexer) {
     if (!parser) return NULL;
 
     parser->lexer = lexer;
-    parser->current_token = get_next_token(lexer);
+    parser->tokens = create_token_buffer(TOKEN_WINDOW);
+    parser->position = 0;
+
+    if (!parser->tokens) {
+        free(parser);
+        return NULL;
+    }
+    fill_token_buffer(lexer, parser->tokens, 0, 1);
+    if (parser->tokens->count == 0) {
+        free_parser(parser);
+        return NULL;
+    }
+
     return parser;
 }
 
 void free_parser(parser_t *parser) {
     if (!parser) return;
 
-    free(parser->current_token.value);
+    free_token_buffer(parser->tokens);
     free(parser);
 }
 
 static struct decl *parse_comment_decl(parser_t *parser) {
     struct decl *d = NULL;
 
-    if (parser->current_token.type == TOKEN_COMMENT) {
-        char *comment_text = strdup(parser->current_token.value);
+    if (current_type(parser) == TOKEN_COMMENT) {
+        char *comment_text = current_text(parser);
         eat(parser, TOKEN_COMMENT);
         d = create_comment_decl(comment_text, 0, NULL);
-    } else if (parser->current_token.type == TOKEN_MULTI_COMMENT) {
-        char *comment_text = strdup(parser->current_token.value);
+    } else if (current_type(parser) == TOKEN_MULTI_COMMENT) {
+        char *comment_text = current_text(parser);
         eat(parser, TOKEN_MULTI_COMMENT);
         d = create_comment_decl(comment_text, 1, NULL);
     }
@@ -60,7 +141,7 @@ static struct decl *parse_comment_decl(parser_t *parser) {
 static struct type *parse_type(parser_t *parser) {
     struct type *t = NULL;
 
-    if (parser->current_token.type == TOKEN_ARRAY) {
+    if (current_type(parser) == TOKEN_ARRAY) {
         eat(parser, TOKEN_ARRAY);
 
         eat(parser, TOKEN_LBRACKET);
@@ -73,7 +154,7 @@ static struct type *parse_type(parser_t *parser) {
         t->array_size = size_expr;
 
         return t;
-    } else if (parser->current_token.type == TOKEN_FUNCTION) {
+    } else if (current_type(parser) == TOKEN_FUNCTION) {
         eat(parser, TOKEN_FUNCTION);
 
         struct type *return_type = parse_type(parser);
@@ -82,16 +163,16 @@ static struct type *parse_type(parser_t *parser) {
 
         eat(parser, TOKEN_LPAREN);
 
-        if (parser->current_token.type != TOKEN_RPAREN) {
+        if (current_type(parser) != TOKEN_RPAREN) {
             struct param_list *params = NULL;
             struct param_list *current = NULL;
 
             do {
-                if (parser->current_token.type != TOKEN_IDENTIFIER) {
+                if (current_type(parser) != TOKEN_IDENTIFIER) {
                     parse_error(parser, "Expected parameter name");
                 }
 
-                char *param_name = strdup(parser->current_token.value);
+                const char *param_name = current_name(parser);
                 eat(parser, TOKEN_IDENTIFIER);
 
                 eat(parser, TOKEN_COLON);
@@ -107,7 +188,7 @@ static struct type *parse_type(parser_t *parser) {
                     current->next = p;
                     current = p;
                 }
-            } while (parser->current_token.type == TOKEN_COMMA && (eat(parser, TOKEN_COMMA), 1));
+            } while (current_type(parser) == TOKEN_COMMA && (eat(parser, TOKEN_COMMA), 1));
 
             t->params = params;
         }
@@ -116,7 +197,7 @@ static struct type *parse_type(parser_t *parser) {
         return t;
     }
 
-    switch (parser->current_token.type) {
+    switch (current_type(parser)) {
         case TOKEN_VOID:
             eat(parser, TOKEN_VOID);
             t = create_type(TYPE_VOID, NULL, NULL);
@@ -144,67 +225,27 @@ static struct type *parse_type(parser_t *parser) {
     return t;
 }
 
-static struct expr *parse_array_initializer(parser_t *parser) {
-    eat(parser, TOKEN_LBRACE);
-
-    struct expr *array_expr = NULL;
-    struct expr *current = NULL;
-    int count = 0;
-
-    if (parser->current_token.type != TOKEN_RBRACE) {
-        do {
-            struct expr *element = parse_expr(parser);
-
-            if (!element) {
-                parse_error(parser, "Expected expression in array initializer");
-            }
-
-            count++;
-
-            if (!array_expr) {
-                array_expr = element;
-                current = element;
-            } else {
-                current->right = element;
-                current = element;
-            }
-        } while (parser->current_token.type == TOKEN_COMMA && (eat(parser, TOKEN_COMMA), 1));
-    }
-
-    eat(parser, TOKEN_RBRACE);
-
-    struct expr *e = create_expr(EXPR_ARRAY_LITERAL, NULL, array_expr);
-
-    if (!e) {
-        parse_error(parser, "Failed to create array literal expression");
-    }
-
-    if (!e->right && count > 0) {
-        parse_error(parser, "Array literal right pointer is NULL but should have elements");
-    }
-
-    return e;
-}
-
+// Literals and names. Parenthesized expressions and array literals are
+// handled by parse_operators.
 static struct expr *parse_primary_expr(parser_t *parser) {
     struct expr *e = NULL;
 
-    switch (parser->current_token.type) {
+    switch (current_type(parser)) {
         case TOKEN_INTEGER:
             e = create_expr(EXPR_INTEGER_LITERAL, NULL, NULL);
-            e->integer_value = atoi(parser->current_token.value);
+            e->integer_value = token_int_value(parser);
             eat(parser, TOKEN_INTEGER);
             break;
 
         case TOKEN_STRING:
             e = create_expr(EXPR_STRING_LITERAL, NULL, NULL);
-            e->string_literal = strdup(parser->current_token.value);
+            e->string_literal = current_text(parser);
             eat(parser, TOKEN_STRING);
             break;
 
         case TOKEN_CHARACTER:
             e = create_expr(EXPR_CHAR_LITERAL, NULL, NULL);
-            e->integer_value = parser->current_token.value[0];
+            e->integer_value = *current_start(parser);
             eat(parser, TOKEN_CHARACTER);
             break;
 
@@ -222,25 +263,15 @@ static struct expr *parse_primary_expr(parser_t *parser) {
 
         case TOKEN_IDENTIFIER:
             e = create_expr(EXPR_NAME, NULL, NULL);
-            e->name = strdup(parser->current_token.value);
+            e->name = current_name(parser);
             eat(parser, TOKEN_IDENTIFIER);
             break;
 
-        case TOKEN_LPAREN:
-            eat(parser, TOKEN_LPAREN);
-            e = parse_expr(parser);
-            eat(parser, TOKEN_RPAREN);
-            break;
-
-        case TOKEN_LBRACE:
-            e = parse_array_initializer(parser);
-            break;
-
         default:
         {
             char error[256];
             snprintf(error, sizeof(error), "Expected expression, got token type %d",
-                     parser->current_token.type);
+                     current_type(parser));
             parse_error(parser, error);
         }
     }
@@ -248,232 +279,267 @@ static struct expr *parse_primary_expr(parser_t *parser) {
     return e;
 }
 
-static struct expr *parse_postfix_expr(parser_t *parser) {
-    struct expr *e = parse_primary_expr(parser);
-
-    while (parser->current_token.type == TOKEN_LPAREN || parser->current_token.type == TOKEN_LBRACKET) {
-        if (parser->current_token.type == TOKEN_LPAREN) {
-            eat(parser, TOKEN_LPAREN);
-
-            struct expr *args = NULL;
-            struct expr *current = NULL;
-
-            if (parser->current_token.type != TOKEN_RPAREN) {
-                do {
-                    struct expr *arg = parse_expr(parser);
-
-                    if (!args) {
-                        args = arg;
-                        current = arg;
-                    } else {
-                        current->right = arg;
-                        current = arg;
-                    }
-                } while (parser->current_token.type == TOKEN_COMMA && (eat(parser, TOKEN_COMMA), 1));
-            }
-
-            eat(parser, TOKEN_RPAREN);
-
-            e = create_expr(EXPR_CALL, e, args);
-        } else if (parser->current_token.type == TOKEN_LBRACKET) {
-            eat(parser, TOKEN_LBRACKET);
-
-            struct expr *index = parse_expr(parser);
-
-            eat(parser, TOKEN_RBRACKET);
-
-            e = create_expr(EXPR_SUBSCRIPT, e, index);
-        }
-    }
-
-    return e;
+// Binary operator precedence, lowest first. PREC_NONE marks tokens that do
+// not continue an expression.
+enum {
+    PREC_NONE,
+    PREC_ASSIGN,
+    PREC_OR,
+    PREC_AND,
+    PREC_EQUALITY,
+    PREC_RELATIONAL,
+    PREC_ADDITIVE,
+    PREC_MULTIPLICATIVE,
+    PREC_POWER
+};
+
+typedef struct {
+    unsigned char precedence;
+    unsigned char right_assoc;
+    expr_kind_t kind;
+} binary_op_t;
+
+static const binary_op_t binary_ops[TOKEN_MULTI_COMMENT + 1] = {
+    [TOKEN_ASSIGN]  = {PREC_ASSIGN, 1, EXPR_ASSIGN},
+    [TOKEN_OR]      = {PREC_OR, 0, EXPR_OR},
+    [TOKEN_AND]     = {PREC_AND, 0, EXPR_AND},
+    [TOKEN_EQ]      = {PREC_EQUALITY, 0, EXPR_EQ},
+    [TOKEN_NEQ]     = {PREC_EQUALITY, 0, EXPR_NEQ},
+    [TOKEN_LT]      = {PREC_RELATIONAL, 0, EXPR_LT},
+    [TOKEN_GT]      = {PREC_RELATIONAL, 0, EXPR_GT},
+    [TOKEN_LE]      = {PREC_RELATIONAL, 0, EXPR_LE},
+    [TOKEN_GE]      = {PREC_RELATIONAL, 0, EXPR_GE},
+    [TOKEN_PLUS]    = {PREC_ADDITIVE, 0, EXPR_ADD},
+    [TOKEN_MINUS]   = {PREC_ADDITIVE, 0, EXPR_SUB},
+    [TOKEN_STAR]    = {PREC_MULTIPLICATIVE, 0, EXPR_MUL},
+    [TOKEN_SLASH]   = {PREC_MULTIPLICATIVE, 0, EXPR_DIV},
+    [TOKEN_PERCENT] = {PREC_MULTIPLICATIVE, 0, EXPR_MOD},
+    [TOKEN_CARET]   = {PREC_POWER, 1, EXPR_POWER},
+};
+
+// Operators and brackets still waiting for their operands.
+typedef enum {
+    PENDING_UNARY,
+    PENDING_BINARY,
+    PENDING_PAREN,
+    PENDING_SUBSCRIPT,
+    PENDING_CALL,
+    PENDING_ARRAY
+} pending_kind_t;
+
+typedef struct {
+    pending_kind_t kind;
+    expr_kind_t op;             // PENDING_UNARY, PENDING_BINARY
+    int precedence;             // PENDING_BINARY
+    struct expr *node;          // subscripted expression, or the EXPR_CALL
+                                // or EXPR_ARRAY_LITERAL being filled in
+    struct expr *tail;          // last argument or element cell
+} pending_t;
+
+static void push_operand(work_stack_t *operands, struct expr *e) {
+    *(struct expr **) work_stack_push(operands) = e;
 }
 
-static struct expr *parse_unary_expr(parser_t *parser) {
+static struct expr *pop_operand(work_stack_t *operands) {
     struct expr *e = NULL;
-
-    if (parser->current_token.type == TOKEN_MINUS) {
-        eat(parser, TOKEN_MINUS);
-        e = create_expr(EXPR_UNARY_MINUS, NULL, parse_unary_expr(parser));
-    } else if (parser->current_token.type == TOKEN_NOT) {
-        eat(parser, TOKEN_NOT);
-        e = create_expr(EXPR_NOT, NULL, parse_unary_expr(parser));
-    } else {
-        e = parse_postfix_expr(parser);
-    }
-
+    work_stack_pop(operands, &e);
     return e;
 }
 
-static struct expr *parse_power_expr(parser_t *parser) {
-    struct expr *e = parse_unary_expr(parser);
+// Applies the pending unary or binary operator on top of the stack.
+static void reduce(work_stack_t *pending, work_stack_t *operands) {
+    pending_t op;
+    work_stack_pop(pending, &op);
 
-    if (parser->current_token.type == TOKEN_CARET) {
-        eat(parser, TOKEN_CARET);
-        e = create_expr(EXPR_POWER, e, parse_power_expr(parser));
-    }
-
-    return e;
+    struct expr *right = pop_operand(operands);
+    struct expr *left = op.kind == PENDING_BINARY ? pop_operand(operands) : NULL;
+    push_operand(operands, create_expr(op.op, left, right));
 }
 
-static struct expr *parse_multiplicative_expr(parser_t *parser) {
-    struct expr *e = parse_power_expr(parser);
-
-    while (parser->current_token.type == TOKEN_STAR ||
-           parser->current_token.type == TOKEN_SLASH ||
-           parser->current_token.type == TOKEN_PERCENT) {
-        token_type_t op = parser->current_token.type;
-        eat(parser, op);
-
-        struct expr *right = parse_power_expr(parser);
+static void reduce_operators(work_stack_t *pending, work_stack_t *operands) {
+    pending_t *top;
+    while ((top = work_stack_top(pending)) && (top->kind == PENDING_UNARY || top->kind == PENDING_BINARY)) {
+        reduce(pending, operands);
+    }
+}
 
-        switch (op) {
-            case TOKEN_STAR:
-                e = create_expr(EXPR_MUL, e, right);
-                break;
-            case TOKEN_SLASH:
-                e = create_expr(EXPR_DIV, e, right);
-                break;
-            case TOKEN_PERCENT:
-                e = create_expr(EXPR_MOD, e, right);
-                break;
-            default:
-                break;
-        }
+// Opens an argument or element list after its opening bracket. Returns 1
+// when the list is empty and already closed.
+static int open_list(parser_t *parser, work_stack_t *pending, pending_kind_t kind, struct expr *node,
+                     token_type_t close) {
+    if (current_type(parser) == close) {
+        eat(parser, close);
+        return 1;
     }
 
-    return e;
+    pending_t *list = work_stack_push(pending);
+    list->kind = kind;
+    list->node = node;
+    return 0;
 }
 
-static struct expr *parse_additive_expr(parser_t *parser) {
-    struct expr *e = parse_multiplicative_expr(parser);
+// Operator-precedence parser driven by binary_ops. Instead of recursing for
+// every operand, it keeps pending operators and open brackets on one heap
+// stack and finished subexpressions on another, so neither deep nesting
+// nor long operator chains use any call stack. An operator on the stack is
+// applied as soon as the incoming operator binds no tighter (strictly
+// looser for the right-associative ^ and =); unary - and ! bind tighter
+// than every binary operator, and calls and subscripts tighter still.
+//
+// With array_initializer set, parses a single {...} literal and stops
+// after its closing brace.
+static struct expr *parse_operators(parser_t *parser, int array_initializer) {
+    work_stack_t pending;
+    work_stack_t operands;
+    work_stack_init(&pending, sizeof(pending_t));
+    work_stack_init(&operands, sizeof(struct expr *));
+
+    struct expr *result = NULL;
+    int expect_operand = 1;
+
+    if (array_initializer) {
+        eat(parser, TOKEN_LBRACE);
+        struct expr *array = create_expr(EXPR_ARRAY_LITERAL, NULL, NULL);
+        if (open_list(parser, &pending, PENDING_ARRAY, array, TOKEN_RBRACE)) {
+            return array;
+        }
+    }
 
-    while (parser->current_token.type == TOKEN_PLUS ||
-           parser->current_token.type == TOKEN_MINUS) {
-        token_type_t op = parser->current_token.type;
-        eat(parser, op);
+    while (!result) {
+        token_type_t type = current_type(parser);
+
+        if (expect_operand) {
+            if (type == TOKEN_MINUS || type == TOKEN_NOT) {
+                eat(parser, type);
+                pending_t *unary = work_stack_push(&pending);
+                unary->kind = PENDING_UNARY;
+                unary->op = type == TOKEN_MINUS ? EXPR_UNARY_MINUS : EXPR_NOT;
+            } else if (type == TOKEN_LPAREN) {
+                eat(parser, TOKEN_LPAREN);
+                ((pending_t *) work_stack_push(&pending))->kind = PENDING_PAREN;
+            } else if (type == TOKEN_LBRACE) {
+                eat(parser, TOKEN_LBRACE);
+                struct expr *array = create_expr(EXPR_ARRAY_LITERAL, NULL, NULL);
+                if (open_list(parser, &pending, PENDING_ARRAY, array, TOKEN_RBRACE)) {
+                    push_operand(&operands, array);
+                    expect_operand = 0;
+                }
+            } else {
+                push_operand(&operands, parse_primary_expr(parser));
+                expect_operand = 0;
+            }
+            continue;
+        }
 
-        struct expr *right = parse_multiplicative_expr(parser);
+        // Postfix operators apply to the operand just parsed.
+        if (type == TOKEN_LPAREN) {
+            eat(parser, TOKEN_LPAREN);
+            struct expr *call = create_expr(EXPR_CALL, pop_operand(&operands), NULL);
+            if (open_list(parser, &pending, PENDING_CALL, call, TOKEN_RPAREN)) {
+                push_operand(&operands, call);
+            } else {
+                expect_operand = 1;
+            }
+            continue;
+        }
 
-        switch (op) {
-            case TOKEN_PLUS:
-                e = create_expr(EXPR_ADD, e, right);
-                break;
-            case TOKEN_MINUS:
-                e = create_expr(EXPR_SUB, e, right);
-                break;
-            default:
-                break;
+        if (type == TOKEN_LBRACKET) {
+            eat(parser, TOKEN_LBRACKET);
+            pending_t *subscript = work_stack_push(&pending);
+            subscript->kind = PENDING_SUBSCRIPT;
+            subscript->node = pop_operand(&operands);
+            expect_operand = 1;
+            continue;
         }
-    }
 
-    return e;
-}
+        const binary_op_t *op = &binary_ops[type];
+        if (op->precedence != PREC_NONE) {
+            pending_t *top;
+            while ((top = work_stack_top(&pending)) &&
+                   (top->kind == PENDING_UNARY ||
+                    (top->kind == PENDING_BINARY &&
+                     (top->precedence > op->precedence ||
+                      (top->precedence == op->precedence && !op->right_assoc))))) {
+                reduce(&pending, &operands);
+            }
 
-static struct expr *parse_relational_expr(parser_t *parser) {
-    struct expr *e = parse_additive_expr(parser);
+            eat(parser, type);
+            pending_t *binary = work_stack_push(&pending);
+            binary->kind = PENDING_BINARY;
+            binary->op = op->kind;
+            binary->precedence = op->precedence;
+            expect_operand = 1;
+            continue;
+        }
 
-    while (parser->current_token.type == TOKEN_LT ||
-           parser->current_token.type == TOKEN_GT ||
-           parser->current_token.type == TOKEN_LE ||
-           parser->current_token.type == TOKEN_GE) {
-        token_type_t op = parser->current_token.type;
-        eat(parser, op);
+        // Any other token completes the innermost bracket, or the whole
+        // expression when no bracket is open.
+        reduce_operators(&pending, &operands);
 
-        struct expr *right = parse_additive_expr(parser);
+        pending_t group;
+        if (!work_stack_pop(&pending, &group)) {
+            result = pop_operand(&operands);
+            break;
+        }
 
-        switch (op) {
-            case TOKEN_LT:
-                e = create_expr(EXPR_LT, e, right);
-                break;
-            case TOKEN_GT:
-                e = create_expr(EXPR_GT, e, right);
-                break;
-            case TOKEN_LE:
-                e = create_expr(EXPR_LE, e, right);
-                break;
-            case TOKEN_GE:
-                e = create_expr(EXPR_GE, e, right);
-                break;
-            default:
+        switch (group.kind) {
+            case PENDING_PAREN:
+                eat(parser, TOKEN_RPAREN);
                 break;
-        }
-    }
 
-    return e;
-}
+            case PENDING_SUBSCRIPT:
+                eat(parser, TOKEN_RBRACKET);
+                push_operand(&operands, create_expr(EXPR_SUBSCRIPT, group.node, pop_operand(&operands)));
+                break;
 
-static struct expr *parse_equality_expr(parser_t *parser) {
-    struct expr *e = parse_relational_expr(parser);
+            case PENDING_CALL:
+            case PENDING_ARRAY: {
+                struct expr *cell = create_expr(EXPR_ARG, pop_operand(&operands), NULL);
+                if (group.tail) {
+                    group.tail->right = cell;
+                } else {
+                    group.node->right = cell;
+                }
+                group.tail = cell;
 
-    while (parser->current_token.type == TOKEN_EQ ||
-           parser->current_token.type == TOKEN_NEQ) {
-        token_type_t op = parser->current_token.type;
-        eat(parser, op);
+                if (current_type(parser) == TOKEN_COMMA) {
+                    eat(parser, TOKEN_COMMA);
+                    *(pending_t *) work_stack_push(&pending) = group;
+                    expect_operand = 1;
+                    break;
+                }
 
-        struct expr *right = parse_relational_expr(parser);
+                eat(parser, group.kind == PENDING_CALL ? TOKEN_RPAREN : TOKEN_RBRACE);
 
-        switch (op) {
-            case TOKEN_EQ:
-                e = create_expr(EXPR_EQ, e, right);
-                break;
-            case TOKEN_NEQ:
-                e = create_expr(EXPR_NEQ, e, right);
+                if (array_initializer && pending.count == 0) {
+                    result = group.node;
+                } else {
+                    push_operand(&operands, group.node);
+                }
                 break;
+            }
+
             default:
                 break;
         }
     }
 
-    return e;
-}
-
-static struct expr *parse_logical_and_expr(parser_t *parser) {
-    struct expr *e = parse_equality_expr(parser);
-
-    while (parser->current_token.type == TOKEN_AND) {
-        eat(parser, TOKEN_AND);
-
-        struct expr *right = parse_equality_expr(parser);
-        e = create_expr(EXPR_AND, e, right);
-    }
-
-    return e;
+    work_stack_free(&pending);
+    work_stack_free(&operands);
+    return result;
 }
 
-static struct expr *parse_logical_or_expr(parser_t *parser) {
-    struct expr *e = parse_logical_and_expr(parser);
-
-    while (parser->current_token.type == TOKEN_OR) {
-        eat(parser, TOKEN_OR);
-
-        struct expr *right = parse_logical_and_expr(parser);
-        e = create_expr(EXPR_OR, e, right);
-    }
-
-    return e;
-}
-
-static struct expr *parse_assignment_expr(parser_t *parser) {
-    struct expr *e = parse_logical_or_expr(parser);
-
-    if (parser->current_token.type == TOKEN_ASSIGN) {
-        eat(parser, TOKEN_ASSIGN);
-
-        struct expr *right = parse_assignment_expr(parser);
-        e = create_expr(EXPR_ASSIGN, e, right);
-    }
-
-    return e;
+static struct expr *parse_array_initializer(parser_t *parser) {
+    return parse_operators(parser, 1);
 }
 
 static struct expr *parse_expr(parser_t *parser) {
-    return parse_assignment_expr(parser);
+    return parse_operators(parser, 0);
 }
 
 static struct stmt *parse_comment(parser_t *parser) {
     struct stmt *s = create_stmt(STMT_COMMENT);
-    s->comment_text = strdup(parser->current_token.value);
+    s->comment_text = current_text(parser);
 
     eat(parser, TOKEN_COMMENT);
 
@@ -482,7 +548,7 @@ static struct stmt *parse_comment(parser_t *parser) {
 
 static struct stmt *parse_multi_comment(parser_t *parser) {
     struct stmt *s = create_stmt(STMT_MULTI_COMMENT);
-    s->comment_text = strdup(parser->current_token.value);
+    s->comment_text = current_text(parser);
 
     eat(parser, TOKEN_MULTI_COMMENT);
 
@@ -498,7 +564,7 @@ static struct expr *parse_print_args(parser_t *parser) {
     struct expr *arg_list = create_expr(EXPR_ARG, first_expr, NULL);
     struct expr *current = arg_list;
 
-    while (parser->current_token.type == TOKEN_COMMA) {
+    while (current_type(parser) == TOKEN_COMMA) {
         eat(parser, TOKEN_COMMA);
 
         struct expr *next_expr = parse_expr(parser);
@@ -515,15 +581,30 @@ static struct expr *parse_print_args(parser_t *parser) {
     return arg_list;
 }
 
-static struct stmt *parse_stmt(parser_t *parser) {
+// Statements that contain statements (blocks, if, for and declarations
+// with a body) are not parsed recursively. begin_stmt parses everything up
+// to the first nested statement and leaves the unfinished statement on a
+// heap stack; parse_stmt then parses the nested statements one at a time
+// and hands each to continue_stmt for the innermost unfinished one.
+typedef struct {
+    struct stmt *s;
+    struct stmt *tail;          // STMT_BLOCK: last statement so far
+    int in_else;                // STMT_IF_ELSE: parsing the else branch
+} open_stmt_t;
+
+static struct decl *parse_decl_head(parser_t *parser, int *needs_body);
+
+// Returns the parsed statement, or NULL when it was left open on the stack
+// and its first nested statement comes next.
+static struct stmt *begin_stmt(parser_t *parser, work_stack_t *open) {
     struct stmt *s = NULL;
+    int needs_body = 0;
 
-    switch (parser->current_token.type) {
+    switch (current_type(parser)) {
         case TOKEN_IDENTIFIER:
-            if (parser->lexer->position < parser->lexer->length &&
-                parser->lexer->input[parser->lexer->position] == ':') {
+            if (peek_type(parser, 1) == TOKEN_COLON) {
                 s = create_stmt(STMT_DECL);
-                s->decl = parse_decl(parser);
+                s->decl = parse_decl_head(parser, &needs_body);
             } else {
                 s = create_stmt(STMT_EXPR);
                 s->expr = parse_expr(parser);
@@ -533,7 +614,7 @@ static struct stmt *parse_stmt(parser_t *parser) {
 
         case TOKEN_FUNCTION:
             s = create_stmt(STMT_DECL);
-            s->decl = parse_decl(parser);
+            s->decl = parse_decl_head(parser, &needs_body);
             break;
 
         case TOKEN_IF:
@@ -542,12 +623,7 @@ static struct stmt *parse_stmt(parser_t *parser) {
             eat(parser, TOKEN_LPAREN);
             s->expr = parse_expr(parser);
             eat(parser, TOKEN_RPAREN);
-            s->body = parse_stmt(parser);
-
-            if (parser->current_token.type == TOKEN_ELSE) {
-                eat(parser, TOKEN_ELSE);
-                s->else_body = parse_stmt(parser);
-            }
+            needs_body = 1;
             break;
 
         case TOKEN_FOR:
@@ -555,29 +631,29 @@ static struct stmt *parse_stmt(parser_t *parser) {
             eat(parser, TOKEN_FOR);
             eat(parser, TOKEN_LPAREN);
 
-            if (parser->current_token.type != TOKEN_SEMICOLON) {
+            if (current_type(parser) != TOKEN_SEMICOLON) {
                 s->init_expr = parse_expr(parser);
             }
             eat(parser, TOKEN_SEMICOLON);
 
-            if (parser->current_token.type != TOKEN_SEMICOLON) {
+            if (current_type(parser) != TOKEN_SEMICOLON) {
                 s->expr = parse_expr(parser);
             }
             eat(parser, TOKEN_SEMICOLON);
 
-            if (parser->current_token.type != TOKEN_RPAREN) {
+            if (current_type(parser) != TOKEN_RPAREN) {
                 s->next_expr = parse_expr(parser);
             }
             eat(parser, TOKEN_RPAREN);
 
-            s->body = parse_stmt(parser);
+            needs_body = 1;
             break;
 
         case TOKEN_RETURN:
             s = create_stmt(STMT_RETURN);
             eat(parser, TOKEN_RETURN);
 
-            if (parser->current_token.type != TOKEN_SEMICOLON) {
+            if (current_type(parser) != TOKEN_SEMICOLON) {
                 s->expr = parse_expr(parser);
             }
             eat(parser, TOKEN_SEMICOLON);
@@ -596,24 +672,11 @@ static struct stmt *parse_stmt(parser_t *parser) {
             s = create_stmt(STMT_BLOCK);
             eat(parser, TOKEN_LBRACE);
 
-            struct stmt *block_stmt = NULL;
-            struct stmt *current = NULL;
-
-            while (parser->current_token.type != TOKEN_RBRACE &&
-                   parser->current_token.type != TOKEN_EOF) {
-                struct stmt *stmt = parse_stmt(parser);
-
-                if (!block_stmt) {
-                    block_stmt = stmt;
-                    current = stmt;
-                } else {
-                    current->next = stmt;
-                    current = stmt;
-                }
+            if (current_type(parser) == TOKEN_RBRACE || current_type(parser) == TOKEN_EOF) {
+                eat(parser, TOKEN_RBRACE);
+            } else {
+                needs_body = 1;
             }
-
-            eat(parser, TOKEN_RBRACE);
-            s->body = block_stmt;
             break;
 
         case TOKEN_COMMENT:
@@ -631,45 +694,128 @@ static struct stmt *parse_stmt(parser_t *parser) {
             break;
     }
 
+    if (needs_body) {
+        ((open_stmt_t *) work_stack_push(open))->s = s;
+        return NULL;
+    }
+
     return s;
 }
 
-static struct decl *parse_decl(parser_t *parser) {
-    if (parser->current_token.type == TOKEN_COMMENT ||
-        parser->current_token.type == TOKEN_MULTI_COMMENT) {
+// Attaches a finished nested statement to the innermost open statement.
+// Returns that statement if this completed it, or NULL if it needs another
+// nested statement.
+static struct stmt *continue_stmt(parser_t *parser, work_stack_t *open, struct stmt *child) {
+    open_stmt_t *top = work_stack_top(open);
+    struct stmt *s = top->s;
+
+    switch (s->kind) {
+        case STMT_BLOCK:
+            if (top->tail) {
+                top->tail->next = child;
+            } else {
+                s->body = child;
+            }
+            top->tail = child;
+
+            if (current_type(parser) != TOKEN_RBRACE && current_type(parser) != TOKEN_EOF) {
+                return NULL;
+            }
+            eat(parser, TOKEN_RBRACE);
+            break;
+
+        case STMT_IF_ELSE:
+            if (top->in_else) {
+                s->else_body = child;
+            } else {
+                s->body = child;
+
+                if (current_type(parser) == TOKEN_ELSE) {
+                    eat(parser, TOKEN_ELSE);
+                    top->in_else = 1;
+                    return NULL;
+                }
+            }
+            break;
+
+        case STMT_FOR:
+            s->body = child;
+            break;
+
+        case STMT_DECL:
+            s->decl->code = child;
+            break;
+
+        default:
+            break;
+    }
+
+    work_stack_pop(open, NULL);
+    return s;
+}
+
+static struct stmt *parse_stmt(parser_t *parser) {
+    work_stack_t open;
+    work_stack_init(&open, sizeof(open_stmt_t));
+
+    struct stmt *s = NULL;
+
+    for (;;) {
+        s = begin_stmt(parser, &open);
+
+        while (s && open.count > 0) {
+            s = continue_stmt(parser, &open, s);
+        }
+
+        if (s) {
+            break;
+        }
+    }
+
+    work_stack_free(&open);
+    return s;
+}
+
+// Parses a declaration up to its body. Sets *needs_body when a statement
+// follows that belongs in d->code.
+static struct decl *parse_decl_head(parser_t *parser, int *needs_body) {
+    *needs_body = 0;
+
+    if (current_type(parser) == TOKEN_COMMENT ||
+        current_type(parser) == TOKEN_MULTI_COMMENT) {
         return parse_comment_decl(parser);
     }
 
-    char *name = NULL;
+    const char *name = NULL;
     struct type *t = NULL;
     struct decl *d = NULL;
 
-    if (parser->current_token.type == TOKEN_FUNCTION) {
+    if (current_type(parser) == TOKEN_FUNCTION) {
         eat(parser, TOKEN_FUNCTION);
 
-        if (parser->current_token.type != TOKEN_IDENTIFIER) {
+        if (current_type(parser) != TOKEN_IDENTIFIER) {
             parse_error(parser, "Expected function name");
         }
 
-        name = strdup(parser->current_token.value);
+        name = current_name(parser);
         eat(parser, TOKEN_IDENTIFIER);
 
         t = create_type(TYPE_FUNCTION, NULL, NULL);
 
         eat(parser, TOKEN_LPAREN);
 
-        if (parser->current_token.type != TOKEN_RPAREN) {
+        if (current_type(parser) != TOKEN_RPAREN) {
             struct param_list *params = NULL;
             struct param_list *current = NULL;
 
             do {
                 struct type *param_type = parse_type(parser);
 
-                if (parser->current_token.type != TOKEN_IDENTIFIER) {
+                if (current_type(parser) != TOKEN_IDENTIFIER) {
                     parse_error(parser, "Expected parameter name");
                 }
 
-                char *param_name = strdup(parser->current_token.value);
+                const char *param_name = current_name(parser);
                 eat(parser, TOKEN_IDENTIFIER);
 
                 struct param_list *p = create_param(param_name, param_type, NULL);
@@ -681,7 +827,7 @@ static struct decl *parse_decl(parser_t *parser) {
                     current->next = p;
                     current = p;
                 }
-            } while (parser->current_token.type == TOKEN_COMMA && (eat(parser, TOKEN_COMMA), 1));
+            } while (current_type(parser) == TOKEN_COMMA && (eat(parser, TOKEN_COMMA), 1));
 
             t->params = params;
         }
@@ -695,19 +841,19 @@ static struct decl *parse_decl(parser_t *parser) {
         d = create_decl(name, t, NULL, NULL, NULL);
         if (d) {
             d->kind = DECL_FUNCTION;
-            d->code = parse_stmt(parser);
+            *needs_body = 1;
         }
 
         return d;
     } else {
-        if (parser->current_token.type != TOKEN_IDENTIFIER) {
+        if (current_type(parser) != TOKEN_IDENTIFIER) {
             parse_error(parser, "Expected identifier for declaration");
         }
 
-        name = strdup(parser->current_token.value);
+        name = current_name(parser);
         eat(parser, TOKEN_IDENTIFIER);
 
-        if (parser->current_token.type != TOKEN_COLON) {
+        if (current_type(parser) != TOKEN_COLON) {
             parse_error(parser, "Expected colon after identifier in declaration");
         }
         eat(parser, TOKEN_COLON);
@@ -718,20 +864,20 @@ static struct decl *parse_decl(parser_t *parser) {
         if (d) {
             d->kind = DECL_VARIABLE;
 
-            if (parser->current_token.type == TOKEN_ASSIGN) {
+            if (current_type(parser) == TOKEN_ASSIGN) {
                 eat(parser, TOKEN_ASSIGN);
 
-                if (t->kind == TYPE_FUNCTION && parser->current_token.type == TOKEN_LBRACE) {
-                    d->code = parse_stmt(parser);
+                if (t->kind == TYPE_FUNCTION && current_type(parser) == TOKEN_LBRACE) {
+                    *needs_body = 1;
                 } else {
-                    if (t->kind == TYPE_ARRAY && parser->current_token.type == TOKEN_LBRACE) {
+                    if (t->kind == TYPE_ARRAY && current_type(parser) == TOKEN_LBRACE) {
                         d->value = parse_array_initializer(parser);
 
                         if (!d->value) {
                             parse_error(parser, "Failed to create array initializer");
                         }
 
-                        if (!d->value->right && d->value->kind == EXPR_ARRAY_LITERAL) {
+                        if (d->value->kind == EXPR_ARRAY_LITERAL && !d->value->right) {
                             parse_error(parser, "Array initializer has NULL right pointer");
                         }
                     } else {
@@ -742,7 +888,7 @@ static struct decl *parse_decl(parser_t *parser) {
                         eat(parser, TOKEN_SEMICOLON);
                     }
                 }
-            } else if (parser->current_token.type == TOKEN_SEMICOLON) {
+            } else if (current_type(parser) == TOKEN_SEMICOLON) {
                 eat(parser, TOKEN_SEMICOLON);
             }
         }
@@ -751,17 +897,28 @@ static struct decl *parse_decl(parser_t *parser) {
     }
 }
 
+static struct decl *parse_decl(parser_t *parser) {
+    int needs_body;
+    struct decl *d = parse_decl_head(parser, &needs_body);
+
+    if (needs_body) {
+        d->code = parse_stmt(parser);
+    }
+
+    return d;
+}
+
 struct decl *parse_program(parser_t *parser) {
     if (!parser) return NULL;
 
     struct decl *program = NULL;
     struct decl *current = NULL;
 
-    while (parser->current_token.type != TOKEN_EOF) {
+    while (current_type(parser) != TOKEN_EOF) {
         struct decl *d = NULL;
 
-        if (parser->current_token.type == TOKEN_COMMENT ||
-            parser->current_token.type == TOKEN_MULTI_COMMENT) {
+        if (current_type(parser) == TOKEN_COMMENT ||
+            current_type(parser) == TOKEN_MULTI_COMMENT) {
             d = parse_comment_decl(parser);
         } else {
             d = parse_decl(parser);
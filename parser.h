@@ -4,10 +4,13 @@
 #include "lexer.h"
 #include "ast.h"
 
-// Parser structure
+// Parser structure. The input is tokenized as the parser goes; position
+// indexes the current token in the buffer, which holds it and the tokens
+// after it that have been lexed so far.
 typedef struct {
     lexer_t *lexer;
-    token_t current_token;
+    token_buffer_t *tokens;
+    size_t position;
 } parser_t;
 
 // Parser functions
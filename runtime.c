@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "runtime.h"
+
+// Both helpers wrap around like the compile-time folding does, and give
+// what pow() truncates to for negative exponents.
+static const char power_call_helper[] =
+    "static int bminor_pow(int base, int exponent) {\n"
+    "\tif (exponent < 0) {\n"
+    "\t\treturn base == 1 ? 1 : base == -1 ? (exponent % 2 ? -1 : 1) : 0;\n"
+    "\t}\n"
+    "\tunsigned int result = 1;\n"
+    "\tunsigned int factor = (unsigned int) base;\n"
+    "\tfor (; exponent; exponent >>= 1) {\n"
+    "\t\tif (exponent & 1) result *= factor;\n"
+    "\t\tfactor *= factor;\n"
+    "\t}\n"
+    "\treturn (int) result;\n"
+    "}\n\n";
+
+static const char power_product_helper[] =
+    "static int bminor_pow_product(int base, int exponent) {\n"
+    "\tunsigned int factor = (unsigned int) base;\n"
+    "\tunsigned int result = factor * factor;\n"
+    "\tif (exponent > 2) result *= factor;\n"
+    "\tif (exponent > 3) result *= factor;\n"
+    "\treturn (int) result;\n"
+    "}\n\n";
+
+static const char power_shift_helper[] =
+    "static int bminor_pow2(int exponent) {\n"
+    "\treturn (unsigned int) exponent < 32 ? (int) (1u << exponent) : 0;\n"
+    "}\n\n";
+
+static const char zero_division_helper[] =
+    "static int " ZERO_DIVISION_HELPER "(int dividend, int remainder) {\n"
+    "\tvolatile int value = dividend;\n"
+    "\tvolatile int zero = 0;\n"
+    "\treturn remainder ? value % zero : value / zero;\n"
+    "}\n\n";
+
+// Mixes one argument of a memoized call into its table slot.
+static const char memo_hash_helper[] =
+    "static unsigned int bminor_memo_hash(unsigned int hash, int key) {\n"
+    "\thash = (hash ^ (unsigned int) key) * 0x9E3779B1u;\n"
+    "\treturn hash ^ (hash >> 16);\n"
+    "}\n\n";
+
+// The report itself is emitted after the memoized functions, which start
+// it on their first call.
+static const char memo_stats_helper[] =
+    "static void bminor_memo_report(void);\n\n"
+    "static void bminor_memo_start_report(void) {\n"
+    "\tstatic int started;\n"
+    "\tif (!started) {\n"
+    "\t\tstarted = 1;\n"
+    "\t\tatexit(bminor_memo_report);\n"
+    "\t}\n"
+    "}\n\n";
+
+power_form_t choose_power_form(int base_is_plain, int base_is_two, int exponent_is_constant, int exponent) {
+    if (exponent_is_constant && exponent >= 2 && exponent <= MAX_POWER_PRODUCT) {
+        return base_is_plain ? POWER_PRODUCT : POWER_PRODUCT_CALL;
+    }
+    if (base_is_two) {
+        return POWER_SHIFT;
+    }
+    return POWER_CALL;
+}
+
+const char *power_helper_name(power_form_t form) {
+    switch (form) {
+        case POWER_PRODUCT_CALL: return "bminor_pow_product";
+        case POWER_SHIFT: return "bminor_pow2";
+        case POWER_CALL: return "bminor_pow";
+        default: return NULL;
+    }
+}
+
+const char *c_name(const char *name) {
+    if (name[0] != '_' && strncmp(name, RESERVED_PREFIX, sizeof(RESERVED_PREFIX) - 1) != 0) return name;
+
+    size_t length = strlen(name);
+    size_t size = sizeof(USER_NAME_PREFIX) + length;
+    char *mangled = malloc(size);
+    if (!mangled) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    snprintf(mangled, size, "%s%s", USER_NAME_PREFIX, name);
+
+    const char *interned = intern(mangled, size - 1);
+    free(mangled);
+    return interned;
+}
+
+void note_power_form(runtime_needs_t *needs, power_form_t form) {
+    needs->power_product |= form == POWER_PRODUCT_CALL;
+    needs->power_call |= form == POWER_CALL;
+    needs->power_shift |= form == POWER_SHIFT;
+}
+
+void emit_runtime(const runtime_needs_t *needs, FILE *output) {
+    if (needs->power_product) {
+        fputs(power_product_helper, output);
+    }
+    if (needs->power_call) {
+        fputs(power_call_helper, output);
+    }
+    if (needs->power_shift) {
+        fputs(power_shift_helper, output);
+    }
+    if (needs->zero_divisor) {
+        fputs(zero_division_helper, output);
+    }
+    if (needs->memo) {
+        fputs(memo_hash_helper, output);
+    }
+    if (needs->memo_stats) {
+        fputs(memo_stats_helper, output);
+    }
+}
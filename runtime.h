@@ -0,0 +1,66 @@
+#ifndef RUNTIME_H
+#define RUNTIME_H
+
+#include <stdio.h>
+
+// Support code emitted into generated programs, only when something uses
+// it. Both the AST and the IR code generators note what they need while
+// choosing how to emit an operation, and the helpers go at the top of the
+// output file.
+
+// Integer power never goes through the double-precision pow(). A small
+// constant exponent becomes a product, in unsigned arithmetic so that it
+// wraps like the helpers and folding do: written out for a plain operand
+// (one that can be repeated without evaluating anything twice), and
+// through a helper that takes the operand once for anything else. 2 ^ n
+// becomes a shift, and anything else calls the general helper.
+typedef enum {
+    POWER_PRODUCT,
+    POWER_PRODUCT_CALL,
+    POWER_SHIFT,
+    POWER_CALL
+} power_form_t;
+
+#define MAX_POWER_PRODUCT 4
+
+power_form_t choose_power_form(int base_is_plain, int base_is_two, int exponent_is_constant, int exponent);
+
+// Name of the helper that form calls, or NULL for a product.
+const char *power_helper_name(power_form_t form);
+
+// A division or remainder by a literal zero, which folding leaves to run
+// time, calls this helper with the dividend and whether it is a remainder:
+// C compilers warn about a literal zero divisor, and optimize around one.
+// The helper divides operands the compiler cannot see, so it traps where
+// the program would have.
+#define ZERO_DIVISION_HELPER "bminor_divide_by_zero"
+
+// The generated code names its own variables with a leading underscore
+// (the IR emitter's temporaries _vN, _pN and _aN) and everything else it
+// adds with "bminor_": the helpers here, bminor_init_globals, the memo
+// tables, counters and bodies, and the locals the AST generator renames,
+// whose names add a source name to a prefix no other name starts with. A B-minor identifier that starts
+// with either goes into the C file behind USER_NAME_PREFIX, which nothing
+// the compiler adds starts with, so it can meet neither those names nor
+// another identifier. c_name returns the name a B-minor identifier has in
+// the C file, interned; most keep their own.
+#define RESERVED_PREFIX "bminor_"
+#define USER_NAME_PREFIX "bminor_u"
+
+const char *c_name(const char *name);
+
+typedef struct {
+    int power_product;
+    int power_call;
+    int power_shift;
+    int zero_divisor;
+    int memo;                       // the hash memoized functions index their tables with
+    int memo_stats;                 // the exit-time report of their hit rates
+} runtime_needs_t;
+
+void note_power_form(runtime_needs_t *needs, power_form_t form);
+
+// Emits the helpers needs asks for.
+void emit_runtime(const runtime_needs_t *needs, FILE *output);
+
+#endif
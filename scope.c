@@ -0,0 +1,173 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "scope.h"
+#include "work_stack.h"
+
+typedef struct {
+    const char *name;
+    struct symbol *binding;
+} scope_entry_t;
+
+typedef struct {
+    struct symbol *bindings;        // linked through next_in_scope
+} scope_frame_t;
+
+// Names stay in the table once seen, with a NULL binding when out of
+// scope, so nothing is ever deleted and probing needs no tombstones.
+typedef struct {
+    scope_entry_t *entries;
+    uint32_t capacity;
+    uint32_t count;
+    work_stack_t frames;
+    int initialized;
+} scope_table_t;
+
+static scope_table_t table = {NULL, 0, 0, {NULL, 0, 0, 0}, 0};
+
+static uint32_t hash_name(const char *name) {
+    // Interned names are unique pointers; mix the address bits.
+    uint64_t bits = (uint64_t) (uintptr_t) name;
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdull;
+    bits ^= bits >> 33;
+    return (uint32_t) bits;
+}
+
+static int grow(void) {
+    uint32_t capacity = table.capacity ? table.capacity * 2 : 256;
+    scope_entry_t *entries = calloc(capacity, sizeof(scope_entry_t));
+    if (!entries) return 0;
+
+    for (uint32_t i = 0; i < table.capacity; i++) {
+        scope_entry_t *entry = &table.entries[i];
+        if (!entry->name) continue;
+
+        uint32_t slot = hash_name(entry->name) & (capacity - 1);
+        while (entries[slot].name) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        entries[slot] = *entry;
+    }
+
+    free(table.entries);
+    table.entries = entries;
+    table.capacity = capacity;
+
+    return 1;
+}
+
+static scope_entry_t *find(const char *name, int insert) {
+    if (insert && (table.count + 1) * 2 > table.capacity && !grow()) {
+        return NULL;
+    }
+    if (!table.capacity) {
+        return NULL;
+    }
+
+    uint32_t slot = hash_name(name) & (table.capacity - 1);
+
+    for (;;) {
+        scope_entry_t *entry = &table.entries[slot];
+
+        if (entry->name == name) {
+            return entry;
+        }
+
+        if (!entry->name) {
+            if (!insert) return NULL;
+
+            entry->name = name;
+            entry->binding = NULL;
+            table.count++;
+            return entry;
+        }
+
+        slot = (slot + 1) & (table.capacity - 1);
+    }
+}
+
+struct symbol *symbol_create(symbol_kind_t kind, const char *name, struct type *type) {
+    struct symbol *sym = ast_alloc(sizeof(struct symbol));
+    if (!sym) return NULL;
+
+    sym->kind = kind;
+    sym->name = name;
+    sym->type = type;
+    sym->level = 0;
+    sym->reads = 0;
+    sym->writes = 0;
+    sym->shadowed = NULL;
+    sym->emitted_name = NULL;
+    sym->next_in_scope = NULL;
+
+    return sym;
+}
+
+void scope_enter(void) {
+    if (!table.initialized) {
+        work_stack_init(&table.frames, sizeof(scope_frame_t));
+        table.initialized = 1;
+    }
+
+    work_stack_push(&table.frames);
+}
+
+void scope_exit(void) {
+    scope_frame_t frame;
+    if (!work_stack_pop(&table.frames, &frame)) return;
+
+    // Restore whatever each binding made in this scope was shadowing.
+    for (struct symbol *sym = frame.bindings; sym; sym = sym->next_in_scope) {
+        scope_entry_t *entry = find(sym->name, 0);
+        if (entry && entry->binding == sym) {
+            entry->binding = sym->shadowed;
+        }
+    }
+
+    if (table.frames.count == 0) {
+        free(table.entries);
+        work_stack_free(&table.frames);
+        table.entries = NULL;
+        table.capacity = 0;
+        table.count = 0;
+    }
+}
+
+int scope_level(void) {
+    return (int) table.frames.count;
+}
+
+struct symbol *scope_bind(struct symbol *sym) {
+    scope_frame_t *frame = work_stack_top(&table.frames);
+    if (!frame || !sym) return NULL;
+
+    scope_entry_t *entry = find(sym->name, 1);
+    if (!entry) return NULL;
+
+    struct symbol *replaced = NULL;
+    struct symbol *outer = entry->binding;
+
+    if (outer && outer->level == scope_level()) {
+        // Rebinding in the same scope replaces the earlier binding.
+        replaced = outer;
+        outer = outer->shadowed;
+    }
+
+    sym->level = scope_level();
+    sym->shadowed = outer;
+    sym->next_in_scope = frame->bindings;
+    frame->bindings = sym;
+    entry->binding = sym;
+
+    return replaced;
+}
+
+struct symbol *scope_lookup(const char *name) {
+    scope_entry_t *entry = find(name, 0);
+    return entry ? entry->binding : NULL;
+}
+
+struct symbol *scope_lookup_current(const char *name) {
+    struct symbol *sym = scope_lookup(name);
+    return sym && sym->level == scope_level() ? sym : NULL;
+}
@@ -0,0 +1,55 @@
+#ifndef SCOPE_H
+#define SCOPE_H
+
+// Scoped symbol table. One open-addressing hash table, keyed by interned
+// name, maps each name to its innermost binding; a binding remembers the
+// one it shadows, and each scope remembers the bindings made in it. So
+// scope_enter is O(1), scope_exit is O(bindings made in the scope) and
+// scope_lookup is a single probe however deep the nesting.
+//
+// The table is global, like the interner. Exiting the outermost scope
+// releases it.
+
+#include "ast.h"
+
+typedef enum {
+    SYMBOL_GLOBAL,
+    SYMBOL_LOCAL,
+    SYMBOL_PARAM
+} symbol_kind_t;
+
+struct symbol {
+    symbol_kind_t kind;
+    const char *name;
+    struct type *type;
+    int level;                      // scope level it was bound at
+
+    // Use counts, kept by eliminate_dead_code: reads of the value, and
+    // plain stores `name = value`.
+    int reads;
+    int writes;
+
+    struct symbol *shadowed;        // binding of the same name further out
+    const char *emitted_name;       // name in the C file, if not c_name(name)
+    struct symbol *next_in_scope;
+};
+
+// Symbols are allocated with ast_alloc, so they live as long as the AST
+// that refers to them.
+struct symbol *symbol_create(symbol_kind_t kind, const char *name, struct type *type);
+
+void scope_enter(void);
+void scope_exit(void);
+int scope_level(void);
+
+// Binds sym in the innermost scope, replacing any binding of the same name
+// made in that scope. Returns the replaced binding, or NULL.
+struct symbol *scope_bind(struct symbol *sym);
+
+// Innermost binding of name, or NULL. Names must be interned.
+struct symbol *scope_lookup(const char *name);
+
+// Binding of name made in the innermost scope, or NULL.
+struct symbol *scope_lookup_current(const char *name);
+
+#endif
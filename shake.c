@@ -0,0 +1,108 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "shake.h"
+#include "intern.h"
+#include "scope.h"
+#include "work_stack.h"
+
+typedef struct {
+    const char *name;
+    struct decl *d;
+    int reached;
+} shake_entry_t;
+
+// Top-level declarations sorted by their interned name, so that all
+// declarations of one name sit next to each other.
+typedef struct {
+    shake_entry_t *entries;
+    size_t count;
+    work_stack_t pending;           // names reached but not yet followed
+} shake_t;
+
+static int compare_entries(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t) ((const shake_entry_t *) a)->name;
+    uintptr_t y = (uintptr_t) ((const shake_entry_t *) b)->name;
+    return (x > y) - (x < y);
+}
+
+// First entry for name, or NULL.
+static shake_entry_t *find_entries(shake_t *shake, const char *name) {
+    size_t low = 0;
+    size_t high = shake->count;
+
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if ((uintptr_t) shake->entries[middle].name < (uintptr_t) name) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low < shake->count && shake->entries[low].name == name ? &shake->entries[low] : NULL;
+}
+
+static void reach(shake_t *shake, const char *name) {
+    shake_entry_t *entry = find_entries(shake, name);
+    if (!entry || entry->reached) return;
+
+    for (shake_entry_t *end = shake->entries + shake->count; entry < end && entry->name == name; entry++) {
+        entry->reached = 1;
+        *(struct decl **) work_stack_push(&shake->pending) = entry->d;
+    }
+}
+
+static void reach_globals(struct expr *e, void *context) {
+    if (e->kind == EXPR_NAME && e->symbol && e->symbol->kind == SYMBOL_GLOBAL) {
+        reach(context, e->name);
+    }
+}
+
+struct decl *shake_program(struct decl *program) {
+    const char *main_name = intern_string("main");
+    shake_t shake = {NULL, 0, {NULL, 0, 0, 0}};
+
+    size_t count = 0;
+    for (struct decl *d = program; d; d = d->next) {
+        count += d->name != NULL;
+    }
+
+    shake.entries = malloc((count ? count : 1) * sizeof(shake_entry_t));
+    if (!shake.entries) return program;
+
+    for (struct decl *d = program; d; d = d->next) {
+        if (d->name) {
+            shake.entries[shake.count++] = (shake_entry_t) {d->name, d, 0};
+        }
+    }
+
+    qsort(shake.entries, shake.count, sizeof(shake_entry_t), compare_entries);
+
+    if (!find_entries(&shake, main_name)) {
+        free(shake.entries);
+        return program;
+    }
+
+    work_stack_init(&shake.pending, sizeof(struct decl *));
+    reach(&shake, main_name);
+
+    struct decl *d;
+    while (work_stack_pop(&shake.pending, &d)) {
+        ast_visit_decl_exprs(d, reach_globals, &shake);
+    }
+
+    // Unlink what was never reached.
+    struct decl **link = &program;
+    while (*link) {
+        d = *link;
+        if (d->name && !find_entries(&shake, d->name)->reached) {
+            *link = d->next;
+        } else {
+            link = &d->next;
+        }
+    }
+
+    work_stack_free(&shake.pending);
+    free(shake.entries);
+    return program;
+}
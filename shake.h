@@ -0,0 +1,16 @@
+#ifndef SHAKE_H
+#define SHAKE_H
+
+#include "ast.h"
+
+// Whole-program tree shaking. Starting from main, follows every global
+// name a reachable declaration refers to, calls included, through
+// function bodies, initializers and array sizes, and drops the top-level
+// declarations that are never reached. All declarations of a reached name
+// are kept, so a prototype stays with its definition. Comments are kept.
+//
+// A program without main is returned unchanged. Returns the new head of
+// the declaration list.
+struct decl *shake_program(struct decl *program);
+
+#endif
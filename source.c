@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "source.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SOURCE_HAVE_MMAP 1
+#endif
+
+static source_t *read_source(const char *path) {
+    FILE *input_file = fopen(path, "rb");
+    if (!input_file) {
+        return NULL;
+    }
+
+    fseek(input_file, 0, SEEK_END);
+    long file_size = ftell(input_file);
+    fseek(input_file, 0, SEEK_SET);
+
+    source_t *source = malloc(sizeof(source_t));
+    char *data = malloc(file_size + 1);
+    if (!source || !data || file_size < 0) {
+        free(source);
+        free(data);
+        fclose(input_file);
+        return NULL;
+    }
+
+    size_t read = fread(data, 1, file_size, input_file);
+    data[read] = '\0';
+    fclose(input_file);
+
+    source->data = data;
+    source->length = read;
+    source->mapped = 0;
+
+    return source;
+}
+
+#ifdef SOURCE_HAVE_MMAP
+static source_t *map_source(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        // Empty files cannot be mapped and pipes have no size; let the
+        // caller fall back to reading.
+        close(fd);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+#ifdef MADV_SEQUENTIAL
+    madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+#endif
+
+    source_t *source = malloc(sizeof(source_t));
+    if (!source) {
+        munmap(data, (size_t) st.st_size);
+        return NULL;
+    }
+
+    source->data = data;
+    source->length = (size_t) st.st_size;
+    source->mapped = 1;
+
+    return source;
+}
+#endif
+
+source_t *load_source(const char *path) {
+#ifdef SOURCE_HAVE_MMAP
+    source_t *source = map_source(path);
+    if (source) {
+        return source;
+    }
+#endif
+    return read_source(path);
+}
+
+void free_source(source_t *source) {
+    if (!source) return;
+
+#ifdef SOURCE_HAVE_MMAP
+    if (source->mapped) {
+        munmap(source->data, source->length);
+        free(source);
+        return;
+    }
+#endif
+
+    free(source->data);
+    free(source);
+}
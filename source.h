@@ -0,0 +1,18 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+
+// Source file contents. When the platform supports it the file is mapped
+// read-only into memory instead of being copied into a heap buffer, so the
+// data is not guaranteed to be NUL-terminated: always honour length.
+typedef struct {
+    char *data;
+    size_t length;
+    int mapped;
+} source_t;
+
+source_t *load_source(const char *path);
+void free_source(source_t *source);
+
+#endif
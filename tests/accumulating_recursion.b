@@ -0,0 +1,46 @@
+// Recursion whose calls are wrapped in additions and multiplications,
+// which tail-call elimination turns into loops with accumulators, and a
+// plain tail call, which needs none.
+
+gcd: function integer (a: integer, b: integer) = {
+    if (b == 0) return a;
+    return gcd(b, a % b);
+}
+
+sum: function integer (n: integer) = {
+    if (n == 0) return 0;
+    return n + sum(n - 1);
+}
+
+factorial: function integer (n: integer) = {
+    if (n <= 1) return 1;
+    return n * factorial(n - 1);
+}
+
+// Both at once: a multiplier and an addend, in either order.
+mixed: function integer (n: integer) = {
+    if (n == 0) return 1;
+    return 3 + 2 * mixed(n - 1);
+}
+
+mixed_right: function integer (n: integer) = {
+    if (n == 0) return 5;
+    return mixed_right(n - 1) * 2 + n;
+}
+
+nested: function integer (n: integer) = {
+    if (n == 0) return 2;
+    return n * (nested(n - 1) + 1);
+}
+
+main: function integer () = {
+    i: integer;
+    for (i = 0; i < 8; i = i + 1) {
+        print sum(i * 100), " ", factorial(i), " ", mixed(i), " ", mixed_right(i), " ", nested(i), "\n";
+    }
+    print sum(10), " ", factorial(10), " ", mixed(20), "\n";
+    for (i = 1; i < 4; i = i + 1) {
+        print gcd(i * 84, 36 * i + 24), "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,38 @@
+// A value computed twice in a block is computed once, and so is a load,
+// until a store or a call may have changed what it reads. A local array
+// whose loads all take the value stored before them is not kept at all.
+
+g: integer = 1;
+cells: array [4] integer = {1, 2, 3, 4};
+
+bump: function void () = {
+    g = g + 10;
+}
+
+products: function integer (a: integer, b: integer) = {
+    x: integer = a * b + 1;
+    y: integer = a * b + 2;
+    return x * y + a * b;
+}
+
+loads: function integer (i: integer) = {
+    first: integer = g * cells[i] + g * cells[i];
+    bump();
+    second: integer = g * cells[i];
+    cells[i] = cells[i] + 1;
+    return first + second + g * cells[i];
+}
+
+scratch: function integer (x: integer) = {
+    t: array [2] integer = {0, 0};
+    t[1] = x * 3;
+    return t[1] + 1;
+}
+
+main: function integer () = {
+    print products(3, 4), " ", products(5, 6), "\n";
+    print loads(1), "\n";
+    print loads(2), "\n";
+    print scratch(4), " ", scratch(5), "\n";
+    return 0;
+}
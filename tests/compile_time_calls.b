@@ -0,0 +1,33 @@
+// Calls with constant arguments to functions that depend on nothing else
+// are run by the compiler, and so are global initializers that call
+// functions which only compute: the literals replace them in the C. A
+// call that reads a global the program writes stays a call.
+
+factor: integer = 3;
+
+factorial: function integer (n: integer) = {
+    if (n <= 1) return 1;
+    return n * factorial(n - 1);
+}
+
+collatz_steps: function integer (n: integer) = {
+    steps: integer = 0;
+    for (; n != 1; steps = steps + 1) {
+        if (n % 2 == 0) n = n / 2;
+        else n = 3 * n + 1;
+    }
+    return steps;
+}
+
+scaled: function integer (n: integer) = {
+    return n * factor;
+}
+
+factorials: array [5] integer = {factorial(1), factorial(2), factorial(3), factorial(4), factorial(5)};
+longest: integer = collatz_steps(27);
+
+main: function integer () = {
+    factor = factor + 1;
+    print factorial(10), " ", longest, " ", factorials[4], " ", scaled(5), "\n";
+    return 0;
+}
@@ -0,0 +1,36 @@
+// Constant conditions pick their branch, statements after a return go, and
+// so do stores nothing reads and locals nothing uses, except for the calls
+// in them.
+
+count: integer = 0;
+
+tick: function integer () = {
+    count = count + 1;
+    return count;
+}
+
+pick: function integer (x: integer) = {
+    unused: integer = x * 7;
+    stored: integer = 0;
+    stored = x * 11;
+    stored = tick();
+    if (false) {
+        print "never printed\n";
+    } else {
+        x = x + 1;
+    }
+    for (; false;) {
+        print "never looped\n";
+    }
+    if (true) {
+        return x + 1000;
+    }
+    print "after the return\n";
+    return x;
+}
+
+main: function integer () = {
+    print pick(1), " ", pick(2), "\n";
+    print count, "\n";
+    return 0;
+}
@@ -0,0 +1,38 @@
+// Constant arithmetic wraps like the generated code, identities drop their
+// literal operand, an operand with side effects stays, and a division by
+// a literal zero is left to run time with a warning.
+
+calls: integer = 0;
+
+noisy: function integer (x: integer) = {
+    calls = calls + 1;
+    return x;
+}
+
+identities: function integer (x: integer) = {
+    a: integer = (x + 0) * 1 + (0 + x) * (1 * x);
+    b: integer = (x - 0) / 1 - (0 - x) ^ 1;
+    c: integer = x % 1 + x * 0 + 0 * x + x ^ 0 + 1 ^ x;
+    d: integer = - -x;
+    return a + b + c + d;
+}
+
+guarded: function integer (x: integer) = {
+    if (x > 100) {
+        return x / 0;
+    }
+    if (x > 200) {
+        return x % 0;
+    }
+    return x;
+}
+
+main: function integer () = {
+    big: integer = 2147483647;
+    print 2147483647 + 1, " ", -2147483647 - 1, " ", 46341 * 46341, "\n";
+    print identities(3), " ", identities(-5), "\n";
+    print noisy(4) * 0, " ", 0 * noisy(5), " ", noisy(6) % 1, "\n";
+    print calls, "\n";
+    print !!(big > 0), " ", guarded(7), " ", guarded(calls), "\n";
+    return 0;
+}
@@ -0,0 +1,54 @@
+// Functions that read only their arguments are const, ones that also read
+// changing globals or array parameters are pure, and ones that print or
+// write outside their locals get no attribute, callees included.
+
+fixed: integer = 4;
+moving: integer = 0;
+shared: array [3] integer = {1, 2, 3};
+
+twice: function integer (x: integer) = {
+    return x * 2 + fixed;
+}
+
+calls_twice: function integer (x: integer) = {
+    local: array [2] integer = {0, 0};
+    local[1] = twice(x);
+    return local[1] + 1;
+}
+
+sees_moving: function integer (x: integer) = {
+    return x + moving;
+}
+
+first: function integer (a: array [3] integer) = {
+    return a[0];
+}
+
+bump: function integer (x: integer) = {
+    moving = moving + x;
+    return moving;
+}
+
+fill: function integer (a: array [3] integer, x: integer) = {
+    a[0] = x;
+    return x;
+}
+
+loud: function integer (x: integer) = {
+    print "loud ", x, "\n";
+    return x;
+}
+
+calls_bump: function integer (x: integer) = {
+    return bump(x) + 1;
+}
+
+main: function integer () = {
+    print calls_twice(3), " ", sees_moving(1), " ", first(shared), "\n";
+    print bump(5), "\n";
+    print fill(shared, 9), "\n";
+    print first(shared), "\n";
+    print loud(7), "\n";
+    print calls_bump(2), "\n";
+    return 0;
+}
@@ -0,0 +1,26 @@
+// Global initializers that compile-time evaluation gives up on, or is not
+// asked to run, are assigned at the start of main.
+
+slow: function integer (n: integer) = {
+    s: integer = 0;
+    i: integer;
+    for (i = 0; i < n; i = i + 1) {
+        s = s + i % 7;
+    }
+    return s;
+}
+
+depth: function integer (n: integer) = {
+    if (n == 0) return 0;
+    return 1 + depth(n - 1);
+}
+
+big: integer = slow(3000000);
+deep: integer = depth(100000);
+table: array [3] integer = {slow(10), 2, big};
+after: integer = big + 1;
+
+main: function integer () = {
+    print big, " ", deep, " ", table[0], " ", table[1], " ", table[2], " ", after, "\n";
+    return 0;
+}
@@ -0,0 +1,43 @@
+// A small function is inlined at its calls and, once none are left, not
+// emitted at all; a recursive one is not inlined, and a function too big
+// for the budget stays a call.
+
+counter: integer = 0;
+
+square: function integer (x: integer) = {
+    return x * x;
+}
+
+clamp: function integer (x: integer, low: integer, high: integer) = {
+    if (x < low) return low;
+    if (x > high) return high;
+    return x;
+}
+
+fib: function integer (n: integer) = {
+    if (n < 2) return n;
+    return fib(n - 1) + fib(n - 2);
+}
+
+busy: function integer (n: integer) = {
+    s: integer = 0;
+    i: integer;
+    for (i = 0; i < n; i = i + 1) {
+        s = s + i * i - i / 3 + i % 5;
+        if (s > 1000) s = s - 1000;
+        if (s < 0) s = s + 7;
+        counter = counter + 1;
+        s = s * 3 + counter;
+        if (s > 500) s = s / 2;
+        s = s + square(i) - clamp(i, 2, 4);
+    }
+    return s;
+}
+
+main: function integer () = {
+    a: integer = counter + 3;
+    print square(a), " ", clamp(a * 5, 0, 10), " ", fib(a + 2), "\n";
+    print busy(a), "\n";
+    print busy(a + 1), "\n";
+    return 0;
+}
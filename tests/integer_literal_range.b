@@ -0,0 +1,8 @@
+// An integer literal has to fit an int: INT_MAX is the largest one, and
+// the next is an error rather than a value that wrapped.
+
+main: function integer () = {
+    x: integer = 2147483647;
+    print x, " ", 2147483648, "\n";
+    return 0;
+}
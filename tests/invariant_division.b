@@ -0,0 +1,36 @@
+// A division by a divisor that does not change in the loop, and is zero,
+// under a condition that never holds: it must not be hoisted out of the
+// loop, or folded, into a division that runs.
+
+zero: integer = 0;
+
+guarded: function integer (n: integer, d: integer) = {
+    s: integer = 0;
+    i: integer;
+    for (i = 0; i < n; i = i + 1) {
+        if (d != 0) {
+            s = s + 1000 / d;
+        }
+        s = s + i;
+    }
+    return s;
+}
+
+never_reached: function integer (n: integer) = {
+    s: integer = 0;
+    d: integer = zero;
+    i: integer;
+    for (i = 0; i < n; i = i + 1) {
+        if (i > n) {
+            s = s + i % d;
+        }
+        s = s + 2;
+    }
+    return s;
+}
+
+main: function integer () = {
+    print guarded(10, 0), " ", guarded(10, 7), "\n";
+    print never_reached(10), "\n";
+    return 0;
+}
@@ -0,0 +1,29 @@
+// Whitespace runs, comments and strings long enough for the bulk scanners,
+// with the bytes that stop them at every offset a vector can start from,
+// and identifiers that start with a keyword.
+
+/* A block comment that runs past several vector widths, holding stars *
+   and slashes / that do not close it: * / ** // *** ///////////// **
+   ************************************************************** */
+
+iffy: integer = 3;                                     					                                                                      // a trailing comment ------------------------------------------------------------------------------------------
+returned: integer = 4;
+format: string = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef\"quoted\" and \\ backslash";
+
+main: function integer () = {
+                                     					                                                                      integers: integer = iffy * returned;
+    true_count: integer = 0;                                     					                                                                      
+    i: integer;
+    for (i = 0; i < 3; i = i + 1) {                                                                                                                                                                                                        
+												true_count = true_count + i;
+    }
+    print "\"yyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyy\\", "\n";
+    print "xxxxxxx\"yyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyyy\\", "\n";
+    print "xxxxxxxxxxxxxx\"yyyyyyyyyyyyyyyyyyyyyyyyyy\\", "\n";
+    print "xxxxxxxxxxxxxxxxxxxxx\"yyyyyyyyyyyyyyyyyyy\\", "\n";
+    print "xxxxxxxxxxxxxxxxxxxxxxxxxxxx\"yyyyyyyyyyyy\\", "\n";
+    print "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx\"yyyyy\\", "\n";
+    print integers, " ", true_count, " ", format, "\n";
+    print 'a', 'z', "\n";
+    return 0;                                 /* ====================================================================== */
+}
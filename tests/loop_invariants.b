@@ -0,0 +1,30 @@
+// What a loop computes the same way on every iteration is computed once
+// before it: arithmetic on values the loop does not change, and a load of
+// a global nothing in the loop writes. A load the loop writes stays in it.
+
+limit: integer = 3;
+total: integer = 0;
+
+sums: function integer (n: integer, a: integer, b: integer) = {
+    s: integer = 0;
+    i: integer;
+    for (i = 0; i < n; i = i + 1) {
+        s = s + a * b + limit * a + i;
+    }
+    return s;
+}
+
+accumulate: function integer (n: integer, a: integer) = {
+    i: integer;
+    for (i = 0; i < n; i = i + 1) {
+        total = total + a * a;
+    }
+    return total;
+}
+
+main: function integer () = {
+    print sums(4, 2, 5), " ", sums(10, 3, 7), "\n";
+    print accumulate(3, 2), "\n";
+    print accumulate(2, 5), "\n";
+    return 0;
+}
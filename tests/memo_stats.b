@@ -0,0 +1,29 @@
+// A memoized function called with arguments only known at run time, so
+// that the hit rates reported with --memo-stats come from the calls
+// below and not from compile-time evaluation. A function whose result
+// depends on a global it writes is not memoized, pragma or not.
+
+// pragma memoize
+fibonacci: function integer (n: integer) = {
+    if (n < 2) return n;
+    return fibonacci(n - 1) + fibonacci(n - 2);
+}
+
+calls: integer = 0;
+
+// pragma memoize
+counted: function integer (n: integer) = {
+    calls = calls + 1;
+    return n + calls;
+}
+
+main: function integer () = {
+    i: integer;
+    for (i = 0; i < 30; i = i + 3) {
+        print fibonacci(i), " ";
+    }
+    print "\n";
+    print counted(1), " ", calls, "\n";
+    print counted(1), " ", calls, "\n";
+    return 0;
+}
@@ -0,0 +1,55 @@
+// Values that trade places every iteration: the phis at the loop head
+// read each other, so their copies on the back edge must not clobber one
+// another.
+
+rotate: function integer (n: integer) = {
+    a: integer = 1;
+    b: integer = 2;
+    c: integer = 3;
+    i: integer;
+    for (i = 0; i < n; i = i + 1) {
+        t: integer = a;
+        a = b;
+        b = c;
+        c = t;
+    }
+    return a * 100 + b * 10 + c;
+}
+
+fibonacci: function integer (n: integer) = {
+    a: integer = 0;
+    b: integer = 1;
+    i: integer;
+    for (i = 0; i < n; i = i + 1) {
+        t: integer = a + b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Swaps only on some iterations, so the phis merge a swapped and an
+// unswapped pair.
+sort_pairs: function integer (n: integer) = {
+    lo: integer = 9;
+    hi: integer = 0;
+    i: integer;
+    for (i = 0; i < n; i = i + 1) {
+        if (lo > hi) {
+            t: integer = lo;
+            lo = hi;
+            hi = t;
+        }
+        hi = hi + i % 3;
+        lo = lo + i % 5;
+    }
+    return lo * 1000 + hi;
+}
+
+main: function integer () = {
+    n: integer;
+    for (n = 0; n < 5; n = n + 1) {
+        print rotate(n), " ", fibonacci(n * 5), " ", sort_pairs(n * 4), "\n";
+    }
+    return 0;
+}
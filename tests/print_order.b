@@ -0,0 +1,15 @@
+// The values of a print are computed left to right, by both back ends,
+// even when a call in one changes what another reads.
+
+count: integer = 0;
+
+next: function integer () = {
+    count = count + 1;
+    return count;
+}
+
+main: function integer () = {
+    print "before ", count, " ", next(), " ", count, " ", next() * 10, " after\n";
+    print next() > 2, " ", count, "\n";
+    return 0;
+}
@@ -0,0 +1,24 @@
+// Parameters every call passes the same constant, and copies of functions
+// for the constants hot calls pass: what is replaced by a constant leaves
+// the signatures, so the generated code has no unused parameters.
+
+sum: function integer (n: integer, step: integer, base: integer);
+
+sum: function integer (n: integer, step: integer, base: integer) = {
+    if (n <= 0) return base;
+    return n * step + sum(n - step, step, base);
+}
+
+area: function integer (w: integer, h: integer) = {
+    return w * h;
+}
+
+main: function integer () = {
+    i: integer;
+    t: integer = 0;
+    for (i = 0; i < 5; i = i + 1) {
+        t = t + sum(i, 1, 7) + sum(i * 2, 2, 7) + area(i, 3);
+    }
+    print t, " ", sum(10, 1, 7), " ", area(4, 3), "\n";
+    return 0;
+}
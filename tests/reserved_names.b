@@ -0,0 +1,37 @@
+// Identifiers named like what the generated C adds for itself: its
+// runtime helpers, the tables and counters of memoized functions, and
+// the names it gives the identifiers that start with an underscore.
+
+bminor_pow: integer = 3;
+bminor_divide_by_zero: integer = 0;
+bminor_u_v0: integer = 5;
+_v0: integer = 7;
+
+// pragma memoize
+hash: function integer (bminor_slot: integer) = {
+    if (bminor_slot < 2) return bminor_slot;
+    return hash(bminor_slot - 1) + hash(bminor_slot - 2);
+}
+
+// pragma memoize
+hash_hits: function integer (n: integer) = {
+    return n * n;
+}
+
+bminor_init_globals: function integer (bminor_value: integer) = {
+    return bminor_value ^ bminor_pow;
+}
+
+main: function integer () = {
+    i: integer;
+    for (i = 1; i < 5; i = i + 1) {
+        bminor_divide_by_zero = bminor_divide_by_zero + i;
+        print hash(i * 3), " ", hash_hits(i), " ", bminor_init_globals(i), " ";
+        print i ^ (bminor_pow + i), " ", bminor_divide_by_zero % (i + 1), "\n";
+        if (i > 10) {
+            print i / 0, "\n";
+        }
+    }
+    print bminor_u_v0 * 10 + _v0, "\n";
+    return 0;
+}
@@ -0,0 +1,138 @@
+# Compiles one B-minor program under each set of options its behaviour
+# must not depend on, builds and runs the generated C, and compares what
+# it prints with the expected output:
+#
+#   cmake -DCOMPILER=<compiler> -DC_COMPILER=<cc> -DC_FLAGS=<flags>
+#         -DSOURCE=<name>.b -DWORK_DIR=<dir> [-DFLAGS=<options>]
+#         -P run_test.cmake
+#
+# Standard output must match <name>.out, and standard error <name>.err
+# when there is one. FLAGS go to the compiler in every run.
+#
+# When there is a <name>.match, the first run also has to produce each of
+# its lines somewhere in the generated C or in what the compiler prints on
+# stderr (its warnings, and the IR with --dump-ir), and none of the lines
+# that start with '!'. A \n in a line stands for a line break, so a line
+# can check text that spans several. Blank lines and lines starting with
+# '#' are skipped.
+#
+# A program without a <name>.out must be rejected: no run may write C, and
+# the messages go through <name>.match.
+
+set(VARIANTS
+        "default"
+        "--ast-codegen"
+        "--no-ctfe"
+        "--specialize-budget=0"
+        "--inline-budget=0"
+        )
+
+get_filename_component(NAME ${SOURCE} NAME_WE)
+get_filename_component(SOURCE_DIR ${SOURCE} DIRECTORY)
+set(REJECTED TRUE)
+if(EXISTS ${SOURCE_DIR}/${NAME}.out)
+    set(REJECTED FALSE)
+    file(READ ${SOURCE_DIR}/${NAME}.out EXPECTED_OUTPUT)
+endif()
+set(EXPECTED_ERROR "")
+if(EXISTS ${SOURCE_DIR}/${NAME}.err)
+    file(READ ${SOURCE_DIR}/${NAME}.err EXPECTED_ERROR)
+endif()
+
+set(MATCHES "")
+if(EXISTS ${SOURCE_DIR}/${NAME}.match)
+    file(STRINGS ${SOURCE_DIR}/${NAME}.match MATCHES)
+endif()
+
+# Checks TEXT against the lines of <name>.match, adding VARIANT to FAILED
+# for each one it breaks.
+function(check_matches VARIANT TEXT)
+    foreach(MATCH IN LISTS MATCHES)
+        if(MATCH STREQUAL "" OR MATCH MATCHES "^#")
+            continue()
+        endif()
+        string(REPLACE "\\n" "\n" MATCH "${MATCH}")
+        if(MATCH MATCHES "^!")
+            string(SUBSTRING "${MATCH}" 1 -1 MATCH)
+            string(FIND "${TEXT}" "${MATCH}" AT)
+            if(NOT AT EQUAL -1)
+                message(SEND_ERROR "${VARIANT}: the compiler produced\n${MATCH}")
+                set(FAILED ${FAILED} ${VARIANT} PARENT_SCOPE)
+            endif()
+        else()
+            string(FIND "${TEXT}" "${MATCH}" AT)
+            if(AT EQUAL -1)
+                message(SEND_ERROR "${VARIANT}: the compiler did not produce\n${MATCH}")
+                set(FAILED ${FAILED} ${VARIANT} PARENT_SCOPE)
+            endif()
+        endif()
+    endforeach()
+endfunction()
+
+separate_arguments(FLAGS)
+separate_arguments(C_FLAGS)
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+set(FAILED "")
+set(RUN 0)
+foreach(VARIANT ${VARIANTS})
+    set(OPTIONS ${FLAGS})
+    if(NOT VARIANT STREQUAL "default")
+        list(APPEND OPTIONS ${VARIANT})
+    endif()
+
+    # The compiler writes its output next to its input.
+    set(INPUT ${WORK_DIR}/${NAME}_${RUN}.b)
+    set(PROGRAM ${WORK_DIR}/${NAME}_${RUN})
+    math(EXPR RUN "${RUN} + 1")
+    configure_file(${SOURCE} ${INPUT} COPYONLY)
+
+    file(REMOVE ${INPUT}.c)
+    execute_process(COMMAND ${COMPILER} ${OPTIONS} ${INPUT}
+            RESULT_VARIABLE RESULT OUTPUT_VARIABLE LOG ERROR_VARIABLE LOG)
+    if(REJECTED)
+        if(EXISTS ${INPUT}.c)
+            message(SEND_ERROR "${VARIANT}: the compiler accepted the program")
+            list(APPEND FAILED ${VARIANT})
+        elseif(VARIANT STREQUAL "default")
+            check_matches(${VARIANT} "${LOG}")
+        endif()
+        continue()
+    endif()
+    if(NOT RESULT EQUAL 0)
+        message(SEND_ERROR "${VARIANT}: the compiler failed:\n${LOG}")
+        list(APPEND FAILED ${VARIANT})
+        continue()
+    endif()
+
+    if(VARIANT STREQUAL "default")
+        file(READ ${INPUT}.c GENERATED)
+        check_matches(${VARIANT} "${GENERATED}${LOG}")
+    endif()
+
+    execute_process(COMMAND ${C_COMPILER} ${C_FLAGS} -o ${PROGRAM} ${INPUT}.c
+            RESULT_VARIABLE RESULT OUTPUT_VARIABLE LOG ERROR_VARIABLE LOG)
+    if(NOT RESULT EQUAL 0)
+        message(SEND_ERROR "${VARIANT}: the generated C does not build:\n${LOG}")
+        list(APPEND FAILED ${VARIANT})
+        continue()
+    endif()
+
+    execute_process(COMMAND ${PROGRAM}
+            RESULT_VARIABLE RESULT OUTPUT_VARIABLE OUTPUT ERROR_VARIABLE ERROR)
+    if(NOT RESULT EQUAL 0)
+        message(SEND_ERROR "${VARIANT}: the program exited with ${RESULT}")
+        list(APPEND FAILED ${VARIANT})
+    elseif(NOT OUTPUT STREQUAL EXPECTED_OUTPUT)
+        message(SEND_ERROR "${VARIANT}: expected\n${EXPECTED_OUTPUT}got\n${OUTPUT}")
+        list(APPEND FAILED ${VARIANT})
+    elseif(NOT ERROR STREQUAL EXPECTED_ERROR)
+        message(SEND_ERROR "${VARIANT}: expected on stderr\n${EXPECTED_ERROR}got\n${ERROR}")
+        list(APPEND FAILED ${VARIANT})
+    endif()
+endforeach()
+
+if(FAILED)
+    list(REMOVE_DUPLICATES FAILED)
+    message(FATAL_ERROR "${NAME} failed with: ${FAILED}")
+endif()
@@ -0,0 +1,24 @@
+// A function that reads a global assigned at the start of main reads
+// memory that changes, so it may be pure but never const; one that reads
+// a global with a literal initializer, never written, stays const.
+
+depth: function integer (n: integer) = {
+    if (n == 0) return 0;
+    return 1 + depth(n - 1);
+}
+
+b: integer = depth(100000);
+k: integer = 7;
+
+getb: function integer () = {
+    return b;
+}
+
+getk: function integer (n: integer) = {
+    return k * n;
+}
+
+main: function integer () = {
+    print getb(), " ", getk(b), " ", getb() + getk(2), "\n";
+    return 0;
+}
@@ -0,0 +1,16 @@
+// A name declared twice in one block, and a local used after its block
+// has ended.
+
+x: integer = 1;
+
+main: function integer () = {
+    y: integer = 2;
+    if (x > 0) {
+        z: integer = 3;
+        x: integer = 4;
+        y = z + x;
+    }
+    y: integer = 5;
+    print y + z, "\n";
+    return 0;
+}
@@ -0,0 +1,190 @@
+// Enough globals to make the symbol table grow, shadowing in nested
+// blocks, the same names in sibling blocks, and outer bindings that come
+// back when a block ends.
+
+g0: integer = 0;
+g1: integer = 3;
+g2: integer = 6;
+g3: integer = 9;
+g4: integer = 12;
+g5: integer = 15;
+g6: integer = 18;
+g7: integer = 21;
+g8: integer = 24;
+g9: integer = 27;
+g10: integer = 30;
+g11: integer = 33;
+g12: integer = 36;
+g13: integer = 39;
+g14: integer = 42;
+g15: integer = 45;
+g16: integer = 48;
+g17: integer = 51;
+g18: integer = 54;
+g19: integer = 57;
+g20: integer = 60;
+g21: integer = 63;
+g22: integer = 66;
+g23: integer = 69;
+g24: integer = 72;
+g25: integer = 75;
+g26: integer = 78;
+g27: integer = 81;
+g28: integer = 84;
+g29: integer = 87;
+g30: integer = 90;
+g31: integer = 93;
+g32: integer = 96;
+g33: integer = 99;
+g34: integer = 102;
+g35: integer = 105;
+g36: integer = 108;
+g37: integer = 111;
+g38: integer = 114;
+g39: integer = 117;
+g40: integer = 120;
+g41: integer = 123;
+g42: integer = 126;
+g43: integer = 129;
+g44: integer = 132;
+g45: integer = 135;
+g46: integer = 138;
+g47: integer = 141;
+g48: integer = 144;
+g49: integer = 147;
+g50: integer = 150;
+g51: integer = 153;
+g52: integer = 156;
+g53: integer = 159;
+g54: integer = 162;
+g55: integer = 165;
+g56: integer = 168;
+g57: integer = 171;
+g58: integer = 174;
+g59: integer = 177;
+g60: integer = 180;
+g61: integer = 183;
+g62: integer = 186;
+g63: integer = 189;
+g64: integer = 192;
+g65: integer = 195;
+g66: integer = 198;
+g67: integer = 201;
+g68: integer = 204;
+g69: integer = 207;
+g70: integer = 210;
+g71: integer = 213;
+g72: integer = 216;
+g73: integer = 219;
+g74: integer = 222;
+g75: integer = 225;
+g76: integer = 228;
+g77: integer = 231;
+g78: integer = 234;
+g79: integer = 237;
+g80: integer = 240;
+g81: integer = 243;
+g82: integer = 246;
+g83: integer = 249;
+g84: integer = 252;
+g85: integer = 255;
+g86: integer = 258;
+g87: integer = 261;
+g88: integer = 264;
+g89: integer = 267;
+g90: integer = 270;
+g91: integer = 273;
+g92: integer = 276;
+g93: integer = 279;
+g94: integer = 282;
+g95: integer = 285;
+g96: integer = 288;
+g97: integer = 291;
+g98: integer = 294;
+g99: integer = 297;
+g100: integer = 300;
+g101: integer = 303;
+g102: integer = 306;
+g103: integer = 309;
+g104: integer = 312;
+g105: integer = 315;
+g106: integer = 318;
+g107: integer = 321;
+g108: integer = 324;
+g109: integer = 327;
+g110: integer = 330;
+g111: integer = 333;
+g112: integer = 336;
+g113: integer = 339;
+g114: integer = 342;
+g115: integer = 345;
+g116: integer = 348;
+g117: integer = 351;
+g118: integer = 354;
+g119: integer = 357;
+g120: integer = 360;
+g121: integer = 363;
+g122: integer = 366;
+g123: integer = 369;
+g124: integer = 372;
+g125: integer = 375;
+g126: integer = 378;
+g127: integer = 381;
+g128: integer = 384;
+g129: integer = 387;
+g130: integer = 390;
+g131: integer = 393;
+g132: integer = 396;
+g133: integer = 399;
+g134: integer = 402;
+g135: integer = 405;
+g136: integer = 408;
+g137: integer = 411;
+g138: integer = 414;
+g139: integer = 417;
+g140: integer = 420;
+g141: integer = 423;
+g142: integer = 426;
+g143: integer = 429;
+g144: integer = 432;
+g145: integer = 435;
+g146: integer = 438;
+g147: integer = 441;
+g148: integer = 444;
+g149: integer = 447;
+g150: integer = 450;
+g151: integer = 453;
+g152: integer = 456;
+g153: integer = 459;
+g154: integer = 462;
+g155: integer = 465;
+g156: integer = 468;
+g157: integer = 471;
+g158: integer = 474;
+g159: integer = 477;
+
+sum: function integer (n: integer) = {
+    total: integer = 0;
+    if (n > 0) {
+        total: integer = 100;
+        if (n > 1) {
+            total: integer = 1000;
+            n = n + total;
+        }
+        n = n + total;
+    }
+    if (n > 2) {
+        g7: integer = 1;
+        total = total + g7;
+    } else {
+        g7: integer = 2;
+        total = total + g7;
+    }
+    return n + total + g7;
+}
+
+main: function integer () = {
+    g0: integer = g159;
+    print g0, " ", g1 + g158, " ", sum(0), " ", sum(1), " ", sum(2), "\n";
+    return 0;
+}
@@ -0,0 +1,33 @@
+// A local whose initializer reads the name it shadows reads the outer
+// binding: a global, a parameter or a local of an enclosing block.
+
+h: integer = 5;
+a: array [3] integer = {1, 2, 3};
+
+step: function integer (n: integer) = {
+    h: integer = h + n;
+    if (n > 0) {
+        h: integer = h * 2;
+        h = h + 1;
+        return h;
+    }
+    return h;
+}
+
+twice: function integer (n: integer) = {
+    if (n > 1) {
+        n: integer = n * 2;
+        return n;
+    }
+    return n;
+}
+
+main: function integer () = {
+    i: integer;
+    for (i = 0; i < 2; i = i + 1) {
+        a: array [3] integer = {a[2], a[1], a[0]};
+        print a[0] + i, " ";
+    }
+    print step(h), " ", step(0), " ", twice(h), " ", twice(1), "\n";
+    return 0;
+}
@@ -0,0 +1,32 @@
+// Only what main reaches, through calls and global references, is
+// emitted: not a function nothing calls, the functions and globals only it
+// uses, or a global nothing reads.
+
+limit: integer = 10;
+scale: integer = 3;
+orphan_table: array [4] integer = {1, 2, 3, 4};
+orphan_count: integer = 0;
+
+used_helper: function integer (n: integer) = {
+    if (n > limit) return limit;
+    return n * scale;
+}
+
+used: function integer (n: integer) = {
+    return used_helper(n) + used_helper(n + 1);
+}
+
+orphan_helper: function integer (n: integer) = {
+    orphan_count = orphan_count + 1;
+    return orphan_table[n % 4];
+}
+
+orphan: function integer (n: integer) = {
+    return orphan_helper(n) + orphan(n - 1);
+}
+
+main: function integer () = {
+    scale = scale + 1;
+    print used(2), " ", used(limit), "\n";
+    return 0;
+}
@@ -0,0 +1,26 @@
+// Every type error in a program is reported, each against the function it
+// is in, and the program is rejected.
+
+flag: boolean = 3;
+table: array [2] integer = {1, 'a'};
+
+add: function integer (a: integer, b: integer) = {
+    return a + b;
+}
+
+check: function boolean (c: char) = {
+    if (c) {
+        return c == 'x';
+    }
+    return 1;
+}
+
+main: function integer () = {
+    s: string = "text";
+    n: integer = add(1, true);
+    n = add(2);
+    n = s * 2;
+    n[0] = 1;
+    print !n, check('x') + 1, "\n";
+    return 0;
+}
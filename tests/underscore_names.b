@@ -0,0 +1,26 @@
+// Names the IR emitter gives its own temporaries (_vN, _pN, _aN) are
+// valid B-minor identifiers too, for globals, locals, parameters and
+// functions alike; none may capture or shadow the other.
+
+_v0: integer = 10;
+_a0: array [3] integer = {1, 2, 3};
+
+_p0: function integer (_v1: integer, _p1: integer) = {
+    _a1: integer = _v1 * _p1;
+    if (_a1 > 20) {
+        _a1 = _a1 - _v0;
+    }
+    return _a1 + _a0[1];
+}
+
+main: function integer () = {
+    x: integer = 2;
+    _v2: integer;
+    _v0 = _v0 + 1;
+    print _v0 * x, " ", x * 4, " ", x ^ _v0, "\n";
+    for (_v2 = 0; _v2 < 3; _v2 = _v2 + 1) {
+        _a0[_v2] = _a0[_v2] + _p0(_v2 + x, _v0);
+    }
+    print _a0[0], " ", _a0[1], " ", _a0[2], "\n";
+    return 0;
+}
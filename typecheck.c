@@ -0,0 +1,521 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include "typecheck.h"
+#include "work_stack.h"
+
+static struct type type_void = {TYPE_VOID, NULL, NULL, NULL};
+static struct type type_boolean = {TYPE_BOOLEAN, NULL, NULL, NULL};
+static struct type type_character = {TYPE_CHARACTER, NULL, NULL, NULL};
+static struct type type_integer = {TYPE_INTEGER, NULL, NULL, NULL};
+static struct type type_string = {TYPE_STRING, NULL, NULL, NULL};
+
+static int error_count = 0;
+static const char *current_function = NULL;
+
+struct type *type_basic(type_kind_t kind) {
+    switch (kind) {
+        case TYPE_VOID: return &type_void;
+        case TYPE_BOOLEAN: return &type_boolean;
+        case TYPE_CHARACTER: return &type_character;
+        case TYPE_INTEGER: return &type_integer;
+        case TYPE_STRING: return &type_string;
+        default: return NULL;
+    }
+}
+
+int type_equals(struct type *a, struct type *b) {
+    if (a == b) return 1;
+    if (!a || !b || a->kind != b->kind) return 0;
+
+    switch (a->kind) {
+        case TYPE_ARRAY:
+            return type_equals(a->subtype, b->subtype);
+
+        case TYPE_FUNCTION: {
+            if (!type_equals(a->subtype, b->subtype)) return 0;
+
+            struct param_list *p = a->params;
+            struct param_list *q = b->params;
+            for (; p && q; p = p->next, q = q->next) {
+                if (!type_equals(p->type, q->type)) return 0;
+            }
+            return !p && !q;
+        }
+
+        default:
+            return 1;
+    }
+}
+
+const char *type_name(struct type *t) {
+    if (!t) return "unknown";
+
+    switch (t->kind) {
+        case TYPE_VOID: return "void";
+        case TYPE_BOOLEAN: return "boolean";
+        case TYPE_CHARACTER: return "char";
+        case TYPE_INTEGER: return "integer";
+        case TYPE_STRING: return "string";
+        case TYPE_ARRAY: return "array";
+        case TYPE_FUNCTION: return "function";
+    }
+
+    return "unknown";
+}
+
+static void type_error(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+
+    fprintf(stderr, "error: ");
+    if (current_function) {
+        fprintf(stderr, "in function %s: ", current_function);
+    }
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+
+    va_end(args);
+    error_count++;
+}
+
+static const char *operator_name(expr_kind_t kind) {
+    switch (kind) {
+        case EXPR_UNARY_MINUS: return "-";
+        case EXPR_NOT: return "!";
+        case EXPR_POWER: return "^";
+        case EXPR_MUL: return "*";
+        case EXPR_DIV: return "/";
+        case EXPR_MOD: return "%";
+        case EXPR_ADD: return "+";
+        case EXPR_SUB: return "-";
+        case EXPR_LT: return "<";
+        case EXPR_LE: return "<=";
+        case EXPR_GT: return ">";
+        case EXPR_GE: return ">=";
+        case EXPR_EQ: return "==";
+        case EXPR_NEQ: return "!=";
+        case EXPR_AND: return "&&";
+        case EXPR_OR: return "||";
+        default: return "?";
+    }
+}
+
+static int is_value_type(struct type *t) {
+    return t && t->kind != TYPE_VOID && t->kind != TYPE_ARRAY && t->kind != TYPE_FUNCTION;
+}
+
+static void check_call(struct expr *e) {
+    struct type *callee = e->left->type;
+    const char *name = e->left->kind == EXPR_NAME ? e->left->name : "expression";
+
+    if (!callee || callee->kind != TYPE_FUNCTION) {
+        type_error("%s is not a function", name);
+        e->type = &type_integer;
+        return;
+    }
+
+    struct expr *arg = e->right;
+    struct param_list *param = callee->params;
+    int position = 1;
+
+    for (; arg && param; arg = arg->right, param = param->next, position++) {
+        if (!type_equals(arg->type, param->type)) {
+            type_error("argument %d of %s is %s, expected %s",
+                       position, name, type_name(arg->type), type_name(param->type));
+        }
+    }
+
+    if (arg || param) {
+        type_error("%s called with the wrong number of arguments", name);
+    }
+
+    e->type = callee->subtype ? callee->subtype : &type_void;
+}
+
+// Computes the type of e from the already typed children.
+static void type_node(struct expr *e) {
+    int operands = expr_has_operands(e);
+    struct type *left = operands && e->left ? e->left->type : NULL;
+    struct type *right = operands && e->right ? e->right->type : NULL;
+
+    switch (e->kind) {
+        case EXPR_NAME:
+            e->symbol = scope_lookup(e->name);
+            if (!e->symbol) {
+                type_error("%s is not declared", e->name);
+                e->type = &type_integer;
+            } else {
+                e->type = e->symbol->type;
+            }
+            break;
+
+        case EXPR_INTEGER_LITERAL:
+            e->type = &type_integer;
+            break;
+        case EXPR_STRING_LITERAL:
+            e->type = &type_string;
+            break;
+        case EXPR_CHAR_LITERAL:
+            e->type = &type_character;
+            break;
+        case EXPR_BOOL_LITERAL:
+            e->type = &type_boolean;
+            break;
+
+        case EXPR_CALL:
+            check_call(e);
+            break;
+
+        case EXPR_SUBSCRIPT:
+            if (!right || right->kind != TYPE_INTEGER) {
+                type_error("index is %s, expected integer", type_name(right));
+            }
+
+            if (left && left->kind == TYPE_ARRAY) {
+                e->type = left->subtype;
+            } else if (left && left->kind == TYPE_STRING) {
+                e->type = &type_character;
+            } else {
+                type_error("cannot index a value of type %s", type_name(left));
+                e->type = &type_integer;
+            }
+            break;
+
+        case EXPR_UNARY_MINUS:
+            if (!right || right->kind != TYPE_INTEGER) {
+                type_error("operand of - is %s, expected integer", type_name(right));
+            }
+            e->type = &type_integer;
+            break;
+
+        case EXPR_NOT:
+            if (!right || right->kind != TYPE_BOOLEAN) {
+                type_error("operand of ! is %s, expected boolean", type_name(right));
+            }
+            e->type = &type_boolean;
+            break;
+
+        case EXPR_POWER:
+        case EXPR_MUL:
+        case EXPR_DIV:
+        case EXPR_MOD:
+        case EXPR_ADD:
+        case EXPR_SUB:
+            if (!left || left->kind != TYPE_INTEGER || !right || right->kind != TYPE_INTEGER) {
+                type_error("operands of %s are %s and %s, expected integers",
+                           operator_name(e->kind), type_name(left), type_name(right));
+            }
+            e->type = &type_integer;
+            break;
+
+        case EXPR_LT:
+        case EXPR_LE:
+        case EXPR_GT:
+        case EXPR_GE:
+            if (!left || !right || left->kind != right->kind ||
+                (left->kind != TYPE_INTEGER && left->kind != TYPE_CHARACTER)) {
+                type_error("operands of %s are %s and %s, expected integers or chars",
+                           operator_name(e->kind), type_name(left), type_name(right));
+            }
+            e->type = &type_boolean;
+            break;
+
+        case EXPR_EQ:
+        case EXPR_NEQ:
+            if (!is_value_type(left) || !type_equals(left, right)) {
+                type_error("cannot compare %s with %s", type_name(left), type_name(right));
+            }
+            e->type = &type_boolean;
+            break;
+
+        case EXPR_AND:
+        case EXPR_OR:
+            if (!left || left->kind != TYPE_BOOLEAN || !right || right->kind != TYPE_BOOLEAN) {
+                type_error("operands of %s are %s and %s, expected booleans",
+                           operator_name(e->kind), type_name(left), type_name(right));
+            }
+            e->type = &type_boolean;
+            break;
+
+        case EXPR_ASSIGN:
+            if (e->left->kind != EXPR_NAME && e->left->kind != EXPR_SUBSCRIPT) {
+                type_error("left side of = is not assignable");
+            } else if (!is_value_type(left)) {
+                type_error("cannot assign to a value of type %s", type_name(left));
+            } else if (!type_equals(left, right)) {
+                type_error("cannot assign %s to %s", type_name(right), type_name(left));
+            }
+            e->type = left;
+            break;
+
+        case EXPR_ARRAY_LITERAL: {
+            struct type *element = e->right ? e->right->type : &type_integer;
+
+            for (struct expr *cell = e->right; cell; cell = cell->right) {
+                if (!type_equals(cell->type, element)) {
+                    type_error("array literal mixes %s and %s", type_name(element), type_name(cell->type));
+                    break;
+                }
+            }
+
+            e->type = create_type(TYPE_ARRAY, element, NULL);
+            break;
+        }
+
+        case EXPR_ARG:
+            e->type = left;
+            break;
+    }
+}
+
+// Types every node of the tree bottom-up, from an explicit stack.
+static struct type *check_expr(struct expr *root) {
+    if (!root) return NULL;
+
+    typedef struct {
+        struct expr *e;
+        int children_done;
+    } expr_work_t;
+
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(expr_work_t));
+    ((expr_work_t *) work_stack_push(&stack))->e = root;
+
+    expr_work_t item;
+    while (work_stack_pop(&stack, &item)) {
+        struct expr *e = item.e;
+
+        if (item.children_done) {
+            type_node(e);
+            continue;
+        }
+
+        expr_work_t *again = work_stack_push(&stack);
+        again->e = e;
+        again->children_done = 1;
+
+        if (!expr_has_operands(e)) {
+            continue;
+        }
+        if (e->right) {
+            ((expr_work_t *) work_stack_push(&stack))->e = e->right;
+        }
+        if (e->left) {
+            ((expr_work_t *) work_stack_push(&stack))->e = e->left;
+        }
+    }
+
+    work_stack_free(&stack);
+    return root->type;
+}
+
+static void bind(struct symbol *sym) {
+    struct symbol *replaced = scope_bind(sym);
+
+    // A function may be declared again with the same type, as a
+    // prototype and then its definition.
+    if (replaced && !(sym->type && sym->type->kind == TYPE_FUNCTION && type_equals(replaced->type, sym->type))) {
+        type_error("%s is already declared in this scope", sym->name);
+    }
+}
+
+// Checks a variable or function declaration and binds its name.
+static void check_decl(struct decl *d, symbol_kind_t kind) {
+    struct type *t = d->type;
+
+    if (t && t->kind == TYPE_ARRAY && t->array_size) {
+        struct type *size = check_expr(t->array_size);
+        if (!size || size->kind != TYPE_INTEGER) {
+            type_error("size of array %s is %s, expected integer", d->name, type_name(size));
+        }
+    }
+
+    if (d->value) {
+        struct type *value = check_expr(d->value);
+
+        if (t && t->kind == TYPE_ARRAY && d->value->kind == EXPR_ARRAY_LITERAL) {
+            if (d->value->right && !type_equals(value->subtype, t->subtype)) {
+                type_error("%s has elements of type %s, initialized with %s",
+                           d->name, type_name(t->subtype), type_name(value->subtype));
+            }
+        } else if (!type_equals(value, t)) {
+            type_error("%s is %s, initialized with %s", d->name, type_name(t), type_name(value));
+        }
+    }
+
+    d->symbol = symbol_create(kind, d->name, t);
+    bind(d->symbol);
+}
+
+// Statements are walked from an explicit stack, like codegen does, with
+// scope entries and exits as items of their own.
+typedef enum {
+    CHECK_STMTS,                // the rest of a statement list
+    CHECK_ENTER_SCOPE,
+    CHECK_ENTER_FUNCTION,       // enters a scope and binds the parameters
+    CHECK_EXIT_SCOPE
+} check_kind_t;
+
+typedef struct {
+    check_kind_t kind;
+    struct stmt *s;
+    struct decl *function;      // the function the statements belong to
+} check_work_t;
+
+static void push_check(work_stack_t *stack, check_kind_t kind, struct stmt *s, struct decl *function) {
+    check_work_t *item = work_stack_push(stack);
+    item->kind = kind;
+    item->s = s;
+    item->function = function;
+}
+
+// A body gets a scope of its own; a body that is a block shares it, just
+// as codegen prints the block's statements inside the body's braces.
+static void push_body(work_stack_t *stack, struct stmt *body, check_kind_t enter, struct decl *function) {
+    push_check(stack, CHECK_EXIT_SCOPE, NULL, function);
+
+    if (body && body->kind == STMT_BLOCK) {
+        body = body->body;
+    }
+    if (body) {
+        push_check(stack, CHECK_STMTS, body, function);
+    }
+
+    push_check(stack, enter, NULL, function);
+}
+
+static void check_condition(struct expr *condition, const char *statement) {
+    struct type *t = check_expr(condition);
+    if (t && t->kind != TYPE_BOOLEAN) {
+        type_error("condition of %s is %s, expected boolean", statement, type_name(t));
+    }
+}
+
+static void check_stmt(work_stack_t *stack, struct stmt *s, struct decl *function) {
+    struct type *return_type = function && function->type ? function->type->subtype : NULL;
+
+    switch (s->kind) {
+        case STMT_DECL:
+            if (!s->decl) break;
+
+            check_decl(s->decl, SYMBOL_LOCAL);
+            if (s->decl->code) {
+                push_body(stack, s->decl->code, CHECK_ENTER_FUNCTION, s->decl);
+            }
+            break;
+
+        case STMT_EXPR:
+            check_expr(s->expr);
+            break;
+
+        case STMT_IF_ELSE:
+            check_condition(s->expr, "if");
+            if (s->else_body) {
+                push_body(stack, s->else_body, CHECK_ENTER_SCOPE, function);
+            }
+            push_body(stack, s->body, CHECK_ENTER_SCOPE, function);
+            break;
+
+        case STMT_FOR:
+            check_expr(s->init_expr);
+            if (s->expr) {
+                check_condition(s->expr, "for");
+            }
+            check_expr(s->next_expr);
+            push_body(stack, s->body, CHECK_ENTER_SCOPE, function);
+            break;
+
+        case STMT_PRINT:
+            check_expr(s->expr);
+            for (struct expr *arg = s->expr; arg; arg = arg->right) {
+                if (!is_value_type(arg->type)) {
+                    type_error("cannot print a value of type %s", type_name(arg->type));
+                }
+            }
+            break;
+
+        case STMT_RETURN: {
+            struct type *t = s->expr ? check_expr(s->expr) : &type_void;
+
+            if (return_type && !type_equals(t, return_type)) {
+                type_error("returns %s, expected %s", type_name(t), type_name(return_type));
+            }
+            break;
+        }
+
+        case STMT_BLOCK:
+            push_check(stack, CHECK_EXIT_SCOPE, NULL, function);
+            if (s->body) {
+                push_check(stack, CHECK_STMTS, s->body, function);
+            }
+            push_check(stack, CHECK_ENTER_SCOPE, NULL, function);
+            break;
+
+        case STMT_COMMENT:
+        case STMT_MULTI_COMMENT:
+            break;
+    }
+}
+
+static void check_function_body(struct decl *d) {
+    work_stack_t stack;
+    work_stack_init(&stack, sizeof(check_work_t));
+    push_body(&stack, d->code, CHECK_ENTER_FUNCTION, d);
+
+    check_work_t item;
+    while (work_stack_pop(&stack, &item)) {
+        current_function = item.function ? item.function->name : NULL;
+
+        switch (item.kind) {
+            case CHECK_ENTER_SCOPE:
+                scope_enter();
+                break;
+
+            case CHECK_ENTER_FUNCTION:
+                scope_enter();
+                for (struct param_list *p = item.function->type->params; p; p = p->next) {
+                    p->symbol = symbol_create(SYMBOL_PARAM, p->name, p->type);
+                    bind(p->symbol);
+                }
+                break;
+
+            case CHECK_EXIT_SCOPE:
+                scope_exit();
+                break;
+
+            case CHECK_STMTS:
+                if (item.s->next) {
+                    push_check(&stack, CHECK_STMTS, item.s->next, item.function);
+                }
+                check_stmt(&stack, item.s, item.function);
+                break;
+        }
+    }
+
+    work_stack_free(&stack);
+    current_function = NULL;
+}
+
+int typecheck_program(struct decl *program) {
+    error_count = 0;
+    current_function = NULL;
+
+    scope_enter();
+
+    for (struct decl *d = program; d; d = d->next) {
+        if (d->kind == DECL_COMMENT || d->kind == DECL_MULTI_COMMENT) {
+            continue;
+        }
+
+        check_decl(d, SYMBOL_GLOBAL);
+
+        // Bound before the body is checked, so functions can recurse.
+        if (d->code && d->type && d->type->kind == TYPE_FUNCTION) {
+            check_function_body(d);
+        }
+    }
+
+    scope_exit();
+
+    return error_count;
+}
@@ -0,0 +1,25 @@
+#ifndef TYPECHECK_H
+#define TYPECHECK_H
+
+#include "ast.h"
+#include "scope.h"
+
+// Semantic pass run between parsing and code generation. It resolves every
+// name against the scoped symbol table, checks the program against the
+// B-minor typing rules, and annotates the tree: every expression gets its
+// type in e->type, names get their symbol in e->symbol, and declarations
+// and parameters get theirs in ->symbol. Later passes and codegen read
+// those fields instead of looking names up again.
+//
+// Errors are reported on stderr; returns the number found. The
+// annotations are only complete when that is zero.
+int typecheck_program(struct decl *program);
+
+// Shared instances of the non-composite types, for passes that build new
+// typed nodes.
+struct type *type_basic(type_kind_t kind);
+
+int type_equals(struct type *a, struct type *b);
+const char *type_name(struct type *t);
+
+#endif
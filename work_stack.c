@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "work_stack.h"
+
+void work_stack_init(work_stack_t *stack, size_t item_size) {
+    stack->items = NULL;
+    stack->item_size = item_size;
+    stack->count = 0;
+    stack->capacity = 0;
+}
+
+void *work_stack_push(work_stack_t *stack) {
+    if (stack->count == stack->capacity) {
+        size_t capacity = stack->capacity ? stack->capacity * 2 : 64;
+        char *items = realloc(stack->items, capacity * stack->item_size);
+        if (!items) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        stack->items = items;
+        stack->capacity = capacity;
+    }
+
+    void *item = stack->items + stack->count * stack->item_size;
+    memset(item, 0, stack->item_size);
+    stack->count++;
+
+    return item;
+}
+
+void *work_stack_top(work_stack_t *stack) {
+    if (stack->count == 0) return NULL;
+    return stack->items + (stack->count - 1) * stack->item_size;
+}
+
+int work_stack_pop(work_stack_t *stack, void *item) {
+    if (stack->count == 0) return 0;
+
+    stack->count--;
+    if (item) {
+        memcpy(item, stack->items + stack->count * stack->item_size, stack->item_size);
+    }
+
+    return 1;
+}
+
+void work_stack_free(work_stack_t *stack) {
+    free(stack->items);
+    stack->items = NULL;
+    stack->count = 0;
+    stack->capacity = 0;
+}
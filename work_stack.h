@@ -0,0 +1,31 @@
+#ifndef WORK_STACK_H
+#define WORK_STACK_H
+
+#include <stddef.h>
+
+// Growable stack of fixed-size items, used in place of the call stack by
+// the tree walks that must not overflow on deeply nested or very long
+// input. Items are copied in and out, and pointers returned by
+// work_stack_push and work_stack_top stay valid only until the next push.
+typedef struct {
+    char *items;
+    size_t item_size;
+    size_t count;
+    size_t capacity;
+} work_stack_t;
+
+void work_stack_init(work_stack_t *stack, size_t item_size);
+
+// Returns the new, zeroed top item. Running out of memory is fatal.
+void *work_stack_push(work_stack_t *stack);
+
+// Returns the top item, or NULL when the stack is empty.
+void *work_stack_top(work_stack_t *stack);
+
+// Copies the top item into item (when item is not NULL) and removes it.
+// Returns 0 when the stack is empty.
+int work_stack_pop(work_stack_t *stack, void *item);
+
+void work_stack_free(work_stack_t *stack);
+
+#endif